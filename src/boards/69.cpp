@@ -122,7 +122,7 @@ static DECLFW(M69SWrite1) {
 	int x;
 	GameExpSound.Fill = AYSound;
 	GameExpSound.HiFill = AYSoundHQ;
-	if (FSettings.SndRate)
+	if (FSettings.SndRate && !SoundSuspended)
 		switch (sndcmd) {
 		case 0:
 		case 1:
@@ -820,11 +820,55 @@ static INLINE int16 calc(OPLL * opll) {
 	return (int16)out;
 }
 
+/* Samples calc_block renders at a time */
+#define BLOCK_LEN 64
+
+/* Same as calling calc() len times.  The channels only share the LFOs, so those are
+   worked out for the whole block first and then each channel runs through the block on
+   its own, keeping its two slots hot, and a channel whose carrier has finished skips
+   the operator math for the rest of the block. */
+static void calc_block(OPLL * opll, int32 *out, int32 len) {
+	int32 lfo_pm[BLOCK_LEN], lfo_am[BLOCK_LEN];
+	int32 i, k;
+
+	for (k = 0; k < len; k++) {
+		update_ampm(opll);
+		lfo_pm[k] = opll->lfo_pm;
+		lfo_am[k] = opll->lfo_am;
+		out[k] = 0;
+	}
+
+	for (i = 0; i < 6; i++) {
+		OPLL_SLOT *mod = MOD(opll, i), *car = CAR(opll, i);
+		int silent = (opll->mask & OPLL_MASK_CH(i)) || car->eg_mode == FINISH;
+
+		for (k = 0; k < len; k++) {
+			calc_phase(mod, lfo_pm[k]);
+			calc_envelope(mod, lfo_am[k]);
+			calc_phase(car, lfo_pm[k]);
+			calc_envelope(car, lfo_am[k]);
+			/* a carrier can finish during the block but never start again in it */
+			if (!silent) {
+				if (car->eg_mode == FINISH)
+					silent = 1;
+				else
+					out[k] += calc_slot_car(car, calc_slot_mod(mod));
+			}
+		}
+	}
+}
+
 void OPLL_fillbuf(OPLL* opll, int32 *buf, int32 len, int shift) {
+	int32 out[BLOCK_LEN];
+	int32 k, n;
+
 	while (len > 0) {
-		*buf += (calc(opll) + 32768) << shift;
-		buf++;
-		len--;
+		n = len < BLOCK_LEN ? len : BLOCK_LEN;
+		calc_block(opll, out, n);
+		for (k = 0; k < n; k++)
+			buf[k] += ((int16)out[k] + 32768) << shift;
+		buf += n;
+		len -= n;
 	}
 }
 
@@ -839,8 +883,8 @@ int16 OPLL_calc(OPLL * opll) {
 	}
 
 	opll->oplltime -= opll->realstep;
-	opll->out = (int16)(((double)opll->next * (opll->opllstep - opll->oplltime)
-						   + (double)opll->prev * opll->oplltime) / opll->opllstep);
+	opll->out = (int16)(((long long)opll->next * (opll->opllstep - opll->oplltime)
+						   + (long long)opll->prev * opll->oplltime) / opll->opllstep);
 
 	return (int16)opll->out;
 }
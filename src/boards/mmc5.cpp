@@ -586,10 +586,8 @@ static void Do5PCM() {
 }
 
 static void Do5PCMHQ() {
-	uint32 V;
 	if (!(MMC5Sound.rawcontrol & 0x40) && MMC5Sound.raw)
-		for (V = MMC5Sound.BC[2]; V < SOUNDTS; V++)
-			WaveHi[V] += MMC5Sound.raw << 5;
+		WaveHiRun(MMC5Sound.BC[2], SOUNDTS, MMC5Sound.raw << 5);
 	MMC5Sound.BC[2] = SOUNDTS;
 }
 
@@ -601,17 +599,17 @@ static DECLFW(Mapper5_SW) {
 	GameExpSound.HiFill = MMC5RunSoundHQ;
 
 	switch (A) {
-	case 0x10: if (psfun) psfun(); MMC5Sound.rawcontrol = V; break;
-	case 0x11: if (psfun) psfun(); MMC5Sound.raw = V; break;
+	case 0x10: if (psfun && !SoundSuspended) psfun(); MMC5Sound.rawcontrol = V; break;
+	case 0x11: if (psfun && !SoundSuspended) psfun(); MMC5Sound.raw = V; break;
 
 	case 0x0:
 	case 0x4:
-		if (sfun) sfun(A >> 2);
+		if (sfun && !SoundSuspended) sfun(A >> 2);
 		MMC5Sound.env[A >> 2] = V;
 		break;
 	case 0x2:
 	case 0x6:
-		if (sfun) sfun(A >> 2);
+		if (sfun && !SoundSuspended) sfun(A >> 2);
 		MMC5Sound.wl[A >> 2] &= ~0x00FF;
 		MMC5Sound.wl[A >> 2] |= V & 0xFF;
 		break;
@@ -622,7 +620,7 @@ static DECLFW(Mapper5_SW) {
 		MMC5Sound.running |= 1 << (A >> 2);
 		break;
 	case 0x15:
-		if (sfun) {
+		if (sfun && !SoundSuspended) {
 			sfun(0);
 			sfun(1);
 		}
@@ -669,7 +667,7 @@ static void Do5SQ(int P) {
 
 static void Do5SQHQ(int P) {
 	static int tal[4] = { 1, 2, 4, 6 };
-	uint32 V;
+	int32 V, n, end = SOUNDTS;
 	int32 amp, rthresh, wl;
 
 	wl = MMC5Sound.wl[P] + 1;
@@ -683,10 +681,14 @@ static void Do5SQHQ(int P) {
 
 		dc = MMC5Sound.dcount[P];
 		vc = MMC5Sound.vcount[P];
-		for (V = MMC5Sound.BC[P]; V < SOUNDTS; V++) {
+		/* A run of cycles from one timer reload to the next at a time. */
+		for (V = MMC5Sound.BC[P]; V < end; V += n) {
+			n = vc > 0 ? vc : 1;
+			if (n > end - V)
+				n = end - V;
 			if (dc < rthresh)
-				WaveHi[V] += amp;
-			vc--;
+				WaveHiRun(V, V + n, amp);
+			vc -= n;
 			if (vc <= 0) { /* Less than zero when first started. */
 				vc = wl;
 				dc = (dc + 1) & 7;
@@ -772,6 +774,8 @@ static void GenMMC5Reset(void) {
 
 	NTAMirroring = NTFill = ATFill = 0xFF;
 
+	memset(&MMC5Sound, 0, sizeof(MMC5Sound));
+
 	MMC5Synco();
 
 	SetWriteHandler(0x4020, 0x5bff, Mapper5_write);
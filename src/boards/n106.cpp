@@ -158,7 +158,8 @@ static DECLFW(Mapper19_write) {
 		case 0x4800:
 			if (dopol & 0x40) {
 				if (FSettings.SndRate) {
-					NamcoSoundHack();
+					if (!SoundSuspended)
+						NamcoSoundHack();
 					GameExpSound.Fill = NamcoSound;
 					GameExpSound.HiFill = DoNamcoSoundHQ;
 					GameExpSound.HiSync = SyncHQ;
@@ -248,8 +249,18 @@ static INLINE uint32 FetchDuff(uint32 P, uint32 envelope) {
 	return(duff);
 }
 
+// adds v to WaveHi for half cycles start to end-1
+static INLINE void HalfRun(int32 start, int32 end, uint32 v) {
+	if (start & 1)
+		WaveHi[start++ >> 1] += v;
+	if (start < end)
+		WaveHiRun(start >> 1, end >> 1, v << 1);
+	if (end & 1)
+		WaveHi[end >> 1] += v;
+}
+
 static void DoNamcoSoundHQ(void) {
-	int32 P, V;
+	int32 P, V, n, end = SOUNDTS << 1;
 	int32 cyclesuck = (((IRAM[0x7F] >> 4) & 7) + 1) * 15;
 
 	for (P = 7; P >= (7 - ((IRAM[0x7F] >> 4) & 7)); P--) {
@@ -263,16 +274,21 @@ static void DoNamcoSoundHQ(void) {
 			envelope = EnvCache[P];
 			lengo = LengthCache[P];
 
+			// a sample holds for vco + 1 half cycles, then the next is fetched
 			duff2 = FetchDuff(P, envelope);
-			for (V = CVBC << 1; V < (int)SOUNDTS << 1; V++) {
-				WaveHi[V >> 1] += duff2;
-				if (!vco) {
+			for (V = CVBC << 1; V < end; V += n) {
+				n = vco + 1;
+				if (n > end - V)
+					n = end - V;
+				if (duff2)
+					HalfRun(V, V + n, duff2);
+				vco -= n;
+				if (vco < 0) {
 					PlayIndex[P] += freq;
 					while ((PlayIndex[P] >> TOINDEX) >= lengo) PlayIndex[P] -= lengo << TOINDEX;
 					duff2 = FetchDuff(P, envelope);
-					vco = cyclesuck;
+					vco = cyclesuck - 1;
 				}
-				vco--;
 			}
 			vcount[P] = vco;
 		}
@@ -351,9 +367,14 @@ void Mapper19_ESI(void) {
 }
 
 void NSFN106_Init(void) {
+	int x;
 	SetWriteHandler(0xf800, 0xffff, Mapper19_write);
 	SetWriteHandler(0x4800, 0x4fff, Mapper19_write);
 	SetReadHandler(0x4800, 0x4fff, Namco_Read4800);
+	FCEU_dwmemset(IRAM, 0, 128);
+	for (x = 0x40; x < 0x80; x++)
+		FixCache(x, 0);
+	dopol = 0;
 	Mapper19_ESI();
 }
 
@@ -50,6 +50,13 @@ static int32 cvbc[3];
 static int32 vcount[3];
 static int32 dcount[2];
 
+//saw accumulator and the step it is on, and for low quality sound the
+//timer and the current output
+static int32 phaseacc;
+static uint8 b3;
+static int32 saw1phaseacc;
+static uint32 duff;
+
 static SFORMAT SStateRegs[] =
 {
 	{ vpsg1, 8, "PSG1" },
@@ -78,13 +85,13 @@ static DECLFW(VRC6SW) {
 	A &= 0xF003;
 	if (A >= 0x9000 && A <= 0x9002) {
 		vpsg1[A & 3] = V;
-		if (sfun[0]) sfun[0]();
+		if (sfun[0] && !SoundSuspended) sfun[0]();
 	} else if (A >= 0xA000 && A <= 0xA002) {
 		vpsg1[4 | (A & 3)] = V;
-		if (sfun[1]) sfun[1]();
+		if (sfun[1] && !SoundSuspended) sfun[1]();
 	} else if (A >= 0xB000 && A <= 0xB002) {
 		vpsg2[A & 3] = V;
-		if (sfun[2]) sfun[2]();
+		if (sfun[2] && !SoundSuspended) sfun[2]();
 	}
 }
 
@@ -122,12 +129,15 @@ static DECLFW(VRC6Write) {
 	}
 }
 
+static void VRC6SoundReset(void);
+
 static void VRC6Power(void) {
 	Sync();
 	SetReadHandler(0x6000, 0xFFFF, CartBR);
 	SetWriteHandler(0x6000, 0x7FFF, CartBW);
 	SetWriteHandler(0x8000, 0xFFFF, VRC6Write);
 	FCEU_CheatAddRAM(WRAMSIZE >> 10, 0x6000, WRAM);
+	VRC6SoundReset();
 }
 
 static void VRC6IRQHook(int a) {
@@ -209,11 +219,7 @@ static void DoSawV(void) {
 	cvbc[2] = end;
 
 	if (vpsg2[2] & 0x80) {
-		static int32 saw1phaseacc = 0;
 		uint32 freq3;
-		static uint8 b3 = 0;
-		static int32 phaseacc = 0;
-		static uint32 duff = 0;
 
 		freq3 = (vpsg2[1] + ((vpsg2[2] & 15) << 8) + 1);
 
@@ -240,20 +246,24 @@ static void DoSawV(void) {
 	}
 }
 
+// the high quality channels render a run of cycles from one timer reload to the next at a time.
+// a timer at or below zero still holds its output for one cycle.
 static INLINE void DoSQVHQ(int x) {
-	int32 V;
+	int32 V, n, end = SOUNDTS;
 	int32 amp = ((vpsg1[x << 2] & 15) << 8) * 6 / 8;
 
 	if (vpsg1[(x << 2) | 0x2] & 0x80) {
-		if (vpsg1[x << 2] & 0x80) {
-			for (V = cvbc[x]; V < (int)SOUNDTS; V++)
-				WaveHi[V] += amp;
-		} else {
+		if (vpsg1[x << 2] & 0x80)
+			WaveHiRun(cvbc[x], end, amp);
+		else {
 			int32 thresh = (vpsg1[x << 2] >> 4) & 7;
-			for (V = cvbc[x]; V < (int)SOUNDTS; V++) {
+			for (V = cvbc[x]; V < end; V += n) {
+				n = vcount[x] > 0 ? vcount[x] : 1;
+				if (n > end - V)
+					n = end - V;
 				if (dcount[x] > thresh)
-					WaveHi[V] += amp;
-				vcount[x]--;
+					WaveHiRun(V, V + n, amp);
+				vcount[x] -= n;
 				if (vcount[x] <= 0) {
 					vcount[x] = (vpsg1[(x << 2) | 0x1] | ((vpsg1[(x << 2) | 0x2] & 15) << 8)) + 1;
 					dcount[x] = (dcount[x] + 1) & 15;
@@ -273,14 +283,15 @@ static void DoSQV2HQ(void) {
 }
 
 static void DoSawVHQ(void) {
-	static uint8 b3 = 0;
-	static int32 phaseacc = 0;
-	int32 V;
+	int32 V, n, end = SOUNDTS;
 
 	if (vpsg2[2] & 0x80) {
-		for (V = cvbc[2]; V < (int)SOUNDTS; V++) {
-			WaveHi[V] += (((phaseacc >> 3) & 0x1f) << 8) * 6 / 8;
-			vcount[2]--;
+		for (V = cvbc[2]; V < end; V += n) {
+			n = vcount[2] > 0 ? vcount[2] : 1;
+			if (n > end - V)
+				n = end - V;
+			WaveHiRun(V, V + n, (((phaseacc >> 3) & 0x1f) << 8) * 6 / 8);
+			vcount[2] -= n;
 			if (vcount[2] <= 0) {
 				vcount[2] = (vpsg2[1] + ((vpsg2[2] & 15) << 8) + 1) << 1;
 				phaseacc += vpsg2[0] & 0x3f;
@@ -317,6 +328,15 @@ void VRC6SyncHQ(int32 ts) {
 	for (x = 0; x < 3; x++) cvbc[x] = ts;
 }
 
+static void VRC6SoundReset(void) {
+	memset(vpsg1, 0, sizeof(vpsg1));
+	memset(vpsg2, 0, sizeof(vpsg2));
+	phaseacc = 0;
+	b3 = 0;
+	saw1phaseacc = 0;
+	duff = 0;
+}
+
 static void VRC6_ESI(void) {
 	GameExpSound.RChange = VRC6_ESI;
 	GameExpSound.Fill = VRC6Sound;
@@ -373,6 +393,7 @@ void Mapper26_Init(CartInfo *info) {
 }
 
 void NSFVRC6_Init(void) {
+	VRC6SoundReset();
 	VRC6_ESI();
 	SetWriteHandler(0x8000, 0xbfff, VRC6SW);
 }
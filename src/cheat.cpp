@@ -26,6 +26,7 @@
 #include "file.h"
 #include "cart.h"
 #include "driver.h"
+#include "state.h"
 #include "utils/memory.h"
 
 #include <string>
@@ -438,7 +439,10 @@ void FCEU_ApplyPeriodicCheats(void)
 	{
 		if(cur->status && !(cur->type))
 			if(CheatRPtrs[cur->addr>>10])
+			{
 				CheatRPtrs[cur->addr>>10][cur->addr]=cur->val;
+				StateHashDirty=~0U;
+			}
 		if(cur->next)
 			cur=cur->next;
 		else
@@ -944,7 +948,10 @@ int FCEU_CheatGetByte(uint32 A)
 void FCEU_CheatSetByte(uint32 A, uint8 V)
 {
    if(CheatRPtrs[A>>10])
+   {
     CheatRPtrs[A>>10][A]=V;
+    StateHashDirty=~0U;
+   }
    else if(A < 0x10000)
     BWrite[A](A, V);
 }
@@ -8,6 +8,7 @@
 #include "debug.h"
 #include "driver.h"
 #include "ppu.h"
+#include "trace.h"
 
 #include "x6502abbrev.h"
 
@@ -393,7 +394,6 @@ int condition(watchpointinfo* wp)
 volatile int codecount, datacount, undefinedcount;
 unsigned char *cdloggerdata;
 unsigned int cdloggerdataSize = 0;
-static int indirectnext;
 
 int debug_loggingCD;
 
@@ -417,43 +417,6 @@ void LogCDVectors(int which){
 	}
 }
 
-void LogCDData(uint8 *opcode, uint16 A, int size) {
-	int i, j;
-	uint8 memop = 0;
-
-	if((j = GetPRGAddress(_PC)) != -1)
-		for (i = 0; i < size; i++) {
-			if(cdloggerdata[j+i] & 1)continue; //this has been logged so skip
-			cdloggerdata[j+i] |= 1;
-			cdloggerdata[j+i] |= ((_PC + i) >> 11) & 0x0c;
-			cdloggerdata[j+i] |= ((_PC & 0x8000) >> 8) ^ 0x80;	// 19/07/14 used last reserved bit, if bit 7 is 1, then code is running from lowe area (6000)
-			if(indirectnext)cdloggerdata[j+i] |= 0x10;
-			codecount++;
-			if(!(cdloggerdata[j+i] & 2))undefinedcount--;
-		}
-
-	//log instruction jumped to in an indirect jump
-	if(opcode[0] == 0x6c)
-		indirectnext = 1;
-	else
-		indirectnext = 0;
-
-	switch (optype[opcode[0]]) {
-		case 1:
-		case 4: memop = 0x20; break;
-	}
-
-	if((j = GetPRGAddress(A)) != -1) {
-		if(!(cdloggerdata[j] & 2)) {
-			cdloggerdata[j] |= 2;
-			cdloggerdata[j] |=(A>>11)&0x0c;
-			cdloggerdata[j] |= memop;
-			datacount++;
-			if(!(cdloggerdata[j] & 1))undefinedcount--;
-		}
-	}
-}
-
 //-----------debugger stuff
 
 watchpointinfo watchpoint[65]; //64 watchpoints, + 1 reserved for step over
@@ -526,6 +489,7 @@ void BreakHit(int bp_num, bool force)
 		}
 	}
 
+	FCEU_TraceBreak();
 	FCEUI_SetEmulationPaused(EMULATIONPAUSED_PAUSED); //mbg merge 7/19/06 changed to use EmulationPaused()
 
 #ifdef WIN32
@@ -756,6 +720,24 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 }
 //bbit edited: this is the end of the inserted code
 
+static INLINE bool BreakpointsActive()
+{
+	return numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap;
+}
+
+#ifdef WIN32
+extern volatile int logging;
+#endif
+
+bool DebuggerActive()
+{
+#ifdef WIN32
+	if (logging)
+		return true;
+#endif
+	return BreakpointsActive();
+}
+
 void DebugCycle()
 {
 	uint8 opcode[3] = {0};
@@ -809,12 +791,9 @@ void DebugCycle()
 	}
 	addressOfTheLastAccessedData = A;
 
-	if (numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap)
+	if (BreakpointsActive())
 		breakpoint(opcode, A, size);
 
-	if(debug_loggingCD)
-		LogCDData(opcode, A, size);
-
 #ifdef WIN32
 	//This needs to be windows only or else the linux build system will fail since logging is declared in a
 	//windows source file
@@ -74,10 +74,13 @@ uint8 GetPPUMem(uint8 A);
 
 //---------CDLogger
 void LogCDVectors(int which);
-void LogCDData(uint8 *opcode, uint16 A, int size);
 extern volatile int codecount, datacount, undefinedcount;
 extern unsigned char *cdloggerdata;
 extern unsigned int cdloggerdataSize;
+//the chr half, logged by the ppu
+extern volatile int rendercount, vromreadcount, undefinedvromcount;
+extern unsigned char *cdloggervdata;
+extern unsigned int cdloggerVideoDataSize;
 
 extern int debug_loggingCD;
 static INLINE void FCEUI_SetLoggingCD(int val) { debug_loggingCD = val; }
@@ -95,6 +98,9 @@ static INLINE int FCEUI_GetLoggingCD() { return debug_loggingCD; }
 extern int iaPC;
 extern uint32 iapoffset; //mbg merge 7/18/06 changed from int
 void DebugCycle();
+//whether DebugCycle has breakpoints to check or instructions to trace. the cpu core only calls it
+//while this is true; the code/data logger runs in the cpu loop itself
+bool DebuggerActive();
 void BreakHit(int bp_num, bool force = false);
 
 extern bool break_asap;
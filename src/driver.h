@@ -59,6 +59,7 @@ void FCEUD_NetworkClose(void);
 
 bool FCEUI_BeginWaveRecord(const char *fn);
 int FCEUI_EndWaveRecord(void);
+bool FCEUI_WaveRecordRunning(void);
 
 void FCEUI_ResetNES(void);
 void FCEUI_PowerNES(void);
@@ -108,6 +109,12 @@ bool FCEUI_Initialize();
 //Emulates a frame.
 void FCEUI_Emulate(uint8 **, int32 **, int32 *, int);
 
+//the scanlines of the picture that changed since the last call, one bit per line (bit y&31 of
+//word y>>5). it covers every picture since then, so a driver that drops frames can still redraw
+//only these lines; anything it did not keep from the last call must be redrawn in full anyway.
+#define FCEU_DIRTY_WORDS 8
+void FCEUI_TakeDirtyLines(uint32 *lines);
+
 //Closes currently loaded game
 void FCEUI_CloseGame(void);
 
@@ -156,6 +163,10 @@ void FCEUI_SetPCMVolume(uint32 volume);
 
 void FCEUI_SetSoundQuality(int quality);
 
+//Renders high quality sound (quality 1 and 2) from band-limited steps instead of running the
+//FIR filter over every cpu cycle.  Sounds the same and is much cheaper.
+void FCEUI_SetStepSynth(int enable);
+
 void FCEUD_SoundToggle(void);
 void FCEUD_SoundVolumeAdjust(int);
 
@@ -20,12 +20,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "hq3x.h"
 
-static int   *LUT16to32 = NULL;
-static int   *RGBtoYUV = NULL;
-static int   YUV1, YUV2;
+// the input is palette classes (see hq3x_SetPalette), so what the filter needs is per class:
+// its 32 bit color, and a bit for each class that it is different enough from
+static int *ClassTo32=NULL;
+static unsigned int *DiffBits=NULL;
+static int DiffStride;
 static const  int   Ymask = 0x00FF0000;
 static const  int   Umask = 0x0000FF00;
 static const  int   Vmask = 0x000000FF;
@@ -120,19 +126,50 @@ inline void Interp5(unsigned char * pc, int c1, int c2)
 
 static inline int Diff(unsigned int w1, unsigned int w2)
 {
-  YUV1 = RGBtoYUV[w1];
-  YUV2 = RGBtoYUV[w2];
-  return ( ( abs((YUV1 & Ymask) - (YUV2 & Ymask)) > trY ) ||
-           ( abs((YUV1 & Umask) - (YUV2 & Umask)) > trU ) ||
-           ( abs((YUV1 & Vmask) - (YUV2 & Vmask)) > trV ) );
+  return (DiffBits[w1*DiffStride + (w2>>5)] >> (w2&31)) & 1;
 }
 
-void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL )
+// Marks the pixels whose eight neighbours all are of their class. Their pattern is 0, and any
+// interpolation of equal colors is that color, so they only need a plain block.
+static inline int Flat(const unsigned short *p, const unsigned short *c, const unsigned short *n, int l, int i, int r)
+{
+  unsigned short v = c[i];
+  return p[l] == v && p[i] == v && p[r] == v && c[l] == v && c[r] == v && n[l] == v && n[i] == v && n[r] == v;
+}
+
+static void FlatRow(const unsigned short *p, const unsigned short *c, const unsigned short *n, int Xres, unsigned char *flat)
+{
+  int i;
+
+  flat[0] = Flat(p, c, n, 0, 0, Xres > 1 ? 1 : 0);
+  i = 1;
+#ifdef __SSE2__
+  // eight pixels at a time, away from the edges where the neighbours are clamped
+  for (; i + 8 < Xres; i += 8)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(c + i));
+    __m128i e = _mm_and_si128(_mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(c + i - 1))),
+                              _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(c + i + 1))));
+    e = _mm_and_si128(e, _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(p + i - 1))));
+    e = _mm_and_si128(e, _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(p + i))));
+    e = _mm_and_si128(e, _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(p + i + 1))));
+    e = _mm_and_si128(e, _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(n + i - 1))));
+    e = _mm_and_si128(e, _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(n + i))));
+    e = _mm_and_si128(e, _mm_cmpeq_epi16(v, _mm_loadu_si128((const __m128i*)(n + i + 1))));
+    _mm_storel_epi64((__m128i*)(flat + i), _mm_packs_epi16(e, e));
+  }
+#endif
+  for (; i < Xres; i++)
+    flat[i] = Flat(p, c, n, i - 1, i, i < Xres - 1 ? i + 1 : i);
+}
+
+void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, const unsigned int *rows )
 {
   int  i, j, k;
   int  prevline, nextline;
   int  w[10];
   int  c[10];
+  unsigned char flat[256];
 
   //   +----+----+----+
   //   |    |    |    |
@@ -147,14 +184,37 @@ void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
 
   for (j=0; j<Yres; j++)
   {
+    if (rows && !((rows[j>>5] >> (j&31)) & 1))
+    {
+      pIn+=Xres*2;
+      pOut+=BpL*3;
+      continue;
+    }
+
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
 
+    FlatRow((unsigned short*)(pIn + prevline), (unsigned short*)pIn, (unsigned short*)(pIn + nextline), Xres, flat);
+
     for (i=0; i<Xres; i++)
     {
       int pattern;
       int flag;
 
+      if (flat[i])
+      {
+        int c5 = ClassTo32[*((unsigned short*)pIn)];
+        for (k=0; k<3; k++)
+        {
+          *((int*)(pOut+k*BpL)) = c5;
+          *((int*)(pOut+k*BpL+4)) = c5;
+          *((int*)(pOut+k*BpL+8)) = c5;
+        }
+        pIn+=2;
+        pOut+=12;
+        continue;
+      }
+
       w[2] = *((unsigned short*)(pIn + prevline));
       w[5] = *((unsigned short*)pIn);
       w[8] = *((unsigned short*)(pIn + nextline));
@@ -188,25 +248,17 @@ void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
       pattern = 0;
       flag = 1;
 
-      YUV1 = RGBtoYUV[w[5]];
-
       for (k=1; k<=9; k++)
       {
         if (k==5) continue;
 
-        if ( w[k] != w[5] )
-        {
-          YUV2 = RGBtoYUV[w[k]];
-          if ( ( abs((YUV1 & Ymask) - (YUV2 & Ymask)) > trY ) ||
-               ( abs((YUV1 & Umask) - (YUV2 & Umask)) > trU ) ||
-               ( abs((YUV1 & Vmask) - (YUV2 & Vmask)) > trV ) )
-            pattern |= flag;
-        }
+        if ( w[k] != w[5] && Diff(w[5], w[k]) )
+          pattern |= flag;
         flag <<= 1;
       }
 
       for (k=1; k<=9; k++)
-        c[k] = LUT16to32[w[k]];
+        c[k] = ClassTo32[w[k]];
 
       switch (pattern)
       {
@@ -3834,32 +3886,49 @@ void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int
 
 int hq3x_InitLUTs(void)
 {
-  int i, j, k, r, g, b, Y, u, v;
+  // everything is class 0 (black) until the palette is set
+  if(!(ClassTo32 = (int*)calloc(HQ_MAXCOLORS, sizeof(int)))) return(0);
+  if(!(DiffBits = (unsigned int*)calloc(HQ_MAXCOLORS * ((HQ_MAXCOLORS + 31) >> 5), sizeof(unsigned int)))) { free(ClassTo32); return(0); }
+  DiffStride = 1;
+  return(1);
+}
 
-  if(!(LUT16to32 = (int*)malloc(65536*sizeof(int)))) return(0); //mbg merge 7/17/06 
-  if(!(RGBtoYUV = (int*)malloc(65536*sizeof(int)))) { free(LUT16to32); return(0); } //mbg merge 7/17/06 
+void hq3x_SetPalette(const unsigned short *colors, int count)
+{
+  int i, j, Y, u, v, r, g, b;
+  int yuv[HQ_MAXCOLORS];
 
-  for (i=0; i<65536; i++)
-    LUT16to32[i] = ((i & 0xF800) << 8) + ((i & 0x07E0) << 5) + ((i & 0x001F) << 3);
+  if (count > HQ_MAXCOLORS) count = HQ_MAXCOLORS;
 
-  for (i=0; i<32; i++)
-  for (j=0; j<64; j++)
-  for (k=0; k<32; k++)
+  for (i=0; i<count; i++)
   {
-    r = i << 3;
-    g = j << 2;
-    b = k << 3;
+    ClassTo32[i] = ((colors[i] & 0xF800) << 8) + ((colors[i] & 0x07E0) << 5) + ((colors[i] & 0x001F) << 3);
+
+    r = (colors[i] >> 11) << 3;
+    g = ((colors[i] >> 5) & 0x3F) << 2;
+    b = (colors[i] & 0x1F) << 3;
     Y = (r + g + b) >> 2;
     u = 128 + ((r - b) >> 2);
     v = 128 + ((-r + 2*g -b)>>3);
-    RGBtoYUV[ (i << 11) + (j << 5) + k ] = (Y<<16) + (u<<8) + v;
+    yuv[i] = (Y<<16) + (u<<8) + v;
+  }
+
+  DiffStride = (count + 31) >> 5;
+  memset(DiffBits, 0, count * DiffStride * sizeof(unsigned int));
+  for (i=0; i<count; i++)
+  for (j=0; j<count; j++)
+  {
+    if ( ( abs((yuv[i] & Ymask) - (yuv[j] & Ymask)) > trY ) ||
+         ( abs((yuv[i] & Umask) - (yuv[j] & Umask)) > trU ) ||
+         ( abs((yuv[i] & Vmask) - (yuv[j] & Vmask)) > trV ) )
+      DiffBits[i*DiffStride + (j>>5)] |= 1u << (j&31);
   }
- return(1);
 }
 
 void hq3x_Kill(void)
 {
- free(LUT16to32);
- free(RGBtoYUV);
+ free(ClassTo32);
+ free(DiffBits);
+ ClassTo32 = NULL;
+ DiffBits = NULL;
 }
-
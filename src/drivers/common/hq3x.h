@@ -1,4 +1,15 @@
-void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL);
+#ifndef HQ_MAXCOLORS
+// palette classes hq2x/hq3x can tell apart: 256 colors and the 512 of the deemphasis palette
+#define HQ_MAXCOLORS (256+512)
+#endif
+
+//pIn holds 16 bit palette classes, not colors. rows are at most 256 pixels.
+//rows, when given, has a bit for each input row (bit j&31 of word j>>5) whose output is wanted;
+//the output of the others is left alone
+void hq3x_32( unsigned char * pIn, unsigned char * pOut, int Xres, int Yres, int BpL, const unsigned int *rows = 0);
 int hq3x_InitLUTs(void);
+//colors are the 565 colors of the classes, at most HQ_MAXCOLORS of them
+void hq3x_SetPalette(const unsigned short *colors, int count);
 void hq3x_Kill(void);
 
+
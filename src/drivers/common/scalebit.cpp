@@ -385,3 +385,33 @@ void scale(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_
 	}
 }
 
+/**
+ * Apply the Scale effect on some rows of a bitmap.
+ * Only the destination rows of the source rows from first to first+count-1 are written. The
+ * rows around them are still read, so they come out the same as with ::scale().
+ * Only scale 2 and 3 are supported.
+ * \param first First source row to scale.
+ * \param count Number of source rows to scale.
+ * The other parameters are the same as for ::scale().
+ */
+void scale_part(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_src, unsigned src_slice, unsigned pixel, unsigned width, unsigned height, unsigned first, unsigned count)
+{
+	unsigned char* dst = (unsigned char*)void_dst;
+	const unsigned char* src = (unsigned char*)void_src;
+	unsigned y;
+
+	for (y = first; y < first + count; ++y) {
+		const unsigned char* src0 = SCSRC(y > 0 ? y - 1 : 0);
+		const unsigned char* src2 = SCSRC(y + 1 < height ? y + 1 : y);
+		unsigned char* dst0 = SCDST(y * scale);
+
+		if (scale == 2)
+			stage_scale2x(dst0, dst0 + dst_slice, src0, SCSRC(y), src2, pixel, width);
+		else
+			stage_scale3x(dst0, dst0 + dst_slice, dst0 + 2 * dst_slice, src0, SCSRC(y), src2, pixel, width);
+	}
+
+#if defined(__GNUC__) && defined(__i386__)
+	scale2x_mmx_emms();
+#endif
+}
@@ -19,6 +19,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "scalebit.h"
 #include "hq2x.h"
@@ -26,6 +27,7 @@
 
 #include "../../fceu.h"
 #include "../../types.h"
+#include "../../driver.h"
 #include "../../palette.h"
 #include "../../utils/memory.h"
 #include "nes_ntsc.h"
@@ -47,12 +49,26 @@ static int Bpp;	// BYTES per pixel
 static int highefx;
 //static uint32 backmask[3];
 
-static uint16 *specbuf=NULL;		// 8bpp -> 16bpp, pre hq2x/hq3x
+static uint16 *specbuf=NULL;		// 8bpp -> palette classes, pre hq2x/hq3x
+static uint16 hqclass[256+512];		// palettetranslate index -> hq2x/hq3x palette class
 static uint32 *specbuf32bpp= NULL;	// Buffer to hold output of hq2x/hq3x when converting to 16bpp and 24bpp
 static uint8  *specbuf8bpp = NULL;	// For 2xscale, 3xscale.
-static uint8  *ntscblit    = NULL;	// For nes_ntsc
+static uint8  *ntscblit    = NULL;	// For nes_ntsc, the output of both burst phases
+#define NTSC_ROWS 2			// output rows of nes_ntsc per input row
+#define NTSC_SPILL 64			// bytes a row of its output can run into the next
+static int     ntscsize;		// bytes of the output of one burst phase
+static uint32  ntscstale[2][FCEU_DIRTY_WORDS];	// rows of each that changed since it was drawn
 static uint32 *prescalebuf = NULL;	// Prescale pointresizes to 2x-4x to allow less blur with hardware acceleration.
 
+//what the last blit drew, to tell whether its output can be kept
+struct BlitTarget
+{
+	bool valid;
+	uint8 *dest;
+	int xr, yr, pitch, xscale, yscale, filter;
+};
+static BlitTarget lastblit, lastblit8;
+
 //////////////////////
 // PAL filter start //
 //////////////////////
@@ -134,8 +150,9 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 		
 		if ( nes_ntsc )
 		{
-			nes_ntsc_init( nes_ntsc, &ntsc_setup, b, 2 );			
-			ntscblit = (uint8*)FCEU_dmalloc(256*257*b*multi); //Need to add multiplier for larger sizes
+			nes_ntsc_init( nes_ntsc, &ntsc_setup, b, NTSC_ROWS );			
+			ntscsize = 256*257*b*multi; //Need to add multiplier for larger sizes
+			ntscblit = (uint8*)FCEU_dmalloc(ntscsize*2);
 		}
 		
 	} // -Video Modes Tag-
@@ -194,6 +211,7 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 			hq3x_InitLUTs();
 		else
 			hq2x_InitLUTs();
+		memset(hqclass, 0, sizeof(hqclass));
 		
 		specbuf=(uint16*)FCEU_dmalloc(256*240*sizeof(uint16)); //mbg merge 7/17/06 added cast
 	}
@@ -212,6 +230,7 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 
 	silt = specfilt;	
 	Bpp=b;	
+	lastblit.valid = false;
 	highefx=efx;
 	
 	if(Bpp<=1 || Bpp>4)
@@ -232,6 +251,7 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 
 void KillBlitToHigh(void)
 {
+	lastblit.valid = false;
 	if(palettetranslate)
 	{
 		free(palettetranslate);
@@ -280,12 +300,39 @@ void KillBlitToHigh(void)
 }
 
 
+// hq2x and hq3x work on palette classes: every distinct 16bpp color of the palette and the
+// deemphasis palette is a class, so that how similar two pixels are is a table lookup
+static void SetPaletteHQ()
+{
+	uint16 colors[256+512];
+	int count = 0;
+	
+	for(int x=0;x<256+512;x++)
+	{
+		uint16 color = palettetranslate[x];
+		int c;
+		for(c=0;c<count;c++)
+			if(colors[c] == color)
+				break;
+		if(c == count)
+			colors[count++] = color;
+		hqclass[x] = c;
+	}
+	
+	// -Video Modes Tag-
+	if(silt == 4)
+		hq3x_SetPalette(colors, count);
+	else
+		hq2x_SetPalette(colors, count);
+}
+
 void SetPaletteBlitToHigh(uint8 *src)
 { 
 	int cshiftr[3];
 	int cshiftl[3];
 	
 	CalculateShift(CBM, cshiftr, cshiftl);
+	lastblit.valid = false;
 
 	switch(Bpp)
 	{
@@ -316,6 +363,9 @@ void SetPaletteBlitToHigh(uint8 *src)
 			}
 		}
 
+		if(specbuf)
+			SetPaletteHQ();
+
 		break;
 
 	case 3:
@@ -401,21 +451,63 @@ void Blit32to16(uint32 *src, uint16 *dest, int xr, int yr, int dpitch, int shift
 }
 
 
-void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special)
+#define ROW_SET(rows, y) (((rows)[(y) >> 5] >> ((y) & 31)) & 1)
+
+//fills rows with the rows of the blit that need drawing, counted from its first row: all of them,
+//unless dirty is given and the last blit went to the same place the same way. filters reading
+//spread rows above and below redraw that many around each dirty line. false when none need it.
+static bool BlitRows(BlitTarget *last, uint32 *rows, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int filter, const uint32 *dirty, int firstline, int spread)
 {
-	int x,y;
+	bool full = !dirty || !last->valid || last->dest != dest || last->xr != xr || last->yr != yr ||
+		last->pitch != pitch || last->xscale != xscale || last->yscale != yscale || last->filter != filter;
+	bool any = false;
+
+	last->valid = true;
+	last->dest = dest;
+	last->xr = xr;
+	last->yr = yr;
+	last->pitch = pitch;
+	last->xscale = xscale;
+	last->yscale = yscale;
+	last->filter = filter;
+
+	memset(rows, 0, FCEU_DIRTY_WORDS*sizeof(uint32));
+	for(int y=0;y<yr;y++)
+	{
+		if(!full && !ROW_SET(dirty, firstline + y))
+			continue;
+		int from = y-spread < 0 ? 0 : y-spread;
+		int to = y+spread >= yr ? yr-1 : y+spread;
+		for(int r=from;r<=to;r++)
+			rows[r>>5] |= 1u<<(r&31);
+		any = true;
+	}
+	return any;
+}
+
+//the run of rows to draw that starts at or after *y; its length, 0 when there are no more
+static int NextRows(const uint32 *rows, int yr, int *y)
+{
+	int n = 0;
+	while(*y < yr && !ROW_SET(rows, *y))
+		(*y)++;
+	while(*y + n < yr && ROW_SET(rows, *y + n))
+		n++;
+	return n;
+}
+
+static void Blit8To8Rows(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int special, const uint32 *rows)
+{
+	int x,y,n;
 	int pinc;
 	
-	// -Video Modes Tag-
-	if(special==3) //NTSC 2x
-		return; //Incompatible with 8-bit output. This is here for SDL.
-	
 	// -Video Modes Tag-
 	if(special==2)
 	{
 		if(xscale!=2 || yscale!=2) return;
 		
-		scale(2,dest,pitch,src,256,1,xr,yr);
+		for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
+			scale_part(2,dest,pitch,src,256,1,xr,yr,first,n);
 		return;
 	}
 	
@@ -423,43 +515,79 @@ void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, in
 	if(special==5)
 	{
 		if(xscale!=3 || yscale!=3) return;
-		scale(3,dest,pitch,src,256,1,xr,yr);
+		for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
+			scale_part(3,dest,pitch,src,256,1,xr,yr,first,n);
 		return;
 	}     
 	
 	pinc=pitch-(xr*xscale);
-	if(xscale!=1 || yscale!=1)
+	for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
 	{
-		for(y=yr;y;y--,src+=256-xr)
+		uint8 *s=src+first*256;
+		uint8 *d=dest+first*yscale*pitch;
+
+		if(xscale!=1 || yscale!=1)
 		{
-			int doo=yscale;
-			do
+			for(y=n;y;y--,s+=256-xr)
 			{
-				for(x=xr;x;x--,src++)
+				int doo=yscale;
+				do
 				{
-					int too=xscale;
-					do
+					for(x=xr;x;x--,s++)
 					{
-						*(uint8 *)dest=*(uint8 *)src;
-						dest++;
-					} while(--too);
-				}
-				src-=xr;
-				dest+=pinc;
-			} while(--doo);
-			src+=xr;
+						int too=xscale;
+						do
+						{
+							*(uint8 *)d=*(uint8 *)s;
+							d++;
+						} while(--too);
+					}
+					s-=xr;
+					d+=pinc;
+				} while(--doo);
+				s+=xr;
+			}
+		}
+		else
+		{
+			for(y=n;y;y--,d+=pinc,s+=256-xr)
+				for(x=xr;x;x-=4,d+=4,s+=4)
+					*(uint32 *)d=*(uint32 *)s;
 		}
 	}
-	else
-	{
-		for(y=yr;y;y--,dest+=pinc,src+=256-xr)
-			for(x=xr;x;x-=4,dest+=4,src+=4)
-				*(uint32 *)dest=*(uint32 *)src;
-	}
+}
+
+void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special, const uint32 *dirty, int firstline)
+{
+	uint32 rows[FCEU_DIRTY_WORDS];
+	
+	// -Video Modes Tag-
+	if(special==3) //NTSC 2x
+		return; //Incompatible with 8-bit output. This is here for SDL.
+	
+	// scale2x and scale3x look at the rows next to each
+	if(BlitRows(&lastblit8, rows, dest, xr, yr, pitch, xscale, yscale, special, dirty, firstline, (special==2 || special==5) ? 1 : 0))
+		Blit8To8Rows(src, dest, xr, yr, pitch, xscale, yscale, special, rows);
 }
 
 /* Todo:  Make sure 24bpp code works right with big-endian cpus */
 
+static uint8 *blitxbuf=NULL, *blitxdbuf=NULL;
+
+void SetBlitSource(uint8 *xbuf, uint8 *xdbuf)
+{
+	blitxbuf = xbuf;
+	blitxdbuf = xdbuf;
+}
+
+//the deemph bits of a pixel of the picture being blitted
+static inline uint8 DeemphAt(uint8 *src)
+{
+	if(blitxbuf)
+		return blitxdbuf[src-blitxbuf];
+	return XDBuf[src-XBuf];
+}
+
 //takes a pointer to XBuf and applies fully modern deemph palettizing
 u32 ModernDeemphColorMap(u8* src)
 {
@@ -469,8 +597,7 @@ u32 ModernDeemphColorMap(u8* src)
 	u32 color = palettetranslate[pixel];
 	
 	//find out which deemph bitplane value we're on
-	int ofs = src-XBuf;
-	uint8 deemph = XDBuf[ofs];
+	uint8 deemph = DeemphAt(src);
 
 	//if it was a deemph'd value, grab it from the deemph palette
 	if(deemph != 0)
@@ -479,488 +606,566 @@ u32 ModernDeemphColorMap(u8* src)
 	return color;
 }
 
-void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
+// 2xscale/3xscale
+static void BlitScale(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, const uint32 *rows)
 {
-	int x,y;
+	int x,y,n;
 	int pinc;
-	uint8 *destbackup = NULL;	/* For hq2x */
-	int pitchbackup = 0;
+	int mult; 
+	int base;
 	
-	//static int google=0;
-	//google^=1;
+	// -Video Modes Tag-
+	if(silt == 2) mult = 2;
+	else mult = 3;
+	
+	Blit8To8Rows(src, specbuf8bpp, xr, yr, 256*mult, xscale, yscale, silt, rows);
 	
-	if(specbuf8bpp)                  // 2xscale/3xscale
+	base = 256*mult;
+	
+	for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
 	{
-		int mult; 
-		int base;
-		
-		// -Video Modes Tag-
-		if(silt == 2) mult = 2;
-		else mult = 3;
-		
-		Blit8To8(src, specbuf8bpp, xr, yr, 256*mult, xscale, yscale, 0, silt);
-		
-		xr *= mult;
-		yr *= mult;
-		xscale=yscale=1;
-		src = specbuf8bpp;
-		base = 256*mult;
-		
+		uint8 *s = specbuf8bpp + first*mult*base;
+		uint8 *d = dest + first*mult*pitch;
+		int w = xr*mult;
+
 		switch(Bpp)
 		{
 		case 4:
-			pinc=pitch-(xr<<2);
-			for(y=yr;y;y--,src+=base-xr)
+			pinc=pitch-(w<<2);
+			for(y=n*mult;y;y--,s+=base-w)
 			{
-				for(x=xr;x;x--)
+				for(x=w;x;x--)
 				{
-				 *(uint32 *)dest=palettetranslate[(uint32)*src];
-				 dest+=4;
-				 src++;
+				 *(uint32 *)d=palettetranslate[(uint32)*s];
+				 d+=4;
+				 s++;
 				}
-				dest+=pinc;
+				d+=pinc;
 			}
 			break;
 		case 3:
-			pinc=pitch-(xr+xr+xr);
-			for(y=yr;y;y--,src+=base-xr)
+			pinc=pitch-(w+w+w);
+			for(y=n*mult;y;y--,s+=base-w)
 			{
-				for(x=xr;x;x--)
+				for(x=w;x;x--)
 				{
-					uint32 tmp=palettetranslate[(uint32)*src];
-					*(uint8 *)dest=tmp;
-					*((uint8 *)dest+1)=tmp>>8;
-					*((uint8 *)dest+2)=tmp>>16;
-					dest+=3;
-					src++;
-					src++;
+					uint32 tmp=palettetranslate[(uint32)*s];
+					*(uint8 *)d=tmp;
+					*((uint8 *)d+1)=tmp>>8;
+					*((uint8 *)d+2)=tmp>>16;
+					d+=3;
+					s++;
 				}
-				dest+=pinc;
+				d+=pinc;
 			}
 			break; 
 		case 2:
-			pinc=pitch-(xr<<1);
+			pinc=pitch-(w<<1);
 			
-			for(y=yr;y;y--,src+=base-xr)
+			for(y=n*mult;y;y--,s+=base-w)
 			{
-				for(x=xr>>1;x;x--)
+				for(x=w>>1;x;x--)
 				{
-					*(uint32 *)dest=palettetranslate[*(uint16 *)src];
-					dest+=4;
-					src+=2;
+					*(uint32 *)d=palettetranslate[*(uint16 *)s];
+					d+=4;
+					s+=2;
 				}
-				dest+=pinc;
+				d+=pinc;
 			}
 			break;
 		}
-		return;
 	}
-	else if(prescalebuf)             // bare prescale
-	{
-		destbackup = dest;
-		dest = (uint8 *)prescalebuf;
-		pitchbackup = pitch;		
-		pitch = xr*sizeof(uint32);
-		pinc = pitch-(xr<<2);
+}
+
+// bare prescale. rows are blitted on their own, so this takes any part of the picture
+static void BlitPrescale(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int yscale, int first)
+{
+	int x,y;
+	int pinc;
+	uint8 *destbackup = dest;
+	
+	dest = (uint8 *)(prescalebuf + first*xr);
+	pitch = xr*sizeof(uint32);
+	pinc = pitch-(xr<<2);
 
-		for(y=yr; y; y--, src+=256-xr)
+	for(y=yr; y; y--, src+=256-xr)
+	{
+		for(x=xr; x; x--)
 		{
-			for(x=xr; x; x--)
-			{
-				*(uint32 *)dest = palettetranslate[(uint32)*src];
-				dest += 4;
-				src++;
-			}
-			dest += pinc;
+			*(uint32 *)dest = palettetranslate[(uint32)*src];
+			dest += 4;
+			src++;
 		}
+		dest += pinc;
+	}
 
-		if (Bpp == 4) // are other modes really needed?
-		{
-			int mult = silt - 4; // magic assuming prescales are silt >= 6
-			uint32 *s = prescalebuf;
-			uint32 *d = (uint32 *)destbackup; // use 32-bit pointers ftw
+	if (Bpp == 4) // are other modes really needed?
+	{
+		int mult = silt - 4; // magic assuming prescales are silt >= 6
+		uint32 *s = prescalebuf + first*xr;
+		uint32 *d = (uint32 *)destbackup + first*yscale*xr*mult; // use 32-bit pointers ftw
 
-			for (y=0; y<yr*yscale; y++)
+		for (y=first*yscale; y<(first+yr)*yscale; y++)
+		{
+			for (x=0; x<xr; x++)
 			{
-				for (x=0; x<xr; x++)
+				for (int subpixel=1; subpixel<=mult; subpixel++)
 				{
-					for (int subpixel=1; subpixel<=mult; subpixel++)
-					{
-						*d++ = *s++;
-						if (subpixel < mult)
-							s--; // repeat subpixel
-					}
+					*d++ = *s++;
+					if (subpixel < mult)
+						s--; // repeat subpixel
 				}
-				if (x == 256 && (y+1)%mult != 0)
-					s -= 256; // repeat scanline
 			}
+			if (x == 256 && (y+1)%mult != 0)
+				s -= 256; // repeat scanline
 		}
-		return;
 	}
-	else if (palrgb)                 // pal moire
+}
+
+// pal moire. it carries the last color from row to row, so it is always drawn whole
+static void BlitPAL(uint8 *src, uint8 *dest, int xr, int yr)
+{
+	int x,y;
+
+	// skip usual palette translation, fill lookup array of RGB+moire values per palette update, and send directly to DX dest
+	// written by feos in 2015, credits to HardWareMan and r57shell
+	if (palupdate)
 	{
-		// skip usual palette translation, fill lookup array of RGB+moire values per palette update, and send directly to DX dest
-		// written by feos in 2015, credits to HardWareMan and r57shell
-		if (palupdate)
+		uint8 *source = (uint8 *)palettetranslate;
+		int16 R,G,B;
+		float Y,U,V;
+		float alpha;
+		float sat = (float) palsaturation/100;
+		float contrast = (float) palcontrast/100;
+		int bright = palbrightness - 50;
+		int notch = palnotch;
+		int unnotch = 100 - palnotch;
+		int mixR[PAL_PHASES], mixG[PAL_PHASES], mixB[PAL_PHASES];
+
+		for (int i=0; i<256+512; i++)
 		{
-			uint8 *source = (uint8 *)palettetranslate;
-			int16 R,G,B;
-			float Y,U,V;
-			float alpha;
-			float sat = (float) palsaturation/100;
-			float contrast = (float) palcontrast/100;
-			int bright = palbrightness - 50;
-			int notch = palnotch;
-			int unnotch = 100 - palnotch;
-			int mixR[PAL_PHASES], mixG[PAL_PHASES], mixB[PAL_PHASES];
-
-			for (int i=0; i<256+512; i++)
-			{
-				// fetch color
-				R = source[i*4  ];
-				G = source[i*4+1];
-				B = source[i*4+2];
-			
-				// rgb -> yuv, sdtv bt.601
-				Y =  0.299  *R + 0.587  *G + 0.114  *B;
-				U = -0.14713*R - 0.28886*G + 0.436  *B;
-				V =  0.615  *R - 0.51499*G - 0.10001*B;
+			// fetch color
+			R = source[i*4  ];
+			G = source[i*4+1];
+			B = source[i*4+2];
+		
+			// rgb -> yuv, sdtv bt.601
+			Y =  0.299  *R + 0.587  *G + 0.114  *B;
+			U = -0.14713*R - 0.28886*G + 0.436  *B;
+			V =  0.615  *R - 0.51499*G - 0.10001*B;
 
-				// all variants of this color
-				for (int x=0; x<18; x++)
+			// all variants of this color
+			for (int x=0; x<18; x++)
+			{
+				for (y=0; y<6; y++)
 				{
-					for (y=0; y<6; y++)
-					{
-						alpha = (x*phasex + y*phasey)*pi;                // 2*pi*freq*t
-						if (y%2 == 0) alpha = -alpha;                    // phase alternating line!
-						moire[x+y*18] = Y + U*sin(alpha) + V*cos(alpha); // modulated composite signal
-					}
+					alpha = (x*phasex + y*phasey)*pi;                // 2*pi*freq*t
+					if (y%2 == 0) alpha = -alpha;                    // phase alternating line!
+					moire[x+y*18] = Y + U*sin(alpha) + V*cos(alpha); // modulated composite signal
 				}
+			}
 
-				for (int j=0; j<PAL_PHASES; j++)
-				{
-					// yuv -> rgb, sdtv bt.601
-					R = Round(moire[j]*contrast+bright                 + 1.13983*V*sat);
-					G = Round(moire[j]*contrast+bright - 0.39465*U*sat - 0.58060*V*sat);
-					B = Round(moire[j]*contrast+bright + 2.03211*U*sat                );
-
-					// clamp
-					if (R > 0xff) R = 0xff; else if (R < 0) R = 0;
-					if (G > 0xff) G = 0xff; else if (G < 0) G = 0;
-					if (B > 0xff) B = 0xff; else if (B < 0) B = 0;
-
-					// store colors to mix
-					mixR[j] = R;
-					mixG[j] = G;
-					mixB[j] = B;
-
-					// moirecolor
-					palrgb[i*PAL_PHASES+j] = (B<<16)|(G<<8)|R;
-				}
+			for (int j=0; j<PAL_PHASES; j++)
+			{
+				// yuv -> rgb, sdtv bt.601
+				R = Round(moire[j]*contrast+bright                 + 1.13983*V*sat);
+				G = Round(moire[j]*contrast+bright - 0.39465*U*sat - 0.58060*V*sat);
+				B = Round(moire[j]*contrast+bright + 2.03211*U*sat                );
 
-				for (int j=0; j<PAL_PHASES; j++)
-				{
-					// mix to simulate notch
-					R = (mixR[j]*unnotch + (mixR[0]+mixR[1]+mixR[2]+mixR[3]+mixR[4]+mixR[5])/6*notch)/100;
-					G = (mixG[j]*unnotch + (mixG[0]+mixG[1]+mixG[2]+mixG[3]+mixG[4]+mixG[5])/6*notch)/100;
-					B = (mixB[j]*unnotch + (mixB[0]+mixB[1]+mixB[2]+mixB[3]+mixB[4]+mixB[5])/6*notch)/100;
+				// clamp
+				if (R > 0xff) R = 0xff; else if (R < 0) R = 0;
+				if (G > 0xff) G = 0xff; else if (G < 0) G = 0;
+				if (B > 0xff) B = 0xff; else if (B < 0) B = 0;
 
-					// notchcolor
-					palrgb2[i*PAL_PHASES+j] = (B<<16)|(G<<8)|R;
-				}
+				// store colors to mix
+				mixR[j] = R;
+				mixG[j] = G;
+				mixB[j] = B;
+
+				// moirecolor
+				palrgb[i*PAL_PHASES+j] = (B<<16)|(G<<8)|R;
+			}
+
+			for (int j=0; j<PAL_PHASES; j++)
+			{
+				// mix to simulate notch
+				R = (mixR[j]*unnotch + (mixR[0]+mixR[1]+mixR[2]+mixR[3]+mixR[4]+mixR[5])/6*notch)/100;
+				G = (mixG[j]*unnotch + (mixG[0]+mixG[1]+mixG[2]+mixG[3]+mixG[4]+mixG[5])/6*notch)/100;
+				B = (mixB[j]*unnotch + (mixB[0]+mixB[1]+mixB[2]+mixB[3]+mixB[4]+mixB[5])/6*notch)/100;
+
+				// notchcolor
+				palrgb2[i*PAL_PHASES+j] = (B<<16)|(G<<8)|R;
 			}
-			palupdate = 0;
 		}
+		palupdate = 0;
+	}
+
+	if (Bpp == 4)
+	{
+		uint32 *d = (uint32 *)dest;
+		uint8  xsub      = 0;
+		uint16 xabs      = 0;
+		uint32 index     = 0;
+		uint32 lastindex = 0;
+		uint32 newindex  = 0;
+		int sharp   = 50 + palsharpness;
+		int unsharp = 50 - palsharpness;
+		int rmask   = 0xff0000;
+		int gmask   = 0x00ff00;
+		int bmask   = 0x0000ff;
+		int r, g, b;
+		uint8 deemph;
+		uint32 color, moirecolor, notchcolor, finalcolor, lastcolor = 0;
 
-		if (Bpp == 4)
+		for (y=0; y<yr; y++)
 		{
-			uint32 *d = (uint32 *)dest;
-			uint8  xsub      = 0;
-			uint16 xabs      = 0;
-			uint32 index     = 0;
-			uint32 lastindex = 0;
-			uint32 newindex  = 0;
-			int sharp   = 50 + palsharpness;
-			int unsharp = 50 - palsharpness;
-			int rmask   = 0xff0000;
-			int gmask   = 0x00ff00;
-			int bmask   = 0x0000ff;
-			int r, g, b, ofs;
-			uint8 deemph;
-			uint32 color, moirecolor, notchcolor, finalcolor, lastcolor = 0;
-
-			for (y=0; y<yr; y++)
+			for (x=0; x<xr; x++)
 			{
-				for (x=0; x<xr; x++)
-				{
-					ofs = src-XBuf;                  //find out which deemph bitplane value we're on
-					deemph = XDBuf[ofs];
-					int temp = *src;
-					index = (*src&63) | (deemph*64); //get combined index from basic value and preemph bitplane
-					index += 256;
+				deemph = DeemphAt(src);           //find out which deemph bitplane value we're on
+				int temp = *src;
+				index = (*src&63) | (deemph*64); //get combined index from basic value and preemph bitplane
+				index += 256;
 
-					src++;
-					
-					ofs = src-XBuf;
-					deemph = XDBuf[ofs];
-					newindex = (*src&63) | (deemph*64);
-					newindex += 256;
+				src++;
+				
+				deemph = DeemphAt(src);
+				newindex = (*src&63) | (deemph*64);
+				newindex += 256;
 
-					if(GameInfo->type==GIT_NSF)
-					{
-						*d++ = palettetranslate[temp];
-						*d++ = palettetranslate[temp];
-						*d++ = palettetranslate[temp];
-					}
-					else
+				if(GameInfo->type==GIT_NSF)
+				{
+					*d++ = palettetranslate[temp];
+					*d++ = palettetranslate[temp];
+					*d++ = palettetranslate[temp];
+				}
+				else
+				{
+					for (xsub = 0; xsub < 3; xsub++)
 					{
-						for (xsub = 0; xsub < 3; xsub++)
+						xabs = x*3 + xsub;
+						moirecolor = PAL_LUT(palrgb,  index, xabs, y);							
+						notchcolor = PAL_LUT(palrgb2, index, xabs, y);
+
+						// | | |*|*| | |
+						if (index !=  newindex && xsub == 2 ||
+							index != lastindex && xsub == 0)
 						{
-							xabs = x*3 + xsub;
-							moirecolor = PAL_LUT(palrgb,  index, xabs, y);							
-							notchcolor = PAL_LUT(palrgb2, index, xabs, y);
-
-							// | | |*|*| | |
-							if (index !=  newindex && xsub == 2 ||
-								index != lastindex && xsub == 0)
-							{
-								r = ((moirecolor&rmask)*90 + (notchcolor&rmask)*10)/100;
-								g = ((moirecolor&gmask)*90 + (notchcolor&gmask)*10)/100;
-								b = ((moirecolor&bmask)*90 + (notchcolor&bmask)*10)/100;
-								color = r&rmask | g&gmask | b&bmask;
-							}
-							// | |*| | |*| |
-							else if (index !=  newindex && xsub == 1 ||
-									 index != lastindex && xsub == 1)
-							{
-								r = ((moirecolor&rmask)*60 + (notchcolor&rmask)*40)/100;
-								g = ((moirecolor&gmask)*60 + (notchcolor&gmask)*40)/100;
-								b = ((moirecolor&bmask)*60 + (notchcolor&bmask)*40)/100;
-								color = r&rmask | g&gmask | b&bmask;
-							}
-							// |*| | | | |*|
-							else if (index !=  newindex && xsub == 0 ||
-									 index != lastindex && xsub == 2)
-							{
-								r = ((moirecolor&rmask)*30 + (notchcolor&rmask)*70)/100;
-								g = ((moirecolor&gmask)*30 + (notchcolor&gmask)*70)/100;
-								b = ((moirecolor&bmask)*30 + (notchcolor&bmask)*70)/100;
-								color = r&rmask | g&gmask | b&bmask;
-							}
-							else
-							{
-								color = notchcolor;
-							}
-							
-							if (color != lastcolor && sharp < 100)
-							{
-								r = ((color&rmask)*sharp + (lastcolor&rmask)*unsharp)/100;
-								g = ((color&gmask)*sharp + (lastcolor&gmask)*unsharp)/100;
-								b = ((color&bmask)*sharp + (lastcolor&bmask)*unsharp)/100;
-								finalcolor = r&rmask | g&gmask | b&bmask;
-
-								r = ((lastcolor&rmask)*sharp + (color&rmask)*unsharp)/100;
-								g = ((lastcolor&gmask)*sharp + (color&gmask)*unsharp)/100;
-								b = ((lastcolor&bmask)*sharp + (color&bmask)*unsharp)/100;
-								lastcolor = r&rmask | g&gmask | b&bmask;
-
-								*d-- = lastcolor;
-								d++;
-							}
-							else
-								finalcolor = color;
+							r = ((moirecolor&rmask)*90 + (notchcolor&rmask)*10)/100;
+							g = ((moirecolor&gmask)*90 + (notchcolor&gmask)*10)/100;
+							b = ((moirecolor&bmask)*90 + (notchcolor&bmask)*10)/100;
+							color = r&rmask | g&gmask | b&bmask;
+						}
+						// | |*| | |*| |
+						else if (index !=  newindex && xsub == 1 ||
+								 index != lastindex && xsub == 1)
+						{
+							r = ((moirecolor&rmask)*60 + (notchcolor&rmask)*40)/100;
+							g = ((moirecolor&gmask)*60 + (notchcolor&gmask)*40)/100;
+							b = ((moirecolor&bmask)*60 + (notchcolor&bmask)*40)/100;
+							color = r&rmask | g&gmask | b&bmask;
+						}
+						// |*| | | | |*|
+						else if (index !=  newindex && xsub == 0 ||
+								 index != lastindex && xsub == 2)
+						{
+							r = ((moirecolor&rmask)*30 + (notchcolor&rmask)*70)/100;
+							g = ((moirecolor&gmask)*30 + (notchcolor&gmask)*70)/100;
+							b = ((moirecolor&bmask)*30 + (notchcolor&bmask)*70)/100;
+							color = r&rmask | g&gmask | b&bmask;
+						}
+						else
+						{
+							color = notchcolor;
+						}
 						
-							lastcolor = color;
-							*d++ = finalcolor;
+						if (color != lastcolor && sharp < 100)
+						{
+							r = ((color&rmask)*sharp + (lastcolor&rmask)*unsharp)/100;
+							g = ((color&gmask)*sharp + (lastcolor&gmask)*unsharp)/100;
+							b = ((color&bmask)*sharp + (lastcolor&bmask)*unsharp)/100;
+							finalcolor = r&rmask | g&gmask | b&bmask;
+
+							r = ((lastcolor&rmask)*sharp + (color&rmask)*unsharp)/100;
+							g = ((lastcolor&gmask)*sharp + (color&gmask)*unsharp)/100;
+							b = ((lastcolor&bmask)*sharp + (color&bmask)*unsharp)/100;
+							lastcolor = r&rmask | g&gmask | b&bmask;
+
+							*d-- = lastcolor;
+							d++;
 						}
-						lastindex = index;
+						else
+							finalcolor = color;
+					
+						lastcolor = color;
+						*d++ = finalcolor;
 					}
+					lastindex = index;
 				}
 			}
+		}
+
+	}
+}
+
+// hq2x/hq3x
+static void BlitHQ(uint8 *src, uint8 *dest, int xr, int yr, int pitch, const uint32 *rows)
+{
+	// -Video Modes Tag-
+	int mult = (silt == 4)?3:2;
+	int n;
+	
+	for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
+	{
+		uint8 *s = src + first*256;
+		uint16 *d = specbuf + first*xr;
 
+		for(int y=n;y;y--,s+=256-xr)
+		{
+			for(int x=xr;x;x--,s++)
+			{
+				// same lookup as ModernDeemphColorMap, into the classes
+				uint8 deemph = DeemphAt(s);
+				*d++ = deemph ? hqclass[256+(*s&0x3F)+deemph*64] : hqclass[*s];
+			}
 		}
-		return;
 	}
-	else if(specbuf)                 // hq2x/hq3x
+	
+	if(specbuf32bpp)
 	{
-		destbackup=dest;
-		dest=(uint8 *)specbuf;
-		pitchbackup=pitch;
+		// -Video Modes Tag-
+		if(silt == 4)
+			hq3x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*3*sizeof(uint32),rows);
+		else
+			hq2x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*2*sizeof(uint32),rows);
 		
-		pitch=xr*sizeof(uint16);
-		xscale=1;
-		yscale=1;
+		for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
+		{
+			uint32 *s = specbuf32bpp + first*mult*xr*mult;
+			if(backBpp == 2)
+				Blit32to16(s, (uint16*)(dest + first*mult*pitch), xr*mult, n*mult, pitch, backshiftr,backshiftl);
+			else // == 3
+				Blit32to24(s, dest + first*mult*pitch, xr*mult, n*mult, pitch);
+		}
+	}
+	else
+	{
+		// -Video Modes Tag-
+		if(silt == 4)
+			hq3x_32((uint8 *)specbuf,dest,xr,yr,pitch,rows);
+		else
+			hq2x_32((uint8 *)specbuf,dest,xr,yr,pitch,rows);
+	}
+}
+
+// nes_ntsc. the burst phase of a row alternates between two values from frame to frame, so the
+// output of both is kept, each with the rows that changed since it was last drawn
+static void BlitNTSC(uint8 *src, uint8 *dest, int xr, int yr, int xscale, int yscale, const uint32 *rows)
+{
+	int outpitch = xr * Bpp * xscale;
+	int n;
+	
+	for(int i=0;i<FCEU_DIRTY_WORDS;i++)
+	{
+		ntscstale[0][i] |= rows[i];
+		ntscstale[1][i] |= rows[i];
 	}
 	
+	burst_phase ^= 1;
+	uint8 *out = ntscblit + burst_phase*ntscsize;
+	uint32 *stale = ntscstale[burst_phase];
+	for(int first=0;(n=NextRows(stale,yr,&first));first+=n)
 	{
-		if(xscale!=1 || yscale!=1)
+		// a row runs a few pixels into the next, which a blit of the whole draws over afterwards
+		uint8 *next = out + (first+n)*NTSC_ROWS*outpitch;
+		uint8 keep[NTSC_SPILL];
+		if(first+n < yr)
+			memcpy(keep, next, NTSC_SPILL);
+		nes_ntsc_blit( nes_ntsc, (unsigned char*)src + first*xr, xr, (burst_phase + first) % nes_ntsc_burst_count, xr, n, out + first*NTSC_ROWS*outpitch, outpitch );
+		if(first+n < yr)
+			memcpy(next, keep, NTSC_SPILL);
+	}
+	memset(stale, 0, FCEU_DIRTY_WORDS*sizeof(uint32));
+	
+	//Multiply 4 by the multiplier on output, because it's 4 bpp
+	//Top 2 lines = line 3, due to distracting flicker
+	//memcpy(dest,ntscblit+(Bpp * xscale)+(Bpp * xr * xscale),(Bpp * xr * xscale));
+	//memcpy(dest+(Bpp * xr * xscale),ntscblit+(Bpp * xscale)+(Bpp * xr * xscale * 2),(Bpp * xr * xscale));
+	memcpy(dest+(Bpp * xr * xscale),out+(Bpp * xscale),(xr*yr*Bpp*xscale*yscale));
+}
+
+static void BlitPlain(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
+{
+	int x,y;
+	int pinc;
+	
+	if(xscale!=1 || yscale!=1)
+	{
+		switch(Bpp)
 		{
-			switch(Bpp)
+		case 4:
+			pinc=pitch-((xr*xscale)<<2);
+			for(y=yr;y;y--,src+=256-xr)
 			{
-			case 4:
-				if ( nes_ntsc && GameInfo->type!=GIT_NSF) {
-					burst_phase ^= 1;
-					nes_ntsc_blit( nes_ntsc, (unsigned char*)src, xr, burst_phase, xr, yr, ntscblit, xr * Bpp * xscale );
-					
-					//Multiply 4 by the multiplier on output, because it's 4 bpp
-					//Top 2 lines = line 3, due to distracting flicker
-					//memcpy(dest,ntscblit+(Bpp * xscale)+(Bpp * xr * xscale),(Bpp * xr * xscale));
-					//memcpy(dest+(Bpp * xr * xscale),ntscblit+(Bpp * xscale)+(Bpp * xr * xscale * 2),(Bpp * xr * xscale));
-					memcpy(dest+(Bpp * xr * xscale),ntscblit+(Bpp * xscale),(xr*yr*Bpp*xscale*yscale));
-				} else {
-					pinc=pitch-((xr*xscale)<<2);
-					for(y=yr;y;y--,src+=256-xr)
+				int doo=yscale;
+				        
+				do
+				{
+					for(x=xr;x;x--,src++)
 					{
-						int doo=yscale;
-						        
+						int too=xscale;
 						do
 						{
-							for(x=xr;x;x--,src++)
-							{
-								int too=xscale;
-								do
-								{
-									*(uint32 *)dest=palettetranslate[*src];
-									dest+=4;
-								} while(--too);
-							}
-							src-=xr;
-							dest+=pinc;
-						} while(--doo);
-						src+=xr;
+							*(uint32 *)dest=palettetranslate[*src];
+							dest+=4;
+						} while(--too);
 					}
-				}
-				break;
-			
-			case 3:
-				pinc=pitch-((xr*xscale)*3);
-				for(y=yr;y;y--,src+=256-xr)
-				{  
-					int doo=yscale;
-					 
-					do
-					{
-						for(x=xr;x;x--,src++)
-						{    
-							int too=xscale;
-							do
-							{
-								uint32 tmp=palettetranslate[(uint32)*src];
-								*(uint8 *)dest=tmp;
-								*((uint8 *)dest+1)=tmp>>8;
-								*((uint8 *)dest+2)=tmp>>16;
-								dest+=3;
-								
-								//*(uint32 *)dest=palettetranslate[*src];
-								//dest+=4;
-							} while(--too);
-						}
-						src-=xr;
-						dest+=pinc;
-					} while(--doo);
-					src+=xr;
-				}
-				break;
-						
-			case 2:
-				pinc=pitch-((xr*xscale)<<1);
-				   
-				for(y=yr;y;y--,src+=256-xr)
-				{   
-					int doo=yscale;
-					   
-					do
-					{
-						for(x=xr;x;x--,src++)
-						{
-							int too=xscale;
-							do
-							{
-								*(uint16 *)dest=palettetranslate[*src];
-								dest+=2;
-							} while(--too);
-						}
 					src-=xr;
 					dest+=pinc;
-					} while(--doo);
-					src+=xr;
-				}  
-				break;
+				} while(--doo);
+				src+=xr;
 			}
-		}
-		else
-			switch(Bpp)
-			{
-			case 4:
-				pinc=pitch-(xr<<2);
-				for(y=yr;y;y--,src+=256-xr)
+			break;
+		
+		case 3:
+			pinc=pitch-((xr*xscale)*3);
+			for(y=yr;y;y--,src+=256-xr)
+			{  
+				int doo=yscale;
+				 
+				do
 				{
-					for(x=xr;x;x--)
-					{
-						//THE MAIN BLITTING CODEPATH (there may be others that are important)
-						*(uint32 *)dest = ModernDeemphColorMap(src);
-						dest+=4;
-						src++;
+					for(x=xr;x;x--,src++)
+					{    
+						int too=xscale;
+						do
+						{
+							uint32 tmp=palettetranslate[(uint32)*src];
+							*(uint8 *)dest=tmp;
+							*((uint8 *)dest+1)=tmp>>8;
+							*((uint8 *)dest+2)=tmp>>16;
+							dest+=3;
+							
+							//*(uint32 *)dest=palettetranslate[*src];
+							//dest+=4;
+						} while(--too);
 					}
+					src-=xr;
 					dest+=pinc;
-				}
-				break;
-			case 3:
-				pinc=pitch-(xr+xr+xr);
-				for(y=yr;y;y--,src+=256-xr)
+				} while(--doo);
+				src+=xr;
+			}
+			break;
+					
+		case 2:
+			pinc=pitch-((xr*xscale)<<1);
+			   
+			for(y=yr;y;y--,src+=256-xr)
+			{   
+				int doo=yscale;
+				   
+				do
 				{
-					for(x=xr;x;x--)
-					{     
-						uint32 tmp = ModernDeemphColorMap(src);
-						*(uint8 *)dest=tmp;
-						*((uint8 *)dest+1)=tmp>>8;
-						*((uint8 *)dest+2)=tmp>>16;
-						dest+=3;
-						src++;
+					for(x=xr;x;x--,src++)
+					{
+						int too=xscale;
+						do
+						{
+							*(uint16 *)dest=palettetranslate[*src];
+							dest+=2;
+						} while(--too);
 					}
-					dest+=pinc;
+				src-=xr;
+				dest+=pinc;
+				} while(--doo);
+				src+=xr;
+			}  
+			break;
+		}
+	}
+	else
+		switch(Bpp)
+		{
+		case 4:
+			pinc=pitch-(xr<<2);
+			for(y=yr;y;y--,src+=256-xr)
+			{
+				for(x=xr;x;x--)
+				{
+					//THE MAIN BLITTING CODEPATH (there may be others that are important)
+					*(uint32 *)dest = ModernDeemphColorMap(src);
+					dest+=4;
+					src++;
 				}
-				break;
-			case 2:
-				pinc=pitch-(xr<<1);
-				for(y=yr;y;y--,src+=256-xr)
+				dest+=pinc;
+			}
+			break;
+		case 3:
+			pinc=pitch-(xr+xr+xr);
+			for(y=yr;y;y--,src+=256-xr)
+			{
+				for(x=xr;x;x--)
+				{     
+					uint32 tmp = ModernDeemphColorMap(src);
+					*(uint8 *)dest=tmp;
+					*((uint8 *)dest+1)=tmp>>8;
+					*((uint8 *)dest+2)=tmp>>16;
+					dest+=3;
+					src++;
+				}
+				dest+=pinc;
+			}
+			break;
+		case 2:
+			pinc=pitch-(xr<<1);
+			for(y=yr;y;y--,src+=256-xr)
+			{
+				for(x=xr;x;x--)
 				{
-					for(x=xr;x;x--)
-					{
-						*(uint16 *)dest = ModernDeemphColorMap(src);
-						dest+=2;
-						src++;
-					}
-					dest+=pinc;
+					*(uint16 *)dest = ModernDeemphColorMap(src);
+					dest+=2;
+					src++;
 				}
-				break;
+				dest+=pinc;
 			}
-	}
+			break;
+		}
+}
+
+void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, const uint32 *dirty, int firstline)
+{
+	uint32 rows[FCEU_DIRTY_WORDS];
+	int n;
 	
-	if(specbuf)
+	//static int google=0;
+	//google^=1;
+	
+	// the pal filter carries its colors on from row to row, so any change redraws all of it, and
+	// so do new pal settings
+	if(palrgb && palupdate)
+		dirty = NULL;
+	
+	// scale2x/3x and hq2x/3x look at the rows next to each
+	bool redraw = BlitRows(&lastblit, rows, dest, xr, yr, pitch, xscale, yscale, silt, dirty, firstline, (specbuf8bpp || specbuf) ? 1 : 0);
+	
+	// the ntsc picture changes every frame anyway
+	if(nes_ntsc && (xscale!=1 || yscale!=1) && Bpp == 4 && GameInfo->type!=GIT_NSF)
+		BlitNTSC(src, dest, xr, yr, xscale, yscale, rows);
+	else if(!redraw)
+		return;
+	else if(specbuf8bpp)             // 2xscale/3xscale
+		BlitScale(src, dest, xr, yr, pitch, xscale, yscale, rows);
+	else if(prescalebuf)             // bare prescale
 	{
-		if(specbuf32bpp)
-		{
-			// -Video Modes Tag-
-			int mult = (silt == 4)?3:2;
-			
-			if(silt == 4)
-				hq3x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*3*sizeof(uint32));
-			else
-				hq2x_32((uint8 *)specbuf,(uint8*)specbuf32bpp,xr,yr,xr*2*sizeof(uint32));
-			
-			if(backBpp == 2)
-				Blit32to16(specbuf32bpp, (uint16*)destbackup, xr*mult, yr*mult, pitchbackup, backshiftr,backshiftl);
-			else // == 3
-				Blit32to24(specbuf32bpp, (uint8*)destbackup, xr*mult, yr*mult, pitchbackup);
-		}
-		else
-		{
-			// -Video Modes Tag-
-			if(silt == 4)
-				hq3x_32((uint8 *)specbuf,destbackup,xr,yr,pitchbackup);
-			else
-				hq2x_32((uint8 *)specbuf,destbackup,xr,yr,pitchbackup);
-		}
+		for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
+			BlitPrescale(src + first*256, dest, xr, n, pitch, yscale, first);
+	}
+	else if (palrgb)                 // pal moire
+		BlitPAL(src, dest, xr, yr);
+	else if(specbuf)                 // hq2x/hq3x
+		BlitHQ(src, dest, xr, yr, pitch, rows);
+	else
+	{
+		for(int first=0;(n=NextRows(rows,yr,&first));first+=n)
+			BlitPlain(src + first*256, dest + first*yscale*pitch, xr, n, pitch, xscale, yscale);
 	}
 }
@@ -21,8 +21,14 @@
 int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int eefx, int specfilt, int specfilteropt);
 void SetPaletteBlitToHigh(uint8 *src);
 void KillBlitToHigh(void);
-void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale);
-void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special);
+//dirty is what FCEUI_TakeDirtyLines gave and firstline the scanline src starts at. rows that did
+//not change keep what the last blit drew, as long as it went to the same place the same way, so
+//dest must still hold that. without dirty, everything is drawn.
+void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, const uint32 *dirty=0, int firstline=0);
+void Blit8To8(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale, int efx, int special, const uint32 *dirty=0, int firstline=0);
+//Blit8ToHigh finds the deemph bits of src at the same offset from xdbuf as src is from xbuf.
+//that is XBuf and XDBuf unless a driver blitting a copy of XBuf points it at its copy of XDBuf
+void SetBlitSource(uint8 *xbuf, uint8 *xdbuf);
 
 void Blit32to24(uint32 *src, uint8 *dest, int xr, int yr, int dpitch);
 void Blit32to16(uint32 *src, uint16 *dest, int xr, int yr, int dpitch,
@@ -0,0 +1,398 @@
+/// \file
+/// \brief fceux-bench: runs roms for a fixed number of frames on both ppu cores and every sound
+/// quality and synthesis engine, and reports speed next to hashes of the video and audio output
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../debug.h"
+#include "../../runahead.h"
+#include "../../state.h"
+#include "../../movie.h"
+#include "../../emufile.h"
+#include "../../utils/crc32.h"
+#include "headless.h"
+
+struct BenchResult
+{
+	std::string rom;
+	int ppu, quality, synth;
+	int frames;
+	double seconds;
+	uint64 instructions;
+	uint32 video, audio;
+	FCEU_RUNAHEAD_STATS runahead;
+};
+
+static const char *PPUNames[2] = { "old", "new" };
+static const char *SynthNames[2] = { "fir", "step" };
+
+static std::string BaseName(const char *path)
+{
+	const char *p = strrchr(path, '/');
+	return p ? p + 1 : path;
+}
+
+//the sound output is kept in "samples" when it is given, for comparing the two engines
+static bool RunOne(const char *rom, int ppu, int quality, int synth, int runahead, int frames, BenchResult *r, std::vector<int32> *samples)
+{
+	if(newppu != ppu)
+		FCEU_TogglePPU();
+	FCEUI_SetSoundQuality(quality);
+	FCEUI_SetStepSynth(synth);
+	FCEUI_SetRunAhead(runahead);
+	if(!FCEUI_LoadGame(rom, 1, true))
+		return false;
+
+	r->rom = BaseName(rom);
+	r->ppu = ppu;
+	r->quality = quality;
+	r->synth = synth;
+	if(samples)
+		samples->clear();
+	r->frames = frames;
+	r->video = r->audio = 0;
+
+	// hashing is part of the timed loop on purpose: it is cheap next to a frame and keeps the
+	// compiler from discarding work nobody reads
+	uint64 inst0 = total_instructions;
+	uint64 t0 = HeadlessTime();
+	for(int i = 0; i < frames; i++)
+	{
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		r->video = CalcCRC32(r->video, gfx, 256 * 240);
+		r->audio = CalcCRC32(r->audio, (uint8 *)sound, ssize * sizeof(int32));
+		if(samples)
+			samples->insert(samples->end(), sound, sound + ssize);
+	}
+	r->seconds = (HeadlessTime() - t0) / 1000000.0;
+	r->instructions = total_instructions - inst0;
+	FCEUI_GetRunAheadStats(&r->runahead);
+
+	FCEUI_CloseGame();
+	return true;
+}
+
+//times "count" savestates of the machine after "frames" frames, and as many loads of it. with "movie", a
+//movie is recorded to that file over those frames, which every state then carries. the crc of the state
+//is shown, to tell that two builds save the same
+static bool RunStates(const char *rom, int frames, int count, const char *movie)
+{
+	if(!FCEUI_LoadGame(rom, 1, true))
+		return false;
+	if(movie)
+		FCEUI_SaveMovie(movie, MOVIE_FLAG_NONE, L"");
+	for(int i = 0; i < frames; i++)
+	{
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+	}
+
+	EMUFILE_MEMORY first, ms;
+	FCEUSS_SaveMS(&first, 0);
+	uint64 t0 = HeadlessTime();
+	for(int i = 0; i < count; i++)
+	{
+		ms.truncate(0);
+		ms.fseek(0, SEEK_SET);
+		FCEUSS_SaveMS(&ms, 0);
+	}
+	double save = (HeadlessTime() - t0) / (double)count;
+
+	bool loaded = true;
+	t0 = HeadlessTime();
+	for(int i = 0; i < count; i++)
+	{
+		first.fseek(0, SEEK_SET);
+		loaded = FCEUSS_LoadFP(&first, SSLOADPARAM_NOBACKUP) && loaded;
+	}
+	double load = (HeadlessTime() - t0) / (double)count;
+
+	printf("%-12s %7d %9d %08x %10.2f %10.2f%s\n", BaseName(rom).c_str(), frames, (int)first.size(),
+		CalcCRC32(0, first.buf(), first.size()), save, load, loaded ? "" : " LOAD FAILED");
+	fflush(stdout);
+	if(movie)
+		FCEUI_StopMovie();
+	FCEUI_CloseGame();
+	return loaded;
+}
+
+//signal to noise ratio of "test" against "ref" in dB. the two engines delay the sound by
+//different amounts, so the best lag within a few ms is used.
+static double SNR(const std::vector<int32> &ref, const std::vector<int32> &test)
+{
+	const int maxlag = 256;
+	size_t len = ref.size() < test.size() ? ref.size() : test.size();
+	if(len <= (size_t)maxlag * 2)
+		return 0;
+
+	double signal = 0;
+	for(size_t i = maxlag; i < len - maxlag; i++)
+		signal += (double)ref[i] * ref[i];
+
+	double best = -1;
+	for(int lag = -maxlag; lag <= maxlag; lag++)
+	{
+		double noise = 0;
+		for(size_t i = maxlag; i < len - maxlag && (best < 0 || noise < best); i++)
+		{
+			double d = (double)ref[i] - test[i + lag];
+			noise += d * d;
+		}
+		if(best < 0 || noise < best)
+			best = noise;
+	}
+	if(signal == 0)
+		return best == 0 ? 999 : 0;
+	if(best == 0)
+		return 999;
+	return 10 * log10(signal / best);
+}
+
+//reference files hold one "rom ppu quality synth frames video audio" line per run
+static bool LoadReference(const char *fname, std::vector<BenchResult> &ref)
+{
+	FILE *fp = fopen(fname, "r");
+	if(!fp)
+		return false;
+	char line[256];
+	while(fgets(line, sizeof(line), fp))
+	{
+		char rom[128], ppu[8], synth[8];
+		BenchResult r;
+		if(line[0] == '#' || sscanf(line, "%127s %7s %d %7s %d %x %x", rom, ppu, &r.quality, synth, &r.frames, &r.video, &r.audio) != 7)
+			continue;
+		r.rom = rom;
+		r.ppu = strcmp(ppu, "new") ? 0 : 1;
+		r.synth = strcmp(synth, "step") ? 0 : 1;
+		ref.push_back(r);
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool WriteReference(const char *fname, const std::vector<BenchResult> &results)
+{
+	FILE *fp = fopen(fname, "w");
+	if(!fp)
+		return false;
+	fprintf(fp, "# rom ppu quality synth frames video audio\n");
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult &r = results[i];
+		fprintf(fp, "%s %s %d %s %d %08x %08x\n", r.rom.c_str(), PPUNames[r.ppu], r.quality, SynthNames[r.synth], r.frames, r.video, r.audio);
+	}
+	fclose(fp);
+	return true;
+}
+
+static const BenchResult *FindReference(const std::vector<BenchResult> &ref, const BenchResult &r)
+{
+	for(size_t i = 0; i < ref.size(); i++)
+		if(ref[i].rom == r.rom && ref[i].ppu == r.ppu && ref[i].quality == r.quality && ref[i].synth == r.synth && ref[i].frames == r.frames)
+			return &ref[i];
+	return NULL;
+}
+
+static const double DefaultMinSNR = 30;
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] rom...\n"
+		"  --frames n        frames to run per rom, core and sound quality (default 600)\n"
+		"  --ppu old|new     only run one ppu core\n"
+		"  --quality q       only run one sound quality (0, 1 or 2)\n"
+		"  --synth fir|step  only run one high quality synthesis engine. when both run, the\n"
+		"                    step engine's output is compared with the fir's\n"
+		"  --min-snr db      fail when the step engine is further than this from the fir (default %g)\n"
+		"  --runahead n      run n frames ahead. the picture is then ahead of the reference, so\n"
+		"                    only the sound is checked, which shows the rollback changed nothing\n"
+		"  --check file      compare the hashes with a reference file, fail on mismatch\n"
+		"  --write file      write the hashes as a reference file\n"
+		"  --savestates n    instead, time n uncompressed savestates and loads of the machine\n"
+		"                    after --frames frames\n"
+		"  --statemovie file record a movie to file over those frames, for states that carry it\n",
+		prog, DefaultMinSNR);
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 600;
+	int ppus[2] = { 0, 1 }, ppucount = 2;
+	int qualities[3] = { 0, 1, 2 }, qualitycount = 3;
+	int synths[2] = { 0, 1 }, synthcount = 2;
+	double minsnr = DefaultMinSNR;
+	int runahead = 0;
+	int savestates = 0;
+	const char *statemovie = NULL;
+	const char *checkfile = NULL, *writefile = NULL;
+	std::vector<const char *> roms;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		bool hasval = i + 1 < argc;
+		if(!strcmp(arg, "--frames") && hasval)
+			frames = atoi(argv[++i]);
+		else if(!strcmp(arg, "--ppu") && hasval)
+		{
+			ppus[0] = strcmp(argv[++i], "new") ? 0 : 1;
+			ppucount = 1;
+		}
+		else if(!strcmp(arg, "--quality") && hasval)
+		{
+			qualities[0] = atoi(argv[++i]);
+			qualitycount = 1;
+		}
+		else if(!strcmp(arg, "--synth") && hasval)
+		{
+			synths[0] = strcmp(argv[++i], "step") ? 0 : 1;
+			synthcount = 1;
+		}
+		else if(!strcmp(arg, "--min-snr") && hasval)
+			minsnr = atof(argv[++i]);
+		else if(!strcmp(arg, "--runahead") && hasval)
+			runahead = atoi(argv[++i]);
+		else if(!strcmp(arg, "--savestates") && hasval)
+			savestates = atoi(argv[++i]);
+		else if(!strcmp(arg, "--statemovie") && hasval)
+			statemovie = argv[++i];
+		else if(!strcmp(arg, "--check") && hasval)
+			checkfile = argv[++i];
+		else if(!strcmp(arg, "--write") && hasval)
+			writefile = argv[++i];
+		else if(arg[0] == '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+		else
+			roms.push_back(arg);
+	}
+	if(roms.empty() || frames <= 0 || runahead < 0 || runahead > RUNAHEAD_MAX || (runahead && writefile) || savestates < 0 || (statemovie && !savestates))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<BenchResult> ref;
+	if(checkfile && !LoadReference(checkfile, ref))
+	{
+		fprintf(stderr, "Couldn't read reference file %s\n", checkfile);
+		return 1;
+	}
+
+	HeadlessQuiet = true;
+	if(!FCEUI_Initialize())
+		return 1;
+	FCEUI_Sound(48000);
+	FCEUI_SetSoundVolume(150);
+	FCEUI_SetLowPass(0);
+
+	if(savestates)
+	{
+		int failures = 0;
+		if(newppu != ppus[0])
+			FCEU_TogglePPU();
+		FCEUI_SetSoundQuality(qualities[0]);
+		printf("%-12s %7s %9s %-8s %10s %10s\n", "rom", "frames", "bytes", "crc", "save us", "load us");
+		for(size_t n = 0; n < roms.size(); n++)
+		{
+			if(!RunStates(roms[n], frames, savestates, statemovie))
+			{
+				fprintf(stderr, "%s failed\n", roms[n]);
+				failures++;
+			}
+		}
+		FCEUI_Kill();
+		return failures ? 1 : 0;
+	}
+
+	printf("%-12s %-3s %1s %-4s %7s %9s %8s %-8s %-8s\n", "rom", "ppu", "q", "syn", "frames", "fps", "Minst/s", "video", "audio");
+
+	std::vector<BenchResult> results;
+	int failures = 0;
+	double seconds = 0;
+	int totalframes = 0;
+	for(size_t n = 0; n < roms.size(); n++)
+	for(int p = 0; p < ppucount; p++)
+	for(int q = 0; q < qualitycount; q++)
+	for(int s = 0; s < synthcount; s++)
+	{
+		//low quality sound has a single engine of its own
+		if(qualities[q] == 0 && synths[s] == 1)
+			continue;
+
+		//the fir run's sound is kept for the step run that follows it
+		static std::vector<int32> firsamples, stepsamples;
+		bool compare = synthcount == 2 && qualities[q] > 0;
+		BenchResult r;
+		if(!RunOne(roms[n], ppus[p], qualities[q], synths[s], runahead, frames, &r, compare ? (synths[s] ? &stepsamples : &firsamples) : NULL))
+		{
+			fprintf(stderr, "Couldn't load %s\n", roms[n]);
+			failures++;
+			continue;
+		}
+		results.push_back(r);
+		seconds += r.seconds;
+		totalframes += r.frames;
+
+		std::string status;
+		if(checkfile)
+		{
+			const BenchResult *expect = FindReference(ref, r);
+			if(!expect)
+				status += " (no reference)";
+			else if((!runahead && expect->video != r.video) || expect->audio != r.audio)
+			{
+				status += " MISMATCH";
+				failures++;
+			}
+		}
+		if(r.runahead.frames)
+		{
+			char ms[64];
+			sprintf(ms, " runahead %.2f ms/frame", r.runahead.avg[RUNAHEAD_TOTAL]);
+			status += ms;
+		}
+		if(compare && synths[s])
+		{
+			char snr[64];
+			double db = SNR(firsamples, stepsamples);
+			sprintf(snr, " snr %.1f dB%s", db, db < minsnr ? " TOO FAR FROM FIR" : "");
+			status += snr;
+			if(db < minsnr)
+				failures++;
+		}
+		printf("%-12s %-3s %1d %-4s %7d %9.1f %8.2f %08x %08x%s\n", r.rom.c_str(), PPUNames[r.ppu], r.quality, SynthNames[r.synth],
+			r.frames, r.frames / r.seconds, r.instructions / r.seconds / 1000000.0, r.video, r.audio, status.c_str());
+		fflush(stdout);
+	}
+
+	if(seconds > 0)
+		printf("%d frames in %.2f s, %.1f fps overall\n", totalframes, seconds, totalframes / seconds);
+
+	if(writefile && !WriteReference(writefile, results))
+	{
+		fprintf(stderr, "Couldn't write reference file %s\n", writefile);
+		failures++;
+	}
+
+	FCEUI_Kill();
+	if(failures)
+		fprintf(stderr, "%d run(s) failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,677 @@
+#!/usr/bin/env python
+#
+# benchroms.py - generates the synthetic test roms run by fceux-bench
+#
+# usage: python benchroms.py <output dir>
+#
+# Every rom shares one skeleton: it clears ram, fills the palette and both
+# nametables, starts the apu, and then spins a busy loop in the main thread
+# while the nmi handler does sprite dma, scrolling and a pitch sweep.  Each
+# mapper adds its own bank switching, irq and audio code on top of that.
+# The expansion audio chips also get a small nsf each, whose play routine
+# rewrites the chip's registers several times a frame.
+# The output only depends on this script, so the hashes fceux-bench prints
+# are stable between builds.
+#
+
+import os
+import sys
+
+OPCODES = {
+  ('adc', '#'): 0x69, ('adc', 'z'): 0x65, ('adc', 'a,x'): 0x7D,
+  ('and', '#'): 0x29,
+  ('asl', ''): 0x0A, ('lsr', ''): 0x4A, ('rol', ''): 0x2A, ('ror', ''): 0x6A,
+  ('bit', 'a'): 0x2C,
+  ('bcc', 'r'): 0x90, ('bcs', 'r'): 0xB0, ('beq', 'r'): 0xF0, ('bne', 'r'): 0xD0,
+  ('bmi', 'r'): 0x30, ('bpl', 'r'): 0x10,
+  ('clc', ''): 0x18, ('cld', ''): 0xD8, ('cli', ''): 0x58, ('sec', ''): 0x38, ('sei', ''): 0x78,
+  ('cmp', '#'): 0xC9, ('cpx', '#'): 0xE0, ('cpy', '#'): 0xC0,
+  ('dec', 'z'): 0xC6, ('inc', 'z'): 0xE6,
+  ('dex', ''): 0xCA, ('dey', ''): 0x88, ('inx', ''): 0xE8, ('iny', ''): 0xC8,
+  ('eor', '#'): 0x49, ('eor', 'z'): 0x45, ('eor', 'a,x'): 0x5D,
+  ('ora', '#'): 0x09, ('ora', 'z'): 0x05,
+  ('jmp', 'a'): 0x4C, ('jsr', 'a'): 0x20, ('rts', ''): 0x60, ('rti', ''): 0x40,
+  ('lda', '#'): 0xA9, ('lda', 'z'): 0xA5, ('lda', 'a'): 0xAD, ('lda', 'a,x'): 0xBD, ('lda', 'a,y'): 0xB9,
+  ('ldx', '#'): 0xA2, ('ldx', 'z'): 0xA6,
+  ('ldy', '#'): 0xA0, ('ldy', 'z'): 0xA4,
+  ('sta', 'z'): 0x85, ('sta', 'a'): 0x8D, ('sta', 'a,x'): 0x9D, ('sta', 'a,y'): 0x99,
+  ('stx', 'z'): 0x86, ('stx', 'a'): 0x8E,
+  ('sty', 'z'): 0x84, ('sty', 'a'): 0x8C,
+  ('pha', ''): 0x48, ('pla', ''): 0x68,
+  ('tax', ''): 0xAA, ('txa', ''): 0x8A, ('tay', ''): 0xA8, ('tya', ''): 0x98, ('txs', ''): 0x9A,
+  ('nop', ''): 0xEA,
+}
+
+OPERAND_SIZE = { '': 0, '#': 1, 'z': 1, 'r': 1, 'a': 2, 'a,x': 2, 'a,y': 2 }
+
+# zero page used by the skeleton
+FRAME = 0x00     # nmi counter
+BANK = 0x01      # bank the main loop switches to next
+CHRBANK = 0x02   # chr bank the irq handler switches to next
+SUM = 0x03       # main loop checksum
+
+class Assembler:
+  """two pass assembler for the handful of addressing modes the roms use"""
+
+  def __init__(self, org):
+    self.org = org
+    self.code = []   # (opcode, mode, operand)
+    self.labels = {}
+
+  def pc(self):
+    pc = self.org
+    for op, mode, operand in self.code:
+      pc += 1 + OPERAND_SIZE[mode]
+    return pc
+
+  def label(self, name):
+    self.labels[name] = self.pc()
+
+  def __call__(self, op, mode='', operand=None):
+    if op in ('bcc', 'bcs', 'beq', 'bne', 'bmi', 'bpl'):
+      mode = 'r'
+    if (op, mode) not in OPCODES:
+      raise ValueError('no such instruction: %s %s' % (op, mode))
+    self.code.append((op, mode, operand))
+
+  def assemble(self):
+    out = bytearray()
+    pc = self.org
+    for op, mode, operand in self.code:
+      if isinstance(operand, str):
+        operand = self.labels[operand]
+      out.append(OPCODES[(op, mode)])
+      size = OPERAND_SIZE[mode]
+      if mode == 'r':
+        offset = operand - (pc + 2)
+        if offset < -128 or offset > 127:
+          raise ValueError('branch out of range at $%04X' % pc)
+        out.append(offset & 0xFF)
+      elif size == 1:
+        out.append(operand & 0xFF)
+      elif size == 2:
+        out.append(operand & 0xFF)
+        out.append((operand >> 8) & 0xFF)
+      pc += 1 + size
+    return out
+
+def noise(size, seed):
+  """deterministic filler for chr, data banks and dmc samples"""
+  out = bytearray(size)
+  x = seed & 0xFFFFFFFF
+  for i in range(size):
+    x = (x * 1103515245 + 12345) & 0xFFFFFFFF
+    out[i] = (x >> 16) & 0xFF
+  return out
+
+def store(a, pairs):
+  """writes constant values to registers"""
+  for addr, value in pairs:
+    a('lda', '#', value)
+    a('sta', 'a', addr)
+
+class Rom:
+  """per-mapper hooks around the common skeleton"""
+  mapper = 0
+  prg_size = 0x4000
+  chr_size = 0x2000
+  org = 0xC000
+  apu_enable = 0x0F
+
+  def init(self, a):
+    pass
+  def main(self, a):
+    pass
+  def nmi(self, a):
+    pass
+  def irq(self, a):
+    pass
+  def subroutines(self, a):
+    pass
+
+  def build(self):
+    a = Assembler(self.org)
+
+    a.label('reset')
+    a('sei')
+    a('cld')
+    a('ldx', '#', 0xFF)
+    a('txs')
+    a('lda', '#', 0)
+    a('sta', 'a', 0x2000)
+    a('sta', 'a', 0x2001)
+    a('lda', '#', 0x40)
+    a('sta', 'a', 0x4017)
+    self.init(a)
+
+    # two vblanks for the ppu to warm up
+    a('bit', 'a', 0x2002)
+    a.label('vblank1')
+    a('bit', 'a', 0x2002)
+    a('bpl', '', 'vblank1')
+    a.label('vblank2')
+    a('bit', 'a', 0x2002)
+    a('bpl', '', 'vblank2')
+
+    # clear ram (not the stack), spread the sprites over the screen
+    a('ldx', '#', 0)
+    a.label('clear')
+    a('lda', '#', 0)
+    for page in (0x0000, 0x0300, 0x0400, 0x0500, 0x0600, 0x0700):
+      a('sta', 'a,x', page)
+    a('txa')
+    a('sta', 'a,x', 0x0200)
+    a('inx')
+    a('bne', '', 'clear')
+
+    # palette
+    store(a, [(0x2006, 0x3F), (0x2006, 0x00)])
+    a('ldx', '#', 0)
+    a.label('palette')
+    a('txa')
+    a('sta', 'a', 0x2007)
+    a('inx')
+    a('cpx', '#', 32)
+    a('bne', '', 'palette')
+
+    # both nametables
+    store(a, [(0x2006, 0x20), (0x2006, 0x00)])
+    a('ldy', '#', 8)
+    a('ldx', '#', 0)
+    a.label('nametable')
+    a('txa')
+    a('sta', 'a', 0x2007)
+    a('inx')
+    a('bne', '', 'nametable')
+    a('dey')
+    a('bne', '', 'nametable')
+
+    # pulses, triangle and noise playing continuously
+    store(a, [(0x4000, 0xBF), (0x4002, 0xFD), (0x4003, 0x00),
+              (0x4004, 0x7F), (0x4006, 0x80), (0x4007, 0x01),
+              (0x4008, 0xFF), (0x400A, 0x40), (0x400B, 0x00),
+              (0x400C, 0x3C), (0x400E, 0x04), (0x400F, 0x00),
+              (0x4015, self.apu_enable)])
+
+    # background from $0000 and sprites from $1000, so mmc3 sees a12 rise each line
+    a('bit', 'a', 0x2002)
+    store(a, [(0x2005, 0), (0x2005, 0), (0x2000, 0x88), (0x2001, 0x1E)])
+    a('cli')
+
+    a.label('main')
+    a('ldx', '#', 0)
+    a.label('busy')
+    a('lda', 'a,x', 0x0300)
+    a('adc', 'z', FRAME)
+    a('sta', 'a,x', 0x0300)
+    a('eor', 'z', SUM)
+    a('sta', 'z', SUM)
+    a('inx')
+    a('bne', '', 'busy')
+    self.main(a)
+    a('jmp', 'a', 'main')
+
+    a.label('nmi')
+    a('pha')
+    a('txa')
+    a('pha')
+    a('tya')
+    a('pha')
+    store(a, [(0x2003, 0x00), (0x4014, 0x02)])
+    a('inc', 'z', FRAME)
+    a('bit', 'a', 0x2002)
+    a('lda', 'z', FRAME)
+    a('sta', 'a', 0x2005)
+    a('sta', 'a', 0x4002)
+    a('lsr')
+    a('sta', 'a', 0x2005)
+    a('sta', 'a', 0x4006)
+    a('lda', '#', 0x88)
+    a('sta', 'a', 0x2000)
+    self.nmi(a)
+    a('pla')
+    a('tay')
+    a('pla')
+    a('tax')
+    a('pla')
+    a('rti')
+
+    a.label('irq')
+    a('pha')
+    a('txa')
+    a('pha')
+    self.irq(a)
+    a('pla')
+    a('tax')
+    a('pla')
+    a('rti')
+
+    self.subroutines(a)
+
+    return a, a.assemble()
+
+  def image(self):
+    a, code = self.build()
+    prg = noise(self.prg_size, self.mapper * 7 + 1)
+    offset = self.prg_size - 0x10000 + self.org
+    prg[offset:offset + len(code)] = code
+    for vector, name in ((0xFFFA, 'nmi'), (0xFFFC, 'reset'), (0xFFFE, 'irq')):
+      addr = a.labels[name]
+      prg[self.prg_size - 0x10000 + vector] = addr & 0xFF
+      prg[self.prg_size - 0x10000 + vector + 1] = addr >> 8
+    chr = noise(self.chr_size, self.mapper * 7 + 2)
+
+    header = bytearray(b'NES\x1a')
+    header += bytearray([self.prg_size // 0x4000, self.chr_size // 0x2000,
+                         ((self.mapper & 0x0F) << 4) | 1, self.mapper & 0xF0])
+    header += bytearray(8)
+    return header + prg + chr
+
+class NROM(Rom):
+  pass
+
+class DMC(Rom):
+  """looping dmc at the highest rate plus raw pcm writes from the main loop"""
+  apu_enable = 0x1F
+
+  def init(self, a):
+    # samples come from the $E000 half of the rom, which is noise
+    store(a, [(0x4010, 0x4F), (0x4011, 0x00), (0x4012, 0x80), (0x4013, 0xFF)])
+
+  def main(self, a):
+    a('lda', '#', 0x1F)
+    a('sta', 'a', 0x4015)
+    a('ldx', '#', 0)
+    a.label('pcm')
+    a('txa')
+    a('and', '#', 0x7F)
+    a('sta', 'a', 0x4011)
+    a('inx')
+    a('bne', '', 'pcm')
+
+  def nmi(self, a):
+    # vary the rate so all the period table gets exercised
+    a('lda', 'z', FRAME)
+    a('and', '#', 0x0F)
+    a('ora', '#', 0x40)
+    a('sta', 'a', 0x4010)
+
+  def build(self):
+    # keep the code out of the sample area
+    a, code = Rom.build(self)
+    assert self.org + len(code) <= 0xE000
+    return a, code
+
+class MMC1(Rom):
+  """prg banks switched from the main loop, chr banks every frame"""
+  mapper = 1
+  prg_size = 0x20000
+  chr_size = 0x8000
+
+  def write(self, a, reg):
+    for i in range(5):
+      a('sta', 'a', reg)
+      if i < 4:
+        a('lsr')
+
+  def init(self, a):
+    store(a, [(0x8000, 0x80)])
+    # 16k prg with $C000 fixed, 4k chr, vertical mirroring
+    a('lda', '#', 0x1E)
+    self.write(a, 0x8000)
+
+  def main(self, a):
+    a('inc', 'z', BANK)
+    a('lda', 'z', BANK)
+    a('and', '#', 0x07)
+    self.write(a, 0xE000)
+    a('ldx', '#', 0)
+    a.label('readbank')
+    a('eor', 'a,x', 0x8000)
+    a('inx')
+    a('bne', '', 'readbank')
+    a('sta', 'z', SUM)
+
+  def nmi(self, a):
+    a('lda', 'z', FRAME)
+    a('and', '#', 0x07)
+    self.write(a, 0xA000)
+    a('lda', 'z', FRAME)
+    a('lsr')
+    a('and', '#', 0x07)
+    self.write(a, 0xC000)
+
+class MMC3(Rom):
+  """scanline irq every 16 lines, each switching a chr bank"""
+  mapper = 4
+  prg_size = 0x10000
+  chr_size = 0x10000
+  org = 0xE000
+
+  def init(self, a):
+    store(a, [(0xA000, 0x00), (0xE000, 0x00)])
+    for reg, bank in ((0, 0), (1, 2), (2, 4), (3, 5), (4, 6), (5, 7), (6, 0), (7, 1)):
+      store(a, [(0x8000, reg), (0x8001, bank)])
+
+  def main(self, a):
+    a('inc', 'z', BANK)
+    a('lda', '#', 6)
+    a('sta', 'a', 0x8000)
+    a('lda', 'z', BANK)
+    a('and', '#', 0x05)
+    a('sta', 'a', 0x8001)
+    a('ldx', '#', 0)
+    a.label('readbank')
+    a('eor', 'a,x', 0x8000)
+    a('inx')
+    a('bne', '', 'readbank')
+    a('sta', 'z', SUM)
+
+  def nmi(self, a):
+    store(a, [(0xE000, 0), (0xC000, 15), (0xC001, 0), (0xE001, 0)])
+
+  def irq(self, a):
+    a('sta', 'a', 0xE000)
+    a('sta', 'a', 0xE001)
+    a('lda', '#', 2)
+    a('sta', 'a', 0x8000)
+    a('inc', 'z', CHRBANK)
+    a('lda', 'z', CHRBANK)
+    a('sta', 'a', 0x8001)
+
+class MMC5(Rom):
+  """8k prg and 1k chr banking, scanline irq, multiplier and both pulses"""
+  mapper = 5
+  prg_size = 0x20000
+  chr_size = 0x10000
+  org = 0xE000
+
+  def init(self, a):
+    store(a, [(0x5100, 3), (0x5101, 3), (0x5102, 2), (0x5103, 1), (0x5104, 2), (0x5105, 0x44),
+              (0x5114, 0x80), (0x5115, 0x81), (0x5116, 0x82), (0x5117, 0xFF)])
+    for i in range(12):
+      store(a, [(0x5120 + i, i)])
+    store(a, [(0x5015, 0x03), (0x5000, 0xBF), (0x5002, 0x40), (0x5003, 0x01),
+              (0x5004, 0x7F), (0x5006, 0xC0), (0x5007, 0x00),
+              (0x5203, 120), (0x5204, 0x80)])
+
+  def main(self, a):
+    a('inc', 'z', BANK)
+    a('lda', 'z', BANK)
+    a('and', '#', 0x0F)
+    a('ora', '#', 0x80)
+    a('sta', 'a', 0x5114)
+    a('ldx', '#', 0)
+    a.label('readbank')
+    a('eor', 'a,x', 0x8000)
+    a('sta', 'a', 0x5205)
+    a('stx', 'a', 0x5206)
+    a('lda', 'a', 0x5205)
+    a('inx')
+    a('bne', '', 'readbank')
+    a('sta', 'z', SUM)
+
+  def nmi(self, a):
+    a('lda', 'z', FRAME)
+    a('sta', 'a', 0x5002)
+    a('eor', '#', 0xFF)
+    a('sta', 'a', 0x5006)
+
+  def irq(self, a):
+    a('lda', 'a', 0x5204)
+    a('inc', 'z', CHRBANK)
+    a('lda', 'z', CHRBANK)
+    a('sta', 'a', 0x5123)
+
+def opll_write(a):
+  """subroutine writing a to opll register x"""
+  a.label('opll')
+  a('stx', 'a', 0x9010)
+  a('sta', 'a', 0x9030)
+  a('rts')
+
+def opll_init(a):
+  """a custom instrument and a different instrument and volume per channel"""
+  for reg, value in enumerate((0x21, 0x21, 0x1A, 0x07, 0xF0, 0xF4, 0x23, 0x34)):
+    a('ldx', '#', reg)
+    a('lda', '#', value)
+    a('jsr', 'a', 'opll')
+  for ch in range(6):
+    a('ldx', '#', 0x30 + ch)
+    a('lda', '#', ((ch * 3) & 0x0F) << 4)
+    a('jsr', 'a', 'opll')
+
+def opll_keys(a):
+  """all six fm channels keyed on and off with a pitch sweep"""
+  for ch in range(6):
+    a('lda', 'z', FRAME)
+    if ch:
+      a('adc', '#', ch * 37)
+    a('ldx', '#', 0x10 + ch)
+    a('jsr', 'a', 'opll')
+    # key on for 24 frames, off for 8
+    a('lda', 'z', FRAME)
+    if ch:
+      a('adc', '#', ch * 5)
+    a('and', '#', 0x18)
+    a('cmp', '#', 0x18)
+    a('lda', '#', 0x14 | ((ch % 3) << 1))
+    a('bcc', '', 'keyon%d' % ch)
+    a('and', '#', 0x0F)
+    a.label('keyon%d' % ch)
+    a('ldx', '#', 0x20 + ch)
+    a('jsr', 'a', 'opll')
+
+class VRC7(Rom):
+  """all six fm channels keyed on and off with a pitch sweep"""
+  mapper = 85
+  prg_size = 0x10000
+  chr_size = 0x10000
+  org = 0xE000
+
+  def init(self, a):
+    store(a, [(0x8000, 0), (0x8010, 1), (0x9000, 2), (0xE000, 0), (0xF000, 0)])
+    for i, reg in enumerate((0xA000, 0xA010, 0xB000, 0xB010, 0xC000, 0xC010, 0xD000, 0xD010)):
+      store(a, [(reg, i)])
+    opll_init(a)
+
+  def main(self, a):
+    a('inc', 'z', BANK)
+    a('lda', 'z', BANK)
+    a('and', '#', 0x07)
+    a('sta', 'a', 0x8000)
+    a('ldx', '#', 0)
+    a.label('readbank')
+    a('eor', 'a,x', 0x8000)
+    a('inx')
+    a('bne', '', 'readbank')
+    a('sta', 'z', SUM)
+
+  def nmi(self, a):
+    opll_keys(a)
+
+  def subroutines(self, a):
+    opll_write(a)
+
+class Nsf:
+  """nsf skeleton: init starts the apu pulses and the expansion chip, play
+  runs once a frame and rewrites the chip's registers several times with
+  delays in between, so the sound is rendered in pieces between writes"""
+  chip = 0
+  org = 0x8000
+
+  def init(self, a):
+    pass
+  def play(self, a):
+    pass
+  def subroutines(self, a):
+    pass
+
+  def build(self):
+    a = Assembler(self.org)
+
+    a.label('init')
+    store(a, [(0x4015, 0x03), (0x4000, 0xB4), (0x4002, 0x80), (0x4003, 0x01),
+              (0x4004, 0x74), (0x4006, 0x00), (0x4007, 0x02)])
+    self.init(a)
+    a('rts')
+
+    a.label('play')
+    a('inc', 'z', FRAME)
+    a('lda', 'z', FRAME)
+    a('sta', 'a', 0x4002)
+    self.play(a)
+    a('rts')
+
+    # about 1300 cycles
+    a.label('wait')
+    a('ldx', '#', 0)
+    a.label('waitloop')
+    a('dex')
+    a('bne', '', 'waitloop')
+    a('rts')
+
+    self.subroutines(a)
+    return a, a.assemble()
+
+  def image(self, name):
+    a, code = self.build()
+    header = bytearray(b'NESM\x1a') + bytearray([1, 1, 1])
+    for addr in (self.org, a.labels['init'], a.labels['play']):
+      header += bytearray([addr & 0xFF, addr >> 8])
+    for text in (name, 'fceux-bench', ''):
+      header += bytearray(text.encode('ascii')).ljust(32, b'\0')
+    # 60 Hz, no bank switching, 50 Hz, ntsc
+    header += bytearray([0x1A, 0x41]) + bytearray(8) + bytearray([0x20, 0x4E, 0, self.chip])
+    header += bytearray(4)
+    return header + code
+
+class VRC6Nsf(Nsf):
+  """both pulses with duty and volume changes and the saw with a varying rate"""
+  chip = 0x01
+
+  def init(self, a):
+    store(a, [(0x9000, 0x3F), (0x9001, 0x00), (0x9002, 0x81),
+              (0xA000, 0x7A), (0xA001, 0x80), (0xA002, 0x80),
+              (0xB000, 0x20), (0xB001, 0x40), (0xB002, 0x81)])
+
+  def play(self, a):
+    a('lda', 'z', FRAME)
+    a('sta', 'a', 0x9001)
+    a('eor', '#', 0xFF)
+    a('sta', 'a', 0xA001)
+    a('jsr', 'a', 'wait')
+    store(a, [(0x9000, 0x1C), (0xA000, 0xF6)])
+    a('jsr', 'a', 'wait')
+    a('lda', 'z', FRAME)
+    a('and', '#', 0x3F)
+    a('sta', 'a', 0xB000)
+    a('jsr', 'a', 'wait')
+    store(a, [(0x9000, 0x5F), (0xA000, 0x7A), (0xB002, 0x80)])
+    a('jsr', 'a', 'wait')
+    store(a, [(0xB002, 0x81)])
+
+class VRC7Nsf(Nsf):
+  """the same six fm channels as vrc7.nes, keyed from the play routine"""
+  chip = 0x02
+
+  def init(self, a):
+    opll_init(a)
+
+  def play(self, a):
+    opll_keys(a)
+
+  def subroutines(self, a):
+    opll_write(a)
+
+class N163Nsf(Nsf):
+  """four wavetable channels over two waves, with volume changes mid-frame"""
+  chip = 0x10
+
+  def init(self, a):
+    # a 32 sample triangle at $00 and a ramp at $10, written with auto increment
+    store(a, [(0xF800, 0x80)])
+    tri = [i if i < 16 else 31 - i for i in range(32)]
+    ramp = [i >> 1 for i in range(32)]
+    for value in [w[i] | (w[i + 1] << 4) for w in (tri, ramp) for i in range(0, 32, 2)]:
+      a('lda', '#', value)
+      a('sta', 'a', 0x4800)
+    for ch in range(4, 8):
+      base = 0x40 + ch * 8
+      store(a, [(0xF800, 0x80 | base),
+                (0x4800, 0x00), (0x4800, 0x00), (0x4800, (ch * 0x13) & 0xFF), (0x4800, 0x00),
+                (0x4800, 0xE0), (0x4800, 0x00), (0x4800, (ch & 1) * 0x20), (0x4800, 0x38 if ch == 7 else 0x08)])
+
+  def play(self, a):
+    for ch in range(4, 8):
+      base = 0x40 + ch * 8
+      a('lda', '#', base + 2)
+      a('sta', 'a', 0xF800)
+      a('lda', 'z', FRAME)
+      if ch & 1:
+        a('eor', '#', 0xFF)
+      a('sta', 'a', 0x4800)
+      a('jsr', 'a', 'wait')
+    for ch in range(4, 8):
+      a('lda', '#', 0x40 + ch * 8 + 7)
+      a('sta', 'a', 0xF800)
+      a('lda', 'z', FRAME)
+      a('and', '#', 0x0F)
+      if ch == 7:
+        a('ora', '#', 0x30)
+      a('sta', 'a', 0x4800)
+
+class MMC5Nsf(Nsf):
+  """both pulses and raw pcm written from a loop"""
+  chip = 0x08
+
+  def init(self, a):
+    store(a, [(0x5015, 0x03), (0x5000, 0xBF), (0x5002, 0x40), (0x5003, 0x01),
+              (0x5004, 0x7C), (0x5006, 0xC0), (0x5007, 0x00), (0x5010, 0x00)])
+
+  def play(self, a):
+    a('lda', 'z', FRAME)
+    a('sta', 'a', 0x5002)
+    a('eor', '#', 0xFF)
+    a('sta', 'a', 0x5006)
+    a('jsr', 'a', 'wait')
+    store(a, [(0x5000, 0x3A), (0x5004, 0xFF)])
+    a('ldx', '#', 0)
+    a.label('pcm')
+    a('txa')
+    a('sta', 'a', 0x5011)
+    a('inx')
+    a('bne', '', 'pcm')
+    store(a, [(0x5011, 0x00), (0x5000, 0xBF), (0x5004, 0x7C)])
+
+ROMS = [
+  ('nrom.nes', NROM),
+  ('mmc1.nes', MMC1),
+  ('mmc3.nes', MMC3),
+  ('mmc5.nes', MMC5),
+  ('vrc7.nes', VRC7),
+  ('dmc.nes', DMC),
+]
+
+NSFS = [
+  ('vrc6.nsf', VRC6Nsf),
+  ('vrc7.nsf', VRC7Nsf),
+  ('n163.nsf', N163Nsf),
+  ('mmc5.nsf', MMC5Nsf),
+]
+
+def main():
+  outdir = len(sys.argv) > 1 and sys.argv[1] or '.'
+  if not os.path.isdir(outdir):
+    os.makedirs(outdir)
+  for name, cls in ROMS:
+    f = open(os.path.join(outdir, name), 'wb')
+    f.write(cls().image())
+    f.close()
+  for name, cls in NSFS:
+    f = open(os.path.join(outdir, name), 'wb')
+    f.write(cls().image(name))
+    f.close()
+
+if __name__ == '__main__':
+  main()
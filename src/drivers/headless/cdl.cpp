@@ -0,0 +1,311 @@
+/// \file
+/// \brief fceux-cdl: replays movies with the code/data logger on, each in a worker process of its
+/// own, and merges what they covered into one .cdl file
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../cart.h"
+#include "../../movie.h"
+#include "../../debug.h"
+#include "headless.h"
+
+struct CoverageOptions
+{
+	const char *rom;
+	int frames;
+};
+
+//the merged logs: prg then chr, as a .cdl file has them. chr is only logged for chr rom
+struct Coverage
+{
+	std::vector<uint8> prg, chr;
+};
+
+static std::string BaseName(const char *path)
+{
+	const char *p = strrchr(path, '/');
+	std::string name = p ? p + 1 : path;
+	size_t dot = name.rfind('.');
+	if(dot != std::string::npos && dot > 0)
+		name.erase(dot);
+	return name;
+}
+
+//sets the logger up the way the windows code/data logger does when it starts
+static void StartLogging()
+{
+	cdloggerdataSize = PRGsize[0];
+	cdloggerdata = (unsigned char *)calloc(cdloggerdataSize, 1);
+	if(!CHRram[0] || CHRptr[0] == PRGptr[0])
+	{
+		cdloggerVideoDataSize = CHRsize[0];
+		cdloggervdata = (unsigned char *)calloc(cdloggerVideoDataSize, 1);
+	}
+	else
+		cdloggerVideoDataSize = 0;
+	codecount = datacount = rendercount = vromreadcount = 0;
+	undefinedcount = cdloggerdataSize;
+	undefinedvromcount = cdloggerVideoDataSize;
+	FCEUI_SetLoggingCD(1);
+}
+
+//runs in the worker process. the log goes to "out" as two sizes and the prg and chr logs
+static int Replay(const char *movie, const CoverageOptions &o, FILE *out)
+{
+	HeadlessQuiet = true;
+	if(!FCEUI_Initialize())
+		return 1;
+	if(!FCEUI_LoadGame(o.rom, 1, true))
+	{
+		fprintf(stderr, "Couldn't load %s\n", o.rom);
+		return 1;
+	}
+	StartLogging();
+	if(movie && !FCEUI_LoadMovie(movie, true, 0))
+	{
+		fprintf(stderr, "Couldn't play %s\n", movie);
+		FCEUI_CloseGame();
+		return 1;
+	}
+
+	// the video is drawn, since chr coverage comes from the ppu's rendering
+	int frames = 0;
+	uint64 t0 = HeadlessTime();
+	while(!o.frames || frames < o.frames)
+	{
+		if(movie && !FCEUMOV_Mode(MOVIEMODE_PLAY))
+			break;
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		frames++;
+	}
+	double seconds = (HeadlessTime() - t0) / 1000000.0;
+
+	uint32 sizes[2] = { cdloggerdataSize, cdloggerVideoDataSize };
+	bool ok = fwrite(sizes, sizeof(sizes), 1, out) == 1
+		&& fwrite(cdloggerdata, 1, cdloggerdataSize, out) == cdloggerdataSize
+		&& fwrite(cdloggervdata, 1, cdloggerVideoDataSize, out) == cdloggerVideoDataSize
+		&& fflush(out) == 0;
+
+	printf("%s: %d frames, %d code and %d data bytes, %.0f fps\n", movie ? movie : o.rom, frames, (int)codecount, (int)datacount,
+		seconds > 0 ? frames / seconds : 0);
+	fflush(stdout);
+	FCEUI_CloseGame();
+	FCEUI_Kill();
+	return ok ? 0 : 1;
+}
+
+static void Merge(std::vector<uint8> &to, const uint8 *from, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+		to[i] |= from[i];
+}
+
+//reads what a worker wrote and merges it in
+static bool MergeReplay(FILE *fp, Coverage &c, bool &sized)
+{
+	uint32 sizes[2];
+	rewind(fp);
+	if(fread(sizes, sizeof(sizes), 1, fp) != 1)
+		return false;
+	if(!sized)
+	{
+		c.prg.assign(sizes[0], 0);
+		c.chr.assign(sizes[1], 0);
+		sized = true;
+	}
+	if(sizes[0] != c.prg.size() || sizes[1] != c.chr.size())
+		return false;
+	std::vector<uint8> buf(sizes[0] + sizes[1]);
+	if(!buf.empty() && fread(&buf[0], 1, buf.size(), fp) != buf.size())
+		return false;
+	Merge(c.prg, &buf[0], sizes[0]);
+	Merge(c.chr, &buf[0] + sizes[0], sizes[1]);
+	return true;
+}
+
+//merges an existing .cdl file in; it has to be for the same rom
+static bool MergeFile(const char *fname, Coverage &c)
+{
+	FILE *fp = fopen(fname, "rb");
+	if(!fp)
+		return false;
+	std::vector<uint8> buf(c.prg.size() + c.chr.size() + 1);
+	size_t got = fread(&buf[0], 1, buf.size(), fp);
+	fclose(fp);
+	// a log written without chr is fine too
+	if(got != c.prg.size() + c.chr.size() && got != c.prg.size())
+		return false;
+	Merge(c.prg, &buf[0], c.prg.size());
+	Merge(c.chr, &buf[0] + c.prg.size(), got - c.prg.size());
+	return true;
+}
+
+static int Count(const std::vector<uint8> &log, uint8 mask)
+{
+	int n = 0;
+	for(size_t i = 0; i < log.size(); i++)
+		if(log[i] & mask)
+			n++;
+	return n;
+}
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] rom [movie...]\n"
+		"  --frames n   longest a replay may run, 0 for the whole movie (default 0). without\n"
+		"               movies, the rom runs this many frames from power on (default 3600)\n"
+		"  --merge cdl  merge an existing log for the same rom into the result; can be repeated\n"
+		"  --out cdl    where the merged log goes (default <rom name>.cdl)\n"
+		"  -j n         worker processes (default one per cpu)\n"
+		"each movie is replayed with the code/data logger on and what all of them covered is\n"
+		"written as one .cdl file\n",
+		prog);
+}
+
+struct ReplayJobs : HeadlessJobs
+{
+	const std::vector<const char *> &movies;
+	const CoverageOptions &o;
+	std::vector<FILE *> logs;
+	Coverage c;
+	bool sized;
+	int failures;
+
+	ReplayJobs(const std::vector<const char *> &movies, const CoverageOptions &o)
+		: movies(movies), o(o), logs(movies.size()), sized(false), failures(0) {}
+	bool Prepare(size_t i)
+	{
+		logs[i] = tmpfile();
+		if(!logs[i])
+			perror("tmpfile");
+		return logs[i] != NULL;
+	}
+	int Run(size_t i) { return Replay(movies[i], o, logs[i]); }
+	void Finish(size_t i, bool ok)
+	{
+		if(!ok || !MergeReplay(logs[i], c, sized))
+			failures++;
+		if(logs[i])
+			fclose(logs[i]);
+		logs[i] = NULL;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	CoverageOptions o;
+	o.rom = NULL;
+	o.frames = -1;
+	std::string outname;
+	std::vector<const char *> merges;
+	std::vector<const char *> movies;
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		bool hasval = i + 1 < argc;
+		if(!strcmp(arg, "--frames") && hasval)
+			o.frames = atoi(argv[++i]);
+		else if(!strcmp(arg, "--merge") && hasval)
+			merges.push_back(argv[++i]);
+		else if(!strcmp(arg, "--out") && hasval)
+			outname = argv[++i];
+		else if(!strcmp(arg, "-j") && hasval)
+			workers = atoi(argv[++i]);
+		else if(arg[0] == '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+		else if(!o.rom)
+			o.rom = arg;
+		else
+			movies.push_back(arg);
+	}
+	if(!o.rom)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+	if(o.frames < 0)
+		o.frames = movies.empty() ? 3600 : 0;
+	if(movies.empty())
+	{
+		if(!o.frames)
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+		movies.push_back(NULL);
+	}
+	if(workers < 1)
+		workers = 1;
+	if(outname.empty())
+		outname = BaseName(o.rom) + ".cdl";
+
+	printf("replaying %d run(s) of %s with %ld worker(s)\n", (int)movies.size(), o.rom, workers);
+
+	// every replay gets a fresh process and hands its log back through a temporary file
+	uint64 t0 = HeadlessTime();
+	ReplayJobs run(movies, o);
+	Coverage &c = run.c;
+	if(HeadlessRunJobs(run, movies.size(), workers))
+	{
+		// a log missing whole runs would pass for the full coverage, so don't write one
+		fprintf(stderr, "Not all runs could be replayed, nothing written\n");
+		return 1;
+	}
+	int failures = run.failures;
+
+	if(!run.sized)
+	{
+		fprintf(stderr, "No replay finished, nothing to write\n");
+		return 1;
+	}
+	for(size_t i = 0; i < merges.size(); i++)
+		if(!MergeFile(merges[i], c))
+		{
+			fprintf(stderr, "Couldn't merge %s, it is missing or for another rom\n", merges[i]);
+			failures++;
+		}
+
+	FILE *fp = fopen(outname.c_str(), "wb");
+	if(!fp || fwrite(&c.prg[0], 1, c.prg.size(), fp) != c.prg.size()
+		|| (!c.chr.empty() && fwrite(&c.chr[0], 1, c.chr.size(), fp) != c.chr.size()))
+	{
+		fprintf(stderr, "Couldn't write %s\n", outname.c_str());
+		if(fp)
+			fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	double prgsize = c.prg.size();
+	int code = Count(c.prg, 1), data = Count(c.prg, 2), undefined = (int)c.prg.size() - Count(c.prg, 3);
+	printf("%s: code 0x%06x %.2f%%, data 0x%06x %.2f%%, undefined 0x%06x %.2f%%\n", outname.c_str(),
+		code, code * 100 / prgsize, data, data * 100 / prgsize, undefined, undefined * 100 / prgsize);
+	if(!c.chr.empty())
+	{
+		double chrsize = c.chr.size();
+		int rendered = Count(c.chr, 1), read = Count(c.chr, 2), unused = (int)c.chr.size() - Count(c.chr, 3);
+		printf("chr: rendered 0x%06x %.2f%%, read 0x%06x %.2f%%, undefined 0x%06x %.2f%%\n",
+			rendered, rendered * 100 / chrsize, read, read * 100 / chrsize, unused, unused * 100 / chrsize);
+	}
+	printf("%d run(s) in %.2f s\n", (int)movies.size(), (HeadlessTime() - t0) / 1000000.0);
+	if(failures)
+		fprintf(stderr, "%d failure(s)\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,749 @@
+/// \file
+/// \brief fceux-desync: plays a movie on two differently set up emulators side by side, hashes every
+/// savestate field after each frame, and narrows the first difference down to a frame, then to an
+/// instruction, and names the fields that differ
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../movie.h"
+#include "../../state.h"
+#include "../../trace.h"
+#include "../../debug.h"
+#include "../../x6502.h"
+#include "../../ppu.h"
+#include "../../utils/hash.h"
+#include "headless.h"
+
+//each side runs in a worker process and the two are driven over its stdin and stdout in lines of
+//text. a worker can be another build's fceux-desync, so this goes up whenever the lines change:
+//
+//  worker: FCEUDESYNC <version>, then "field <chunk>.<name> <size>" for each field, then "ready"
+//  select <i>...       the fields the frame hashes cover, by index
+//  run <n>             plays n frames, each answered with "frame <frame> <hash> <instructions>",
+//                      and "end" when the movie runs out first; then "ok"
+//  fields <f>          replays frame f of the last run and answers "fields <hash> <field hash>..."
+//  probe <f> <k>       replays frame f of the last run up to its instruction k and answers
+//                      "probe <hash> <pc> <size> <b0> <b1> <b2> <a> <x> <y> <p> <s> <scanline>
+//                      <field hash>...", or "probe none" when the frame has fewer instructions
+//
+//hashes are FCEU_Hash64 in hex; a frame hash is the hash of the selected field hashes, little endian
+#define DESYNC_PROTOCOL 1
+
+//how one side is set up
+struct SideSettings
+{
+	std::string exe; //another build's fceux-desync, or empty for this one
+	int newppu, soundq, stepsynth, soundrate;
+
+	SideSettings() : newppu(0), soundq(1), stepsynth(0), soundrate(48000) {}
+};
+
+static bool ReadLine(FILE *fp, std::string &line)
+{
+	line.clear();
+	int c;
+	while((c = getc(fp)) != EOF && c != '\n')
+		line += (char)c;
+	return c != EOF || !line.empty();
+}
+
+static uint64 CombineHashes(const std::vector<uint64> &hashes, const std::vector<int> &selected)
+{
+	std::vector<uint8> buf(selected.size() * 8);
+	for(size_t i = 0; i < selected.size(); i++)
+	{
+		uint64 h = hashes[selected[i]];
+		for(int b = 0; b < 8; b++)
+			buf[i * 8 + b] = (uint8)(h >> (b * 8));
+	}
+	return FCEU_Hash64(buf.empty() ? NULL : &buf[0], buf.size());
+}
+
+// ---- the worker
+
+//the start of each frame of the last run, to replay it from
+struct FrameStart
+{
+	int frame;
+	std::vector<uint8> state;
+};
+
+static std::vector<FrameStart> starts;
+static std::vector<int> selected;
+static std::vector<uint64> hashes;
+
+//what the probe saw
+static bool probed;
+static std::vector<uint64> probehashes;
+static uint16 probepc;
+static uint8 probebytes[3], proberegs[5];
+static int probesize, probescanline;
+
+static void ProbeNow()
+{
+	probed = true;
+	FCEUSS_HashFields(&probehashes);
+	probepc = X.PC;
+	uint8 op = GetMem(X.PC);
+	probesize = opsize[op] ? opsize[op] : 1;
+	for(int i = 0; i < 3; i++)
+		probebytes[i] = i < probesize ? GetMem((X.PC + i) & 0xFFFF) : 0;
+	proberegs[0] = X.A;
+	proberegs[1] = X.X;
+	proberegs[2] = X.Y;
+	proberegs[3] = X.P;
+	proberegs[4] = X.S;
+	probescanline = newppu ? newppu_get_scanline() : scanline;
+}
+
+static void EmulateFrame()
+{
+	// the picture is drawn: the old ppu's skip mode changes what some games do
+	uint8 *gfx;
+	int32 *sound;
+	int32 ssize;
+	FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+}
+
+static bool Rewind(int frame)
+{
+	for(size_t i = 0; i < starts.size(); i++)
+	{
+		if(starts[i].frame != frame)
+			continue;
+		if(!FCEUSS_LoadRaw(&starts[i].state[0], (uint32)starts[i].state.size()))
+			return false;
+		currFrameCounter = frame;
+		return true;
+	}
+	return false;
+}
+
+static void PrintHashes(const std::vector<uint64> &h)
+{
+	for(size_t i = 0; i < h.size(); i++)
+		printf(" %016llx", (unsigned long long)h[i]);
+	printf("\n");
+}
+
+static int Serve(const SideSettings &s, const char *rom, const char *movie)
+{
+	HeadlessQuiet = true;
+	if(!FCEUI_Initialize())
+		return 1;
+	if(newppu != s.newppu)
+		FCEU_TogglePPU();
+	FCEUI_Sound(s.soundrate);
+	FCEUI_SetSoundQuality(s.soundq);
+	FCEUI_SetStepSynth(s.stepsynth);
+	printf("FCEUDESYNC %d\n", DESYNC_PROTOCOL);
+	if(!FCEUI_LoadGame(rom, 1, true) || (movie && !FCEUI_LoadMovie(movie, true, 0)))
+	{
+		printf("error couldn't play %s on %s\n", movie ? movie : "power on", rom);
+		return 1;
+	}
+
+	std::vector<FCEU_STATE_FIELD> fields;
+	FCEUSS_GetFields(&fields);
+	for(size_t i = 0; i < fields.size(); i++)
+	{
+		printf("field %s.%s %u\n", fields[i].chunk, fields[i].name, fields[i].size);
+		selected.push_back((int)i);
+	}
+	printf("ready\n");
+	fflush(stdout);
+
+	std::string line;
+	while(ReadLine(stdin, line))
+	{
+		const char *cmd = line.c_str();
+		char *p;
+		if(!strncmp(cmd, "select", 6))
+		{
+			selected.clear();
+			for(const char *q = cmd + 6;; q = p)
+			{
+				long i = strtol(q, &p, 10);
+				if(p == q)
+					break;
+				if(i >= 0 && i < (long)fields.size())
+					selected.push_back((int)i);
+			}
+			printf("ok\n");
+		}
+		else if(!strncmp(cmd, "run ", 4))
+		{
+			int n = atoi(cmd + 4);
+			uint32 size = FCEUSS_RawSize();
+			starts.resize(n);
+			for(int i = 0; i < n; i++)
+			{
+				if(movie && !FCEUMOV_Mode(MOVIEMODE_PLAY))
+				{
+					starts.resize(i);
+					printf("end\n");
+					break;
+				}
+				starts[i].frame = currFrameCounter;
+				starts[i].state.resize(size);
+				FCEUSS_SaveRaw(&starts[i].state[0]);
+				uint64 i0 = total_instructions;
+				EmulateFrame();
+				FCEUSS_HashFields(&hashes);
+				printf("frame %d %016llx %llu\n", starts[i].frame, (unsigned long long)CombineHashes(hashes, selected),
+					(unsigned long long)(total_instructions - i0));
+			}
+			printf("ok\n");
+		}
+		else if(!strncmp(cmd, "fields ", 7))
+		{
+			if(!Rewind(atoi(cmd + 7)))
+				printf("error frame %s is not in the last run\n", cmd + 7);
+			else
+			{
+				EmulateFrame();
+				FCEUSS_HashFields(&hashes);
+				printf("fields %016llx", (unsigned long long)CombineHashes(hashes, selected));
+				PrintHashes(hashes);
+			}
+		}
+		else if(!strncmp(cmd, "probe ", 6))
+		{
+			int frame = (int)strtol(cmd + 6, &p, 10);
+			uint32 k = (uint32)strtoul(p, NULL, 10);
+			if(!Rewind(frame))
+				printf("error frame %d is not in the last run\n", frame);
+			else
+			{
+				probed = false;
+				FCEUI_TraceProbe(k, ProbeNow);
+				EmulateFrame();
+				FCEUI_TraceProbe(0, NULL);
+				if(!probed)
+					printf("probe none\n");
+				else
+				{
+					printf("probe %016llx %x %d %x %x %x %x %x %x %x %x %d", (unsigned long long)CombineHashes(probehashes, selected),
+						probepc, probesize, probebytes[0], probebytes[1], probebytes[2],
+						proberegs[0], proberegs[1], proberegs[2], proberegs[3], proberegs[4], probescanline);
+					PrintHashes(probehashes);
+				}
+			}
+		}
+		else if(!strcmp(cmd, "quit"))
+			break;
+		else
+			printf("error unknown command %s\n", cmd);
+		fflush(stdout);
+	}
+
+	FCEUI_CloseGame();
+	FCEUI_Kill();
+	return 0;
+}
+
+// ---- the tool
+
+struct Side
+{
+	const char *label;
+	SideSettings settings;
+	pid_t pid;
+	FILE *to, *from;
+	std::vector<std::string> fields; //chunk.name, with #2, #3... on names that repeat in a chunk
+	std::vector<uint32> sizes;
+	std::vector<int> common; //the fields both sides have, in the same order on each
+};
+
+//what one side said after a frame, or at a probe
+struct Frame
+{
+	int frame;
+	uint64 hash;
+	uint64 instructions;
+};
+
+struct Probe
+{
+	bool ok;
+	uint64 hash;
+	int pc, size, bytes[3], regs[5], scanline;
+	std::vector<uint64> hashes;
+};
+
+static void Describe(const Side &s)
+{
+	printf("%s: %s%s ppu, sound quality %d%s, %d Hz\n", s.label, s.settings.exe.empty() ? "" : (s.settings.exe + ", ").c_str(),
+		s.settings.newppu ? "new" : "old", s.settings.soundq, s.settings.stepsynth ? " step synth" : "", s.settings.soundrate);
+}
+
+static bool Start(Side &s, const char *rom, const char *movie)
+{
+	int to[2], from[2];
+	if(pipe(to) || pipe(from))
+		return false;
+	fflush(stdout);
+	s.pid = fork();
+	if(s.pid < 0)
+		return false;
+	if(s.pid == 0)
+	{
+		dup2(to[0], 0);
+		dup2(from[1], 1);
+		close(to[0]); close(to[1]); close(from[0]); close(from[1]);
+		if(s.settings.exe.empty())
+			_exit(Serve(s.settings, rom, movie));
+
+		char numbers[4][16];
+		sprintf(numbers[0], "%d", s.settings.newppu);
+		sprintf(numbers[1], "%d", s.settings.soundq);
+		sprintf(numbers[2], "%d", s.settings.stepsynth);
+		sprintf(numbers[3], "%d", s.settings.soundrate);
+		const char *args[] = { s.settings.exe.c_str(), "--serve", "--newppu", numbers[0], "--soundq", numbers[1],
+			"--stepsynth", numbers[2], "--soundrate", numbers[3], rom, movie, NULL };
+		// without a movie the list simply ends one early
+		execvp(args[0], (char **)args);
+		_exit(127);
+	}
+	close(to[0]);
+	close(from[1]);
+	s.to = fdopen(to[1], "w");
+	s.from = fdopen(from[0], "r");
+
+	std::string line;
+	int version = 0;
+	if(!ReadLine(s.from, line) || sscanf(line.c_str(), "FCEUDESYNC %d", &version) != 1 || version != DESYNC_PROTOCOL)
+	{
+		fprintf(stderr, "%s: the worker does not speak version %d of the protocol\n", s.label, DESYNC_PROTOCOL);
+		return false;
+	}
+	std::map<std::string, int> seen;
+	while(ReadLine(s.from, line) && line != "ready")
+	{
+		char name[64];
+		unsigned size;
+		if(sscanf(line.c_str(), "field %63s %u", name, &size) != 2)
+		{
+			fprintf(stderr, "%s: %s\n", s.label, line.c_str());
+			return false;
+		}
+		std::string key = name;
+		int n = ++seen[key];
+		if(n > 1)
+		{
+			char suffix[16];
+			sprintf(suffix, "#%d", n);
+			key += suffix;
+		}
+		s.fields.push_back(key);
+		s.sizes.push_back(size);
+	}
+	return line == "ready";
+}
+
+static void Send(Side &s, const std::string &cmd)
+{
+	fprintf(s.to, "%s\n", cmd.c_str());
+	fflush(s.to);
+}
+
+static bool Ignored(const std::string &field, const std::vector<std::string> &ignore)
+{
+	std::string base = field.substr(0, field.find('#'));
+	std::string chunk = base.substr(0, base.find('.'));
+	for(size_t i = 0; i < ignore.size(); i++)
+		if(ignore[i] == chunk || ignore[i] == base || ignore[i] == field)
+			return true;
+	return false;
+}
+
+//lines up the fields the two sides have in common and are not told to ignore
+static bool Match(Side &a, Side &b, const std::vector<std::string> &ignore)
+{
+	std::map<std::string, int> inb;
+	for(size_t i = 0; i < b.fields.size(); i++)
+		inb[b.fields[i]] = (int)i;
+	for(size_t i = 0; i < a.fields.size(); i++)
+	{
+		std::map<std::string, int>::iterator it = inb.find(a.fields[i]);
+		if(it == inb.end())
+			printf("only %s has %s\n", a.label, a.fields[i].c_str());
+		else if(a.sizes[i] != b.sizes[it->second])
+			printf("%s is %u bytes on %s and %u on %s, left out\n", a.fields[i].c_str(), a.sizes[i], a.label, b.sizes[it->second], b.label);
+		else if(!Ignored(a.fields[i], ignore))
+		{
+			a.common.push_back((int)i);
+			b.common.push_back(it->second);
+		}
+		if(it != inb.end())
+			inb.erase(it);
+	}
+	for(std::map<std::string, int>::iterator it = inb.begin(); it != inb.end(); ++it)
+		printf("only %s has %s\n", b.label, it->first.c_str());
+
+	Side *sides[2] = { &a, &b };
+	std::string line;
+	for(int s = 0; s < 2; s++)
+	{
+		std::string cmd = "select";
+		for(size_t i = 0; i < sides[s]->common.size(); i++)
+		{
+			char n[16];
+			sprintf(n, " %d", sides[s]->common[i]);
+			cmd += n;
+		}
+		Send(*sides[s], cmd);
+		if(!ReadLine(sides[s]->from, line) || line != "ok")
+			return false;
+	}
+	return !a.common.empty();
+}
+
+static bool ParseHashes(const char *p, std::vector<uint64> &hashes)
+{
+	hashes.clear();
+	char *end;
+	for(;;)
+	{
+		while(*p == ' ')
+			p++;
+		if(!*p)
+			return true;
+		hashes.push_back(strtoull(p, &end, 16));
+		if(end == p)
+			return false;
+		p = end;
+	}
+}
+
+//plays a run of frames; false when a side fails
+static bool Run(Side &s, std::vector<Frame> &frames, bool &ended)
+{
+	frames.clear();
+	ended = false;
+	std::string line;
+	while(ReadLine(s.from, line) && line != "ok")
+	{
+		Frame f;
+		unsigned long long hash, instructions;
+		if(line == "end")
+			ended = true;
+		else if(sscanf(line.c_str(), "frame %d %llx %llu", &f.frame, &hash, &instructions) == 3)
+		{
+			f.hash = hash;
+			f.instructions = instructions;
+			frames.push_back(f);
+		}
+		else
+		{
+			fprintf(stderr, "%s: %s\n", s.label, line.c_str());
+			return false;
+		}
+	}
+	return line == "ok";
+}
+
+static bool Fields(Side &s, int frame, uint64 &hash, std::vector<uint64> &hashes)
+{
+	char cmd[32];
+	sprintf(cmd, "fields %d", frame);
+	Send(s, cmd);
+	std::string line;
+	unsigned long long h;
+	int used;
+	if(!ReadLine(s.from, line) || sscanf(line.c_str(), "fields %llx%n", &h, &used) != 1 || !ParseHashes(line.c_str() + used, hashes)
+		|| hashes.size() != s.fields.size())
+	{
+		fprintf(stderr, "%s: %s\n", s.label, line.c_str());
+		return false;
+	}
+	hash = h;
+	return true;
+}
+
+static bool ProbeAt(Side &s, int frame, uint64 k, Probe &p)
+{
+	char cmd[48];
+	sprintf(cmd, "probe %d %llu", frame, (unsigned long long)k);
+	Send(s, cmd);
+	std::string line;
+	if(!ReadLine(s.from, line))
+		return false;
+	p.ok = false;
+	if(line == "probe none")
+		return true;
+	unsigned long long h;
+	int used;
+	if(sscanf(line.c_str(), "probe %llx %x %d %x %x %x %x %x %x %x %x %d%n", &h, &p.pc, &p.size, &p.bytes[0], &p.bytes[1], &p.bytes[2],
+		&p.regs[0], &p.regs[1], &p.regs[2], &p.regs[3], &p.regs[4], &p.scanline, &used) != 12
+		|| !ParseHashes(line.c_str() + used, p.hashes) || p.hashes.size() != s.fields.size())
+	{
+		fprintf(stderr, "%s: %s\n", s.label, line.c_str());
+		return false;
+	}
+	p.hash = h;
+	p.ok = true;
+	return true;
+}
+
+static void PrintDifferences(const Side &a, const std::vector<uint64> &ha, const Side &b, const std::vector<uint64> &hb)
+{
+	for(size_t i = 0; i < a.common.size(); i++)
+		if(ha[a.common[i]] != hb[b.common[i]])
+			printf("    %s (%u bytes)\n", a.fields[a.common[i]].c_str(), a.sizes[a.common[i]]);
+}
+
+static void PrintInstruction(const Side &s, const Probe &p)
+{
+	char bytes[16] = "";
+	for(int i = 0; i < p.size && i < 3; i++)
+		sprintf(bytes + i * 3, "%02X ", p.bytes[i]);
+	printf("  %s: $%04X: %-9s A:%02X X:%02X Y:%02X P:%02X S:%02X scanline %d\n", s.label, p.pc, bytes,
+		p.regs[0], p.regs[1], p.regs[2], p.regs[3], p.regs[4], p.scanline);
+}
+
+//frame f ends differently on the two sides, although it started the same
+static bool Narrow(Side &a, Side &b, const Frame &fa, const Frame &fb)
+{
+	int frame = fa.frame;
+	printf("the runs first differ after frame %d\n", frame);
+
+	uint64 ha, hb;
+	std::vector<uint64> fieldsa, fieldsb;
+	if(!Fields(a, frame, ha, fieldsa) || !Fields(b, frame, hb, fieldsb))
+		return false;
+	if(ha != fa.hash)
+		printf("  (%s does not replay frame %d the same from a snapshot, so its savestate misses some state)\n", a.label, frame);
+	if(hb != fb.hash)
+		printf("  (%s does not replay frame %d the same from a snapshot, so its savestate misses some state)\n", b.label, frame);
+	printf("  fields that differ after it:\n");
+	PrintDifferences(a, fieldsa, b, fieldsb);
+
+	if(fa.instructions != fb.instructions)
+		printf("  %s ran %llu instructions in it, %s %llu\n", a.label, (unsigned long long)fa.instructions, b.label,
+			(unsigned long long)fb.instructions);
+
+	//the state before instruction k; the end of the frame stands in for the one past the last
+	uint64 n = fa.instructions < fb.instructions ? fa.instructions : fb.instructions;
+	Probe pa, pb;
+	if(!ProbeAt(a, frame, 0, pa) || !ProbeAt(b, frame, 0, pb))
+		return false;
+	if(!pa.ok || !pb.ok)
+		return true;
+	if(pa.hash != pb.hash)
+	{
+		printf("  they already differ before its first instruction, in:\n");
+		PrintDifferences(a, pa.hashes, b, pb.hashes);
+		return true;
+	}
+
+	uint64 lo = 0, hi = n;
+	Probe same = pa, samepb = pb, differ, differb;
+	bool differprobed = false;
+	while(hi - lo > 1)
+	{
+		uint64 mid = lo + (hi - lo) / 2;
+		if(!ProbeAt(a, frame, mid, pa) || !ProbeAt(b, frame, mid, pb) || !pa.ok || !pb.ok)
+			return false;
+		if(pa.hash == pb.hash)
+		{
+			lo = mid;
+			same = pa;
+			samepb = pb;
+		}
+		else
+		{
+			hi = mid;
+			differ = pa;
+			differb = pb;
+			differprobed = true;
+		}
+	}
+
+	printf("  the first instruction after which they differ is number %llu of %llu in the frame:\n", (unsigned long long)lo,
+		(unsigned long long)n);
+	PrintInstruction(a, same);
+	PrintInstruction(b, samepb);
+	if(differprobed)
+	{
+		printf("  fields that differ after it:\n");
+		PrintDifferences(a, differ.hashes, b, differb.hashes);
+	}
+	else
+		printf("  it is the frame's last, and the fields after it are the ones above\n");
+	return true;
+}
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] rom [movie]\n"
+		"  --newppu n      0 for the old ppu, 1 for the new one (default 0)\n"
+		"  --soundq n      sound quality, 0 to 2 (default 1)\n"
+		"  --stepsynth n   1 renders high quality sound from band-limited steps (default 0)\n"
+		"  --soundrate n   sound rate in Hz (default 48000)\n"
+		"  --exe path      play with another build's fceux-desync\n"
+		"                  each of these goes for both sides, or for one with --a-... or --b-...,\n"
+		"                  as in --b-newppu 1\n"
+		"  --ignore f      leave a chunk (PPU) or a field (PPU.PGEN) out; can be repeated\n"
+		"  --frames n      stop after n frames, 0 for the whole movie (default 0). without a movie,\n"
+		"                  the rom runs this many frames from power on (default 3600)\n"
+		"  --batch n       frames each side plays between comparisons (default 120)\n"
+		"the movie is played on both sides, every savestate field is hashed after each frame, and the\n"
+		"first frame that ends differently is narrowed down to the instruction where they part\n",
+		prog);
+}
+
+static bool SetOption(SideSettings &s, const char *name, const char *value)
+{
+	if(!strcmp(name, "exe"))
+		s.exe = value;
+	else if(!strcmp(name, "newppu"))
+		s.newppu = atoi(value) != 0;
+	else if(!strcmp(name, "soundq"))
+		s.soundq = atoi(value);
+	else if(!strcmp(name, "stepsynth"))
+		s.stepsynth = atoi(value) != 0;
+	else if(!strcmp(name, "soundrate"))
+		s.soundrate = atoi(value);
+	else
+		return false;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	Side a, b;
+	a.label = "a";
+	b.label = "b";
+	const char *rom = NULL, *movie = NULL;
+	std::vector<std::string> ignore;
+	int frames = -1, batch = 120;
+	bool serve = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		bool hasval = i + 1 < argc;
+		if(!strcmp(arg, "--serve"))
+			serve = true;
+		else if(!strcmp(arg, "--ignore") && hasval)
+			ignore.push_back(argv[++i]);
+		else if(!strcmp(arg, "--frames") && hasval)
+			frames = atoi(argv[++i]);
+		else if(!strcmp(arg, "--batch") && hasval)
+			batch = atoi(argv[++i]);
+		else if((!strncmp(arg, "--a-", 4) || !strncmp(arg, "--b-", 4)) && hasval)
+		{
+			if(!SetOption(arg[2] == 'a' ? a.settings : b.settings, arg + 4, argv[++i]))
+			{
+				Usage(argv[0]);
+				return 2;
+			}
+		}
+		else if(!strncmp(arg, "--", 2) && hasval && SetOption(a.settings, arg + 2, argv[i + 1]))
+			SetOption(b.settings, arg + 2, argv[++i]);
+		else if(arg[0] == '-')
+		{
+			Usage(argv[0]);
+			return 2;
+		}
+		else if(!rom)
+			rom = arg;
+		else if(!movie)
+			movie = arg;
+		else
+		{
+			Usage(argv[0]);
+			return 2;
+		}
+	}
+	if(!rom)
+	{
+		Usage(argv[0]);
+		return 2;
+	}
+	if(serve)
+		return Serve(a.settings, rom, movie);
+	if(frames < 0)
+		frames = movie ? 0 : 3600;
+	if(!movie && !frames)
+	{
+		Usage(argv[0]);
+		return 2;
+	}
+	if(batch < 1)
+		batch = 1;
+
+	// a worker that dies should show up as a failed read, not kill the tool
+	signal(SIGPIPE, SIG_IGN);
+	Describe(a);
+	Describe(b);
+	if(!Start(a, rom, movie) || !Start(b, rom, movie) || !Match(a, b, ignore))
+	{
+		fprintf(stderr, "Couldn't start both sides\n");
+		return 2;
+	}
+
+	int result = 0, played = 0;
+	uint64 t0 = HeadlessTime();
+	for(;;)
+	{
+		int n = frames ? std::min(batch, frames - played) : batch;
+		if(n <= 0)
+			break;
+		char cmd[32];
+		sprintf(cmd, "run %d", n);
+		Send(a, cmd);
+		Send(b, cmd);
+		std::vector<Frame> fa, fb;
+		bool enda, endb;
+		if(!Run(a, fa, enda) || !Run(b, fb, endb))
+		{
+			result = 2;
+			break;
+		}
+
+		size_t count = std::min(fa.size(), fb.size()), i;
+		for(i = 0; i < count && fa[i].hash == fb[i].hash && fa[i].frame == fb[i].frame; i++)
+			;
+		played += (int)i;
+		if(i < count)
+		{
+			result = Narrow(a, b, fa[i], fb[i]) ? 1 : 2;
+			break;
+		}
+		if(enda || endb)
+		{
+			if(fa.size() != fb.size())
+				printf("the movie ran out on %s first\n", fa.size() < fb.size() ? a.label : b.label);
+			break;
+		}
+	}
+
+	double seconds = (HeadlessTime() - t0) / 1000000.0;
+	if(result == 0)
+		printf("the runs match for all %d frames\n", played);
+	printf("%d frames compared in %.2f s, %.0f fps\n", played, seconds, seconds > 0 ? played / seconds : 0);
+
+	Send(a, "quit");
+	Send(b, "quit");
+	fclose(a.to);
+	fclose(b.to);
+	waitpid(a.pid, NULL, 0);
+	waitpid(b.pid, NULL, 0);
+	return result;
+}
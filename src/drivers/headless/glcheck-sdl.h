@@ -0,0 +1,19 @@
+#ifndef __FCEU_SDL_H
+#define __FCEU_SDL_H
+
+// stands in for drivers/sdl/sdl.h when "scons glcheck" builds sdl-opengl.cpp,
+// so the OpenGL output runs on the EGL context fceux-glcheck makes, without SDL
+
+#include <EGL/egl.h>
+
+#include "../../types.h"
+
+struct SDL_Surface { int w, h; unsigned flags; };
+#define SDL_FULLSCREEN 1
+#define SDL_GL_GetProcAddress(x) eglGetProcAddress(x)
+#define SDL_GL_SwapBuffers() glFinish()
+
+// lets the check hide extensions, to run the paths taken without them
+#define glGetString GlcheckGetString
+
+#endif
@@ -0,0 +1,230 @@
+/// \file
+/// \brief fceux-glcheck: draws the same random frames through the shader and the fixed function
+/// OpenGL output, on an EGL context without a window, and compares what the two put out
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "../../types.h"
+#include "../../driver.h"
+#include "../../palette.h"
+#include "../common/vidblit.h"
+#include "glcheck-sdl.h"
+#include "../sdl/sdl-opengl.h"
+#include "headless.h"
+
+// what the core's palette would be, with every deemphasis row filled in
+extern pal *palo;
+static pal deemphpal[64 * 8];
+static uint8 palette[256 * 4];
+
+static uint8 xbuf[256 * 256], xdbuf[256 * 256];
+static uint8 pixels[2][768 * 672 * 4];
+
+static bool nostorage;
+
+#undef glGetString
+// sdl-opengl.cpp reads the extensions through here
+extern "C" const GLubyte *GlcheckGetString(GLenum name)
+{
+	static std::string extensions;
+	const GLubyte *s = glGetString(name);
+	if(name != GL_EXTENSIONS || !s || !nostorage)
+		return s;
+	extensions = (const char *)s;
+	size_t at = extensions.find("GL_ARB_buffer_storage");
+	if(at != std::string::npos)
+		extensions.erase(at, strlen("GL_ARB_buffer_storage"));
+	return (const GLubyte *)extensions.c_str();
+}
+
+//draws frames random frames at the given settings into an offscreen buffer and reads it back.
+//the first frame is drawn whole, the rest change a few lines each, as a game's frames do
+static bool Draw(int shader, int scale, int scanlines, int ipolate, int frames, uint8 *out)
+{
+	int w = 256 * scale, h = 224 * scale;
+	GLuint fbo, rb;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glGenRenderbuffers(1, &rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rb);
+
+	SDL_Surface screen = { w, h, 0 };
+	bool ok = InitOpenGL(0, 256, 8, 232, scale, scale, scanlines, ipolate, shader, 0, 0, &screen) != 0;
+	if(ok)
+	{
+		SetOpenGLPalette(palette);
+		srand(1);
+		for(int f = 0; f < frames; f++)
+		{
+			uint32 dirty[FCEU_DIRTY_WORDS];
+			memset(dirty, 0, sizeof(dirty));
+			if(!f)
+				for(int i = 0; i < 256 * 256; i++)
+				{
+					xbuf[i] = rand();
+					xdbuf[i] = (i >> 12) & 7;
+				}
+			else
+				for(int k = 0; k < 5; k++)
+				{
+					int y = rand() % 256;
+					dirty[y >> 5] |= 1u << (y & 31);
+					for(int x = 0; x < 256; x++)
+					{
+						xbuf[y * 256 + x] = rand();
+						xdbuf[y * 256 + x] = rand() & 7;
+					}
+				}
+			SetBlitSource(xbuf, xdbuf);
+			BlitOpenGL(xbuf, xdbuf, f ? dirty : NULL);
+		}
+		glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, out);
+		KillOpenGL();
+	}
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &rb);
+	return ok;
+}
+
+//how many of the last frame's pixels at 1x are not the palette entry they show
+static int CheckUnscaled(const uint8 *out)
+{
+	int bad = 0;
+	for(int y = 0; y < 224; y++)
+		for(int x = 0; x < 256; x++)
+		{
+			// the bottom row read back is the last line shown, 231
+			int at = (231 - y) * 256 + x;
+			uint8 i = xbuf[at], d = xdbuf[at];
+			uint8 r = palette[i * 4], g = palette[i * 4 + 1], b = palette[i * 4 + 2];
+			if(d)
+			{
+				pal *p = &palo[(i & 0x3F) + d * 64];
+				r = p->r;
+				g = p->g;
+				b = p->b;
+			}
+			const uint8 *px = out + (y * 256 + x) * 4;
+			if(px[0] != r || px[1] != g || px[2] != b)
+				bad++;
+		}
+	return bad;
+}
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  --frames n   frames drawn at each setting, the first whole and the rest a few changed\n"
+		"               lines at a time (default 30)\n"
+		"draws the frames through the shader and the fixed function output, with and without\n"
+		"GL_ARB_buffer_storage, and fails if the two differ by more than rounding. it needs an\n"
+		"EGL driver that can make a context without a surface, such as Mesa's llvmpipe\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = 30;
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+	if(frames < 1)
+		frames = 1;
+	HeadlessQuiet = true;
+
+	EGLDisplay display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if(display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_API))
+	{
+		fprintf(stderr, "Couldn't open an EGL display without a surface\n");
+		return 1;
+	}
+	EGLint attribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint configs = 0;
+	eglChooseConfig(display, attribs, &config, 1, &configs);
+	EGLContext context = eglCreateContext(display, configs ? config : NULL, EGL_NO_CONTEXT, NULL);
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		fprintf(stderr, "Couldn't make an OpenGL context\n");
+		return 1;
+	}
+	printf("%s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	srand(2);
+	for(int i = 0; i < 256 * 4; i++)
+		palette[i] = (i & 3) == 3 ? 0xFF : rand();
+	for(int i = 0; i < 64 * 8; i++)
+	{
+		deemphpal[i].r = rand();
+		deemphpal[i].g = rand();
+		deemphpal[i].b = rand();
+	}
+	palo = deemphpal;
+
+	// interpolation mixes colors, which the two paths may round apart by one; everything
+	// else has to match exactly
+	static const struct { int scale, scanlines, ipolate, exact; } cases[] = {
+		{ 1, 0, 0, 1 }, { 2, 0, 0, 1 }, { 2, 1, 0, 1 }, { 3, 1, 0, 1 }, { 2, 0, 1, 0 }, { 3, 1, 1, 0 },
+	};
+	int failures = 0;
+	for(int storage = 1; storage >= 0; storage--)
+	{
+		nostorage = !storage;
+		for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+		{
+			int scale = cases[c].scale, w = 256 * scale, h = 224 * scale;
+			if(!Draw(1, scale, cases[c].scanlines, cases[c].ipolate, frames, pixels[0])
+				|| !Draw(0, scale, cases[c].scanlines, cases[c].ipolate, frames, pixels[1]))
+			{
+				fprintf(stderr, "Couldn't set up OpenGL at %dx\n", scale);
+				return 1;
+			}
+
+			// a line of pixels at either side takes the border with it when interpolated
+			int differing = 0, most = 0;
+			for(int y = 0; y < h; y++)
+				for(int x = scale; x < w - scale; x++)
+					for(int k = 0; k < 3; k++)
+					{
+						int d = abs(pixels[0][(y * w + x) * 4 + k] - pixels[1][(y * w + x) * 4 + k]);
+						if(d)
+							differing++;
+						if(d > most)
+							most = d;
+					}
+			int bad = scale == 1 ? CheckUnscaled(pixels[0]) : 0;
+			bool ok = bad == 0 && (cases[c].exact ? most == 0 : most <= 1);
+			printf("%s %dx%s%s: %d differing, by up to %d%s%s\n", storage ? "buffer storage" : "orphaned buffer", scale,
+				cases[c].scanlines ? " scanlines" : "", cases[c].ipolate ? " interpolated" : "", differing, most,
+				bad ? ", not the palette" : "", ok ? "" : " FAILED");
+			if(!ok)
+				failures++;
+		}
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	if(failures)
+		fprintf(stderr, "%d setting(s) failed\n", failures);
+	return failures ? 1 : 0;
+}
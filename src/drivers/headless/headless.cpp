@@ -0,0 +1,206 @@
+/// \file
+/// \brief driver callbacks for running the core without a frontend
+
+#include <cstdio>
+#include <string>
+#include <map>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../file.h"
+#include "../../emufile.h"
+#include "headless.h"
+
+bool HeadlessQuiet = false;
+
+// globals every driver provides to the core
+int closeFinishedMovie = 0;
+int pal_emulation = 0;
+int dendy = 0;
+bool swapDuty = false;
+bool turbo = false;
+
+static uint8 Palette[256][3];
+
+uint64 HeadlessTime()
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (uint64)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+
+int HeadlessRunJobs(HeadlessJobs &jobs, size_t count, long workers)
+{
+	std::map<pid_t, size_t> running;
+	size_t next = 0;
+	int unstarted = 0;
+	bool prepared = false;
+	while(next < count || !running.empty())
+	{
+		while((long)running.size() < workers && next < count)
+		{
+			if(!prepared && !jobs.Prepare(next))
+			{
+				jobs.Finish(next++, false);
+				unstarted++;
+				continue;
+			}
+			prepared = true;
+			fflush(stdout);
+			fflush(stderr);
+			pid_t pid = fork();
+			if(pid == 0)
+				_exit(jobs.Run(next));
+			if(pid < 0)
+			{
+				perror("fork");
+				// try again once one of the running jobs has ended
+				if(!running.empty())
+					break;
+				// nothing will end to free what fork needs: give up on the rest
+				for(; next < count; next++, unstarted++)
+					jobs.Finish(next, false);
+				break;
+			}
+			running[pid] = next++;
+			prepared = false;
+		}
+		if(running.empty())
+			continue;
+		int status;
+		pid_t pid = wait(&status);
+		if(pid < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			perror("wait");
+			// the children can't be waited for, so their results are lost
+			for(std::map<pid_t, size_t>::iterator it = running.begin(); it != running.end(); ++it)
+				jobs.Finish(it->second, false);
+			running.clear();
+			for(; next < count; next++, unstarted++)
+				jobs.Finish(next, false);
+			break;
+		}
+		std::map<pid_t, size_t>::iterator it = running.find(pid);
+		if(it == running.end())
+			continue;
+		jobs.Finish(it->second, WIFEXITED(status) && !WEXITSTATUS(status));
+		running.erase(it);
+	}
+	if(unstarted)
+		fprintf(stderr, "%d job(s) could not be started\n", unstarted);
+	return unstarted;
+}
+
+uint64 FCEUD_GetTime()
+{
+	return HeadlessTime();
+}
+
+uint64 FCEUD_GetTimeFreq()
+{
+	return 1000000;
+}
+
+void FCEUD_Message(const char *text)
+{
+	if(!HeadlessQuiet)
+		fputs(text, stderr);
+}
+
+void FCEUD_PrintError(const char *errormsg)
+{
+	fprintf(stderr, "%s\n", errormsg);
+}
+
+const char *FCEUD_GetCompilerString()
+{
+	return "g++ " __VERSION__;
+}
+
+void FCEUD_SetPalette(uint8 index, uint8 r, uint8 g, uint8 b)
+{
+	Palette[index][0] = r;
+	Palette[index][1] = g;
+	Palette[index][2] = b;
+}
+
+void FCEUD_GetPalette(uint8 index, uint8 *r, uint8 *g, uint8 *b)
+{
+	*r = Palette[index][0];
+	*g = Palette[index][1];
+	*b = Palette[index][2];
+}
+
+FILE *FCEUD_UTF8fopen(const char *fn, const char *mode)
+{
+	return fopen(fn, mode);
+}
+
+EMUFILE_FILE* FCEUD_UTF8_fstream(const char *fn, const char *m)
+{
+	return new EMUFILE_FILE(fn, m);
+}
+
+// nothing below has anything to show or ask a user
+void FCEUD_VideoChanged() { }
+void FCEUD_SetInput(bool fourscore, bool microphone, ESI port0, ESI port1, ESIFC fcexp) { }
+bool FCEUD_ShouldDrawInputAids() { return false; }
+void FCEUD_SetEmulationSpeed(int cmd) { }
+void FCEUD_SoundToggle() { }
+void FCEUD_SoundVolumeAdjust(int n) { }
+void FCEUD_HideMenuToggle() { }
+void FCEUD_MovieRecordTo() { }
+void FCEUD_MovieReplayFrom() { }
+void FCEUD_SaveStateAs() { }
+void FCEUD_LoadStateFrom() { }
+void FCEUD_ToggleStatusIcon() { }
+int FCEUD_ShowStatusIcon() { return 0; }
+bool FCEUD_PauseAfterPlayback() { return false; }
+void FCEUD_TurboOn() { }
+void FCEUD_TurboOff() { }
+void FCEUD_TurboToggle() { }
+void FCEUD_DebugBreakpoint() { }
+void FCEUD_TraceInstruction() { }
+void FCEUD_AviRecordTo() { }
+void FCEUD_AviStop() { }
+void FCEUI_AviVideoUpdate(const unsigned char* buffer) { }
+bool FCEUI_AviIsRecording() { return false; }
+bool FCEUI_AviEnableHUDrecording() { return false; }
+bool FCEUI_AviDisableMovieMessages() { return true; }
+void FCEUI_UseInputPreset(int preset) { }
+void RefreshThrottleFPS() { }
+void FCEUD_NetplayText(uint8 *text) { }
+void FCEUD_NetworkClose() { }
+int FCEUD_SendData(void *data, uint32 len) { return 0; }
+int FCEUD_RecvData(void *data, uint32 len) { return 0; }
+
+unsigned int *GetKeyboard()
+{
+	static unsigned int keys[512];
+	return keys;
+}
+
+void GetMouseData(uint32 (&d)[3])
+{
+	d[0] = d[1] = d[2] = 0;
+}
+
+// archives are not supported, roms are opened as plain files
+FCEUFILE* FCEUD_OpenArchiveIndex(ArchiveScanRecord& asr, std::string &fname, int innerIndex) { return 0; }
+FCEUFILE* FCEUD_OpenArchive(ArchiveScanRecord& asr, std::string& fname, std::string* innerFilename) { return 0; }
+ArchiveScanRecord FCEUD_ScanArchive(std::string fname) { return ArchiveScanRecord(); }
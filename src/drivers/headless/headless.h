@@ -0,0 +1,32 @@
+#ifndef __FCEU_HEADLESS_H
+#define __FCEU_HEADLESS_H
+
+#include "../../types.h"
+
+// driver callbacks for the command line tools that run the core without
+// video, sound or input.  link headless.cpp instead of a platform driver.
+
+// drop the core's informational messages (errors are always printed)
+extern bool HeadlessQuiet;
+
+// microseconds, monotonic
+uint64 HeadlessTime();
+
+// a batch of jobs for HeadlessRunJobs, each run in a forked process of its own
+struct HeadlessJobs
+{
+	virtual ~HeadlessJobs() {}
+	// in the parent, before job i is started; false leaves it unstarted
+	virtual bool Prepare(size_t i) { return true; }
+	// in job i's process; the return value is its exit status
+	virtual int Run(size_t i) = 0;
+	// in the parent, once for every job: ok is false if it failed or never started
+	virtual void Finish(size_t i, bool ok) {}
+};
+
+// runs count jobs, up to workers at a time.  a job that can't be forked is
+// retried when another ends; once none are left running, it and the rest are
+// given up on.  returns how many jobs were never started, and says so on stderr
+int HeadlessRunJobs(HeadlessJobs &jobs, size_t count, long workers);
+
+#endif
@@ -0,0 +1,313 @@
+/// \file
+/// \brief fceux-nsfrender: renders nsf tracks to wav files as fast as the core runs, each track
+/// in a worker process of its own
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../git.h"
+#include "../../nsf.h"
+#include "headless.h"
+
+struct RenderOptions
+{
+	std::string outdir;
+	int rate, quality, synth, volume;
+	double length;
+	double silence;
+	int silencelevel;
+};
+
+struct RenderJob
+{
+	const char *nsf;
+	int track;
+};
+
+static const char *SynthNames[2] = { "fir", "step" };
+
+static std::string BaseName(const char *path)
+{
+	const char *p = strrchr(path, '/');
+	std::string name = p ? p + 1 : path;
+	size_t dot = name.rfind('.');
+	if(dot != std::string::npos && dot > 0)
+		name.erase(dot);
+	return name;
+}
+
+//number of tracks in an nsf, 0 when it is not one
+static int CountTracks(const char *fname)
+{
+	NSF_HEADER header;
+	memset(&header, 0, sizeof(header));
+	FILE *fp = fopen(fname, "rb");
+	if(!fp)
+		return 0;
+	size_t got = fread(&header, 1, 0x80, fp);
+	fclose(fp);
+	if(got != 0x80 || memcmp(header.ID, "NESM\x1a", 5))
+		return 0;
+	return header.TotalSongs;
+}
+
+//"1,3,5-8" into track numbers, checked against the track count
+static bool ParseTracks(const char *spec, int total, std::vector<int> &tracks)
+{
+	const char *p = spec;
+	while(*p)
+	{
+		char *end;
+		int first = strtol(p, &end, 10), last;
+		if(end == p)
+			return false;
+		last = first;
+		p = end;
+		if(*p == '-')
+		{
+			p++;
+			last = strtol(p, &end, 10);
+			if(end == p)
+				return false;
+			p = end;
+		}
+		if(*p == ',')
+			p++;
+		else if(*p)
+			return false;
+		if(first < 1 || last > total || first > last)
+			return false;
+		for(int t = first; t <= last; t++)
+			tracks.push_back(t);
+	}
+	return true;
+}
+
+//a frame is silent when its peak to peak level stays within "level"; this ignores the dc
+//offset a stopped channel can leave behind
+static bool IsSilent(const int32 *sound, int32 count, int level)
+{
+	if(!count)
+		return true;
+	int32 lo = sound[0], hi = sound[0];
+	for(int32 i = 1; i < count; i++)
+	{
+		if(sound[i] < lo) lo = sound[i];
+		if(sound[i] > hi) hi = sound[i];
+	}
+	return hi - lo <= level;
+}
+
+//runs in the worker process
+static int RenderTrack(const RenderJob &job, const RenderOptions &o)
+{
+	char name[32];
+	sprintf(name, "-%02d.wav", job.track);
+	std::string wav = o.outdir + BaseName(job.nsf) + name;
+
+	HeadlessQuiet = true;
+	if(!FCEUI_Initialize())
+		return 1;
+	FCEUI_Sound(o.rate);
+	FCEUI_SetSoundVolume(o.volume);
+	FCEUI_SetSoundQuality(o.quality);
+	FCEUI_SetStepSynth(o.synth);
+	FCEUI_SetLowPass(0);
+	if(!FCEUI_LoadGame(job.nsf, 1, true) || GameInfo->type != GIT_NSF)
+	{
+		fprintf(stderr, "Couldn't load %s as an nsf\n", job.nsf);
+		return 1;
+	}
+	FCEUI_NSFSetVis(0);
+	FCEUI_NSFChange(job.track - FCEUI_NSFChange(0));
+
+	if(!FCEUI_BeginWaveRecord(wav.c_str()))
+	{
+		fprintf(stderr, "Couldn't write %s\n", wav.c_str());
+		FCEUI_CloseGame();
+		return 1;
+	}
+
+	// the track ends at the length limit, or once it has been silent for o.silence seconds after
+	// it first made a sound. the silence is kept, so a track that pauses briefly is not cut.
+	int64 limit = (int64)(o.length * o.rate);
+	int64 quiet = (int64)(o.silence * o.rate);
+	int64 samples = 0, silent = 0;
+	bool started = false, ended = false;
+	uint64 t0 = HeadlessTime();
+	while(samples < limit)
+	{
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+
+		// skipping the frame also skips DrawNSF and the rest of the video work
+		FCEUI_Emulate(&gfx, &sound, &ssize, 1);
+		samples += ssize;
+		if(IsSilent(sound, ssize, o.silencelevel))
+			silent += ssize;
+		else
+		{
+			started = true;
+			silent = 0;
+		}
+		if(quiet && started && silent >= quiet)
+		{
+			ended = true;
+			break;
+		}
+	}
+	double seconds = (HeadlessTime() - t0) / 1000000.0;
+
+	FCEUI_EndWaveRecord();
+	FCEUI_CloseGame();
+	FCEUI_Kill();
+
+	double played = (double)samples / o.rate;
+	printf("%s: %.1f s%s, %.0fx realtime\n", wav.c_str(), played, ended ? " (silence)" : started ? "" : " (no sound)",
+		seconds > 0 ? played / seconds : 0);
+	fflush(stdout);
+	return 0;
+}
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] nsf...\n"
+		"  --tracks list      tracks to render, like 1,3,5-8 (default all)\n"
+		"  --length s         longest a track may run, in seconds (default 180)\n"
+		"  --silence s        end a track once it has been silent this long, 0 never (default 3)\n"
+		"  --silence-level n  peak to peak level a frame counts as silent at (default 16)\n"
+		"  --rate hz          sample rate (default 44100)\n"
+		"  --quality q        sound quality, 0, 1 or 2 (default 1)\n"
+		"  --synth fir|step   high quality synthesis engine (default step)\n"
+		"  --volume n         0-150 (default 150)\n"
+		"  --out dir          where the wav files go (default the current directory)\n"
+		"  -j n               worker processes (default one per cpu)\n"
+		"a track is written to <out>/<nsf name>-<track>.wav\n",
+		prog);
+}
+
+struct RenderJobs : HeadlessJobs
+{
+	const std::vector<RenderJob> &jobs;
+	const RenderOptions &o;
+	int failures;
+
+	RenderJobs(const std::vector<RenderJob> &jobs, const RenderOptions &o) : jobs(jobs), o(o), failures(0) {}
+	int Run(size_t i) { return RenderTrack(jobs[i], o); }
+	void Finish(size_t i, bool ok)
+	{
+		if(!ok)
+			failures++;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	RenderOptions o;
+	o.rate = 44100;
+	o.quality = 1;
+	o.synth = 1;
+	o.volume = 150;
+	o.length = 180;
+	o.silence = 3;
+	o.silencelevel = 16;
+	const char *trackspec = NULL;
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	std::vector<const char *> nsfs;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		bool hasval = i + 1 < argc;
+		if(!strcmp(arg, "--tracks") && hasval)
+			trackspec = argv[++i];
+		else if(!strcmp(arg, "--length") && hasval)
+			o.length = atof(argv[++i]);
+		else if(!strcmp(arg, "--silence") && hasval)
+			o.silence = atof(argv[++i]);
+		else if(!strcmp(arg, "--silence-level") && hasval)
+			o.silencelevel = atoi(argv[++i]);
+		else if(!strcmp(arg, "--rate") && hasval)
+			o.rate = atoi(argv[++i]);
+		else if(!strcmp(arg, "--quality") && hasval)
+			o.quality = atoi(argv[++i]);
+		else if(!strcmp(arg, "--synth") && hasval)
+			o.synth = strcmp(argv[++i], "fir") ? 1 : 0;
+		else if(!strcmp(arg, "--volume") && hasval)
+			o.volume = atoi(argv[++i]);
+		else if(!strcmp(arg, "--out") && hasval)
+			o.outdir = argv[++i];
+		else if(!strcmp(arg, "-j") && hasval)
+			workers = atoi(argv[++i]);
+		else if(arg[0] == '-')
+		{
+			Usage(argv[0]);
+			return 1;
+		}
+		else
+			nsfs.push_back(arg);
+	}
+	if(nsfs.empty() || o.length <= 0 || o.rate <= 0 || o.quality < 0 || o.quality > 2)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+	if(workers < 1)
+		workers = 1;
+	if(!o.outdir.empty() && o.outdir[o.outdir.size() - 1] != '/')
+		o.outdir += '/';
+
+	std::vector<RenderJob> jobs;
+	int failures = 0;
+	for(size_t n = 0; n < nsfs.size(); n++)
+	{
+		int total = CountTracks(nsfs[n]);
+		if(!total)
+		{
+			fprintf(stderr, "%s is not an nsf\n", nsfs[n]);
+			failures++;
+			continue;
+		}
+		std::vector<int> tracks;
+		if(trackspec)
+		{
+			if(!ParseTracks(trackspec, total, tracks))
+			{
+				fprintf(stderr, "Bad track list \"%s\" for %s, which has %d tracks\n", trackspec, nsfs[n], total);
+				failures++;
+				continue;
+			}
+		}
+		else
+			for(int t = 1; t <= total; t++)
+				tracks.push_back(t);
+		for(size_t t = 0; t < tracks.size(); t++)
+		{
+			RenderJob job = { nsfs[n], tracks[t] };
+			jobs.push_back(job);
+		}
+	}
+
+	printf("rendering %d track(s) with %ld worker(s), %d Hz, quality %d%s\n", (int)jobs.size(), workers, o.rate, o.quality,
+		o.quality ? (std::string(" ") + SynthNames[o.synth]).c_str() : "");
+
+	// every track gets a fresh process, so no core state can carry over from one to the next
+	uint64 t0 = HeadlessTime();
+	RenderJobs run(jobs, o);
+	HeadlessRunJobs(run, jobs.size(), workers);
+	failures += run.failures;
+
+	printf("%d track(s) in %.2f s\n", (int)jobs.size(), (HeadlessTime() - t0) / 1000000.0);
+	if(failures)
+		fprintf(stderr, "%d track(s) failed\n", failures);
+	return failures ? 1 : 0;
+}
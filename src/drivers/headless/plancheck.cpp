@@ -0,0 +1,81 @@
+/// \file
+/// \brief fceux-plancheck: plays an emu.runplan input plan while the driver holds buttons on
+/// joypad 1, and checks that every frame the game gets the planned buttons, not a mix of both
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../driver.h"
+#include "../../fceulua.h"
+#include "headless.h"
+
+extern uint8 joy[4];
+
+//what the player holds: A and right
+#define HELD 0x81
+
+//the plan, one frame a line. a table without joypad 1 leaves it to the player
+static const char *Plan =
+	"emu.runplan({0x00, 0x01, 0x02, 0x81, 0x80, {}, {nil, 0x08}, 0xFF})\n";
+static const int Planned[] = { 0x00, 0x01, 0x02, 0x81, 0x80, HELD, HELD, 0xFF };
+#define PLAN_FRAMES (int)(sizeof(Planned) / sizeof(Planned[0]))
+
+int main(int argc, char *argv[])
+{
+	if(argc != 2)
+	{
+		fprintf(stderr, "usage: %s rom\n", argv[0]);
+		return 1;
+	}
+	HeadlessQuiet = true;
+	if(!FCEUI_Initialize())
+		return 1;
+	FCEUI_Sound(48000);
+	if(!FCEUI_LoadGame(argv[1], 1, true))
+	{
+		fprintf(stderr, "Couldn't load %s\n", argv[1]);
+		return 1;
+	}
+	static uint32 joydata = HELD;
+	FCEUI_SetInput(0, SI_GAMEPAD, &joydata, 0);
+
+	char script[] = "/tmp/fceux-plancheckXXXXXX";
+	int fd = mkstemp(script);
+	if(fd < 0 || write(fd, Plan, strlen(Plan)) != (ssize_t)strlen(Plan))
+	{
+		perror("script");
+		return 1;
+	}
+	close(fd);
+	bool loaded = FCEU_LoadLuaCode(script) != 0;
+	unlink(script);
+	if(!loaded)
+	{
+		fprintf(stderr, "Couldn't run the plan\n");
+		return 1;
+	}
+
+	// one frame past the plan, which has to hand the joypad back to the player
+	int failures = 0;
+	for(int f = 0; f <= PLAN_FRAMES; f++)
+	{
+		uint8 *gfx;
+		int32 *sound, ssize;
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		int want = f < PLAN_FRAMES ? Planned[f] : HELD;
+		if(joy[0] != want)
+		{
+			fprintf(stderr, "frame %d of the plan: joypad 1 is %02X, not %02X\n", f + 1, joy[0], want);
+			failures++;
+		}
+	}
+	FCEU_LuaStop();
+	FCEUI_CloseGame();
+
+	printf("%d frame(s) with %02X held, %d wrong\n", PLAN_FRAMES + 1, HELD, failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,390 @@
+/// \file
+/// \brief fceux-tracedump: turns an instruction trace recorded by the emulator into text, or finds
+/// where two traces part ways
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <zlib.h>
+
+#include "../../types.h"
+#include "../../trace.h"
+
+//addressing modes, for printing the operand
+enum { IMP, ACC, IMM, ZP, ZPX, ZPY, IZX, IZY, ABS, ABX, ABY, IND, REL };
+
+static const uint8 Modes[256] = {
+/*0x00*/	IMP,IZX,IMP,IMP,IMP,ZP,ZP,IMP,IMP,IMM,ACC,IMP,IMP,ABS,ABS,IMP,
+/*0x10*/	REL,IZY,IMP,IMP,IMP,ZPX,ZPX,IMP,IMP,ABY,IMP,IMP,IMP,ABX,ABX,IMP,
+/*0x20*/	ABS,IZX,IMP,IMP,ZP,ZP,ZP,IMP,IMP,IMM,ACC,IMP,ABS,ABS,ABS,IMP,
+/*0x30*/	REL,IZY,IMP,IMP,IMP,ZPX,ZPX,IMP,IMP,ABY,IMP,IMP,IMP,ABX,ABX,IMP,
+/*0x40*/	IMP,IZX,IMP,IMP,IMP,ZP,ZP,IMP,IMP,IMM,ACC,IMP,ABS,ABS,ABS,IMP,
+/*0x50*/	REL,IZY,IMP,IMP,IMP,ZPX,ZPX,IMP,IMP,ABY,IMP,IMP,IMP,ABX,ABX,IMP,
+/*0x60*/	IMP,IZX,IMP,IMP,IMP,ZP,ZP,IMP,IMP,IMM,ACC,IMP,IND,ABS,ABS,IMP,
+/*0x70*/	REL,IZY,IMP,IMP,IMP,ZPX,ZPX,IMP,IMP,ABY,IMP,IMP,IMP,ABX,ABX,IMP,
+/*0x80*/	IMP,IZX,IMP,IMP,ZP,ZP,ZP,IMP,IMP,IMP,IMP,IMP,ABS,ABS,ABS,IMP,
+/*0x90*/	REL,IZY,IMP,IMP,ZPX,ZPX,ZPY,IMP,IMP,ABY,IMP,IMP,IMP,ABX,IMP,IMP,
+/*0xA0*/	IMM,IZX,IMM,IMP,ZP,ZP,ZP,IMP,IMP,IMM,IMP,IMP,ABS,ABS,ABS,IMP,
+/*0xB0*/	REL,IZY,IMP,IMP,ZPX,ZPX,ZPY,IMP,IMP,ABY,IMP,IMP,ABX,ABX,ABY,IMP,
+/*0xC0*/	IMM,IZX,IMP,IMP,ZP,ZP,ZP,IMP,IMP,IMM,IMP,IMP,ABS,ABS,ABS,IMP,
+/*0xD0*/	REL,IZY,IMP,IMP,IMP,ZPX,ZPX,IMP,IMP,ABY,IMP,IMP,IMP,ABX,ABX,IMP,
+/*0xE0*/	IMM,IZX,IMP,IMP,ZP,ZP,ZP,IMP,IMP,IMM,IMP,IMP,ABS,ABS,ABS,IMP,
+/*0xF0*/	REL,IZY,IMP,IMP,IMP,ZPX,ZPX,IMP,IMP,ABY,IMP,IMP,IMP,ABX,ABX,IMP
+};
+
+//three letters per opcode; the ones the 6502 does not document are ???
+static const char Names[] =
+	"BRKORA?????????ORAASL???PHPORAASL??????ORAASL???"
+	"BPLORA?????????ORAASL???CLCORA?????????ORAASL???"
+	"JSRAND??????BITANDROL???PLPANDROL???BITANDROL???"
+	"BMIAND?????????ANDROL???SECAND?????????ANDROL???"
+	"RTIEOR?????????EORLSR???PHAEORLSR???JMPEORLSR???"
+	"BVCEOR?????????EORLSR???CLIEOR?????????EORLSR???"
+	"RTSADC?????????ADCROR???PLAADCROR???JMPADCROR???"
+	"BVSADC?????????ADCROR???SEIADC?????????ADCROR???"
+	"???STA??????STYSTASTX???DEY???TXA???STYSTASTX???"
+	"BCCSTA??????STYSTASTX???TYASTATXS??????STA??????"
+	"LDYLDALDX???LDYLDALDX???TAYLDATAX???LDYLDALDX???"
+	"BCSLDA??????LDYLDALDX???CLVLDATSX???LDYLDALDX???"
+	"CPYCMP??????CPYCMPDEC???INYCMPDEX???CPYCMPDEC???"
+	"BNECMP?????????CMPDEC???CLDCMP?????????CMPDEC???"
+	"CPXSBC??????CPXSBCINC???INXSBCNOP???CPXSBCINC???"
+	"BEQSBC?????????SBCINC???SEDSBC?????????SBCINC???";
+
+//an instruction and the state it started in
+struct TraceInstruction
+{
+	uint16 pc;
+	uint8 a, x, y, p, s;
+	uint8 bytes[3];
+	int size;
+	uint64 cycles;
+	uint32 delta; //cycles since the instruction before
+	uint32 frame;
+	int scanline;
+};
+
+class TraceReader
+{
+public:
+	TraceReader() : fp(0), pos(0), bad(false), synced(false) {}
+	~TraceReader() { if(fp) gzclose(fp); }
+
+	bool Open(const char *fname)
+	{
+		name = fname;
+		fp = gzopen(fname, "rb");
+		char magic[TRACE_MAGIC_SIZE];
+		if(!fp || gzread(fp, magic, TRACE_MAGIC_SIZE) != TRACE_MAGIC_SIZE || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE))
+		{
+			fprintf(stderr, "%s is not a trace\n", fname);
+			return false;
+		}
+		return true;
+	}
+
+	//false at the end, or when the trace is damaged
+	bool Next(TraceInstruction &i)
+	{
+		for(;;)
+		{
+			if(pos >= block.size() && !ReadBlock())
+				return false;
+			uint8 tag = Get8();
+			if(tag & 3)
+			{
+				if(!synced)
+					return Damaged();
+				Instruction(tag, i);
+				return !bad || Damaged();
+			}
+			switch(tag)
+			{
+			case TRACE_SYNC:
+				cur.pc = Get16();
+				cur.a = Get8();
+				cur.x = Get8();
+				cur.y = Get8();
+				cur.p = Get8();
+				cur.s = Get8();
+				cur.cycles = Get32();
+				cur.cycles |= (uint64)Get32() << 32;
+				cur.frame = Get32();
+				cur.scanline = (int16)Get16();
+				nextpc = cur.pc;
+				synced = true;
+				break;
+			case TRACE_SCANLINE: cur.scanline = (int16)Get16(); break;
+			case TRACE_FRAME: cur.frame = Get32(); break;
+			default: return Damaged();
+			}
+			if(bad)
+				return Damaged();
+		}
+	}
+
+private:
+	gzFile fp;
+	std::string name;
+	std::vector<uint8> block;
+	size_t pos;
+	bool bad, synced;
+	TraceInstruction cur;
+	uint16 nextpc;
+
+	bool Damaged()
+	{
+		fprintf(stderr, "%s is damaged or cut short\n", name.c_str());
+		return false;
+	}
+
+	bool ReadBlock()
+	{
+		uint8 header[8];
+		int got = gzread(fp, header, 8);
+		if(got == 0)
+			return false;
+		uint32 used = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32)header[3] << 24);
+		if(got != 8 || used > TRACE_BLOCK_SIZE)
+			return Damaged();
+		block.resize(used);
+		pos = 0;
+		if(used && gzread(fp, &block[0], used) != (int)used)
+			return Damaged();
+		return true;
+	}
+
+	uint8 Get8()
+	{
+		if(pos >= block.size())
+		{
+			bad = true;
+			return 0;
+		}
+		return block[pos++];
+	}
+	uint16 Get16() { uint16 v = Get8(); return v | (Get8() << 8); }
+	uint32 Get32() { uint32 v = Get16(); return v | ((uint32)Get16() << 16); }
+
+	void Instruction(uint8 tag, TraceInstruction &i)
+	{
+		cur.pc = (tag & TRACE_PC) ? Get16() : nextpc;
+		if(tag & TRACE_A) cur.a = Get8();
+		if(tag & TRACE_X) cur.x = Get8();
+		if(tag & TRACE_Y) cur.y = Get8();
+		if(tag & TRACE_P) cur.p = Get8();
+		if(tag & TRACE_S) cur.s = Get8();
+		cur.size = tag & 3;
+		memset(cur.bytes, 0, sizeof(cur.bytes));
+		for(int b = 0; b < cur.size; b++)
+			cur.bytes[b] = Get8();
+		uint64 delta = 0;
+		for(int shift = 0; shift < 64; shift += 7)
+		{
+			uint8 v = Get8();
+			delta |= (uint64)(v & 0x7F) << shift;
+			if(!(v & 0x80))
+				break;
+		}
+		cur.delta = (uint32)delta;
+		cur.cycles += delta;
+		nextpc = (uint16)(cur.pc + cur.size);
+		i = cur;
+	}
+};
+
+static std::string Format(const TraceInstruction &i)
+{
+	char bytes[16], operand[16], flags[9], line[128];
+	int len = 0;
+	for(int b = 0; b < i.size; b++)
+		len += sprintf(bytes + len, "%02X ", i.bytes[b]);
+
+	uint16 word = i.bytes[1] | (i.bytes[2] << 8);
+	switch(i.size > 1 ? Modes[i.bytes[0]] : (Modes[i.bytes[0]] == ACC ? ACC : IMP))
+	{
+	case ACC: strcpy(operand, "A"); break;
+	case IMM: sprintf(operand, "#$%02X", i.bytes[1]); break;
+	case ZP: sprintf(operand, "$%02X", i.bytes[1]); break;
+	case ZPX: sprintf(operand, "$%02X,X", i.bytes[1]); break;
+	case ZPY: sprintf(operand, "$%02X,Y", i.bytes[1]); break;
+	case IZX: sprintf(operand, "($%02X,X)", i.bytes[1]); break;
+	case IZY: sprintf(operand, "($%02X),Y", i.bytes[1]); break;
+	case ABS: sprintf(operand, "$%04X", word); break;
+	case ABX: sprintf(operand, "$%04X,X", word); break;
+	case ABY: sprintf(operand, "$%04X,Y", word); break;
+	case IND: sprintf(operand, "($%04X)", word); break;
+	case REL: sprintf(operand, "$%04X", (uint16)(i.pc + 2 + (int8)i.bytes[1])); break;
+	default: operand[0] = 0; break;
+	}
+
+	for(int b = 0; b < 8; b++)
+		flags[b] = (i.p & (0x80 >> b)) ? "NVUBDIZC"[b] : "nvubdizc"[b];
+	flags[8] = 0;
+
+	sprintf(line, "$%04X: %-9s %.3s %-9s A:%02X X:%02X Y:%02X S:%02X P:%s c:%llu sl:%d", i.pc, bytes,
+		Names + i.bytes[0] * 3, operand, i.a, i.x, i.y, i.s, flags, (unsigned long long)i.cycles, i.scanline);
+	return line;
+}
+
+struct PCRange
+{
+	int lo, hi;
+};
+
+static bool InRanges(const std::vector<PCRange> &ranges, uint16 pc)
+{
+	if(ranges.empty())
+		return true;
+	for(size_t r = 0; r < ranges.size(); r++)
+		if(pc >= ranges[r].lo && pc <= ranges[r].hi)
+			return true;
+	return false;
+}
+
+//skips what the ranges leave out
+static bool NextInRanges(TraceReader &t, const std::vector<PCRange> &ranges, TraceInstruction &i)
+{
+	while(t.Next(i))
+		if(InRanges(ranges, i.pc))
+			return true;
+	return false;
+}
+
+//"8000-9FFF", "$C000" and the like
+static bool ParseRange(const char *s, PCRange &r)
+{
+	char *end;
+	if(*s == '$') s++;
+	r.lo = r.hi = (int)strtol(s, &end, 16);
+	if(*end == '-')
+	{
+		s = end + 1;
+		if(*s == '$') s++;
+		r.hi = (int)strtol(s, &end, 16);
+	}
+	return !*end && end != s && r.lo >= 0 && r.lo <= r.hi && r.hi <= 0xFFFF;
+}
+
+static int Dump(const char *fname, const std::vector<PCRange> &ranges)
+{
+	TraceReader t;
+	if(!t.Open(fname))
+		return 1;
+	TraceInstruction i;
+	uint32 frame = 0xFFFFFFFF;
+	while(NextInRanges(t, ranges, i))
+	{
+		if(i.frame != frame)
+		{
+			frame = i.frame;
+			printf("frame %u\n", frame);
+		}
+		puts(Format(i).c_str());
+	}
+	return 0;
+}
+
+//the same instruction in the same state. the clock is compared by how long the instruction before took,
+//so traces started at different times can still be lined up
+static bool Same(const TraceInstruction &a, const TraceInstruction &b)
+{
+	return a.pc == b.pc && a.size == b.size && !memcmp(a.bytes, b.bytes, a.size)
+		&& a.a == b.a && a.x == b.x && a.y == b.y && a.p == b.p && a.s == b.s
+		&& a.delta == b.delta && a.scanline == b.scanline;
+}
+
+static int Diff(const char *fname1, const char *fname2, const std::vector<PCRange> &ranges, int context)
+{
+	TraceReader t1, t2;
+	if(!t1.Open(fname1) || !t2.Open(fname2))
+		return 2;
+
+	std::deque<std::string> before;
+	TraceInstruction i1, i2;
+	uint64 n = 0;
+	for(;; n++)
+	{
+		bool more1 = NextInRanges(t1, ranges, i1), more2 = NextInRanges(t2, ranges, i2);
+		if(!more1 && !more2)
+		{
+			printf("the traces match, %llu instructions\n", (unsigned long long)n);
+			return 0;
+		}
+		if(more1 && more2 && Same(i1, i2))
+		{
+			before.push_back(Format(i1));
+			if((int)before.size() > context)
+				before.pop_front();
+			continue;
+		}
+
+		printf("the traces part at instruction %llu, frame %u\n", (unsigned long long)n, more1 ? i1.frame : i2.frame);
+		for(size_t b = 0; b < before.size(); b++)
+			printf("  %s\n", before[b].c_str());
+		for(int c = 0; c <= context && more1; c++, more1 = NextInRanges(t1, ranges, i1))
+			printf("< %s\n", Format(i1).c_str());
+		if(!more1)
+			printf("< (end of %s)\n", fname1);
+		for(int c = 0; c <= context && more2; c++, more2 = NextInRanges(t2, ranges, i2))
+			printf("> %s\n", Format(i2).c_str());
+		if(!more2)
+			printf("> (end of %s)\n", fname2);
+		return 1;
+	}
+}
+
+static void Usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] trace\n"
+		"  --pc lo-hi    only instructions in this pc range (hex); can be repeated\n"
+		"  --diff other  compare with another trace and show where they first part ways\n"
+		"  --context n   instructions shown around the difference (default 10)\n"
+		"without --diff, the trace is printed as text, one instruction per line\n",
+		prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *fname = NULL, *other = NULL;
+	std::vector<PCRange> ranges;
+	int context = 10;
+
+	for(int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+		bool hasval = i + 1 < argc;
+		PCRange r;
+		if(!strcmp(arg, "--pc") && hasval)
+		{
+			if(!ParseRange(argv[++i], r))
+			{
+				fprintf(stderr, "Bad pc range %s\n", argv[i]);
+				return 2;
+			}
+			ranges.push_back(r);
+		}
+		else if(!strcmp(arg, "--diff") && hasval)
+			other = argv[++i];
+		else if(!strcmp(arg, "--context") && hasval)
+			context = atoi(argv[++i]);
+		else if(arg[0] == '-' || fname)
+		{
+			Usage(argv[0]);
+			return 2;
+		}
+		else
+			fname = arg;
+	}
+	if(!fname)
+	{
+		Usage(argv[0]);
+		return 2;
+	}
+
+	return other ? Diff(fname, other, ranges, context < 0 ? 0 : context) : Dump(fname, ranges);
+}
@@ -136,6 +136,7 @@ InitConfig()
 	config->addOption("pcmvol", "SDL.Sound.PCMVolume", 256);
 	config->addOption("soundrate", "SDL.Sound.Rate", 44100);
 	config->addOption("soundq", "SDL.Sound.Quality", 1);
+	config->addOption("stepsynth", "SDL.Sound.StepSynth", 0);
 	config->addOption("soundrecord", "SDL.Sound.RecordFile", "");
 	config->addOption("soundbufsize", "SDL.Sound.BufSize", 128);
 	config->addOption("lowpass", "SDL.Sound.LowPass", 0);
@@ -143,6 +144,7 @@ InitConfig()
 	config->addOption('g', "gamegenie", "SDL.GameGenie", 0);
 	config->addOption("pal", "SDL.PAL", 0);
 	config->addOption("frameskip", "SDL.Frameskip", 0);
+	config->addOption("runahead", "SDL.RunAhead", 0);
 	config->addOption("clipsides", "SDL.ClipSides", 0);
 	config->addOption("nospritelim", "SDL.DisableSpriteLimit", 1);
 	config->addOption("swapduty", "SDL.SwapDuty", 0);
@@ -176,11 +178,13 @@ InitConfig()
 	config->addOption("noframe", "SDL.NoFrame", 0);
 	config->addOption("special", "SDL.SpecialFilter", 0);
 	config->addOption("showfps", "SDL.ShowFPS", 0);
+	config->addOption("showprofile", "SDL.ShowProfile", 0);
 	config->addOption("togglemenu", "SDL.ToggleMenu", 0);
 
 	// OpenGL options
 	config->addOption("opengl", "SDL.OpenGL", 0);
 	config->addOption("openglip", "SDL.OpenGLip", 0);
+	config->addOption("openglshader", "SDL.OpenGLShader", 1);
 	config->addOption("SDL.SpecialFilter", 0);
 	config->addOption("SDL.SpecialFX", 0);
 	config->addOption("SDL.Vsync", 1);
@@ -257,6 +261,26 @@ InitConfig()
     
 	// fcm -> fm2 conversion
 	config->addOption("fcmconvert", "SDL.FCMConvert", "");
+
+	// rom library index
+	config->addOption("romindex", "SDL.RomIndex", dir + "/romindex.dat");
+	config->addOption("scanroms", "SDL.ScanRoms", "");
+	config->addOption("profilecsv", "SDL.ProfileCSV", "");
+
+	// instruction trace
+	config->addOption("trace", "SDL.TraceFile", "");
+	config->addOption("tracestart", "SDL.TraceStart", "");
+	config->addOption("tracestop", "SDL.TraceStop", "");
+	config->addOption("tracering", "SDL.TraceRing", 0);
+
+	// state hash log
+	config->addOption("hashlog", "SDL.HashLog", "");
+	config->addOption("hashparts", "SDL.HashParts", "all");
+
+	// snapshot burst
+	config->addOption("snapburst", "SDL.SnapBurst", 0);
+	config->addOption("snapstart", "SDL.SnapStart", -1);
+	config->addOption("snapstop", "SDL.SnapStop", -1);
     
 	// fm2 -> srt conversion
 	config->addOption("ripsubs", "SDL.RipSubs", "");
@@ -22,7 +22,10 @@ uint32 *GetJSOr(void);
 
 int InitVideo(FCEUGI *gi);
 int KillVideo(void);
-void BlitScreen(uint8 *XBuf);
+void BlitScreen(uint8 *XBuf, uint8 *dbuf, const uint32 *dirty);
+void QueueFrame(uint8 *XBuf);
+bool FramePending(void);
+bool PresentFrame(void);
 void LockConsole(void);
 void UnlockConsole(void);
 void ToggleFS();		/* SDL */
@@ -187,6 +187,14 @@ void toggleLowPass(GtkWidget* w, gpointer p)
 	g_config->save();
 }
 
+void toggleStepSynth(GtkWidget* w, gpointer p)
+{
+	int enable = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(w)) ? 1 : 0;
+	g_config->setOption("SDL.Sound.StepSynth", enable);
+	FCEUI_SetStepSynth(enable);
+	g_config->save();
+}
+
 void toggleSwapDuty(GtkWidget* w, gpointer p)
 {
 	if(gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(w)))
@@ -1202,6 +1210,7 @@ void openSoundConfig()
 	GtkWidget* vbox;
 	GtkWidget* soundChk;
 	GtkWidget* lowpassChk;
+	GtkWidget* stepsynthChk;
 	GtkWidget* hbox1;
 	GtkWidget* qualityCombo;
 	GtkWidget* qualityLbl;
@@ -1251,6 +1260,12 @@ void openSoundConfig()
 		gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(lowpassChk), FALSE);
 	
 	g_signal_connect(lowpassChk, "clicked", G_CALLBACK(toggleLowPass), NULL);
+
+	// step synthesis check
+	stepsynthChk = gtk_check_button_new_with_label("Band-limited step synthesis");
+	g_config->getOption("SDL.Sound.StepSynth", &cfgBuf);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(stepsynthChk), cfgBuf ? TRUE : FALSE);
+	g_signal_connect(stepsynthChk, "clicked", G_CALLBACK(toggleStepSynth), NULL);
 	
 	// sound quality combo box
 	hbox1 = gtk_hbox_new(FALSE, 3);
@@ -1359,6 +1374,7 @@ void openSoundConfig()
 	gtk_box_pack_start(GTK_BOX(main_hbox), vbox, FALSE, TRUE, 5);
 	gtk_box_pack_start(GTK_BOX(vbox), soundChk, FALSE, FALSE, 5);
 	gtk_box_pack_start(GTK_BOX(vbox), lowpassChk, FALSE, FALSE, 5);
+	gtk_box_pack_start(GTK_BOX(vbox), stepsynthChk, FALSE, FALSE, 5);
 	gtk_box_pack_start(GTK_BOX(vbox), hbox1, FALSE, FALSE, 5);
 	gtk_box_pack_start(GTK_BOX(vbox), hbox2, FALSE, FALSE, 5);
 	gtk_box_pack_start(GTK_BOX(vbox), bufferLbl, FALSE, FALSE, 5);
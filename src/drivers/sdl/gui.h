@@ -45,6 +45,7 @@ void closeVideoWin(GtkWidget* w, gint response, gpointer p);
 void closeDialog(GtkWidget* w, GdkEvent* e, gpointer p);
 
 void toggleLowPass(GtkWidget* w, gpointer p);
+void toggleStepSynth(GtkWidget* w, gpointer p);
 void toggleOption(GtkWidget* w, gpointer p);
 
 int setTint(GtkWidget* w, gpointer p);
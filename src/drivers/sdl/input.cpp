@@ -136,7 +136,12 @@ DoCheatSeq ()
 }
 
 #include "keyscan.h"
-static uint8 *g_keyState = 0;
+// the keys as PollInputEvents last took them from SDL.  SDL's own array
+// changes whenever the main thread handles events, so the emulation thread
+// reads this copy instead, and both threads only touch it under s_emulock.
+// GetKeyboard's callers read it as 256 unsigned ints
+static unsigned int s_keys[256];
+static uint8 *g_keyState = (uint8 *) s_keys;
 static int DIPS = 0;
 
 static uint8 keyonce[MKK_COUNT];
@@ -431,13 +436,7 @@ void FCEUD_LoadStateFrom ()
 */
 unsigned int *GetKeyboard(void)                                                     
 {
-	int size = 256;
-#if SDL_VERSION_ATLEAST(2, 0, 0)
-	Uint8* keystate = (Uint8*)SDL_GetKeyboardState(&size);
-#else
-	Uint8* keystate = SDL_GetKeyState(&size);
-#endif
-	return (unsigned int*)(keystate);
+	return s_keys;
 }
 
 /**
@@ -448,12 +447,6 @@ static void KeyboardCommands ()
 	int is_shift, is_alt;
 
 	char *movie_fname = "";
-	// get the keyboard input
-#if SDL_VERSION_ATLEAST(1, 3, 0)
-	g_keyState = (Uint8*)SDL_GetKeyboardState (NULL);
-#else
-	g_keyState = SDL_GetKeyState (NULL);
-#endif
 
 	// check if the family keyboard is enabled
 	if (CurInputType[2] == SIFC_FKB)
@@ -509,6 +502,9 @@ static void KeyboardCommands ()
 		{
 			g_keyState[SDLK_LALT] = 0;
 			g_keyState[SDLK_RALT] = 0;
+			// and in SDL's array, so the next copy doesn't bring them back
+			SDL_GetKeyState (NULL)[SDLK_LALT] = 0;
+			SDL_GetKeyState (NULL)[SDLK_RALT] = 0;
 		}
 #endif
 	}
@@ -1262,17 +1258,46 @@ static uint32 MouseData[3] = { 0, 0, 0 };
 
 static uint8 fkbkeys[0x48];
 
+/**
+ * Copies SDL's keyboard state to the keys the emulation thread reads.
+ */
+static void
+TakeKeyState ()
+{
+	int size = 0;
+#if SDL_VERSION_ATLEAST(1, 3, 0)
+	const Uint8 *keys = SDL_GetKeyboardState (&size);
+#else
+	const Uint8 *keys = SDL_GetKeyState (&size);
+#endif
+	if (size > (int) sizeof (s_keys))
+		size = sizeof (s_keys);
+	memcpy (s_keys, keys, size);
+}
+
 /**
  * Update all of the input devices required for the active game.
  */
+/**
+ * Handles pending SDL events and the hotkeys.  Runs on the main thread,
+ * which owns the video and the event queue, as often as it likes.
+ */
+void PollInputEvents ()
+{
+	UpdatePhysicalInput ();
+	TakeKeyState ();
+	KeyboardCommands ();
+}
+
+/**
+ * Updates the emulated input devices.  Runs on the emulation thread once
+ * per frame, as rapid fire counts frames.
+ */
 void FCEUD_UpdateInput ()
 {
 	int x;
 	int t = 0;
 
-	UpdatePhysicalInput ();
-	KeyboardCommands ();
-
 	for (x = 0; x < 2; x++)
 	{
 		switch (CurInputType[x])
@@ -1374,6 +1399,9 @@ void InitInputInterface ()
 	int x;
 	int attrib;
 
+	// the emulation thread may read the keys before the first PollInputEvents
+	TakeKeyState ();
+
 	for (t = 0, x = 0; x < 2; x++)
 	{
 		attrib = 0;
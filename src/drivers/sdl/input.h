@@ -50,6 +50,7 @@ void DecreaseEmulationSpeed(void);
 int DTestButtonJoy(ButtConfig *bc);
 
 void FCEUD_UpdateInput(void);
+void PollInputEvents(void);
 
 void UpdateInput(Config *config);
 void InputCfg(const std::string &);
@@ -3,6 +3,8 @@
 #include "sdl.h"
 #include "sdl-opengl.h"
 #include "../common/vidblit.h"
+#include "../../driver.h"
+#include "../../palette.h"
 #include "../../utils/memory.h"
 
 #ifdef APPLEOPENGL
@@ -25,6 +27,7 @@ static GLuint textures[2]={0,0};	// Normal image, scanline overlay.
 
 static int left,right,top,bottom; // right and bottom are not inclusive.
 static int scanlines;
+static GLfloat scanshift; // added to the overlay's texture coordinates, see InitOpenGL
 static void *HiBuffer;
 
 typedef void APIENTRY (*glColorTableEXT_Func)(GLenum target,
@@ -32,10 +35,432 @@ typedef void APIENTRY (*glColorTableEXT_Func)(GLenum target,
 		const GLvoid *table);
 glColorTableEXT_Func p_glColorTableEXT;
 
+// The shader path.  The index and deemphasis planes go up to two 8 bit
+// textures as they are, through a pixel buffer, and only the lines that
+// changed.  A fragment shader looks the colors up in a palette texture,
+// with a row for each deemphasis, and darkens the scanlines; the quad it
+// draws lives in a vertex buffer.  It needs OpenGL 2.1 or the equivalent
+// extensions, which Mesa's software rasterizers have.
+
+#define SHADER_PROCS \
+	P(PFNGLACTIVETEXTUREPROC, glActiveTexture) \
+	P(PFNGLCREATESHADERPROC, glCreateShader) \
+	P(PFNGLSHADERSOURCEPROC, glShaderSource) \
+	P(PFNGLCOMPILESHADERPROC, glCompileShader) \
+	P(PFNGLGETSHADERIVPROC, glGetShaderiv) \
+	P(PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog) \
+	P(PFNGLDELETESHADERPROC, glDeleteShader) \
+	P(PFNGLCREATEPROGRAMPROC, glCreateProgram) \
+	P(PFNGLATTACHSHADERPROC, glAttachShader) \
+	P(PFNGLBINDATTRIBLOCATIONPROC, glBindAttribLocation) \
+	P(PFNGLLINKPROGRAMPROC, glLinkProgram) \
+	P(PFNGLGETPROGRAMIVPROC, glGetProgramiv) \
+	P(PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog) \
+	P(PFNGLDELETEPROGRAMPROC, glDeleteProgram) \
+	P(PFNGLUSEPROGRAMPROC, glUseProgram) \
+	P(PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation) \
+	P(PFNGLUNIFORM1IPROC, glUniform1i) \
+	P(PFNGLUNIFORM1FPROC, glUniform1f) \
+	P(PFNGLVERTEXATTRIBPOINTERPROC, glVertexAttribPointer) \
+	P(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray) \
+	P(PFNGLDISABLEVERTEXATTRIBARRAYPROC, glDisableVertexAttribArray) \
+	P(PFNGLGENBUFFERSPROC, glGenBuffers) \
+	P(PFNGLDELETEBUFFERSPROC, glDeleteBuffers) \
+	P(PFNGLBINDBUFFERPROC, glBindBuffer) \
+	P(PFNGLBUFFERDATAPROC, glBufferData) \
+	P(PFNGLMAPBUFFERPROC, glMapBuffer) \
+	P(PFNGLUNMAPBUFFERPROC, glUnmapBuffer)
+
+// for keeping the pixel buffer mapped, when there is GL_ARB_buffer_storage
+#define PERSISTENT_PROCS \
+	P(PFNGLBUFFERSTORAGEPROC, glBufferStorage) \
+	P(PFNGLMAPBUFFERRANGEPROC, glMapBufferRange) \
+	P(PFNGLFENCESYNCPROC, glFenceSync) \
+	P(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync) \
+	P(PFNGLDELETESYNCPROC, glDeleteSync)
+
+#define P(type, name) static type p_##name;
+SHADER_PROCS
+PERSISTENT_PROCS
+#undef P
+
+#define PLANE_SIZE (256*256)
+#define PLANES_SIZE (2*PLANE_SIZE)
+
+// a kept mapping is split into sections written in turn, so a frame is
+// written while the ones before it may still be uploading
+#define PBO_SECTIONS 3
+
+static GLuint program, vbo, pbo;
+static GLuint planes[2];	// Index plane, deemphasis plane.
+static GLuint paltex;
+static uint8 *pbomap;	// The kept mapping, or 0 when it is mapped each frame.
+static GLsync fences[PBO_SECTIONS];
+static int section;
+static int planesvalid;
+
+static const char *VertexShader =
+	"attribute vec2 pos;\n"
+	"attribute vec2 tex;\n"
+	"varying vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"	uv = tex;\n"
+	"	gl_Position = vec4(pos, 0.0, 1.0);\n"
+	"}\n";
+
+// the planes hold bytes, so their texels are looked up at their centers
+// and interpolation, when it is on, mixes the colors of four of them
+static const char *FragmentShader =
+	"uniform sampler2D indices;\n"
+	"uniform sampler2D deemph;\n"
+	"uniform sampler2D palette;\n"
+	"uniform sampler2D scan;\n"
+	"uniform int scanlines;\n"
+	"uniform float scanshift;\n"
+	"uniform int ipolate;\n"
+	"varying vec2 uv;\n"
+	"vec3 color(vec2 p)\n"
+	"{\n"
+	"	vec2 t = (floor(p) + 0.5) / 256.0;\n"
+	"	float i = floor(texture2D(indices, t).r * 255.0 + 0.5);\n"
+	"	float d = floor(texture2D(deemph, t).r * 255.0 + 0.5);\n"
+	"	return texture2D(palette, vec2((i + 0.5) / 256.0, (d + 0.5) / 8.0)).rgb;\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 p = uv * 256.0;\n"
+	"	vec3 c;\n"
+	"	if(ipolate != 0) {\n"
+	"		vec2 q = p - 0.5;\n"
+	"		vec2 f = fract(q);\n"
+	"		q = floor(q);\n"
+	"		c = mix(mix(color(q), color(q + vec2(1.0, 0.0)), f.x),\n"
+	"			mix(color(q + vec2(0.0, 1.0)), color(q + vec2(1.0, 1.0)), f.x), f.y);\n"
+	"	} else {\n"
+	"		c = color(p);\n"
+	"	}\n"
+	"	if(scanlines != 0)\n"
+	"		c *= texture2D(scan, uv + vec2(0.0, scanshift)).a;\n"
+	"	gl_FragColor = vec4(c, 1.0);\n"
+	"}\n";
+
+static GLuint
+CompileShader(GLenum type, const char *source)
+{
+	GLuint shader = p_glCreateShader(type);
+	GLint ok;
+
+	p_glShaderSource(shader, 1, &source, NULL);
+	p_glCompileShader(shader);
+	p_glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+	if(!ok) {
+		char log[1024];
+		p_glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		FCEU_printf("OpenGL shader failed to compile:\n%s\n", log);
+		p_glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+static void
+SetShaderPalette(uint8 *data)
+{
+	uint8 table[8][256][4];
+	int d, x;
+
+	// row 0 is the palette itself; the others are the deemphasized colors,
+	// the way vidblit looks them up
+	memcpy(table[0], data, sizeof(table[0]));
+	for(d = 1; d < 8; d++) {
+		for(x = 0; x < 256; x++) {
+			if(palo) {
+				pal *p = &palo[(x & 0x3F) + d * 64];
+				table[d][x][0] = p->r;
+				table[d][x][1] = p->g;
+				table[d][x][2] = p->b;
+				table[d][x][3] = 0xFF;
+			} else {
+				memcpy(table[d][x], table[0][x], 4);
+			}
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, paltex);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 8, GL_RGBA,
+					GL_UNSIGNED_BYTE, table);
+}
+
+// the run of set bits in rows that starts at or after *y, as in vidblit
+static int
+NextRows(const uint32 *rows, int *y)
+{
+	int n = 0;
+	while(*y < 256 && !((rows[*y >> 5] >> (*y & 31)) & 1))
+		(*y)++;
+	while(*y + n < 256 && ((rows[(*y + n) >> 5] >> ((*y + n) & 31)) & 1))
+		n++;
+	return n;
+}
+
+static void
+UploadPlanes(uint8 *buf, uint8 *dbuf, const uint32 *dirty)
+{
+	uint32 rows[FCEU_DIRTY_WORDS];
+	uint8 *dest;
+	GLintptr offset = 0;
+	int y, n;
+
+	if(!dirty || !planesvalid) {
+		memset(rows, 0xFF, sizeof(rows));
+	} else {
+		memcpy(rows, dirty, sizeof(rows));
+	}
+	planesvalid = 1;
+
+	p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	if(pbomap) {
+		if(fences[section]) {
+			p_glClientWaitSync(fences[section], GL_SYNC_FLUSH_COMMANDS_BIT,
+								1000000000);
+			p_glDeleteSync(fences[section]);
+			fences[section] = 0;
+		}
+		offset = section * PLANES_SIZE;
+		dest = pbomap + offset;
+	} else {
+		// orphan the last frame's storage rather than wait for its upload
+		p_glBufferData(GL_PIXEL_UNPACK_BUFFER, PLANES_SIZE, NULL,
+						GL_STREAM_DRAW);
+		dest = (uint8*)p_glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		if(!dest) {
+			p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			return;
+		}
+	}
+
+	for(y = 0; (n = NextRows(rows, &y)); y += n) {
+		memcpy(dest + y * 256, buf + y * 256, n * 256);
+		memcpy(dest + PLANE_SIZE + y * 256, dbuf + y * 256, n * 256);
+	}
+	if(!pbomap) {
+		p_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	for(y = 0; (n = NextRows(rows, &y)); y += n) {
+		glBindTexture(GL_TEXTURE_2D, planes[0]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, 256, n, GL_LUMINANCE,
+						GL_UNSIGNED_BYTE, (GLvoid*)(offset + y * 256));
+		glBindTexture(GL_TEXTURE_2D, planes[1]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, 256, n, GL_LUMINANCE,
+						GL_UNSIGNED_BYTE,
+						(GLvoid*)(offset + PLANE_SIZE + y * 256));
+	}
+
+	if(pbomap) {
+		fences[section] = p_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		section = (section + 1) % PBO_SECTIONS;
+	}
+	p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+static void
+BlitShader(uint8 *buf, uint8 *dbuf, const uint32 *dirty)
+{
+	UploadPlanes(buf, dbuf, dirty);
+
+	glClear(GL_COLOR_BUFFER_BIT);
+	p_glUseProgram(program);
+	p_glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, planes[0]);
+	p_glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, planes[1]);
+	p_glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, paltex);
+	p_glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, textures[1]);
+	p_glActiveTexture(GL_TEXTURE0);
+
+	p_glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	p_glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+							(GLvoid*)0);
+	p_glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat),
+							(GLvoid*)(2 * sizeof(GLfloat)));
+	p_glEnableVertexAttribArray(0);
+	p_glEnableVertexAttribArray(1);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	p_glDisableVertexAttribArray(0);
+	p_glDisableVertexAttribArray(1);
+	p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+	p_glUseProgram(0);
+}
+
+static void
+KillShader(void)
+{
+	int i;
+
+	for(i = 0; i < PBO_SECTIONS; i++) {
+		if(fences[i]) {
+			p_glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+	if(pbomap) {
+		p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+		p_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		pbomap = 0;
+	}
+	if(pbo) {
+		p_glDeleteBuffers(1, &pbo);
+		pbo = 0;
+	}
+	if(vbo) {
+		p_glDeleteBuffers(1, &vbo);
+		vbo = 0;
+	}
+	if(planes[0]) {
+		glDeleteTextures(2, &planes[0]);
+		planes[0] = planes[1] = 0;
+	}
+	if(paltex) {
+		glDeleteTextures(1, &paltex);
+		paltex = 0;
+	}
+	if(program) {
+		p_glDeleteProgram(program);
+		program = 0;
+	}
+}
+
+static int
+InitShader(const char *extensions, int ipolate)
+{
+	GLuint vs, fs;
+	GLint ok;
+	int i;
+
+	// OpenGL 2.1 has all of it, as do the extensions before that
+	if(!extensions ||
+		(!strstr(extensions, "GL_ARB_pixel_buffer_object") &&
+		 !strstr(extensions, "GL_EXT_pixel_buffer_object")) ||
+		!strstr(extensions, "GL_ARB_fragment_shader")) {
+		return 0;
+	}
+#define P(type, name) \
+	if(!(p_##name = (type) SDL_GL_GetProcAddress(#name))) return 0;
+	SHADER_PROCS
+#undef P
+
+	vs = CompileShader(GL_VERTEX_SHADER, VertexShader);
+	fs = CompileShader(GL_FRAGMENT_SHADER, FragmentShader);
+	if(!vs || !fs) {
+		if(vs) p_glDeleteShader(vs);
+		if(fs) p_glDeleteShader(fs);
+		return 0;
+	}
+	program = p_glCreateProgram();
+	p_glAttachShader(program, vs);
+	p_glAttachShader(program, fs);
+	p_glBindAttribLocation(program, 0, "pos");
+	p_glBindAttribLocation(program, 1, "tex");
+	p_glLinkProgram(program);
+	p_glDeleteShader(vs);
+	p_glDeleteShader(fs);
+	p_glGetProgramiv(program, GL_LINK_STATUS, &ok);
+	if(!ok) {
+		char log[1024];
+		p_glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		FCEU_printf("OpenGL shader failed to link:\n%s\n", log);
+		p_glDeleteProgram(program);
+		program = 0;
+		return 0;
+	}
+	p_glUseProgram(program);
+	p_glUniform1i(p_glGetUniformLocation(program, "indices"), 0);
+	p_glUniform1i(p_glGetUniformLocation(program, "deemph"), 1);
+	p_glUniform1i(p_glGetUniformLocation(program, "palette"), 2);
+	p_glUniform1i(p_glGetUniformLocation(program, "scan"), 3);
+	p_glUniform1i(p_glGetUniformLocation(program, "scanlines"), scanlines);
+	p_glUniform1f(p_glGetUniformLocation(program, "scanshift"), scanshift);
+	p_glUniform1i(p_glGetUniformLocation(program, "ipolate"), ipolate);
+	p_glUseProgram(0);
+
+	// the picture is looked up texel by texel, so nothing is filtered
+	glGenTextures(2, &planes[0]);
+	glGenTextures(1, &paltex);
+	for(i = 0; i < 3; i++) {
+		glBindTexture(GL_TEXTURE_2D, i < 2 ? planes[i] : paltex);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if(i < 2) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, 256, 256, 0,
+						GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+		} else {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 8, 0,
+						GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	planesvalid = 0;
+
+	{
+		GLfloat quad[] = {
+			// position, then texture coordinate
+			-1.0f, -1.0f, 1.0f*left/256,  1.0f*bottom/256,
+			 1.0f, -1.0f, 1.0f*right/256, 1.0f*bottom/256,
+			-1.0f,  1.0f, 1.0f*left/256,  1.0f*top/256,
+			 1.0f,  1.0f, 1.0f*right/256, 1.0f*top/256,
+		};
+		p_glGenBuffers(1, &vbo);
+		p_glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		p_glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+		p_glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	p_glGenBuffers(1, &pbo);
+	p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	pbomap = 0;
+	section = 0;
+	if(strstr(extensions, "GL_ARB_buffer_storage") &&
+		strstr(extensions, "GL_ARB_sync")) {
+		int found = 1;
+#define P(type, name) \
+		if(!(p_##name = (type) SDL_GL_GetProcAddress(#name))) found = 0;
+		PERSISTENT_PROCS
+#undef P
+		if(found) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+								GL_MAP_COHERENT_BIT;
+			p_glBufferStorage(GL_PIXEL_UNPACK_BUFFER,
+								PBO_SECTIONS * PLANES_SIZE, NULL, flags);
+			pbomap = (uint8*)p_glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+								PBO_SECTIONS * PLANES_SIZE, flags);
+			if(!pbomap) {
+				// the storage can't be respecified, so start over
+				p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				p_glDeleteBuffers(1, &pbo);
+				p_glGenBuffers(1, &pbo);
+				p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+			}
+		}
+	}
+	p_glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	FCEU_printf("Using the OpenGL shader path%s.\n",
+				pbomap ? " with a persistently mapped buffer" : "");
+	return 1;
+}
+
 void
 SetOpenGLPalette(uint8 *data)
 {
-	if(!HiBuffer) {
+	if(program) {
+		SetShaderPalette(data);
+	} else if(!HiBuffer) {
 		glBindTexture(GL_TEXTURE_2D, textures[0]);
 		p_glColorTableEXT(GL_TEXTURE_2D, GL_RGB, 256,
 						GL_RGBA, GL_UNSIGNED_BYTE, data);
@@ -45,13 +470,19 @@ SetOpenGLPalette(uint8 *data)
 }
 
 void
-BlitOpenGL(uint8 *buf)
+BlitOpenGL(uint8 *buf, uint8 *dbuf, const uint32 *dirty)
 {
+	if(program) {
+		BlitShader(buf, dbuf, dirty);
+		SDL_GL_SwapBuffers();
+		return;
+	}
+
 	glClear(GL_COLOR_BUFFER_BIT);
 	glBindTexture(GL_TEXTURE_2D, textures[0]);
 
 	if(HiBuffer) {
-		Blit8ToHigh(buf, (uint8*)HiBuffer, 256, 240, 256*4, 1, 1);
+		Blit8ToHigh(buf, (uint8*)HiBuffer, 256, 240, 256*4, 1, 1, dirty, 0);
     
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 256, 0,
 					GL_RGBA, GL_UNSIGNED_BYTE, HiBuffer);
@@ -86,19 +517,19 @@ BlitOpenGL(uint8 *buf)
 		glBegin(GL_QUADS);
 
 		glTexCoord2f(1.0f*left/256,
-					1.0f*bottom/256); // Bottom left of our picture.
+					1.0f*bottom/256+scanshift); // Bottom left of our picture.
 		glVertex2f(-1.0f, -1.0f);      // Bottom left of target.
  
 		glTexCoord2f(1.0f*right/256,
-					1.0f*bottom/256); // Bottom right of our picture.
+					1.0f*bottom/256+scanshift); // Bottom right of our picture.
 		glVertex2f( 1.0f, -1.0f);      // Bottom right of target.
  
 		glTexCoord2f(1.0f*right/256,
-					1.0f*top/256);    // Top right of our picture.
+					1.0f*top/256+scanshift);    // Top right of our picture.
 		glVertex2f( 1.0f,  1.0f);      // Top right of target.
  
 		glTexCoord2f(1.0f*left/256,
-					1.0f*top/256);     // Top left of our picture.
+					1.0f*top/256+scanshift);     // Top left of our picture.
 		glVertex2f(-1.0f,  1.0f);      // Top left of target.
 
 		glEnd();
@@ -110,6 +541,7 @@ BlitOpenGL(uint8 *buf)
 void
 KillOpenGL(void)
 {
+	KillShader();
 	if(textures[0]) {
 		glDeleteTextures(2, &textures[0]);
 	}
@@ -130,6 +562,7 @@ InitOpenGL(int l,
 		double yscale,
 		int efx,
 		int ipolate,
+		int shader,
 		int stretchx,
 		int stretchy,
 		SDL_Surface *screen)
@@ -169,19 +602,6 @@ InitOpenGL(int l,
  
 	extensions=(const char*)glGetString(GL_EXTENSIONS);
 
-	if((efx&2) || !extensions || !p_glColorTableEXT || !strstr(extensions,"GL_EXT_paletted_texture"))
-	{
-	if(!(efx&2)) // Don't want to print out a warning message in this case...
-		FCEU_printf("Paletted texture extension not found.  Using slower texture format...\n");
-	HiBuffer=FCEU_malloc(4*256*256);
-	memset(HiBuffer,0x00,4*256*256);
-  #ifndef LSB_FIRST
-	InitBlitToHigh(4,0xFF000000,0xFF0000,0xFF00,efx&2,0,0);
-  #else
-	InitBlitToHigh(4,0xFF,0xFF00,0xFF0000,efx&2,0,0);
-  #endif
-	}
- 
 	if(screen->flags & SDL_FULLSCREEN)
 	{
 		xscale=(double)screen->w / (double)(r-l);
@@ -199,6 +619,12 @@ InitOpenGL(int l,
 		if(stretchx) { sx=0; rw=screen->w; }
 		if(stretchy) { sy=0; rh=screen->h; }
 		glViewport(sx, sy, rw, rh);
+
+		// the overlay has two rows for each line, so at 3x and other odd scales every
+		// third pixel's center falls right on an edge between them, and with GL_NEAREST
+		// which side it takes is down to rounding.  Looking a quarter of a pixel higher
+		// keeps every whole scale clear of the edges, in both paths alike.
+		scanshift = ipolate ? 0.0f : -0.25f*(b-t)/256/rh;
 	}
 	glGenTextures(2, &textures[0]);
 	scanlines=0;
@@ -241,6 +667,23 @@ InitOpenGL(int l,
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
+	// the shader path needs neither of the texture formats below
+	if(shader && !InitShader(extensions, ipolate))
+		FCEU_printf("OpenGL shaders or pixel buffers not available.  Using the fixed function path...\n");
+
+	if(!program && ((efx&2) || !extensions || !p_glColorTableEXT || !strstr(extensions,"GL_EXT_paletted_texture")))
+	{
+	if(!(efx&2)) // Don't want to print out a warning message in this case...
+		FCEU_printf("Paletted texture extension not found.  Using slower texture format...\n");
+	HiBuffer=FCEU_malloc(4*256*256);
+	memset(HiBuffer,0x00,4*256*256);
+  #ifndef LSB_FIRST
+	InitBlitToHigh(4,0xFF000000,0xFF0000,0xFF00,efx&2,0,0);
+  #else
+	InitBlitToHigh(4,0xFF,0xFF00,0xFF0000,efx&2,0,0);
+  #endif
+	}
+
 	// In a double buffered setup with page flipping, be sure to clear both buffers.
 	glClear(GL_COLOR_BUFFER_BIT);
 	SDL_GL_SwapBuffers();
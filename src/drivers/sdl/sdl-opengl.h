@@ -1,6 +1,6 @@
 void SetOpenGLPalette(uint8 *data);
-void BlitOpenGL(uint8 *buf);
+void BlitOpenGL(uint8 *buf, uint8 *dbuf, const uint32 *dirty);
 void KillOpenGL(void);
-int InitOpenGL(int l, int r, int t, int b, double xscale,double yscale, int efx, int ipolate,
+int InitOpenGL(int l, int r, int t, int b, double xscale,double yscale, int efx, int ipolate, int shader,
 					int stretchx, int stretchy, SDL_Surface *screen);
 
@@ -73,7 +73,7 @@ fillaudio(void *udata,
 int
 InitSound()
 {
-	int sound, soundrate, soundbufsize, soundvolume, soundtrianglevolume, soundsquare1volume, soundsquare2volume, soundnoisevolume, soundpcmvolume, soundq;
+	int sound, soundrate, soundbufsize, soundvolume, soundtrianglevolume, soundsquare1volume, soundsquare2volume, soundnoisevolume, soundpcmvolume, soundq, stepsynth;
 	SDL_AudioSpec spec;
 
 	g_config->getOption("SDL.Sound", &sound);
@@ -100,6 +100,7 @@ InitSound()
 	g_config->getOption("SDL.Sound.BufSize", &soundbufsize);
 	g_config->getOption("SDL.Sound.Volume", &soundvolume);
 	g_config->getOption("SDL.Sound.Quality", &soundq);
+	g_config->getOption("SDL.Sound.StepSynth", &stepsynth);
 	g_config->getOption("SDL.Sound.TriangleVolume", &soundtrianglevolume);
 	g_config->getOption("SDL.Sound.Square1Volume", &soundsquare1volume);
 	g_config->getOption("SDL.Sound.Square2Volume", &soundsquare2volume);
@@ -133,6 +134,7 @@ InitSound()
 	SDL_PauseAudio(0);
 
 	FCEUI_SetSoundVolume(soundvolume);
+	FCEUI_SetStepSynth(stepsynth);
 	FCEUI_SetSoundQuality(soundq);
 	FCEUI_Sound(soundrate);
 	FCEUI_SetTriangleVolume(soundtrianglevolume);
@@ -145,11 +147,13 @@ InitSound()
 
 
 /**
- * Returns the size of the audio buffer.
+ * Returns the size of the audio buffer, 0 when sound is off.
  */
 uint32
 GetMaxSound(void)
 {
+	if(!s_Buffer)
+		return 0;
 	return(s_BufferSize);
 }
 
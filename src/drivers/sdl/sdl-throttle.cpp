@@ -1,19 +1,46 @@
 /// \file
-/// \brief Handles emulation speed throttling using the SDL timing functions.
+/// \brief Handles emulation speed throttling, pacing frames against the monotonic clock.
 
 #include "sdl.h"
 #include "throttle.h"
+#include "../../fceu.h"
+
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <cmath>
+#include <cstring>
 
 static const double Slowest = 0.015625; // 1/64x speed (around 1 fps on NTSC)
 static const double Fastest = 32;       // 32x speed   (around 1920 fps on NTSC)
 static const double Normal  = 1.0;      // 1x speed    (around 60 fps on NTSC)
 
-static uint64 Lasttime, Nexttime;
-static long double desired_frametime;
+// Times are nanoseconds of CLOCK_MONOTONIC.  Frames are let go on a fixed
+// schedule: each deadline is the previous one plus a frame, so time lost
+// oversleeping one frame is made up on the next instead of adding up.
+static const uint64 SpinMargin = 500000;   // the last 0.5 ms is spun, not slept
+static const uint64 MaxWait = 50000000;    // longest single wait, see SpeedThrottle
+static const uint64 MaxLag = 100000000;    // further behind than this, the schedule restarts
+
+static uint64 Lastdeadline, Nexttime;
+static double desired_frametime;
 static int InFrame;
+static bool Unthrottled;
+static double audio_level = -1;
 double g_fpsScale = Normal; // used by sdl.cpp
 bool MaxSpeed = false;
 
+// time between frames, as let go by SpeedThrottle
+static uint32 s_histogram[PACING_BUCKETS];
+static uint64 s_lastframe, s_intervals;
+static double s_sum, s_sumsq, s_min, s_max;
+
+// SpeedThrottle runs on the emulation thread outside s_emulock, while
+// the speed is changed and the statistics are read from the main thread.
+// Everything above except g_fpsScale, which only changes under s_emulock,
+// is touched under this lock.  It is never held across a sleep.
+static pthread_mutex_t s_throttlelock = PTHREAD_MUTEX_INITIALIZER;
+
 /* LOGMUL = exp(log(2) / 3)
  *
  * This gives us a value such that if we do x*=LOGMUL three times,
@@ -24,67 +51,227 @@ bool MaxSpeed = false;
  */
 #define LOGMUL 1.259921049894873
 
+static uint64 Now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void SleepUntil(uint64 t)
+{
+	timespec ts;
+#ifdef __APPLE__
+	// no clock_nanosleep; sleep for the time left instead
+	uint64 now = Now();
+	if(t <= now)
+		return;
+	t -= now;
+	ts.tv_sec = t / 1000000000;
+	ts.tv_nsec = t % 1000000000;
+	while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+#else
+	ts.tv_sec = t / 1000000000;
+	ts.tv_nsec = t % 1000000000;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR);
+#endif
+}
+
+/**
+ * Returns how much longer (or, when negative, shorter) the next frame
+ * should be to keep the sound buffer at its target level.  The sound card
+ * drains the buffer at its own rate, so this keeps the frames locked to
+ * the audio clock instead of drifting away from it.
+ */
+static double AudioCorrection()
+{
+	uint32 size = GetMaxSound();
+	if(!size || FCEUI_EmulationPaused() || !FSettings.SndRate) {
+		audio_level = -1;
+		return 0;
+	}
+
+	// the sound card takes its samples in blocks, so smooth out the level
+	double queued = size - GetWriteSound();
+	if(audio_level < 0)
+		audio_level = queued;
+	else
+		audio_level += (queued - audio_level) / 32;
+
+	// aim to keep room for two frames of sound, so writing one never has
+	// to wait for the sound card
+	double frame = FSettings.SndRate * desired_frametime / 1e9;
+	double target = size - 2 * frame;
+	if(target < size / 2)
+		target = size / 2;
+
+	// with more sound queued than wanted, the frames are coming too fast.
+	// close the gap over 64 frames, by at most half a percent per frame.
+	double ahead = (audio_level - target) / FSettings.SndRate * 1e9;
+	double correction = ahead / 64;
+	double limit = desired_frametime * 0.005;
+	if(correction > limit)
+		correction = limit;
+	if(correction < -limit)
+		correction = -limit;
+	return correction;
+}
+
+static void RecordInterval(uint64 now)
+{
+	if(s_lastframe) {
+		double interval = now - s_lastframe;
+		int bucket = (int)(interval / PACING_BUCKET_NS);
+		if(bucket >= PACING_BUCKETS)
+			bucket = PACING_BUCKETS - 1;
+		s_histogram[bucket]++;
+		if(!s_intervals || interval < s_min)
+			s_min = interval;
+		if(!s_intervals || interval > s_max)
+			s_max = interval;
+		s_sum += interval;
+		s_sumsq += interval * interval;
+		s_intervals++;
+	}
+	s_lastframe = now;
+}
+
+static void ClearPacing()
+{
+	memset(s_histogram, 0, sizeof(s_histogram));
+	s_lastframe = s_intervals = 0;
+	s_sum = s_sumsq = s_min = s_max = 0;
+}
+
 /**
- * Refreshes the FPS throttling variables.
+ * Refreshes the FPS throttling variables.  Called when the speed changes
+ * and when a game is loaded, which also starts the pacing statistics over.
  */
 void
 RefreshThrottleFPS()
 {
 	uint64 fps = FCEUI_GetDesiredFPS(); // Do >> 24 to get in Hz
-	desired_frametime = 16777216.0l / (fps * g_fpsScale);
 
-	Lasttime=0;   
-	Nexttime=0;
-	InFrame=0;
+	pthread_mutex_lock(&s_throttlelock);
+	desired_frametime = 16777216.0 * 1000000000.0 / (fps * g_fpsScale);
+	Unthrottled = g_fpsScale >= 32;
+
+	// the frame being waited for now ends one new frame after the last
+	// one, so changing the speed doesn't make it early or late
+	if(InFrame)
+		Nexttime = Lastdeadline + (uint64)desired_frametime;
+	audio_level = -1;
+	ClearPacing();
+	pthread_mutex_unlock(&s_throttlelock);
 }
 
 /**
  * Perform FPS speed throttling by delaying until the next time slot.
+ * Sleeps until just before the slot and spins the rest of the way, which
+ * lets frames go within a few microseconds of their time.  Returns 1 when
+ * it gave up waiting early to keep a single wait short, and has to be
+ * called again.
  */
 int
 SpeedThrottle()
 {
-	if(g_fpsScale >= 32)
+	uint64 cur_time = Now(), next;
+
+	pthread_mutex_lock(&s_throttlelock);
+	if(Unthrottled)
 	{
+		pthread_mutex_unlock(&s_throttlelock);
 		return 0; /* Done waiting */
 	}
-	uint64 time_left;
-	uint64 cur_time;
-    
-	if(!Lasttime)
-		Lasttime = SDL_GetTicks();
-    
 	if(!InFrame)
 	{
 		InFrame = 1;
-		Nexttime = Lasttime + desired_frametime * 1000;
+		if(!Lastdeadline)
+			Lastdeadline = cur_time;
+		Nexttime = Lastdeadline + (uint64)(desired_frametime + AudioCorrection());
+		// after a stall, start over from now instead of racing to catch up
+		if(cur_time > Nexttime + MaxLag) {
+			Nexttime = cur_time;
+			s_lastframe = 0;
+		}
 	}
-    
-	cur_time  = SDL_GetTicks();
-	if(cur_time >= Nexttime)
-		time_left = 0;
-	else
-		time_left = Nexttime - cur_time;
-    
-	if(time_left > 50)
+	next = Nexttime;
+	pthread_mutex_unlock(&s_throttlelock);
+
+	if(next > cur_time + MaxWait)
 	{
-		time_left = 50;
-		/* In order to keep input responsive, don't wait too long at once */
-		/* 50 ms wait gives us a 20 Hz responsetime which is nice. */
+		SleepUntil(cur_time + MaxWait);
+		return 1; /* Must still wait some more */
 	}
-	else
-		InFrame = 0;
-    
-	/*fprintf(stderr, "attempting to sleep %Ld ms, frame complete=%s\n",
-		time_left, InFrame?"no":"yes");*/
-	SDL_Delay(time_left);
-    
-	if(!InFrame)
+
+	if(next > cur_time + SpinMargin)
+		SleepUntil(next - SpinMargin);
+	while((cur_time = Now()) < next);
+
+	pthread_mutex_lock(&s_throttlelock);
+	// the speed changed while we waited, so wait for the new time instead
+	if(Nexttime != next)
 	{
-		Lasttime = SDL_GetTicks();
-		return 0; /* Done waiting */
+		pthread_mutex_unlock(&s_throttlelock);
+		return 1;
+	}
+	InFrame = 0;
+	Lastdeadline = next;
+	RecordInterval(cur_time);
+	pthread_mutex_unlock(&s_throttlelock);
+	return 0; /* Done waiting */
+}
+
+/**
+ * Copies out the frame pacing statistics.
+ */
+void
+GetPacingStats(PacingStats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	pthread_mutex_lock(&s_throttlelock);
+	stats->intervals = s_intervals;
+	if(s_intervals) {
+		double mean = s_sum / s_intervals;
+		double var = s_sumsq / s_intervals - mean * mean;
+		stats->mean = mean / 1e6;
+		stats->stddev = var > 0 ? sqrt(var) / 1e6 : 0;
+		stats->min = s_min / 1e6;
+		stats->max = s_max / 1e6;
+	}
+	memcpy(stats->histogram, s_histogram, sizeof(s_histogram));
+	pthread_mutex_unlock(&s_throttlelock);
+}
+
+/**
+ * Prints the frame pacing statistics, with a histogram of the time
+ * between frames in 0.1 ms steps.
+ */
+void
+PrintPacingStats(FILE *fp)
+{
+	PacingStats stats;
+	GetPacingStats(&stats);
+	fprintf(fp, "frame pacing: %llu intervals", (unsigned long long)stats.intervals);
+	if(!stats.intervals) {
+		fprintf(fp, "\n");
+		return;
+	}
+	fprintf(fp, ", mean %.3f ms, sd %.3f ms, min %.3f ms, max %.3f ms\n",
+			stats.mean, stats.stddev, stats.min, stats.max);
+
+	uint32 peak = 0;
+	for(int i = 0; i < PACING_BUCKETS; i++)
+		if(stats.histogram[i] > peak)
+			peak = stats.histogram[i];
+	for(int i = 0; i < PACING_BUCKETS; i++) {
+		if(!stats.histogram[i])
+			continue;
+		int bar = (int)((uint64)stats.histogram[i] * 50 / peak);
+		fprintf(fp, "%s%5.1f ms %10u %.*s\n", i == PACING_BUCKETS - 1 ? ">=" : "  ",
+				i * PACING_BUCKET_NS / 1e6, stats.histogram[i], bar > 0 ? bar : 1,
+				"##################################################");
 	}
-	return 1; /* Must still wait some more */
 }
 
 /**
@@ -27,6 +27,7 @@
 #include "../../fceu.h"
 #include "../../version.h"
 #include "../../video.h"
+#include "../../profile.h"
 
 #include "../../utils/memory.h"
 
@@ -48,6 +49,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <pthread.h>
 
 // GLOBALS
 extern Config *g_config;
@@ -78,6 +80,7 @@ static int s_nativeHeight = -1;
 #define NOFFSET	(s_clipSides ? 8 : 0)
 
 static int s_paletterefresh;
+static int s_fullredraw;
 
 extern bool MaxSpeed;
 
@@ -166,7 +169,7 @@ InitVideo(FCEUGI *gi)
 	// XXX soules - const?  is this necessary?
 	const SDL_VideoInfo *vinf;
 	int error, flags = 0;
-	int doublebuf, xstretch, ystretch, xres, yres, show_fps;
+	int doublebuf, xstretch, ystretch, xres, yres, show_fps, show_profile;
 
 	FCEUI_printf("Initializing video...");
 
@@ -184,6 +187,7 @@ InitVideo(FCEUGI *gi)
 	g_config->getOption("SDL.ClipSides", &s_clipSides);
 	g_config->getOption("SDL.NoFrame", &noframe);
 	g_config->getOption("SDL.ShowFPS", &show_fps);
+	g_config->getOption("SDL.ShowProfile", &show_profile);
 
 	// check the starting, ending, and total scan lines
 	FCEUI_GetCurrentVidSystem(&s_srendline, &s_erendline);
@@ -227,6 +231,7 @@ InitVideo(FCEUGI *gi)
 
 	// check to see if we are showing FPS
 	FCEUI_SetShowFPS(show_fps);
+	FCEUI_SetShowProfile(show_profile);
     
 	// check if we are rendering fullscreen
 	if(s_fullscreen) {
@@ -478,6 +483,7 @@ InitVideo(FCEUGI *gi)
 #endif
 	SDL_WM_SetIcon(s_IconSurface,0);
 	s_paletterefresh = 1;
+	s_fullredraw = 1;
 
 	// XXX soules - can't SDL do this for us?
 	 // if using more than 8bpp, initialize the conversion routines
@@ -490,13 +496,15 @@ InitVideo(FCEUGI *gi)
 #ifdef OPENGL
 		if(s_useOpenGL) 
 		{
-			int openGLip;
+			int openGLip, openGLshader;
 			g_config->getOption("SDL.OpenGLip", &openGLip);
+			g_config->getOption("SDL.OpenGLShader", &openGLshader);
 
 			if(!InitOpenGL(NOFFSET, 256 - (s_clipSides ? 8 : 0),
 						s_srendline, s_erendline + 1,
 						s_exs, s_eys, s_eefx,
-						openGLip, xstretch, ystretch, s_screen)) 
+						openGLip, openGLshader, xstretch, ystretch,
+						s_screen)) 
 			{
 				FCEUD_PrintError("Error initializing OpenGL.");
 				KillVideo();
@@ -547,7 +555,11 @@ void ToggleFS()
 		FCEUI_ToggleEmulationPause();
 }
 
-static SDL_Color s_psdl[256];
+// the core's palette lives in s_psdl, which only changes under s_emulock.
+// a change goes to the display with the next queued frame, through
+// s_pqueued under s_framelock, and the display draws from s_pshown
+static SDL_Color s_psdl[256], s_pqueued[256], s_pshown[256];
+static bool s_palettechanged, s_palettequeued;
 
 /**
  * Sets the color for a particular index in the palette.
@@ -562,7 +574,7 @@ FCEUD_SetPalette(uint8 index,
 	s_psdl[index].g = g;
 	s_psdl[index].b = b;
 
-	s_paletterefresh = 1;
+	s_palettechanged = true;
 }
 
 /**
@@ -586,18 +598,18 @@ static void RedoPalette()
 {
 #ifdef OPENGL
 	if(s_useOpenGL)
-		SetOpenGLPalette((uint8*)s_psdl);
+		SetOpenGLPalette((uint8*)s_pshown);
 	else 
 #endif
 	{
 		if(s_curbpp > 8) {
-			SetPaletteBlitToHigh((uint8*)s_psdl);
+			SetPaletteBlitToHigh((uint8*)s_pshown);
 		} else
 		{
 #if SDL_VERSION_ATLEAST(2, 0, 0)
 			//TODO - SDL2
 #else
-			SDL_SetPalette(s_screen, SDL_PHYSPAL, s_psdl, 0, 256);
+			SDL_SetPalette(s_screen, SDL_PHYSPAL, s_pshown, 0, 256);
 #endif
 		}
 	}
@@ -610,11 +622,133 @@ void LockConsole(){}
 ///Currently unimplemented.
 void UnlockConsole(){}
 
+// Frames go from the emulation thread to the display through three
+// buffers: the emulation thread fills one, the newest finished frame waits
+// in the second and the display draws from the third.  Filling and drawing
+// happen on buffers the other thread can't reach, so neither thread waits
+// for the other to finish a frame, and the display always gets the latest.
+//
+// Handing a frame over swaps the middle index under s_framelock.  The
+// lock also covers what travels with the frames: the lines that changed
+// since the display last drew, the queued palette and the profiler's blit
+// time.  Each side holds it only for the swap and those copies, so a
+// thread can wait on it, but never for longer than that.
+#define FRAME_READY 4
+
+static uint8 s_frames[3][256 * 256];
+static uint8 s_dframes[3][256 * 256]; // the deemphasis bits of each frame
+static volatile int s_framemiddle = 1;
+static int s_frameback = 0, s_framefront = 2;
+
+static uint32 s_framecurrent[3][FCEU_DIRTY_WORDS]; // lines up to date in each buffer
+static uint32 s_framedirty[FCEU_DIRTY_WORDS]; // lines changed since the display drew
+static uint64 s_blitticks; // time the display spent drawing, for the profiler
+static pthread_mutex_t s_framelock = PTHREAD_MUTEX_INITIALIZER;
+
+static int SwapFrame(int index)
+{
+	int old;
+	do {
+		old = s_framemiddle;
+	} while(!__sync_bool_compare_and_swap(&s_framemiddle, old, index));
+	return old;
+}
+
 /**
- * Pushes the given buffer of bits to the screen.
+ * Hands a finished frame to the display.  Called on the emulation thread.
  */
 void
-BlitScreen(uint8 *XBuf)
+QueueFrame(uint8 *XBuf)
+{
+	uint32 dirty[FCEU_DIRTY_WORDS];
+	uint32 *current = s_framecurrent[s_frameback];
+	int i, y;
+
+	// a buffer has to catch up on the lines that changed since it was
+	// last filled, which may be a few frames back
+	FCEUI_TakeDirtyLines(dirty);
+	for(i = 0; i < 3; i++) {
+		for(y = 0; y < FCEU_DIRTY_WORDS; y++) {
+			s_framecurrent[i][y] &= ~dirty[y];
+		}
+	}
+	for(y = 0; y < 256; y++) {
+		if(!((current[y >> 5] >> (y & 31)) & 1)) {
+			memcpy(s_frames[s_frameback] + y * 256, XBuf + y * 256, 256);
+			memcpy(s_dframes[s_frameback] + y * 256, XDBuf + y * 256, 256);
+		}
+	}
+	memset(current, 0xFF, sizeof(s_framecurrent[0]));
+
+	pthread_mutex_lock(&s_framelock);
+	for(y = 0; y < FCEU_DIRTY_WORDS; y++) {
+		s_framedirty[y] |= dirty[y];
+	}
+	if(s_palettechanged) {
+		s_palettechanged = false;
+		memcpy(s_pqueued, s_psdl, sizeof(s_pqueued));
+		s_palettequeued = true;
+	}
+	// the profiler's stages belong to this thread, so the display's
+	// drawing time is added here rather than where it was measured
+	FCEU_PROFILE_ADD(PROFILE_BLIT, s_blitticks);
+	s_blitticks = 0;
+	s_frameback = SwapFrame(s_frameback | FRAME_READY) & 3;
+	pthread_mutex_unlock(&s_framelock);
+}
+
+/**
+ * Returns whether a queued frame has yet to be drawn.
+ */
+bool
+FramePending()
+{
+	return (s_framemiddle & FRAME_READY) != 0;
+}
+
+/**
+ * Draws the newest queued frame, if there is one the display hasn't
+ * drawn yet.  Returns whether it drew anything.
+ */
+bool
+PresentFrame()
+{
+	uint32 dirty[FCEU_DIRTY_WORDS];
+
+	if(!FramePending()) {
+		return false;
+	}
+	pthread_mutex_lock(&s_framelock);
+	s_framefront = SwapFrame(s_framefront) & 3;
+	memcpy(dirty, s_framedirty, sizeof(dirty));
+	memset(s_framedirty, 0, sizeof(s_framedirty));
+	if(s_palettequeued) {
+		s_palettequeued = false;
+		memcpy(s_pshown, s_pqueued, sizeof(s_pshown));
+		s_paletterefresh = 1;
+	}
+	pthread_mutex_unlock(&s_framelock);
+
+#ifdef FCEU_PROFILE
+	uint64 start = FCEU_GetTicks();
+#endif
+	SetBlitSource(s_frames[s_framefront], s_dframes[s_framefront]);
+	BlitScreen(s_frames[s_framefront], s_dframes[s_framefront], dirty);
+#ifdef FCEU_PROFILE
+	pthread_mutex_lock(&s_framelock);
+	s_blitticks += FCEU_GetTicks() - start;
+	pthread_mutex_unlock(&s_framelock);
+#endif
+	return true;
+}
+
+/**
+ * Pushes the given buffer of bits, with its deemphasis bits in dbuf, to
+ * the screen.  dirty, if given, has the lines that changed since the last
+ * call; the others are not drawn again.
+ */
+void
+BlitScreen(uint8 *XBuf, uint8 *dbuf, const uint32 *dirty)
 {
 	SDL_Surface *TmpScreen;
 	uint8 *dest;
@@ -626,14 +760,21 @@ BlitScreen(uint8 *XBuf)
 
 	// refresh the palette if required
 	if(s_paletterefresh) {
-		RedoPalette();
 		s_paletterefresh = 0;
+		RedoPalette();
+		dirty = NULL;
+	}
+
+	// a new surface, or one of two that are flipped, needs everything
+	if(s_fullredraw || (s_screen->flags & SDL_DOUBLEBUF)) {
+		s_fullredraw = 0;
+		dirty = NULL;
 	}
 
 #ifdef OPENGL
 	// OpenGL is handled separately
 	if(s_useOpenGL) {
-		BlitOpenGL(XBuf);
+		BlitOpenGL(XBuf, dbuf, dirty);
 		return;
 	}
 #endif
@@ -670,19 +811,21 @@ BlitScreen(uint8 *XBuf)
 	if(s_curbpp > 8) {
 		if(s_BlitBuf) {
 			Blit8ToHigh(XBuf + NOFFSET, dest, NWIDTH, s_tlines,
-						TmpScreen->pitch, 1, 1);
+						TmpScreen->pitch, 1, 1, dirty, s_srendline);
 		} else {
 			Blit8ToHigh(XBuf + NOFFSET, dest, NWIDTH, s_tlines,
-						TmpScreen->pitch, (int)s_exs, (int)s_eys);
+						TmpScreen->pitch, (int)s_exs, (int)s_eys,
+						dirty, s_srendline);
 		}
 	} else {
 		if(s_BlitBuf) {
 			Blit8To8(XBuf + NOFFSET, dest, NWIDTH, s_tlines,
-					TmpScreen->pitch, 1, 1, 0, s_sponge);
+					TmpScreen->pitch, 1, 1, 0, s_sponge,
+					dirty, s_srendline);
 		} else {
 			Blit8To8(XBuf + NOFFSET, dest, NWIDTH, s_tlines,
 					TmpScreen->pitch, (int)s_exs, (int)s_eys,
-					s_eefx, s_sponge);
+					s_eefx, s_sponge, dirty, s_srendline);
 		}
 	}
 
@@ -758,7 +901,19 @@ BlitScreen(uint8 *XBuf)
        break;
    #endif
      default:
-       NESVideoLoggingVideo(s_screen->pixels, width,height, fps, s_curbpp);
+       // the rows of the screen are the lines from s_srendline on only
+       // when they are drawn one to one
+       if(dirty && s_exs == 1 && s_eys == 1 && !s_sponge && !s_fullscreen)
+       {
+         unsigned rows[FCEU_DIRTY_WORDS];
+         memset(rows, 0, sizeof(rows));
+         for(int y = 0; y < height; y++)
+           if((dirty[(s_srendline + y) >> 5] >> ((s_srendline + y) & 31)) & 1)
+             rows[y >> 5] |= 1u << (y & 31);
+         NESVideoLoggingVideoRows(s_screen->pixels, width,height, fps, s_curbpp, rows);
+       }
+       else
+         NESVideoLoggingVideo(s_screen->pixels, width,height, fps, s_curbpp);
    }
  }
 #endif
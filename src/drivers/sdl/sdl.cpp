@@ -6,6 +6,12 @@
 #include "../../fceu.h"
 #include "../../movie.h"
 #include "../../version.h"
+#include "../../romindex.h"
+#include "../../profile.h"
+#include "../../runahead.h"
+#include "../../trace.h"
+#include "../../state.h"
+#include "../../snapshot.h"
 #ifdef _S9XLUA_H
 #include "../../fceulua.h"
 #endif
@@ -42,6 +48,8 @@
 #include <cstdlib>
 #include <climits>
 #include <cmath>
+#include <vector>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/stat.h>
@@ -92,6 +100,7 @@ static const char *DriverUsage=
 "                          4player\n"
 "--gamegenie    {0|1}   Enable emulated Game Genie.\n"
 "--frameskip    x       Set # of frames to skip per emulated frame.\n"
+"--runahead     x       Run x frames ahead (0-8) to cut input latency.\n"
 "--xres         x       Set horizontal resolution for full screen mode.\n"
 "--yres         x       Set vertical resolution for full screen mode.\n"
 "--autoscale    {0|1}   Enable autoscaling in fullscreen. \n"
@@ -101,6 +110,8 @@ static const char *DriverUsage=
 "--(x/y)stretch {0|1}   Stretch to fill surface on x/y axis (OpenGL only).\n"
 "--bpp       {8|16|32}  Set bits per pixel.\n"
 "--opengl       {0|1}   Enable OpenGL support.\n"
+"--openglshader {0|1}   Draw through shaders with OpenGL 2.1, rather than the\n"
+"                         fixed function pipeline.\n"
 "--fullscreen   {0|1}   Enable full screen mode.\n"
 "--noframe      {0|1}   Hide title bar and window decorations.\n"
 "--special      {1-4}   Use special video scaling filters\n"
@@ -110,6 +121,7 @@ static const char *DriverUsage=
 "--sound        {0|1}   Enable sound.\n"
 "--soundrate    x       Set sound playback rate to x Hz.\n"
 "--soundq      {0|1|2}  Set sound quality. (0 = Low 1 = High 2 = Very High)\n"
+"--stepsynth    {0|1}   Render high quality sound from band-limited steps instead of the FIR filter.\n"
 "--soundbufsize x       Set sound buffer size to x ms.\n"
 "--volume      {0-256}  Set volume to x.\n"
 "--soundrecord  f       Record sound to file f.\n"
@@ -136,7 +148,25 @@ static const char *DriverUsage=
 "                         to not save/load automatically provide a number\n"
 "                         greater than 9\n"
 "--periodicsaves {0|1}  enable automatic periodic saving.  This will save to\n"
-"                         the state passed to --savestate\n";
+"                         the state passed to --savestate\n"
+"--romindex     f       Use rom library index f to speed up game loading.\n"
+"--scanroms     d       Index every ROM under directory d into the rom\n"
+"                         library index on all cores, then exit.\n"
+"--showprofile {0|1}    Overlay per-frame subsystem timings (PROFILE=1 builds).\n"
+"--profilecsv   f       Write per-frame subsystem timings to file f as CSV.\n"
+"--trace        f       Record every instruction the CPU runs to trace file f.\n"
+"--tracestart   x       Start the trace at frame x, or at the first instruction\n"
+"                         at address x when it is written $xxxx.\n"
+"--tracestop    x       Stop the trace at frame x or address $xxxx.\n"
+"--tracering    x       Keep only the last x million instructions, written\n"
+"                         when the trace stops.\n"
+"--hashlog      f       Write a hash of the machine state to file f after\n"
+"                         every frame, to compare two replays of a movie.\n"
+"--hashparts    p       What the hashes cover, like cpu,ram,oam (default all);\n"
+"                         also wram, ppu, apu, mapper and input.\n"
+"--snapburst    x       Save every xth frame as a numbered png snapshot.\n"
+"--snapstart    x       Start the snapshot burst at frame x.\n"
+"--snapstop     x       End the snapshot burst after frame x.\n";
 
 
 // these should be moved to the man file
@@ -268,7 +298,37 @@ CloseGame()
 	return(1);
 }
 
-void FCEUD_Update(uint8 *XBuf, int32 *Buffer, int Count);
+// The game runs on an emulation thread of its own, while the main thread
+// polls input, runs the GTK event loop and draws the frames the emulation
+// thread queues.  Anything on the main thread that touches the core holds
+// s_emulock, which the emulation thread holds while it runs a frame and
+// writes its sound.  Throttling and drawing happen outside the lock.
+static pthread_mutex_t s_emulock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t s_mainthread;
+static volatile bool s_emuquit;
+
+// SIGUSR1 asks for the frame pacing and run-ahead statistics
+static volatile sig_atomic_t s_printpacing;
+
+static void PacingSignal(int)
+{
+	s_printpacing = 1;
+}
+
+static void PrintRunAheadStats(FILE *fp)
+{
+	FCEU_RUNAHEAD_STATS stats;
+	if(!FCEUI_GetRunAheadStats(&stats)) {
+		if(stats.ahead)
+			fprintf(fp, "run-ahead: %d frames, not running\n", stats.ahead);
+		return;
+	}
+	fprintf(fp, "run-ahead: %d frames, %u byte snapshot, over the last %d frames (ms avg/max):",
+		stats.ahead, stats.statesize, stats.frames);
+	for(int i = 0; i < RUNAHEAD_PHASE_COUNT; i++)
+		fprintf(fp, " %s %.3f/%.3f", FCEUI_RunAheadPhaseName(i), stats.avg[i], stats.max[i]);
+	fprintf(fp, "\n");
+}
 
 static void DoFun(int frameskip, int periodic_saves)
 {
@@ -277,6 +337,14 @@ static void DoFun(int frameskip, int periodic_saves)
 	int32 ssize;
 	static int fskipc = 0;
 	static int opause = 0;
+	int throttle;
+
+	pthread_mutex_lock(&s_emulock);
+	// the main thread may have closed the game since we last looked
+	if(!GameInfo) {
+		pthread_mutex_unlock(&s_emulock);
+		return;
+	}
 
     //TODO peroidic saves, working on it right now
     if (periodic_saves && FCEUD_GetTime() % PERIODIC_SAVE_INTERVAL < 30){
@@ -290,12 +358,69 @@ static void DoFun(int frameskip, int periodic_saves)
 		gfx = 0;
 	}
 	FCEUI_Emulate(&gfx, &sound, &ssize, fskipc);
-	FCEUD_Update(gfx, sound, ssize);
+	throttle = FCEUD_Update(gfx, sound, ssize);
 
 	if(opause!=FCEUI_EmulationPaused()) {
 		opause=FCEUI_EmulationPaused();
 		SilenceSound(opause);
 	}
+	pthread_mutex_unlock(&s_emulock);
+
+	if(throttle)
+		while (SpeedThrottle());
+
+	#ifdef CREATE_AVI
+	// the video log needs every frame, so wait for this one to be drawn
+	if(LoggingEnabled == 2)
+		while(FramePending() && !s_emuquit)
+			SDL_Delay(1);
+	#endif
+}
+
+static int s_frameskip, s_periodicsaves;
+
+static void *EmulationThread(void *)
+{
+	while(!s_emuquit)
+	{
+		if(GameInfo)
+			DoFun(s_frameskip, s_periodicsaves);
+		else
+			SDL_Delay(1);
+	}
+	return 0;
+}
+
+/**
+ * Polls input and, with the GUI, handles pending GTK events.  Returns
+ * whether a game is loaded.
+ */
+static bool UpdateMainThread()
+{
+	pthread_mutex_lock(&s_emulock);
+	if(GameInfo)
+		PollInputEvents();
+#ifdef _GTK
+	if(noGui == 0)
+		while(gtk_events_pending())
+			gtk_main_iteration_do(FALSE);
+#endif
+	bool loaded = GameInfo != 0;
+	pthread_mutex_unlock(&s_emulock);
+
+	if(s_printpacing) {
+		s_printpacing = 0;
+		PrintPacingStats(stdout);
+		pthread_mutex_lock(&s_emulock);
+		PrintRunAheadStats(stdout);
+		pthread_mutex_unlock(&s_emulock);
+		fflush(stdout);
+	}
+
+	// draw the newest frame, or wait a little for one to come in
+	if(!PresentFrame())
+		SDL_Delay(1);
+	return loaded;
 }
 
 
@@ -343,10 +468,12 @@ DriverKill()
 }
 
 /**
- * Update the video, audio, and input subsystems with the provided
- * video (XBuf) and audio (Buffer) information.
+ * Update the video and audio subsystems with the provided video (XBuf)
+ * and audio (Buffer) information, and the input for the next frame.
+ * Runs on the emulation thread; the frame is only queued for the main
+ * thread to draw.  Returns whether the caller should throttle.
  */
-void
+int
 FCEUD_Update(uint8 *XBuf,
 			 int32 *Buffer,
 			 int Count)
@@ -358,17 +485,18 @@ FCEUD_Update(uint8 *XBuf,
 	{
 	  if(LoggingEnabled == 2)
 	  {
-		int16* MonoBuf = new int16[Count];
+		static std::vector<int16> MonoBuf;
 		int n;
+		if((int)MonoBuf.size() < Count)
+			MonoBuf.resize(Count);
 		for(n=0; n<Count; ++n)
 			MonoBuf[n] = Buffer[n] & 0xFFFF;
 		NESVideoLoggingAudio
 		 (
-		  MonoBuf, 
+		  &MonoBuf[0], 
 		  FSettings.SndRate, 16, 1,
 		  Count
 		 );
-		delete [] MonoBuf;
 	  }
 	  Count /= 2;
 	  if(inited & 1)
@@ -379,14 +507,15 @@ FCEUD_Update(uint8 *XBuf,
 	  }
 	  if(inited & 2)
 		FCEUD_UpdateInput();
-	  if(XBuf && (inited & 4)) BlitScreen(XBuf);
+	  if(XBuf && (inited & 4)) QueueFrame(XBuf);
 	  
 	  //SpeedThrottle();
-		return;
+		return 0;
 	 }
 	#endif
 	
 	int ocount = Count;
+	int throttle = 0;
 	// apply frame scaling to Count
 	Count = (int)(Count / g_fpsScale);
 	if(Count) {
@@ -407,10 +536,11 @@ FCEUD_Update(uint8 *XBuf,
 
 		//if(uflow) puts("Underflow");
 		tmpcan = GetWriteSound();
+		// skip drawing to catch up when less than a frame of sound is left.
 		// don't underflow when scaling fps
-		if(g_fpsScale>1.0 || ((tmpcan < Count*0.90) && !uflow)) {
+		if(g_fpsScale>1.0 || ((GetMaxSound() - tmpcan >= Count) && !uflow)) {
 			if(XBuf && (inited&4) && !(NoWaiting & 2))
-				BlitScreen(XBuf);
+				QueueFrame(XBuf);
 			Buffer+=can;
 			Count-=can;
 			if(Count) {
@@ -431,6 +561,10 @@ FCEUD_Update(uint8 *XBuf,
 					}
 				}
 			}
+			// the throttle keeps the sound buffer from filling up, so
+			// writing the sound doesn't wait on the sound card
+			if(!NoWaiting && !(eoptions&EO_NOTHROTTLE))
+				throttle = 1;
 		} //else puts("Skipped");
 		else if(!NoWaiting && FCEUDnetplay && (uflow || tmpcan >= (Count * 1.8))) {
 			if(Count > tmpcan) Count=tmpcan;
@@ -446,15 +580,13 @@ FCEUD_Update(uint8 *XBuf,
 
 	} else {
 		if(!NoWaiting && (!(eoptions&EO_NOTHROTTLE) || FCEUI_EmulationPaused()))
-		while (SpeedThrottle())
-		{
-			FCEUD_UpdateInput();
-		}
+			throttle = 1;
 		if(XBuf && (inited&4)) {
-			BlitScreen(XBuf);
+			QueueFrame(XBuf);
 		}
 	}
 	FCEUD_UpdateInput();
+	return throttle;
 	//if(!Count && !NoWaiting && !(eoptions&EO_NOTHROTTLE))
 	// SpeedThrottle();
 	//if(XBuf && (inited&4))
@@ -512,12 +644,26 @@ void FCEUD_DebugBreakpoint() {
 }
 
 /**
- * Unimplemented.
+ * Unused: instruction traces are recorded by the core, see --trace.
  */
 void FCEUD_TraceInstruction() {
 	return;
 }
 
+/**
+ * Reads a --tracestart/--tracestop value: a frame number, or $xxxx for the
+ * address of an instruction.
+ */
+static void ParseTraceCondition(const std::string &when, int *frame, int *pc)
+{
+	if (when.empty())
+		return;
+	if (when[0] == '$')
+		*pc = strtol(when.c_str() + 1, NULL, 16) & 0xFFFF;
+	else
+		*frame = atoi(when.c_str());
+}
+
 
 #ifdef _GTK
 	int noGui = 0;
@@ -531,6 +677,8 @@ void FCEUD_TraceInstruction() {
  */
 int main(int argc, char *argv[])
 {
+	s_mainthread = pthread_self();
+
   // this is a hackish check for the --help arguemnts
   // these are normally processed by the config parser, but SDL_Init
   // must be run before the config parser: so if even SDL_Init fails,
@@ -639,6 +787,26 @@ int main(int argc, char *argv[])
 	}
 
 
+	// build the rom library index and exit, or load it so game loads can skip hashing
+	g_config->getOption("SDL.RomIndex", &s);
+	{
+		std::string scandir;
+		g_config->getOption("SDL.ScanRoms", &scandir);
+		g_config->setOption("SDL.ScanRoms", "");
+		if (!scandir.empty())
+		{
+			int count = FCEUI_ScanRomLibrary(scandir.c_str(), s.c_str(), 0);
+			SDL_Quit();
+			return count < 0 ? -1 : 0;
+		}
+	}
+	if (!s.empty())
+		FCEUI_LoadRomIndex(s.c_str());
+
+	g_config->getOption("SDL.ProfileCSV", &s);
+	if (!s.empty())
+		FCEUI_SetProfileCSV(s.c_str());
+
 	// check for a .fcm file to convert to .fm2
 	g_config->getOption ("SDL.FCMConvert", &s);
 	g_config->setOption ("SDL.FCMConvert", "");
@@ -924,32 +1092,86 @@ int main(int argc, char *argv[])
 	}
 
 	g_config->getOption("SDL.Frameskip", &frameskip);
-	// loop playing the game
-#ifdef _GTK
-	if(noGui == 0)
+	s_frameskip = frameskip;
 	{
-		while(1)
+		int runahead;
+		g_config->getOption("SDL.RunAhead", &runahead);
+		FCEUI_SetRunAhead(runahead);
+	}
+
+	g_config->getOption("SDL.TraceFile", &s);
+	g_config->setOption("SDL.TraceFile", "");
+	if (!s.empty())
+	{
+		FCEU_TRACE_OPTIONS options;
+		std::string when;
+		g_config->getOption("SDL.TraceStart", &when);
+		ParseTraceCondition(when, &options.startframe, &options.startpc);
+		g_config->getOption("SDL.TraceStop", &when);
+		ParseTraceCondition(when, &options.stopframe, &options.stoppc);
+		int ring;
+		g_config->getOption("SDL.TraceRing", &ring);
+		// the count is a uint32, which holds up to 4294 million
+		if (ring > 4294) {
+			FCEUD_PrintError("--tracering is at most 4294, using that.");
+			ring = 4294;
+		}
+		if (ring > 0)
+			options.ring = (uint32)ring * 1000000;
+		FCEUI_TraceStart(s.c_str(), options);
+	}
+
+	g_config->getOption("SDL.HashLog", &s);
+	g_config->setOption("SDL.HashLog", "");
+	if (!s.empty())
+	{
+		std::string names;
+		uint32 parts;
+		g_config->getOption("SDL.HashParts", &names);
+		if (!FCEUI_HashParseParts(names.c_str(), &parts))
 		{
-			if(GameInfo)
-				DoFun(frameskip, periodic_saves);
-			else
-				SDL_Delay(1);
-			while(gtk_events_pending())
-			gtk_main_iteration_do(FALSE);
+			FCEUD_PrintError("Unknown --hashparts, hashing everything");
+			parts = FCEU_HASH_ALL;
 		}
+		FCEUI_HashLogStart(s.c_str(), parts);
 	}
-	else
+
 	{
-		while(GameInfo)
-			DoFun(frameskip, periodic_saves);
+		FCEU_BURST_OPTIONS options;
+		g_config->getOption("SDL.SnapBurst", &options.every);
+		g_config->setOption("SDL.SnapBurst", 0);
+		g_config->getOption("SDL.SnapStart", &options.startframe);
+		g_config->getOption("SDL.SnapStop", &options.stopframe);
+		if (options.every > 0)
+			FCEUI_BurstStart(options);
 	}
-#else
-	while(GameInfo)
+	s_periodicsaves = periodic_saves;
+
+#ifdef SIGUSR1
+	signal(SIGUSR1, PacingSignal);
+#endif
+
+	// play the game on the emulation thread and present it on this one
+	pthread_t emuthread;
+	if(pthread_create(&emuthread, 0, EmulationThread, 0)) {
+		FCEUD_PrintError("Couldn't start the emulation thread");
+		DriverKill();
+		SDL_Quit();
+		return -1;
+	}
+#ifdef _GTK
+	if(noGui == 0)
 	{
-		DoFun(frameskip, periodic_saves);
+		while(1)
+			UpdateMainThread();
 	}
 #endif
+	while(UpdateMainThread());
+
+	s_emuquit = true;
+	pthread_join(emuthread, 0);
 	CloseGame();
+	FCEUI_SetProfileCSV(NULL);
 
 	// exit the infrastructure
 	FCEUI_Kill();
@@ -1002,7 +1224,8 @@ void FCEUD_Message(const char *text)
 void FCEUD_PrintError(const char *errormsg)
 {
 #ifdef GTK
-	if(gtkIsStarted == true && noGui == 0)
+	// GTK may only be used from the main thread
+	if(gtkIsStarted == true && noGui == 0 && pthread_equal(pthread_self(), s_mainthread))
 	{
 		GtkWidget* d;
 		d = gtk_message_dialog_new(GTK_WINDOW(MainWindow), GTK_DIALOG_MODAL, 
@@ -26,7 +26,7 @@ extern bool swapDuty;
 
 int LoadGame(const char *path);
 int CloseGame(void);
-void FCEUD_Update(uint8 *XBuf, int32 *Buffer, int Count);
+int FCEUD_Update(uint8 *XBuf, int32 *Buffer, int Count);
 uint64 FCEUD_GetTime();
 
 #endif
@@ -1,2 +1,26 @@
+#ifndef __FCEU_SDL_THROTTLE_H
+#define __FCEU_SDL_THROTTLE_H
+
+#include <cstdio>
+#include "../../types.h"
+
 void RefreshThrottleFPS();
 int SpeedThrottle(void);
+
+// the frame pacing histogram has 0.1 ms buckets up to 50 ms; the last one
+// also counts anything longer
+#define PACING_BUCKET_NS 100000
+#define PACING_BUCKETS 500
+
+// times in milliseconds
+struct PacingStats
+{
+	uint64 intervals;
+	double mean, stddev, min, max;
+	uint32 histogram[PACING_BUCKETS];
+};
+
+void GetPacingStats(PacingStats *stats);
+void PrintPacingStats(FILE *fp);
+
+#endif
@@ -1024,13 +1024,19 @@ extern "C"
     }
 #endif
 
-    void NESVideoLoggingVideo
+    void NESVideoLoggingVideoRows
         (const void*data, unsigned width,unsigned height,
          unsigned fps_scaled,
-         unsigned bpp
+         unsigned bpp,
+         const unsigned* rows
         )
     {
-        if(LoggingEnabled < 2) return;
+        /* The converted frame is kept, so only the changed rows of the next
+         * one need converting. It goes stale while nothing is logged. */
+        static std::vector<unsigned char> VideoBuf;
+        static bool VideoBufKept = false;
+        
+        if(LoggingEnabled < 2) { VideoBufKept = false; return; }
         
         ++CurrentFrameNumber;
         
@@ -1042,12 +1048,24 @@ extern "C"
         {
             bpp = 24;
             
-            static std::vector<unsigned char> VideoBuf;
-            VideoBuf.resize(width*height * 3);
+            if(VideoBuf.size() != width*height * 3)
+            {
+                VideoBuf.resize(width*height * 3);
+                VideoBufKept = false;
+            }
             
-            Convert32To24Frame(data, &VideoBuf[0], width*height);
+            if(!rows || !VideoBufKept)
+                Convert32To24Frame(data, &VideoBuf[0], width*height);
+            else
+                for(unsigned y=0; y<height; ++y)
+                    if((rows[y >> 5] >> (y & 31)) & 1)
+                        Convert32To24Frame((const unsigned char*)data + y*width*4,
+                                           &VideoBuf[y*width*3], width);
+            VideoBufKept = true;
             data = (void*)&VideoBuf[0];
         }
+        else
+            VideoBufKept = false;
         
         if(bpp) INPUT_BPP = bpp;
         
@@ -1199,6 +1217,15 @@ extern "C"
         GetAVIptr().Video(width,height,fps_scaled,  (const unsigned char*) data);
     }
 
+    void NESVideoLoggingVideo
+        (const void*data, unsigned width,unsigned height,
+         unsigned fps_scaled,
+         unsigned bpp
+        )
+    {
+        NESVideoLoggingVideoRows(data, width, height, fps_scaled, bpp, 0);
+    }
+
     void NESVideoLoggingAudio
         (const void*data,
          unsigned rate, unsigned bits, unsigned chans,
@@ -22,6 +22,14 @@ extern void NESVideoLoggingVideo
      unsigned fps_scaled,
      unsigned bpp); 
 
+/* Same, but only the rows with their bit set in rows (bit y%32 of rows[y/32])
+ * changed since the last frame. rows may be NULL, meaning all of them. */
+extern void NESVideoLoggingVideoRows
+    (const void*data, unsigned width, unsigned height,
+     unsigned fps_scaled,
+     unsigned bpp,
+     const unsigned* rows);
+
 /* Save N bytes of audio. bytes_per_second is required on the first call. */ 
 /* Does not do anything if LoggingEnabled<2. */ 
 /* The interval of calling this function is not important, as long as all the audio
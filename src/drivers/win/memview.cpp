@@ -27,6 +27,7 @@
 #include "../../cheat.h"
 #include "../../cart.h"
 #include "../../ines.h"
+#include "../../state.h"
 #include "memview.h"
 #include "debugger.h"
 #include "cdlogger.h"
@@ -976,6 +977,7 @@ void InputData(char *input){
 				vnapage[(addr>>10)&0x3][addr&0x3FF] = data[i]; //todo: this causes 0x3000-0x3f00 to mirror 0x2000-0x2f00, is this correct?
 			if((addr >= 0x3F00) && (addr < 0x3FFF))
 				PALRAM[addr&0x1F] = data[i];
+			StateHashDirty |= FCEU_HASH_PPU;
 		} else if (EditingMode == MODE_NES_FILE)
 		{
 			// ROM
@@ -43,6 +43,10 @@
 #include "file.h"
 #include "vsuni.h"
 #include "ines.h"
+#include "profile.h"
+#include "runahead.h"
+#include "trace.h"
+#include "snapshot.h"
 #ifdef WIN32
 #include "drivers/win/pref.h"
 #include "utils/xstring.h"
@@ -193,6 +197,10 @@ static void FCEU_CloseGame(void)
 		GameInterface(GI_CLOSE);
 
 		FCEUI_StopMovie();
+		FCEUI_TraceStop();
+		FCEUI_HashLogStop();
+		FCEUI_BurstStop();
+		FCEU_SnapshotFlush();
 
 		ResetExState(0, 0);
 
@@ -359,6 +367,7 @@ uint8 PAL = 0;
 
 static DECLFW(BRAML) {
 	RAM[A] = V;
+	StateHashDirty |= FCEU_HASH_RAM;
 	#ifdef _S9XLUA_H
 	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
 	#endif
@@ -366,6 +375,7 @@ static DECLFW(BRAML) {
 
 static DECLFW(BRAMH) {
 	RAM[A & 0x7FF] = V;
+	StateHashDirty |= FCEU_HASH_RAM;
 	#ifdef _S9XLUA_H
 	CallRegisteredLuaMemHook(A & 0x7FF, 1, V, LUAMEMHOOK_WRITE);
 	#endif
@@ -689,6 +699,8 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		}
 	}
 
+	FCEU_PROFILE_FRAME();
+
 	AutoFire();
 	UpdateAutosave();
 
@@ -697,12 +709,19 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 #endif
 
 	FCEU_UpdateInput();
+	FCEU_TraceFrame();
 	lagFlag = 1;
 
+	//frames a burst captures are drawn whatever the frameskip
+	if (skip && FCEU_BurstWants())
+		skip = 0;
+
 #ifdef _S9XLUA_H
 	CallRegisteredLuaFunctions(LUACALL_BEFOREEMULATION);
 #endif
 
+	bool runahead = !skip && FCEU_RunAheadBegin();
+
 	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
 	r = FCEUPPU_Loop(skip);
 
@@ -728,6 +747,9 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 	timestampbase += timestamp;
 	timestamp = 0;
 
+	if (runahead) FCEU_RunAheadEnd();
+	FCEU_HashLogFrame();
+
 	*pXBuf = skip ? 0 : XBuf;
 	if (skip == 2) { //If skip = 2, then bypass sound
 		*SoundBuf = 0;
@@ -769,6 +791,7 @@ void ResetNES(void) {
 	FCEUMOV_AddCommand(FCEUNPCMD_RESET);
 	if (!GameInfo) return;
 	GameInterface(GI_RESETM2);
+	StateHashDirty = ~0U;
 	FCEUSND_Reset();
 	FCEUPPU_Reset();
 	X6502_Reset();
@@ -776,6 +799,7 @@ void ResetNES(void) {
 	// clear back baffer
 	extern uint8 *XBackBuf;
 	memset(XBackBuf, 0, 256 * 256);
+	FCEU_InvalidateImage();
 
 	FCEU_DispMessage("Reset", 0);
 }
@@ -808,6 +832,7 @@ void PowerNES(void) {
 	FCEU_CheatAddRAM(2, 0, RAM);
 
 	FCEU_GeniePower();
+	StateHashDirty = ~0U;
 
 	//dont do this, it breaks some games: Cybernoid; Minna no Taabou no Nakayoshi Daisakusen; and maybe mechanized attack
 	//memset(RAM,0xFF,0x800);
@@ -848,9 +873,11 @@ void PowerNES(void) {
 #endif
 	FCEU_PowerCheats();
 	LagCounterReset();
-	// clear back buffer
+	// clear back buffer and the last frame, so nothing from a previous game shows through
 	extern uint8 *XBackBuf;
 	memset(XBackBuf, 0, 256 * 256);
+	memset(XBuf, 0, 256 * 256);
+	FCEU_InvalidateImage();
 
 #ifdef WIN32
 	Update_RAM_Search(); // Update_RAM_Watch() is also called.
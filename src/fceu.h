@@ -114,6 +114,7 @@ typedef struct {
 	uint32 SndRate;
 	int soundq;
 	int lowpass;
+	int stepsynth;
 } FCEUS;
 
 int FCEU_TextScanlineOffset(int y);
@@ -135,6 +136,8 @@ void FCEU_PutImage(void);
 #ifdef FRAMESKIP
 void FCEU_PutImageDummy(void);
 #endif
+//while held, both of the above do nothing; run-ahead holds the picture of frames it throws away
+void FCEU_HoldImage(bool hold);
 
 #ifdef WIN32
 extern void UpdateCheckedMenuItems();
@@ -28,6 +28,8 @@ enum LuaMemHookType
 	LUAMEMHOOK_COUNT
 };
 void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
+//whether any write or exec hook is registered; the cpu core skips the hook calls otherwise
+int FCEU_LuaMemHooksActive();
 
 struct LuaSaveData
 {
@@ -319,7 +319,7 @@ static DECLFR(FDSSRead) {
 }
 
 static DECLFW(FDSSWrite) {
-	if (FSettings.SndRate) {
+	if (FSettings.SndRate && !SoundSuspended) {
 		if (FSettings.soundq >= 1)
 			RenderSoundHQ();
 		else
@@ -662,14 +662,14 @@ int FDSLoad(const char *name, FCEUFILE *fp) {
 		free(FDSBIOS);
 	FDSBIOS = NULL;
 	if(FDSRAM)
-		free(FDSRAM);
+		FCEU_gfree(FDSRAM);
 	FDSRAM = NULL;
 	if(CHRRAM)
-		free(CHRRAM);
+		FCEU_gfree(CHRRAM);
 	CHRRAM = NULL;
 
 	FDSBIOSsize = 8192;
-	FDSBIOS = (uint8*)FCEU_gmalloc(FDSBIOSsize);
+	FDSBIOS = (uint8*)FCEU_malloc(FDSBIOSsize);
 	SetupCartPRGMapping(0, FDSBIOS, FDSBIOSsize, 0);
 
 	if (fread(FDSBIOS, 1, FDSBIOSsize, zp) != FDSBIOSsize) {
@@ -802,10 +802,10 @@ void FDSClose(void) {
 		free(FDSBIOS);
 	FDSBIOS = NULL;
 	if(FDSRAM)
-		free(FDSRAM);
+		FCEU_gfree(FDSRAM);
 	FDSRAM = NULL;
 	if(CHRRAM)
-		free(CHRRAM);
+		FCEU_gfree(CHRRAM);
 	CHRRAM = NULL;
 	fclose(fp);
 }
@@ -44,9 +44,11 @@
 #include "movie.h"
 #include "driver.h"
 #include "utils/xstring.h"
+#include "romindex.h"
 
 #ifndef WIN32
 #include <zlib.h>
+#include <sys/mman.h>
 #endif
 
 using namespace std;
@@ -141,6 +143,7 @@ void ApplyIPS(FILE *ips, FCEUFILE* fp)
 	}
 	FCEU_printf(" Hard IPS end!\n");
 end:
+	fp->patched = count != 0;
 	fclose(ips);
 	EMUFILE_MEMORY* ms = new EMUFILE_MEMORY(buf,fp->size);
 	fp->SetStream(ms);
@@ -192,7 +195,14 @@ static FCEUFILE * TryUnzip(const std::string& path) {
 		// Assuming file type by extension usually works,
 		// but I don't like it. :)
 	{
-		if(unzGoToFirstFile(tz)==UNZ_OK)
+		//the rom library index remembers which member the scan below picks, so try to go straight to it
+		const ROMINDEX_ENTRY *indexed = FCEU_RomIndexFind(path.c_str());
+		if(indexed && indexed->member != "" && unzLocateFile(tz,indexed->member.c_str(),1)==UNZ_OK)
+		{
+			if(unzOpenCurrentFile(tz)!=UNZ_OK)
+				goto zpfail;
+		}
+		else if(unzGoToFirstFile(tz)==UNZ_OK)
 		{
 			for(;;)
 			{
@@ -434,6 +444,38 @@ int FCEU_fisarchive(FCEUFILE *fp)
 	else return 1;
 }
 
+///maps the whole of a plain file (not archived, not gzipped, no ips applied) into memory.
+///the view is private and copy-on-write, so writes through it never reach the disk and only cost the pages they touch.
+///returns NULL when the file can't be mapped; callers should fall back to FCEU_fread
+uint8 *FCEU_fmap(FCEUFILE *fp, uint32 *size)
+{
+#ifndef WIN32
+	if(fp->isArchive()) return 0;
+	EMUFILE_FILE* ef = dynamic_cast<EMUFILE_FILE*>(fp->stream);
+	if(!ef || !ef->get_fp()) return 0;
+
+	struct stat st;
+	int fd = fileno(ef->get_fp());
+	if(fstat(fd,&st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0 || st.st_size > INT_MAX)
+		return 0;
+
+	void *ret = mmap(0, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(ret == MAP_FAILED) return 0;
+	*size = (uint32)st.st_size;
+	return (uint8*)ret;
+#else
+	return 0;
+#endif
+}
+
+///releases a view returned by FCEU_fmap
+void FCEU_funmap(uint8 *ptr, uint32 size)
+{
+#ifndef WIN32
+	if(ptr) munmap(ptr, size);
+#endif
+}
+
 std::string GetMfn() //Retrieves the movie filename from curMovieFilename (for adding to savestate and auto-save files)
 {
 	std::string movieFilenamePart;
@@ -672,6 +714,12 @@ std::string FCEU_MakeFName(int type, int id1, const char *cd1)
 			else
 				sprintf(ret,"%s" PSS "snaps" PSS "%s-%d.%s",BaseDirectory.c_str(),FileBase,id1,cd1);
 			break;
+		case FCEUMKF_BURST:
+			if(odirs[FCEUIOD_SNAPS])
+				sprintf(ret,"%s" PSS "%s-burst-%06d.%s",odirs[FCEUIOD_SNAPS],FileBase,id1,cd1);
+			else
+				sprintf(ret,"%s" PSS "snaps" PSS "%s-burst-%06d.%s",BaseDirectory.c_str(),FileBase,id1,cd1);
+			break;
 		case FCEUMKF_FDS:
 			if(odirs[FCEUIOD_NV])
 				sprintf(ret,"%s" PSS "%s.fds",odirs[FCEUIOD_NV],FileBase);
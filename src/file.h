@@ -37,12 +37,16 @@ struct FCEUFILE {
 	//the size of the file
 	int size;
 
+	//whether an ips patch was applied when the file was opened, so the contents no longer match the file on disk
+	bool patched;
+
 	//whether the file is contained in an archive
 	bool isArchive() { return archiveCount > 0; }
 
 	FCEUFILE()
 		: stream(0)
 		, archiveCount(-1)
+		, patched(false)
 	{}
 
 	~FCEUFILE()
@@ -134,6 +138,8 @@ int FCEU_read16le(uint16 *Bufo, FCEUFILE*);
 int FCEU_fgetc(FCEUFILE*);
 uint64 FCEU_fgetsize(FCEUFILE*);
 int FCEU_fisarchive(FCEUFILE*);
+uint8 *FCEU_fmap(FCEUFILE*, uint32 *size);
+void FCEU_funmap(uint8 *ptr, uint32 size);
 
 
 
@@ -167,4 +173,5 @@ void FCEU_SplitArchiveFilename(std::string src, std::string& archive, std::strin
 #define FCEUMKF_AVI			 21
 #define FCEUMKF_TASEDITOR    22
 #define FCEUMKF_RESUMESTATE  23
+#define FCEUMKF_BURST        24
 #endif
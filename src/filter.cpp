@@ -19,6 +19,9 @@ static int32 coeffs[NCOEFFS];
 static uint32 mrindex;
 static uint32 mrratio;
 
+//filter state, cleared along with the resampler so a power cycle always sounds the same
+static int64 sexyacc1, sexyacc2, sexy2acc;
+
 void SexyFilter2(int32 *in, int32 count)
 {
  #ifdef moo
@@ -32,7 +35,7 @@ void SexyFilter2(int32 *in, int32 count)
  c=p*0x100000;
  //printf("%f\n",(double)c/0x100000);
  #endif
- static int64 acc=0;
+ int64 &acc=sexy2acc;
 
  while(count--)
  {
@@ -50,7 +53,7 @@ void SexyFilter2(int32 *in, int32 count)
 
 void SexyFilter(int32 *in, int32 *out, int32 count)
 {
- static int64 acc1=0,acc2=0;
+ int64 &acc1=sexyacc1, &acc2=sexyacc2;
  int32 mul1,mul2,vmul;
 
  mul1=(94<<16)/FSettings.SndRate;
@@ -156,13 +159,46 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
          *leftover=NCOEFFS+1;
 	}
 
+	PostFilterSound(outsave,count);
+	return(count);
+}
+
+/* The rest of the high quality chain, once the sound is at the output rate. */
+void PostFilterSound(int32 *out, int32 count)
+{
 	if(GameExpSound.NeoFill)
-	 GameExpSound.NeoFill(outsave,count);
+	 GameExpSound.NeoFill(out,count);
 
-	SexyFilter(outsave,outsave,count);
+	SexyFilter(out,out,count);
 	if(FSettings.lowpass)
-	 SexyFilter2(outsave,count);
-	return(count);
+	 SexyFilter2(out,count);
+}
+
+/* Describes the filter NeoFilterSound runs: its length, what it multiplies a constant input by
+   (16.16 fixed point), and where it is down by 6dB, as a fraction of the output rate.
+*/
+void NeoFilterResponse(int32 *taps, int32 *gain, double *cutoff)
+{
+	const int32 *c=FSettings.soundq==2?sq2coeffs:coeffs;
+	int32 n=FSettings.soundq==2?SQ2NCOEFFS:NCOEFFS;
+	int64 sum=0;
+	int32 x;
+
+	for(x=0;x<n;x++)
+	 sum+=c[x];
+	*taps=n;
+	*gain=(int32)(sum>>1);
+
+	double lo=0,hi=0.5;
+	for(int i=0;i<24;i++)
+	{
+	 double f=(lo+hi)/2,h=0;
+	 for(x=0;x<n;x++)
+	  h+=c[x]*cos(2*M_PI*f*65536/mrratio*(x-(n-1)/2.0));
+	 if(h>sum/2) lo=f;
+	 else hi=f;
+	}
+	*cutoff=lo;
 }
 
 void MakeFilters(int32 rate)
@@ -182,6 +218,7 @@ void MakeFilters(int32 rate)
   nco=NCOEFFS;
 
  mrindex=(nco+1)<<16;
+ sexyacc1=sexyacc2=sexy2acc=0;
  mrratio=(PAL?(int64)(PAL_CPU*65536):(int64)(NTSC_CPU*65536))/rate;
 
  if(FSettings.soundq==2)
@@ -1,3 +1,5 @@
 int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover);
 void MakeFilters(int32 rate);
 void SexyFilter(int32 *in, int32 *out, int32 count);
+void PostFilterSound(int32 *out, int32 count);
+void NeoFilterResponse(int32 *taps, int32 *gain, double *cutoff);
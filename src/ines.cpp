@@ -37,10 +37,12 @@
 #include "cheat.h"
 #include "vsuni.h"
 #include "driver.h"
+#include "romindex.h"
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 
 extern SFORMAT FCEUVSUNI_STATEINFO[];
 
@@ -65,6 +67,20 @@ static int MapperNo = 0;
 
 static int iNES2 = 0;
 
+//when the image could be mapped straight from disk, ROM and VROM point into this view instead of owning heap copies
+static uint8 *ROMMap = NULL;
+static uint32 ROMMapSize = 0;
+
+static bool iNES_IsMapped(uint8 *ptr) {
+	return ROMMap && ptr >= ROMMap && ptr < ROMMap + ROMMapSize;
+}
+
+static void iNES_FreeVROM() {
+	if (!iNES_IsMapped(VROM))
+		FCEU_gfree(VROM);
+	VROM = NULL;
+}
+
 static DECLFR(TrainerRead) {
 	return(trainerpoo[A & 0x1FF]);
 }
@@ -106,20 +122,24 @@ void iNESGI(GI h) { //bbit edited: removed static keyword
 		FCEU_SaveGameSave(&iNESCart);
 		if (iNESCart.Close)
 			iNESCart.Close();
+		if (VROM)
+			iNES_FreeVROM();
 		if (ROM) {
-			free(ROM);
+			if (!iNES_IsMapped(ROM))
+				free(ROM);
 			ROM = NULL;
 		}
-		if (VROM) {
-			free(VROM);
-			VROM = NULL;
+		if (ROMMap) {
+			FCEU_funmap(ROMMap, ROMMapSize);
+			ROMMap = NULL;
+			ROMMapSize = 0;
 		}
 		if (trainerpoo) {
 			free(trainerpoo);
 			trainerpoo = NULL;
 		}
 		if (ExtraNTARAM) {
-			free(ExtraNTARAM);
+			FCEU_gfree(ExtraNTARAM);
 			ExtraNTARAM = NULL;
 		}
 	}
@@ -141,90 +161,77 @@ struct INPSEL {
 	ESIFC inputfc;
 };
 
-static void SetInput(void) {
-	static struct INPSEL moo[] =
-	{
-		{0x19b0a9f1,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// 6-in-1 (MGC-023)(Unl)[!]
-		{0x29de87af,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Aerobics Studio
-		{0xd89e5a67,	SI_UNSET,		SI_UNSET,		SIFC_ARKANOID	},	// Arkanoid (J)
-		{0x0f141525,	SI_UNSET,		SI_UNSET,		SIFC_ARKANOID	},	// Arkanoid 2(J)
-		{0x32fb0583,	SI_UNSET,		SI_ARKANOID,	SIFC_NONE		},	// Arkanoid(NES)
-		{0x60ad090a,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Athletic World
-		{0x48ca0ee1,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_BWORLD		},	// Barcode World
-		{0x4318a2f8,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Barker Bill's Trick Shooting
-		{0x6cca1c1f,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Dai Undoukai
-		{0x24598791,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Duck Hunt
-		{0xd5d6eac4,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Edu (As)
-		{0xe9a7fe9e,	SI_UNSET,		SI_MOUSE,		SIFC_NONE		},	// Educational Computer 2000
-		{0x8f7b1669,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// FP BASIC 3.3 by maxzhou88
-		{0xf7606810,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Family BASIC 2.0A
-		{0x895037bc,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Family BASIC 2.1a
-		{0xb2530afc,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Family BASIC 3.0
-		{0xea90f3e2,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Family Trainer:  Running Stadium
-		{0xbba58be5,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Family Trainer: Manhattan Police
-		{0x3e58a87e,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Freedom Force
-		{0xd9f45be9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_QUIZKING	},	// Gimme a Break ...
-		{0x1545bd13,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_QUIZKING	},	// Gimme a Break ... 2
-		{0x4e959173,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Gotcha! - The Sport!
-		{0xbeb8ab01,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Gumshoe
-		{0xff24d794,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Hogan's Alley
-		{0x21f85681,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_HYPERSHOT	},	// Hyper Olympic (Gentei Ban)
-		{0x980be936,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_HYPERSHOT	},	// Hyper Olympic
-		{0x915a53a7,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_HYPERSHOT	},	// Hyper Sports
-		{0x9fae4d46,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_MAHJONG	},	// Ide Yousuke Meijin no Jissen Mahjong
-		{0x7b44fb2a,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_MAHJONG	},	// Ide Yousuke Meijin no Jissen Mahjong 2
-		{0x2f128512,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Jogging Race
-		{0xbb33196f,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Keyboard Transformer
-		{0x8587ee00,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Keyboard Transformer
-		{0x543ab532,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// LIKO Color Lines
-		{0x368c19a8,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// LIKO Study Cartridge
-		{0x5ee6008e,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Mechanized Attack
-		{0x370ceb65,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Meiro Dai Sakusen
-		{0x3a1694f9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_4PLAYER	},	// Nekketsu Kakutou Densetsu
-		{0x9d048ea4,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_OEKAKIDS	},	// Oeka Kids
-		{0x2a6559a1,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Operation Wolf (J)
-		{0xedc3662b,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Operation Wolf
-		{0x912989dc,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Playbox BASIC
-		{0x9044550e,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Rairai Kyonshizu
-		{0xea90f3e2,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Running Stadium
-		{0x851eb9be,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// Shooting Range
-		{0x6435c095,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// Short Order/Eggsplode
-		{0xc043a8df,	SI_UNSET,		SI_MOUSE,		SIFC_NONE		},	// Shu Qi Yu - Shu Xue Xiao Zhuan Yuan (Ch)
-		{0x2cf5db05,	SI_UNSET,		SI_MOUSE,		SIFC_NONE		},	// Shu Qi Yu - Zhi Li Xiao Zhuan Yuan (Ch)
-		{0xad9c63e2,	SI_GAMEPAD,		SI_UNSET,		SIFC_SHADOW		},	// Space Shadow
-		{0x61d86167,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// Street Cop
-		{0xabb2f974,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Study and Game 32-in-1
-		{0x41ef9ac4,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Subor
-		{0x8b265862,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Subor
-		{0x82f1fb96,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Subor 1.0 Russian
-		{0x9f8f200a,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Super Mogura Tataki!! - Pokkun Moguraa
-		{0xd74b2719,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// Super Team Games
-		{0x74bea652,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// Supergun 3-in-1
-		{0x5e073a1b,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Supor English (Chinese)
-		{0x589b6b0d,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// SuporV20
-		{0x41401c6d,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// SuporV40
-		{0x23d17f5e,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// The Lone Ranger
-		{0xc3c0811d,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_OEKAKIDS	},	// The two "Oeka Kids" games
-		{0xde8fd935,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// To the Earth
-		{0x47232739,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_TOPRIDER	},	// Top Rider
-		{0x8a12a7d9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Totsugeki Fuuun Takeshi Jou
-		{0xb8b9aca3,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Wild Gunman
-		{0x5112dc21,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Wild Gunman
-		{0xaf4010ea,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// World Class Track Meet
-		{0x00000000,	SI_UNSET,		SI_UNSET,		SIFC_UNSET		}
-	};
-	int x = 0;
-
-	while (moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0) {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			GameInfo->input[0] = moo[x].input1;
-			GameInfo->input[1] = moo[x].input2;
-			GameInfo->inputfc = moo[x].inputfc;
-			break;
-		}
-		x++;
-	}
-}
+static struct INPSEL InputDB[] =
+{
+	{0x19b0a9f1,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// 6-in-1 (MGC-023)(Unl)[!]
+	{0x29de87af,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Aerobics Studio
+	{0xd89e5a67,	SI_UNSET,		SI_UNSET,		SIFC_ARKANOID	},	// Arkanoid (J)
+	{0x0f141525,	SI_UNSET,		SI_UNSET,		SIFC_ARKANOID	},	// Arkanoid 2(J)
+	{0x32fb0583,	SI_UNSET,		SI_ARKANOID,	SIFC_NONE		},	// Arkanoid(NES)
+	{0x60ad090a,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Athletic World
+	{0x48ca0ee1,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_BWORLD		},	// Barcode World
+	{0x4318a2f8,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Barker Bill's Trick Shooting
+	{0x6cca1c1f,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Dai Undoukai
+	{0x24598791,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Duck Hunt
+	{0xd5d6eac4,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Edu (As)
+	{0xe9a7fe9e,	SI_UNSET,		SI_MOUSE,		SIFC_NONE		},	// Educational Computer 2000
+	{0x8f7b1669,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// FP BASIC 3.3 by maxzhou88
+	{0xf7606810,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Family BASIC 2.0A
+	{0x895037bc,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Family BASIC 2.1a
+	{0xb2530afc,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Family BASIC 3.0
+	{0xea90f3e2,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Family Trainer:  Running Stadium
+	{0xbba58be5,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Family Trainer: Manhattan Police
+	{0x3e58a87e,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Freedom Force
+	{0xd9f45be9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_QUIZKING	},	// Gimme a Break ...
+	{0x1545bd13,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_QUIZKING	},	// Gimme a Break ... 2
+	{0x4e959173,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Gotcha! - The Sport!
+	{0xbeb8ab01,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Gumshoe
+	{0xff24d794,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Hogan's Alley
+	{0x21f85681,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_HYPERSHOT	},	// Hyper Olympic (Gentei Ban)
+	{0x980be936,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_HYPERSHOT	},	// Hyper Olympic
+	{0x915a53a7,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_HYPERSHOT	},	// Hyper Sports
+	{0x9fae4d46,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_MAHJONG	},	// Ide Yousuke Meijin no Jissen Mahjong
+	{0x7b44fb2a,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_MAHJONG	},	// Ide Yousuke Meijin no Jissen Mahjong 2
+	{0x2f128512,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Jogging Race
+	{0xbb33196f,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Keyboard Transformer
+	{0x8587ee00,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Keyboard Transformer
+	{0x543ab532,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// LIKO Color Lines
+	{0x368c19a8,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// LIKO Study Cartridge
+	{0x5ee6008e,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Mechanized Attack
+	{0x370ceb65,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Meiro Dai Sakusen
+	{0x3a1694f9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_4PLAYER	},	// Nekketsu Kakutou Densetsu
+	{0x9d048ea4,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_OEKAKIDS	},	// Oeka Kids
+	{0x2a6559a1,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Operation Wolf (J)
+	{0xedc3662b,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Operation Wolf
+	{0x912989dc,	SI_UNSET,		SI_UNSET,		SIFC_FKB		},	// Playbox BASIC
+	{0x9044550e,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Rairai Kyonshizu
+	{0xea90f3e2,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Running Stadium
+	{0x851eb9be,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// Shooting Range
+	{0x6435c095,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// Short Order/Eggsplode
+	{0xc043a8df,	SI_UNSET,		SI_MOUSE,		SIFC_NONE		},	// Shu Qi Yu - Shu Xue Xiao Zhuan Yuan (Ch)
+	{0x2cf5db05,	SI_UNSET,		SI_MOUSE,		SIFC_NONE		},	// Shu Qi Yu - Zhi Li Xiao Zhuan Yuan (Ch)
+	{0xad9c63e2,	SI_GAMEPAD,		SI_UNSET,		SIFC_SHADOW		},	// Space Shadow
+	{0x61d86167,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// Street Cop
+	{0xabb2f974,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Study and Game 32-in-1
+	{0x41ef9ac4,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Subor
+	{0x8b265862,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Subor
+	{0x82f1fb96,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Subor 1.0 Russian
+	{0x9f8f200a,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERA	},	// Super Mogura Tataki!! - Pokkun Moguraa
+	{0xd74b2719,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// Super Team Games
+	{0x74bea652,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// Supergun 3-in-1
+	{0x5e073a1b,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// Supor English (Chinese)
+	{0x589b6b0d,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// SuporV20
+	{0x41401c6d,	SI_UNSET,		SI_UNSET,		SIFC_SUBORKB	},	// SuporV40
+	{0x23d17f5e,	SI_GAMEPAD,		SI_ZAPPER,		SIFC_NONE		},	// The Lone Ranger
+	{0xc3c0811d,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_OEKAKIDS	},	// The two "Oeka Kids" games
+	{0xde8fd935,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// To the Earth
+	{0x47232739,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_TOPRIDER	},	// Top Rider
+	{0x8a12a7d9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FTRAINERB	},	// Totsugeki Fuuun Takeshi Jou
+	{0xb8b9aca3,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Wild Gunman
+	{0x5112dc21,	SI_UNSET,		SI_ZAPPER,		SIFC_NONE		},	// Wild Gunman
+	{0xaf4010ea,	SI_GAMEPAD,		SI_POWERPADB,	SIFC_UNSET		},	// World Class Track Meet
+	{0x00000000,	SI_UNSET,		SI_UNSET,		SIFC_UNSET		}
+};
 
 #define INESB_INCOMPLETE  1
 #define INESB_CORRUPT     2
@@ -241,18 +248,6 @@ static struct BADINF BadROMImages[] =
 	#include "ines-bad.h"
 };
 
-void CheckBad(uint64 md5partial) {
-	int32 x = 0;
-	while (BadROMImages[x].name) {
-		if (BadROMImages[x].md5partial == md5partial) {
-			FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", BadROMImages[x].name);
-			return;
-		}
-		x++;
-	}
-}
-
-
 struct CHINF {
 	uint32 crc32;
 	int32 mapper;
@@ -274,56 +269,175 @@ static const TMasterRomInfo sMasterRomInfo[] = {
 const TMasterRomInfo* MasterRomInfo;
 TMasterRomInfoParams MasterRomInfoParams;
 
-static void CheckHInfo(void) {
-	/* ROM images that have the battery-backed bit set in the header that really
-	don't have battery-backed RAM is not that big of a problem, so I'll
-	treat this differently by only listing games that should have battery-backed RAM.
+/* ROM images that have the battery-backed bit set in the header that really
+don't have battery-backed RAM is not that big of a problem, so I'll
+treat this differently by only listing games that should have battery-backed RAM.
+
+Lower 64 bits of the MD5 hash.
+*/
+
+static uint64 BatteryDB[] =
+{
+	0xc04361e499748382LL,	/* AD&D Heroes of the Lance */
+	0xb72ee2337ced5792LL,	/* AD&D Hillsfar */
+	0x2b7103b7a27bd72fLL,	/* AD&D Pool of Radiance */
+	0x498c10dc463cfe95LL,	/* Battle Fleet */
+	0x854d7947a3177f57LL,	/* Crystalis */
+	0x4a1f5336b86851b6LL,	/* DW */
+	0xb0bcc02c843c1b79LL,	/* DW */
+	0x2dcf3a98c7937c22LL,	/* DW 2 */
+	0x98e55e09dfcc7533LL,	/* DW 4*/
+	0x733026b6b72f2470LL,	/* Dw 3 */
+	0x6917ffcaca2d8466LL,	/* Famista '90 */
+	0x8da46db592a1fcf4LL,	/* Faria */
+	0xedba17a2c4608d20LL,	/* Final Fantasy */
+	0x91a6846d3202e3d6LL,	/* Final Fantasy */
+	0x012df596e2b31174LL,	/* Final Fantasy 1+2 */
+	0xf6b359a720549ecdLL,	/* Final Fantasy 2 */
+	0x5a30da1d9b4af35dLL,	/* Final Fantasy 3 */
+	0xd63dcc68c2b20adcLL,	/* Final Fantasy J */
+	0x2ee3417ba8b69706LL,	/* Hydlide 3*/
+	0xebbce5a54cf3ecc0LL,	/* Justbreed */
+	0x6a858da551ba239eLL,	/* Kaijuu Monogatari */
+	0x2db8f5d16c10b925LL,	/* Kyonshiizu 2 */
+	0x04a31647de80fdabLL,	/* Legend of Zelda */
+	0x94b9484862a26cbaLL,	/* Legend of Zelda */
+	0xa40666740b7d22feLL,	/* Mindseeker */
+	0x82000965f04a71bbLL,	/* Mirai Shinwa Jarvas */
+	0x77b811b2760104b9LL,	/* Mouryou Senki Madara */
+	0x11b69122efe86e8cLL,	/* RPG Jinsei Game */
+	0x9aa1dc16c05e7de5LL,	/* Startropics */
+	0x1b084107d0878bd0LL,	/* Startropics 2*/
+	0xa70b495314f4d075LL,	/* Ys 3 */
+	0x836c0ff4f3e06e45LL,	/* Zelda 2 */
+	0						/* Abandon all hope if the game has 0 in the lower 64-bits of its MD5 hash */
+};
+
+static struct CHINF HeaderFixDB[] =
+{
+	#include "ines-correct.h"
+};
+
+template<typename T> static bool iNES_CRCLess(const T &a, const T &b) {
+	return a.crc32 < b.crc32;
+}
+
+static bool iNES_MD5Less(const BADINF &a, const BADINF &b) {
+	return a.md5partial < b.md5partial;
+}
+
+//the tables above are kept in the order they were written (grouped by game) but are searched sorted.
+//stable sorts keep the first listed entry winning when a hash appears twice, same as the old linear scans.
+static struct iNESDBSorter {
+	iNESDBSorter() {
+		std::stable_sort(InputDB, InputDB + ARRAY_SIZE(InputDB) - 1, iNES_CRCLess<INPSEL>);
+		std::stable_sort(BadROMImages, BadROMImages + ARRAY_SIZE(BadROMImages) - 1, iNES_MD5Less);
+		std::stable_sort(HeaderFixDB, HeaderFixDB + ARRAY_SIZE(HeaderFixDB) - 1, iNES_CRCLess<CHINF>);
+		std::sort(BatteryDB, BatteryDB + ARRAY_SIZE(BatteryDB) - 1);
+	}
+} s_iNESDBSorter;
+
+static const INPSEL* iNES_FindInput(uint32 crc32) {
+	INPSEL *end = InputDB + ARRAY_SIZE(InputDB) - 1, key;
+	key.crc32 = crc32;
+	INPSEL *it = std::lower_bound(InputDB, end, key, iNES_CRCLess<INPSEL>);
+	return (it != end && it->crc32 == crc32) ? it : NULL;
+}
+
+static const BADINF* iNES_FindBad(uint64 md5partial) {
+	BADINF *end = BadROMImages + ARRAY_SIZE(BadROMImages) - 1, key;
+	key.md5partial = md5partial;
+	BADINF *it = std::lower_bound(BadROMImages, end, key, iNES_MD5Less);
+	return (it != end && it->md5partial == md5partial) ? it : NULL;
+}
+
+static const CHINF* iNES_FindHeaderFix(uint32 crc32) {
+	CHINF *end = HeaderFixDB + ARRAY_SIZE(HeaderFixDB) - 1, key;
+	key.crc32 = crc32;
+	CHINF *it = std::lower_bound(HeaderFixDB, end, key, iNES_CRCLess<CHINF>);
+	return (it != end && it->crc32 == crc32) ? it : NULL;
+}
+
+static bool iNES_NeedsBattery(uint64 md5partial) {
+	uint64 *end = BatteryDB + ARRAY_SIZE(BatteryDB) - 1;
+	return std::binary_search(BatteryDB, end, md5partial);
+}
+
+static void SetInput(void) {
+	const INPSEL *inp = iNES_FindInput(iNESGameCRC32);
+	if (inp) {
+		GameInfo->input[0] = inp->input1;
+		GameInfo->input[1] = inp->input2;
+		GameInfo->inputfc = inp->inputfc;
+	}
+}
 
-	Lower 64 bits of the MD5 hash.
+void CheckBad(uint64 md5partial) {
+	const BADINF *bad = iNES_FindBad(md5partial);
+	if (bad)
+		FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", bad->name);
+}
+
+//corrects the header-derived mapper, mirroring and battery bit from the database.
+//returns flags describing what the header got wrong; 8 means the CHR ROM should be dropped.
+static int iNES_FixHeader(uint32 crc32, uint64 partialmd5, bool haschr, int *mapper, uint8 *mirroring, uint8 *rom_type) {
+	int tofix = 0, mask;
+	const CHINF *fix = iNES_FindHeaderFix(crc32);
+
+	if (fix) {
+		if (fix->mapper >= 0) {
+			if (fix->mapper & 0x800 && haschr)
+				tofix |= 8;
+			if (fix->mapper & 0x1000)
+				mask = 0xFFF;
+			else
+				mask = 0xFF;
+			if (*mapper != (fix->mapper & mask)) {
+				tofix |= 1;
+				*mapper = fix->mapper & mask;
+			}
+		}
+		if (fix->mirror >= 0) {
+			if (fix->mirror == 8) {
+				if (*mirroring == 2) {	/* Anything but hard-wired(four screen). */
+					tofix |= 2;
+					*mirroring = 0;
+				}
+			} else if (*mirroring != fix->mirror) {
+				if (*mirroring != (fix->mirror & ~4))
+					if ((fix->mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
+													needs to be set(the iNES header can't
+													hold this information).
+													*/
+						tofix |= 2;
+				*mirroring = fix->mirror;
+			}
+		}
+	}
+
+	if (iNES_NeedsBattery(partialmd5) && !(*rom_type & 2)) {
+		tofix |= 4;
+		*rom_type |= 2;
+	}
+
+	/* Games that use these iNES mappers tend to have the four-screen bit set
+	when it should not be.
 	*/
+	if ((*mapper == 118 || *mapper == 24 || *mapper == 26) && (*mirroring == 2)) {
+		*mirroring = 0;
+		tofix |= 2;
+	}
 
-	static uint64 savie[] =
-	{
-		0xc04361e499748382LL,	/* AD&D Heroes of the Lance */
-		0xb72ee2337ced5792LL,	/* AD&D Hillsfar */
-		0x2b7103b7a27bd72fLL,	/* AD&D Pool of Radiance */
-		0x498c10dc463cfe95LL,	/* Battle Fleet */
-		0x854d7947a3177f57LL,	/* Crystalis */
-		0x4a1f5336b86851b6LL,	/* DW */
-		0xb0bcc02c843c1b79LL,	/* DW */
-		0x2dcf3a98c7937c22LL,	/* DW 2 */
-		0x98e55e09dfcc7533LL,	/* DW 4*/
-		0x733026b6b72f2470LL,	/* Dw 3 */
-		0x6917ffcaca2d8466LL,	/* Famista '90 */
-		0x8da46db592a1fcf4LL,	/* Faria */
-		0xedba17a2c4608d20LL,	/* Final Fantasy */
-		0x91a6846d3202e3d6LL,	/* Final Fantasy */
-		0x012df596e2b31174LL,	/* Final Fantasy 1+2 */
-		0xf6b359a720549ecdLL,	/* Final Fantasy 2 */
-		0x5a30da1d9b4af35dLL,	/* Final Fantasy 3 */
-		0xd63dcc68c2b20adcLL,	/* Final Fantasy J */
-		0x2ee3417ba8b69706LL,	/* Hydlide 3*/
-		0xebbce5a54cf3ecc0LL,	/* Justbreed */
-		0x6a858da551ba239eLL,	/* Kaijuu Monogatari */
-		0x2db8f5d16c10b925LL,	/* Kyonshiizu 2 */
-		0x04a31647de80fdabLL,	/* Legend of Zelda */
-		0x94b9484862a26cbaLL,	/* Legend of Zelda */
-		0xa40666740b7d22feLL,	/* Mindseeker */
-		0x82000965f04a71bbLL,	/* Mirai Shinwa Jarvas */
-		0x77b811b2760104b9LL,	/* Mouryou Senki Madara */
-		0x11b69122efe86e8cLL,	/* RPG Jinsei Game */
-		0x9aa1dc16c05e7de5LL,	/* Startropics */
-		0x1b084107d0878bd0LL,	/* Startropics 2*/
-		0xa70b495314f4d075LL,	/* Ys 3 */
-		0x836c0ff4f3e06e45LL,	/* Zelda 2 */
-		0						/* Abandon all hope if the game has 0 in the lower 64-bits of its MD5 hash */
-	};
-
-	static struct CHINF moo[] =
-	{
-		#include "ines-correct.h"
-	};
-	int32 tofix = 0, x, mask;
+	/* Four-screen mirroring implicitly set. */
+	if (*mapper == 99)
+		*mirroring = 2;
+
+	return tofix;
+}
+
+//indexed, when the rom library index has the image, already holds what the header database says about it
+static void CheckHInfo(const ROMINDEX_ENTRY *indexed) {
+	int32 tofix = 0, x;
 	uint64 partialmd5 = 0;
 
 	for (x = 0; x < 8; x++)
@@ -347,69 +461,19 @@ static void CheckHInfo(void) {
 		break;
 	}
 
-	x = 0;
-	do {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			if (moo[x].mapper >= 0) {
-				if (moo[x].mapper & 0x800 && VROM_size) {
-					VROM_size = 0;
-					free(VROM);
-					VROM = NULL;
-					tofix |= 8;
-				}
-				if (moo[x].mapper & 0x1000)
-					mask = 0xFFF;
-				else
-					mask = 0xFF;
-				if (MapperNo != (moo[x].mapper & mask)) {
-					tofix |= 1;
-					MapperNo = moo[x].mapper & mask;
-				}
-			}
-			if (moo[x].mirror >= 0) {
-				if (moo[x].mirror == 8) {
-					if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
-						tofix |= 2;
-						Mirroring = 0;
-					}
-				} else if (Mirroring != moo[x].mirror) {
-					if (Mirroring != (moo[x].mirror & ~4))
-						if ((moo[x].mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
-														needs to be set(the iNES header can't
-														hold this information).
-														*/
-							tofix |= 2;
-					Mirroring = moo[x].mirror;
-				}
-			}
-			break;
-		}
-		x++;
-	} while (moo[x].mirror >= 0 || moo[x].mapper >= 0);
-
-	x = 0;
-	while (savie[x] != 0) {
-		if (savie[x] == partialmd5) {
-			if (!(head.ROM_type & 2)) {
-				tofix |= 4;
-				head.ROM_type |= 2;
-			}
-		}
-		x++;
-	}
-
-	/* Games that use these iNES mappers tend to have the four-screen bit set
-	when it should not be.
-	*/
-	if ((MapperNo == 118 || MapperNo == 24 || MapperNo == 26) && (Mirroring == 2)) {
-		Mirroring = 0;
-		tofix |= 2;
+	if (indexed) {
+		tofix = indexed->fixed;
+		MapperNo = indexed->mapper;
+		Mirroring = indexed->mirroring;
+		if (indexed->battery)
+			head.ROM_type |= 2;
+	} else
+		tofix = iNES_FixHeader(iNESGameCRC32, partialmd5, VROM_size != 0, &MapperNo, &Mirroring, &head.ROM_type);
+	if (tofix & 8) {
+		VROM_size = 0;
+		iNES_FreeVROM();
 	}
 
-	/* Four-screen mirroring implicitly set. */
-	if (MapperNo == 99)
-		Mirroring = 2;
-
 	if (tofix) {
 		char gigastr[768];
 		strcpy(gigastr, "The iNES header contains incorrect information.  For now, the information will be corrected in RAM.  ");
@@ -724,6 +788,38 @@ static BMAPPINGLocal bmap[] = {
 	{"",					0, NULL}
 };
 
+//md5 and crc32 are fed the same cache-sized blocks so a large image is only streamed through memory once
+static void iNES_HashImage(struct md5_context *md5, uint32 *crc32, uint8 *buf, uint32 len) {
+	while (len) {
+		uint32 todo = len < 0x10000 ? len : 0x10000;
+		md5_update(md5, buf, todo);
+		*crc32 = CalcCRC32(*crc32, buf, todo);
+		buf += todo;
+		len -= todo;
+	}
+}
+
+//tries to use the file itself as the PRG/CHR image. only possible when the image is laid out exactly as
+//the cart mapping wants it: power of 2 sizes and no short reads that would need 0xFF padding
+static bool iNES_MapImage(FCEUFILE *fp, uint32 prg_banks, uint32 chr_banks) {
+	if (prg_banks != ROM_size || chr_banks != VROM_size)
+		return false;
+
+	uint32 offset = 16 + ((head.ROM_type & 4) ? 512 : 0);
+	if ((ROMMap = FCEU_fmap(fp, &ROMMapSize)) == NULL)
+		return false;
+	if (ROMMapSize < offset + (ROM_size << 14) + (VROM_size << 13)) {
+		FCEU_funmap(ROMMap, ROMMapSize);
+		ROMMap = NULL;
+		ROMMapSize = 0;
+		return false;
+	}
+
+	ROM = ROMMap + offset;
+	VROM = VROM_size ? ROM + (ROM_size << 14) : NULL;
+	return true;
+}
+
 int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	struct md5_context md5;
 
@@ -765,7 +861,8 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	else
 		ROM_size = uppow2(not_round_size);
 
-	VROM_size = uppow2(head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0));
+	int not_round_vsize = head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0);
+	VROM_size = uppow2(not_round_vsize);
 
 	int round = true;
 	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
@@ -780,21 +877,24 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 		}
 	}
 
-	if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
-		return 0;
-	memset(ROM, 0xFF, ROM_size << 14);
-
-	if (VROM_size) {
-		if ((VROM = (uint8*)FCEU_malloc(VROM_size << 13)) == NULL) {
-			free(ROM);
-			ROM = NULL;
+	bool mapped = iNES_MapImage(fp, not_round_size, not_round_vsize);
+	if (!mapped) {
+		if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
 			return 0;
+		memset(ROM, 0xFF, ROM_size << 14);
+
+		if (VROM_size) {
+			if ((VROM = (uint8*)FCEU_malloc(VROM_size << 13)) == NULL) {
+				free(ROM);
+				ROM = NULL;
+				return 0;
+			}
+			memset(VROM, 0xFF, VROM_size << 13);
 		}
-		memset(VROM, 0xFF, VROM_size << 13);
 	}
 
 	if (head.ROM_type & 4) {	/* Trainer */
-		trainerpoo = (uint8*)FCEU_gmalloc(512);
+		trainerpoo = (uint8*)FCEU_malloc(512);
 		FCEU_fread(trainerpoo, 512, 1, fp);
 	}
 
@@ -803,21 +903,25 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 
 	SetupCartPRGMapping(0, ROM, ROM_size << 14, 0);
 
-	FCEU_fread(ROM, 0x4000, (round) ? ROM_size : not_round_size, fp);
+	if (!mapped) {
+		FCEU_fread(ROM, 0x4000, (round) ? ROM_size : not_round_size, fp);
 
-	if (VROM_size)
-		FCEU_fread(VROM, 0x2000, VROM_size, fp);
-
-	md5_starts(&md5);
-	md5_update(&md5, ROM, ROM_size << 14);
-
-	iNESGameCRC32 = CalcCRC32(0, ROM, ROM_size << 14);
+		if (VROM_size)
+			FCEU_fread(VROM, 0x2000, VROM_size, fp);
+	}
 
-	if (VROM_size) {
-		iNESGameCRC32 = CalcCRC32(iNESGameCRC32, VROM, VROM_size << 13);
-		md5_update(&md5, VROM, VROM_size << 13);
+	const ROMINDEX_ENTRY *indexed = fp->patched ? NULL : FCEU_RomIndexFind(name);
+	if (indexed) {
+		iNESGameCRC32 = indexed->crc32;
+		memcpy(iNESCart.MD5, indexed->md5, sizeof(iNESCart.MD5));
+	} else {
+		md5_starts(&md5);
+		iNESGameCRC32 = 0;
+		iNES_HashImage(&md5, &iNESGameCRC32, ROM, ROM_size << 14);
+		if (VROM_size)
+			iNES_HashImage(&md5, &iNESGameCRC32, VROM, VROM_size << 13);
+		md5_finish(&md5, iNESCart.MD5);
 	}
-	md5_finish(&md5, iNESCart.MD5);
 	memcpy(&GameInfo->MD5, &iNESCart.MD5, sizeof(iNESCart.MD5));
 
 	iNESCart.CRC32 = iNESGameCRC32;
@@ -861,7 +965,7 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	}
 
 	SetInput();
-	CheckHInfo();
+	CheckHInfo(indexed);
 	{
 		int x;
 		uint64 partialmd5 = 0;
@@ -923,6 +1027,65 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	return 1;
 }
 
+//identifies an image held in memory the way iNESLoad would, without loading it or touching the loader's state.
+//this is what the rom library scanner stores, so it has to reproduce iNESLoad's padding and read sizes exactly
+bool iNESProbe(uint8 *data, uint32 len, ROMINDEX_ENTRY *entry) {
+	iNES_HEADER h;
+	struct md5_context md5;
+
+	if (len < 16)
+		return false;
+	memcpy(&h, data, 16);
+	if (memcmp(&h, "NES\x1a", 4))
+		return false;
+	h.cleanup();
+
+	bool ines2 = ((h.ROM_type2 & 0x0C) == 0x08);
+	int mapper = (h.ROM_type >> 4) | (h.ROM_type2 & 0xF0);
+	if (ines2) mapper |= ((h.ROM_type3 & 0x0F) << 8);
+	uint8 mirroring = (h.ROM_type & 8) ? 2 : (h.ROM_type & 1);
+
+	int not_round_size = h.ROM_size;
+	if (ines2) not_round_size |= ((h.Upper_ROM_VROM_size & 0x0F) << 8);
+	uint32 prg_banks = (!h.ROM_size && !ines2) ? 256 : uppow2(not_round_size);
+	uint32 chr_banks = uppow2(h.VROM_size | (ines2 ? ((h.Upper_ROM_VROM_size & 0xF0) << 4) : 0));
+
+	bool round = true;
+	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i)
+		if (not_power2[i] == mapper)
+			round = false;
+
+	uint32 pos = 16 + ((h.ROM_type & 4) ? 512 : 0);
+	std::vector<uint8> prg(prg_banks << 14, 0xFF), chr(chr_banks << 13, 0xFF);
+	uint32 todo = (round ? prg_banks : not_round_size) << 14;
+	if (pos < len)
+		memcpy(&prg[0], data + pos, std::min(todo, len - pos));
+	pos += todo;
+	if (chr_banks && pos < len)
+		memcpy(&chr[0], data + pos, std::min((uint32)chr.size(), len - pos));
+
+	entry->crc32 = 0;
+	md5_starts(&md5);
+	iNES_HashImage(&md5, &entry->crc32, &prg[0], prg.size());
+	if (chr_banks)
+		iNES_HashImage(&md5, &entry->crc32, &chr[0], chr.size());
+	md5_finish(&md5, entry->md5);
+
+	uint64 partialmd5 = 0;
+	for (int x = 0; x < 8; x++)
+		partialmd5 |= (uint64)entry->md5[15 - x] << (x * 8);
+	entry->fixed = iNES_FixHeader(entry->crc32, partialmd5, chr_banks != 0, &mapper, &mirroring, &h.ROM_type);
+	if (entry->fixed & 8)
+		chr_banks = 0;
+
+	entry->mapper = mapper;
+	entry->mirroring = mirroring;
+	entry->battery = (h.ROM_type & 2) ? 1 : 0;
+	entry->prg_banks = prg_banks;
+	entry->chr_banks = chr_banks;
+	return true;
+}
+
 // bbit edited: the whole function below was added
 int iNesSave() {
 	char name[2048];
@@ -1010,7 +1173,7 @@ static int iNES_Init(int num) {
 				{
 					CHRRAMSize = iNESCart.battery_vram_size + iNESCart.vram_size;
 				}
-				if ((VROM = (uint8*)FCEU_dmalloc(CHRRAMSize)) == NULL) return 0;
+				VROM = (uint8*)FCEU_gmalloc(CHRRAMSize);
 				FCEU_MemoryRand(VROM, CHRRAMSize);
 
 				UNIFchrrama = VROM;
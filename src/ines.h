@@ -49,6 +49,9 @@ extern char LoadedRomFName[2048]; //bbit Edited: line added
 extern const TMasterRomInfo* MasterRomInfo;
 extern TMasterRomInfoParams MasterRomInfoParams;
 
+struct ROMINDEX_ENTRY;
+bool iNESProbe(uint8 *data, uint32 len, ROMINDEX_ENTRY *entry);
+
 //mbg merge 7/19/06 changed to c++ decl format
 struct iNES_HEADER {
 	char ID[4]; /*NES^Z*/
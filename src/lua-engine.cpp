@@ -3,6 +3,9 @@
 #define SetCurrentDir chdir
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
 #endif
 
 #ifdef WIN32
@@ -20,11 +23,14 @@
 #include "movie.h"
 #include "driver.h"
 #include "cheat.h"
+#include "cart.h"
+#include "ppu.h"
 #include "x6502.h"
 #include "utils/xstring.h"
 #include "utils/memory.h"
 #include "utils/crc32.h"
 #include "fceulua.h"
+#include "profile.h"
 
 #ifdef WIN32
 #include "drivers/win/common.h"
@@ -126,10 +132,27 @@ struct LuaSaveState {
 	std::string filename;
 	EMUFILE_MEMORY *data;
 	bool anonymous, persisted;
+
+	// lean states (savestate.createlean) keep a raw snapshot of the emulator instead of a
+	// savestate file, and only keep the back buffer and the movie (in data) when asked to.
+	// every buffer is reused from one save to the next.
+	bool lean, leanbackbuffer, leanmovie;
+	bool saved, savedmovie;
+	std::vector<uint8> raw, backbuffer;
+	uint32 rawlayout;
+	int framecount;
+
 	LuaSaveState()
 		: data(0)
 		, anonymous(false)
 		, persisted(false)
+		, lean(false)
+		, leanbackbuffer(false)
+		, leanmovie(false)
+		, saved(false)
+		, savedmovie(false)
+		, rawlayout(0)
+		, framecount(0)
 	{}
 	~LuaSaveState() {
 		if(data) delete data;
@@ -205,6 +228,17 @@ static uint8 luajoypads2[4]= { 0x00, 0x00, 0x00, 0x00 }; //0x
 	11 - true		01 - pass-through (default)
 	00 - false		10 - invert					*/
 
+// The input plan emu.runplan() is playing. The frame boundary plays it without resuming
+// the script, and the buffers are kept from one plan to the next.
+static struct {
+	std::vector<uint8> input;		// 4 ports a frame
+	std::vector<uint8> ports;		// the ports each frame sets, a bit per port
+	std::vector<uint8> sample;		// nonzero for the frames to sample memory after
+	std::vector<uint16> addresses;
+	std::vector<uint8> samples;
+	size_t frame, frames;
+} luaPlan;
+
 static enum { GUI_USED_SINCE_LAST_DISPLAY, GUI_USED_SINCE_LAST_FRAME, GUI_CLEAR } gui_used = GUI_CLEAR;
 static uint8 *gui_data = NULL;
 static int gui_saw_current_palette = FALSE;
@@ -272,6 +306,7 @@ static void FCEU_LuaOnStop()
 		luajoypads1[i]= 0xFF;	// Set these back to pass-through
 		luajoypads2[i]= 0x00;
 	}
+	luaPlan.frames = 0;
 	gui_used = GUI_CLEAR;
 	//if (wasPaused && !FCEUI_EmulationPaused())
 	//	FCEUI_ToggleEmulationPause();
@@ -425,6 +460,124 @@ static int emu_frameadvance(lua_State *L) {
 	// It's actually rather disappointing...
 }
 
+// Sets the joypads for the frame of the input plan that is about to run. Both masks get the
+// planned buttons, so each one is forced on or off whatever the player holds.
+static void FCEU_LuaPlanInput() {
+	const uint8 *input = &luaPlan.input[luaPlan.frame * 4];
+	uint8 ports = luaPlan.ports[luaPlan.frame];
+	for (int i = 0; i < 4; i++) {
+		if (ports & (1 << i))
+			luajoypads1[i] = luajoypads2[i] = input[i];
+	}
+}
+
+// Called at the frame boundary while an input plan is playing: samples the frame that has just
+// run and sets up the next one. Returns false when the plan is over, after pushing its result
+// onto the thread.
+static bool FCEU_LuaPlanStep(lua_State *thread) {
+	if (luaPlan.sample[luaPlan.frame]) {
+		for (size_t i = 0; i < luaPlan.addresses.size(); i++)
+			luaPlan.samples.push_back(FCEU_CheatGetByte(luaPlan.addresses[i]));
+	}
+
+	if (++luaPlan.frame < luaPlan.frames) {
+		FCEU_LuaPlanInput();
+		return true;
+	}
+
+	luaPlan.frames = 0;
+	lua_createtable(thread, luaPlan.samples.size(), 0);
+	for (size_t i = 0; i < luaPlan.samples.size(); i++) {
+		lua_pushinteger(thread, luaPlan.samples[i]);
+		lua_rawseti(thread, -2, i + 1);
+	}
+	return false;
+}
+
+// table emu.runplan(table inputs, table samples = nil, table addresses = nil)
+//
+//  Plays a list of inputs, one a frame, without coming back to the script until the
+//  last frame is done, and samples memory along the way. An input is a number with
+//  the buttons for joypad 1, in the order of joypad.get (A is 1, right is 128), or
+//  a table of such numbers for joypads 1 to 4, where nil leaves a joypad alone.
+//  samples lists the frames of the plan (1 to #inputs) to read memory after; by
+//  default, only the last one. addresses lists what to read there; by default, the
+//  2KB of RAM. Returns the bytes read, all in one table: sample after sample, each
+//  with a byte for every address.
+//  Registered functions still run every frame, and the frames go by at the
+//  emulation speed, like emu.frameadvance() would make them.
+static int emu_runplan(lua_State *L) {
+	if (frameAdvanceWaiting)
+		return luaL_error(L, "can't call emu.runplan() from here");
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	size_t frames = lua_objlen(L, 1);
+
+	luaPlan.input.assign(frames * 4, 0);
+	luaPlan.ports.assign(frames, 0);
+	for (size_t f = 0; f < frames; f++) {
+		lua_rawgeti(L, 1, f + 1);
+		if (lua_type(L, -1) == LUA_TNUMBER) {
+			luaPlan.input[f * 4] = lua_tointeger(L, -1);
+			luaPlan.ports[f] = 1;
+		} else if (lua_istable(L, -1)) {
+			for (int i = 0; i < 4; i++) {
+				lua_rawgeti(L, -1, i + 1);
+				if (lua_type(L, -1) == LUA_TNUMBER) {
+					luaPlan.input[f * 4 + i] = lua_tointeger(L, -1);
+					luaPlan.ports[f] |= 1 << i;
+				}
+				lua_pop(L, 1);
+			}
+		} else {
+			return luaL_error(L, "invalid input for frame %d of the plan", (int)(f + 1));
+		}
+		lua_pop(L, 1);
+	}
+
+	luaPlan.sample.assign(frames, 0);
+	if (lua_istable(L, 2)) {
+		size_t count = lua_objlen(L, 2);
+		for (size_t i = 1; i <= count; i++) {
+			lua_rawgeti(L, 2, i);
+			int f = lua_tointeger(L, -1);
+			lua_pop(L, 1);
+			if (f < 1 || (size_t)f > frames)
+				return luaL_error(L, "sample %d is not a frame of the plan", (int)i);
+			luaPlan.sample[f - 1] = 1;
+		}
+	} else if (frames) {
+		luaPlan.sample[frames - 1] = 1;
+	}
+
+	luaPlan.addresses.clear();
+	if (lua_istable(L, 3)) {
+		size_t count = lua_objlen(L, 3);
+		for (size_t i = 1; i <= count; i++) {
+			lua_rawgeti(L, 3, i);
+			luaPlan.addresses.push_back(lua_tointeger(L, -1));
+			lua_pop(L, 1);
+		}
+	} else {
+		for (int a = 0; a < 0x800; a++)
+			luaPlan.addresses.push_back(a);
+	}
+
+	if (!frames) {
+		lua_newtable(L);
+		return 1;
+	}
+
+	luaPlan.samples.clear();
+	luaPlan.frame = 0;
+	luaPlan.frames = frames;
+	FCEU_LuaPlanInput();
+
+	// yield like emu.frameadvance(); the frame boundary takes it from here
+	frameAdvanceWaiting = TRUE;
+	return lua_yield(L, 0);
+}
+
 // bool emu.paused()
 static int emu_paused(lua_State *L)
 {
@@ -1335,6 +1488,321 @@ static int memory_readbyterange(lua_State *L) {
 	return 1;
 }
 
+// Views are handles on a whole region of memory or a frame buffer, for scripts that read all of
+// it every frame. They read straight out of the emulator's own buffers: a string is built from the
+// bytes in place and a table passed in is refilled, so reading a view every frame allocates nothing.
+enum LUAVIEWKIND
+{
+	LUAVIEW_RAM,
+	LUAVIEW_WRAM,
+	LUAVIEW_PPU,
+	LUAVIEW_OAM,
+	LUAVIEW_PALETTE,
+	LUAVIEW_SCREEN,
+	LUAVIEW_BACKBUFFER,
+	LUAVIEW_COUNT
+};
+static const char* LuaViewNames[LUAVIEW_COUNT+1] = { "ram", "wram", "ppu", "oam", "palette", "screen", "backbuffer", NULL };
+static const int LuaViewSizes[LUAVIEW_COUNT] = { 0x800, 0x2000, 0x4000, 0x100, 0x20, 256*240, 256*240 };
+static const char* LuaViewMeta = "FCEU View";
+
+struct LuaView
+{
+	int kind;
+};
+
+// Points at the byte at offset and says how many bytes follow it contiguously. The cpu and ppu
+// address spaces are banked, so a run never crosses a bank; NULL is an unmapped bank.
+static const uint8* LuaViewResolve(int kind, int offset, int *run)
+{
+	switch(kind)
+	{
+	case LUAVIEW_RAM:
+		*run = 0x800 - offset;
+		return RAM + offset;
+	case LUAVIEW_WRAM:
+	{
+		uint32 A = 0x6000 + offset;
+		*run = 0x800 - (A & 0x7FF);
+		return Page[A >> 11] ? Page[A >> 11] + A : NULL;
+	}
+	case LUAVIEW_PPU:
+		if(offset < 0x2000)
+		{
+			*run = 0x400 - (offset & 0x3FF);
+			return VPage[offset >> 10] ? VPage[offset >> 10] + offset : NULL;
+		}
+		if(offset < 0x3F00)
+		{
+			*run = std::min(0x400 - (offset & 0x3FF), 0x3F00 - offset);
+			return vnapage[(offset >> 10) & 3] ? vnapage[(offset >> 10) & 3] + (offset & 0x3FF) : NULL;
+		}
+		*run = 0x20 - (offset & 0x1F);
+		return PALRAM + (offset & 0x1F);
+	case LUAVIEW_OAM:
+		*run = 0x100 - offset;
+		return SPRAM + offset;
+	case LUAVIEW_PALETTE:
+		*run = 0x20 - offset;
+		return PALRAM + offset;
+	case LUAVIEW_SCREEN:
+		*run = 256*240 - offset;
+		return XBuf ? XBuf + offset : NULL;
+	case LUAVIEW_BACKBUFFER:
+		*run = 256*240 - offset;
+		return XBackBuf ? XBackBuf + offset : NULL;
+	}
+	*run = 0;
+	return NULL;
+}
+
+static LuaView* LuaViewCheck(lua_State *L, int idx)
+{
+	return (LuaView*)luaL_checkudata(L, idx, LuaViewMeta);
+}
+
+// reads the optional offset and length arguments at idx and idx+1, checked against the view
+static void LuaViewRange(lua_State *L, LuaView *view, int idx, int *offset, int *length)
+{
+	int size = LuaViewSizes[view->kind];
+	*offset = luaL_optinteger(L, idx, 0);
+	if(*offset < 0 || *offset > size)
+		luaL_error(L, "offset %d is outside the %s view (0-%d)", *offset, LuaViewNames[view->kind], size);
+	*length = luaL_optinteger(L, idx + 1, size - *offset);
+	if(*length < 0 || *offset + *length > size)
+		luaL_error(L, "%d bytes from %d run past the end of the %s view (%d bytes)", *length, *offset, LuaViewNames[view->kind], size);
+}
+
+// leaves the table to fill on top of the stack: the one at idx when there is one, else a new one
+static void LuaViewTable(lua_State *L, int idx, int count)
+{
+	if(lua_istable(L, idx))
+		lua_pushvalue(L, idx);
+	else
+		lua_createtable(L, count, 0);
+}
+
+// sets t[first..first+count-1] to the bytes from offset on, with t on top of the stack
+static void LuaViewFill(lua_State *L, LuaView *view, int offset, int count, int first)
+{
+	while(count > 0)
+	{
+		int run;
+		const uint8 *p = LuaViewResolve(view->kind, offset, &run);
+		run = std::min(run, count);
+		for(int i = 0; i < run; i++)
+		{
+			lua_pushinteger(L, p ? p[i] : 0);
+			lua_rawseti(L, -2, first + i);
+		}
+		offset += run;
+		first += run;
+		count -= run;
+	}
+}
+
+// string view:tostring([int offset = 0 [, int length]])
+//
+//  The bytes as a string.
+static int view_tostring(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	int offset, length, run;
+	LuaViewRange(L, view, 2, &offset, &length);
+
+	const uint8 *p = LuaViewResolve(view->kind, offset, &run);
+	if(p && run >= length)
+	{
+		lua_pushlstring(L, (const char*)p, length);
+		return 1;
+	}
+
+	luaL_Buffer b;
+	luaL_buffinit(L, &b);
+	while(length > 0)
+	{
+		p = LuaViewResolve(view->kind, offset, &run);
+		run = std::min(run, length);
+		if(p)
+			luaL_addlstring(&b, (const char*)p, run);
+		else
+			for(int i = 0; i < run; i++)
+				luaL_addchar(&b, 0);
+		offset += run;
+		length -= run;
+	}
+	luaL_pushresult(&b);
+	return 1;
+}
+
+// table view:totable([int offset = 0 [, int length [, table t]]])
+//
+//  The bytes as an array, t[1] being the byte at offset. t is filled when it is given, so a
+//  script that reads the same view every frame can keep reusing one table.
+static int view_totable(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	int offset, length;
+	LuaViewRange(L, view, 2, &offset, &length);
+	LuaViewTable(L, 4, length);
+	LuaViewFill(L, view, offset, length, 1);
+	return 1;
+}
+
+// table view:region(int offset, int width, int height, int pitch [, table t])
+//
+//  height rows of width bytes each, pitch bytes apart, as one array row after row. On the screen
+//  views, view:region(y*256+x, w, h, 256) is a w by h rectangle.
+static int view_region(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	int size = LuaViewSizes[view->kind];
+	int offset = luaL_checkinteger(L, 2);
+	int width = luaL_checkinteger(L, 3);
+	int height = luaL_checkinteger(L, 4);
+	int pitch = luaL_checkinteger(L, 5);
+	if(offset < 0 || width < 0 || height < 0 || pitch < width)
+		luaL_error(L, "bad region");
+	if(width && height && offset + (height - 1) * pitch + width > size)
+		luaL_error(L, "region runs past the end of the %s view (%d bytes)", LuaViewNames[view->kind], size);
+
+	LuaViewTable(L, 6, width * height);
+	for(int y = 0; y < height; y++)
+		LuaViewFill(L, view, offset + y * pitch, width, 1 + y * width);
+	return 1;
+}
+
+// table view:frame([bool rgb = false [, table t]])
+//
+//  The whole 256x240 picture of a screen view as an array of 61440 pixels, row after row: palette
+//  indices (0-63), or with rgb packed 0xRRGGBB colours from the current palette.
+static int view_frame(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	if(view->kind != LUAVIEW_SCREEN && view->kind != LUAVIEW_BACKBUFFER)
+		luaL_error(L, "the %s view is not a frame buffer", LuaViewNames[view->kind]);
+	bool rgb = lua_toboolean(L, 2) != 0;
+	LuaViewTable(L, 3, 256*240);
+
+	int run;
+	const uint8 *p = LuaViewResolve(view->kind, 0, &run);
+	if(!p)
+	{
+		for(int i = 0; i < 256*240; i++)
+		{
+			lua_pushinteger(L, 0);
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
+	int colours[256];
+	for(int c = 0; c < 256; c++)
+	{
+		if(rgb)
+		{
+			uint8 r, g, b;
+			FCEUD_GetPalette(c, &r, &g, &b);
+			colours[c] = (r << 16) | (g << 8) | b;
+		}
+		else
+			colours[c] = c & 0x3F;
+	}
+	for(int i = 0; i < 256*240; i++)
+	{
+		lua_pushinteger(L, colours[p[i]]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+// int view:size()
+static int view_size(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	lua_pushinteger(L, LuaViewSizes[view->kind]);
+	return 1;
+}
+
+// view[offset] is the byte at offset (counted from 0); anything else is a method
+static int view_index(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	if(lua_type(L, 2) == LUA_TNUMBER)
+	{
+		int offset = lua_tointeger(L, 2), run;
+		if(offset < 0 || offset >= LuaViewSizes[view->kind])
+			return 0;
+		const uint8 *p = LuaViewResolve(view->kind, offset, &run);
+		lua_pushinteger(L, p ? *p : 0);
+		return 1;
+	}
+	lua_pushvalue(L, 2);
+	lua_rawget(L, lua_upvalueindex(1));
+	return 1;
+}
+
+static int view_name(lua_State *L)
+{
+	LuaView *view = LuaViewCheck(L, 1);
+	lua_pushfstring(L, "view: %s (%d bytes)", LuaViewNames[view->kind], LuaViewSizes[view->kind]);
+	return 1;
+}
+
+static const struct luaL_reg viewmethods[] = {
+	{"tostring", view_tostring},
+	{"totable", view_totable},
+	{"region", view_region},
+	{"frame", view_frame},
+	{"size", view_size},
+	{NULL,NULL}
+};
+
+// view memory.view(string name)
+//
+//  A view of "ram" (2KB), "wram" ($6000-$7FFF as mapped now), "ppu" (the $0000-$3FFF ppu address
+//  space as mapped now), "oam", "palette", "screen" (the picture with the script's drawing) or
+//  "backbuffer" (the picture as the ppu drew it). A view always reads the memory as it is at the
+//  time of the read; there is one view object per name.
+static int memory_view(lua_State *L)
+{
+	int kind = luaL_checkoption(L, 1, NULL, LuaViewNames);
+
+	if(luaL_newmetatable(L, LuaViewMeta))
+	{
+		lua_newtable(L);
+		for(const luaL_reg *m = viewmethods; m->name; m++)
+		{
+			lua_pushcfunction(L, m->func);
+			lua_setfield(L, -2, m->name);
+		}
+		lua_pushcclosure(L, view_index, 1);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, view_size);
+		lua_setfield(L, -2, "__len");
+		lua_pushcfunction(L, view_name);
+		lua_setfield(L, -2, "__tostring");
+
+		// the views themselves, so each name is created once
+		lua_newtable(L);
+		lua_setfield(L, -2, "views");
+	}
+
+	lua_getfield(L, -1, "views");
+	lua_rawgeti(L, -1, kind);
+	if(lua_isnil(L, -1))
+	{
+		lua_pop(L, 1);
+		LuaView *view = (LuaView*)lua_newuserdata(L, sizeof(LuaView));
+		view->kind = kind;
+		lua_pushvalue(L, -3);
+		lua_setmetatable(L, -2);
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, -3, kind);
+	}
+	return 1;
+}
+
 static inline bool isalphaorunderscore(char c)
 {
 	return isalpha(c) || c == '_';
@@ -1926,6 +2394,8 @@ static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, un
 				infoStack.insert(infoStack.begin(), &info);
 				struct Scope { ~Scope(){ infoStack.erase(infoStack.begin()); } } scope;
 #endif
+				FCEU_PROFILE_STAGE(PROFILE_LUA);
+				FCEU_PROFILE_COUNT(PROFILE_MEMHOOK);
 				lua_settop(L, 0);
 				lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
 				for(int i = address; i != address+size; i++)
@@ -1976,6 +2446,11 @@ void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value
 	}
 }
 
+int FCEU_LuaMemHooksActive()
+{
+	return hookedRegions[LUAMEMHOOK_WRITE].NotEmpty() || hookedRegions[LUAMEMHOOK_EXEC].NotEmpty();
+}
+
 void CallRegisteredLuaFunctions(LuaCallID calltype)
 {
 	assert((unsigned int)calltype < (unsigned int)LUACALL_COUNT);
@@ -1984,6 +2459,7 @@ void CallRegisteredLuaFunctions(LuaCallID calltype)
 	if (!L)
 		return;
 
+	FCEU_PROFILE_STAGE(PROFILE_LUA);
 	lua_settop(L, 0);
 	lua_getfield(L, LUA_REGISTRYINDEX, idstring);
 
@@ -2534,6 +3010,31 @@ static int savestate_gc(lua_State *L) {
 	return 0;
 }
 
+// Gives the savestate object on top of the stack its metatable
+static void savestate_setmetatable(lua_State *L) {
+
+	// The metatable we use, protected from Lua and contains garbage collection info and stuff.
+	lua_newtable(L);
+
+	//// First, we must protect it
+	lua_pushstring(L, "FCEU Savestate");
+	lua_setfield(L, -2, "__metatable");
+	//
+	//
+	//// Now we need to save the file itself.
+	//lua_pushstring(L, filename.c_str());
+	//lua_setfield(L, -2, "filename");
+
+	// If it's an anonymous savestate, we must delete the file from disk should it be gargage collected
+	//if (which < 0) {
+		lua_pushcfunction(L, savestate_gc);
+		lua_setfield(L, -2, "__gc");
+	//}
+
+	// Set the metatable
+	lua_setmetatable(L, -2);
+}
+
 //  Referenced by:
 //  savestate.create(int which = nil)
 //  savestate.object(int which = nil)
@@ -2578,27 +3079,7 @@ static int savestate_create_aliased(lua_State *L, bool newnumbering) {
 		ss->anonymous = true;
 	}
 
-
-	// The metatable we use, protected from Lua and contains garbage collection info and stuff.
-	lua_newtable(L);
-
-	//// First, we must protect it
-	lua_pushstring(L, "FCEU Savestate");
-	lua_setfield(L, -2, "__metatable");
-	//
-	//
-	//// Now we need to save the file itself.
-	//lua_pushstring(L, filename.c_str());
-	//lua_setfield(L, -2, "filename");
-
-	// If it's an anonymous savestate, we must delete the file from disk should it be gargage collected
-	//if (which < 0) {
-		lua_pushcfunction(L, savestate_gc);
-		lua_setfield(L, -2, "__gc");
-	//}
-
-	// Set the metatable
-	lua_setmetatable(L, -2);
+	savestate_setmetatable(L);
 
 	// Awesome. Return the object
 	return 1;
@@ -2628,6 +3109,89 @@ static int savestate_create(lua_State *L) {
 	return savestate_create_aliased(L,false);
 }
 
+// object savestate.createlean([table options])
+//
+//  Creates a savestate object for scripts that save and load many times a frame.
+//  It holds a raw copy of the emulator state instead of a savestate file: saving
+//  reuses the object's buffer and loading copies the state straight back, without
+//  any chunks to parse. The back buffer and the movie are left out unless the
+//  options ask for them ({backbuffer=true, movie=true}); without the movie, only
+//  the frame counter goes back when the state is loaded.
+//  A lean state can only be loaded into the game it was saved from, and it cannot
+//  be persisted.
+static int savestate_createlean(lua_State *L) {
+	bool backbuffer = false, movie = false;
+	if (lua_istable(L, 1)) {
+		lua_getfield(L, 1, "backbuffer");
+		backbuffer = lua_toboolean(L, -1) != 0;
+		lua_getfield(L, 1, "movie");
+		movie = lua_toboolean(L, -1) != 0;
+		lua_pop(L, 2);
+	}
+
+	LuaSaveState *ss = new(lua_newuserdata(L,sizeof(LuaSaveState))) LuaSaveState();
+	ss->lean = true;
+	ss->leanbackbuffer = backbuffer;
+	ss->leanmovie = movie;
+	ss->anonymous = true;
+
+	savestate_setmetatable(L);
+	return 1;
+}
+
+static void savestate_savelean(LuaSaveState *ss) {
+	uint32 size = FCEUSS_RawSize();
+	if (ss->raw.size() != size)
+		ss->raw.resize(size);
+	FCEUSS_SaveRaw(&ss->raw[0]);
+	ss->rawlayout = FCEUSS_RawLayout();
+	ss->framecount = currFrameCounter;
+
+	if (ss->leanbackbuffer) {
+		ss->backbuffer.resize(256 * 256);
+		memcpy(&ss->backbuffer[0], XBackBuf, 256 * 256);
+	}
+
+	ss->savedmovie = false;
+	if (ss->leanmovie && FCEUMOV_IsLoaded() && !FCEUMOV_Mode(MOVIEMODE_TASEDITOR)) {
+		if (!ss->data)
+			ss->data = new EMUFILE_MEMORY();
+		ss->data->set_len(0);
+		ss->data->unfail();
+		FCEUMOV_WriteState(ss->data);
+		ss->savedmovie = true;
+	}
+	ss->saved = true;
+}
+
+static void savestate_loadlean(lua_State *L, LuaSaveState *ss) {
+	if (!ss->saved) {
+		luaL_error(L, "Nothing has been saved to this lean savestate");
+		return;
+	}
+	if (ss->rawlayout != FCEUSS_RawLayout()) {
+		luaL_error(L, "This lean savestate belongs to another game");
+		return;
+	}
+
+	if (!FCEUSS_LoadRaw(&ss->raw[0], ss->raw.size())) {
+		luaL_error(L, "This lean savestate no longer matches the game's state layout");
+		return;
+	}
+	if (ss->savedmovie)
+		FCEUMOV_PreLoad();
+	currFrameCounter = ss->framecount;
+	if (ss->leanbackbuffer) {
+		memcpy(XBackBuf, &ss->backbuffer[0], 256 * 256);
+		FCEU_InvalidateImage();
+	}
+	if (ss->savedmovie) {
+		ss->data->fseek(0, SEEK_SET);
+		if (FCEUMOV_ReadState(ss->data, ss->data->size()))
+			FCEUMOV_PostLoad();
+	}
+}
+
 
 // savestate.save(object state)
 //
@@ -2642,14 +3206,22 @@ static int savestate_save(lua_State *L) {
 		return 0;
 	}
 
-	if(ss->data) delete ss->data;
-	ss->data = new EMUFILE_MEMORY();
-
 //	printf("saving %s\n", filename);
 
 	// Save states are very expensive. They take time.
 	numTries--;
 
+	if (ss->lean) {
+		savestate_savelean(ss);
+		return 0;
+	}
+
+	// keep the buffer of the last save
+	if (!ss->data)
+		ss->data = new EMUFILE_MEMORY();
+	ss->data->set_len(0);
+	ss->data->unfail();
+
 	FCEUSS_SaveMS(ss->data,Z_NO_COMPRESSION);
 	ss->data->fseek(0,SEEK_SET);
 	return 0;
@@ -2658,6 +3230,10 @@ static int savestate_save(lua_State *L) {
 static int savestate_persist(lua_State *L) {
 
 	LuaSaveState *ss = (LuaSaveState *)lua_touserdata(L, 1);
+	if (ss->lean) {
+		luaL_error(L, "Lean savestates cannot be persisted");
+		return 0;
+	}
 	ss->persist();
 	return 0;
 }
@@ -2678,6 +3254,11 @@ static int savestate_load(lua_State *L) {
 
 	numTries--;
 
+	if (ss->lean) {
+		savestate_loadlean(L, ss);
+		return 0;
+	}
+
 	/*if (!ss->data) {
 		luaL_error(L, "Invalid savestate.load data");
 		return 0;
@@ -2737,6 +3318,402 @@ static int savestate_loadscriptdata(lua_State *L) {
 	return 0;
 }
 
+#ifdef __linux
+// emu.fork() runs the branches of a search in child processes. fork() gives every child
+// a copy-on-write copy of the emulator and of the script, so a branch starts from where
+// the parent stands without anything being copied up front. the child emulates frames
+// itself until the branch function returns, then sends back what it returned through a
+// pipe, with a lean snapshot of where it ended up if the script asked for one, and exits.
+
+// deepest nesting of tables a branch can send back
+#define FORK_MAXDEPTH 16
+
+enum { FORK_NIL, FORK_FALSE, FORK_TRUE, FORK_NUMBER, FORK_STRING, FORK_TABLE, FORK_END };
+
+// what a branch sends back besides its results, as asked for in emu.fork's options
+enum { FORK_SENDSTATE = 1, FORK_SENDSCREEN = 2 };
+
+// in a forked child, the pipe to report back through and what to send on it. -1 in the parent
+static int forkChildFd = -1;
+static int forkChildSends;
+
+static void fork_put(std::string &out, const void *p, size_t size) {
+	out.append((const char *)p, size);
+}
+
+static void fork_putstring(std::string &out, const char *s, size_t len) {
+	uint32 n = len;
+	fork_put(out, &n, 4);
+	out.append(s, len);
+}
+
+// Packs the value at idx. Whatever cannot leave the process (functions, userdata,
+// threads, tables nested too deep) goes as nil.
+static void fork_pack(lua_State *L, int idx, std::string &out, int depth) {
+	if (idx < 0)
+		idx = lua_gettop(L) + idx + 1;
+
+	switch (lua_type(L, idx)) {
+	case LUA_TBOOLEAN:
+		out += (char)(lua_toboolean(L, idx) ? FORK_TRUE : FORK_FALSE);
+		return;
+	case LUA_TNUMBER: {
+		lua_Number v = lua_tonumber(L, idx);
+		out += (char)FORK_NUMBER;
+		fork_put(out, &v, sizeof(v));
+		return;
+	}
+	case LUA_TSTRING: {
+		size_t len;
+		const char *s = lua_tolstring(L, idx, &len);
+		out += (char)FORK_STRING;
+		fork_putstring(out, s, len);
+		return;
+	}
+	case LUA_TTABLE:
+		if (depth < FORK_MAXDEPTH && lua_checkstack(L, 2)) {
+			out += (char)FORK_TABLE;
+			lua_pushnil(L);
+			while (lua_next(L, idx)) {
+				fork_pack(L, -2, out, depth + 1);
+				fork_pack(L, -1, out, depth + 1);
+				lua_pop(L, 1);
+			}
+			out += (char)FORK_END;
+			return;
+		}
+		break;
+	}
+	out += (char)FORK_NIL;
+}
+
+static const uint8 *fork_get(const uint8 *p, void *v, size_t size) {
+	memcpy(v, p, size);
+	return p + size;
+}
+
+// Pushes the value packed at p and returns where the next one starts. The data comes
+// from our own child, whose message arrived whole, so it is not checked any further.
+static const uint8 *fork_unpack(lua_State *L, const uint8 *p) {
+	lua_checkstack(L, 3);
+	switch (*p++) {
+	case FORK_FALSE:
+	case FORK_TRUE:
+		lua_pushboolean(L, p[-1] == FORK_TRUE);
+		break;
+	case FORK_NUMBER: {
+		lua_Number v;
+		p = fork_get(p, &v, sizeof(v));
+		lua_pushnumber(L, v);
+		break;
+	}
+	case FORK_STRING: {
+		uint32 len;
+		p = fork_get(p, &len, 4);
+		lua_pushlstring(L, (const char *)p, len);
+		p += len;
+		break;
+	}
+	case FORK_TABLE:
+		lua_newtable(L);
+		while (*p != FORK_END) {
+			p = fork_unpack(L, p);
+			p = fork_unpack(L, p);
+			// pairs that lost their key or value on the way are dropped, and so are NaN keys,
+			// which lua_rawset would raise over while other children are still running
+			if (lua_isnil(L, -2) || lua_isnil(L, -1)
+				|| (lua_type(L, -2) == LUA_TNUMBER && lua_tonumber(L, -2) != lua_tonumber(L, -2)))
+				lua_pop(L, 2);
+			else
+				lua_rawset(L, -3);
+		}
+		p++;
+		break;
+	default:
+		lua_pushnil(L);
+		break;
+	}
+	return p;
+}
+
+// Called in a forked child when its branch is over, with the branch thread as lua_resume
+// left it: the returned values, or the error message. Reports to the parent and exits.
+static void fork_finish(lua_State *thread, int result) {
+	// the size of the message goes first, so the parent can tell a child that died
+	// half way through from one that finished
+	std::string out(4, '\0');
+	if (result) {
+		const char *s = lua_tostring(thread, -1);
+		if (!s)
+			s = "(error object is not a string)";
+		out += (char)0;
+		fork_putstring(out, s, strlen(s));
+	} else {
+		uint32 count = lua_gettop(thread);
+		out += (char)1;
+		fork_put(out, &count, 4);
+		for (uint32 i = 1; i <= count; i++)
+			fork_pack(thread, i, out, 0);
+
+		if (forkChildSends & FORK_SENDSTATE) {
+			uint32 layout = FCEUSS_RawLayout(), size = FCEUSS_RawSize();
+			int32 framecount = currFrameCounter;
+			fork_put(out, &layout, 4);
+			fork_put(out, &framecount, 4);
+			fork_put(out, &size, 4);
+			size_t at = out.size();
+			out.resize(at + size);
+			FCEUSS_SaveRaw((uint8 *)&out[at]);
+			if (forkChildSends & FORK_SENDSCREEN)
+				fork_put(out, XBackBuf, 256 * 256);
+		}
+	}
+	uint32 size = out.size() - 4;
+	memcpy(&out[0], &size, 4);
+
+	for (size_t done = 0; done < out.size(); ) {
+		ssize_t n = write(forkChildFd, out.data() + done, out.size() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		done += n;
+	}
+
+	// _exit, so that nothing the parent had buffered is written out twice
+	fflush(stdout);
+	fflush(stderr);
+	_exit(0);
+}
+
+extern int EnableAutosave;
+
+// Runs in a forked child, with the branch's entry function on top of the stack. It becomes
+// the script's frame advance thread, so emu.frameadvance() inside the branch works as it
+// does in the script, and FCEU_LuaFrameBoundary() hands it to fork_finish() when it returns.
+// Never returns.
+static void fork_runchild(lua_State *L, int fd, int sends) {
+	// a branch that forks again reports to its own parent only
+	if (forkChildFd >= 0)
+		close(forkChildFd);
+	forkChildFd = fd;
+	forkChildSends = sends;
+
+	// the autosave files belong to the parent
+	EnableAutosave = 0;
+
+	lua_State *thread = lua_newthread(L);
+	lua_insert(L, -2);
+	lua_xmove(L, thread, 1);
+	lua_setfield(L, LUA_REGISTRYINDEX, frameAdvanceThread);
+
+	uint8 *gfx;
+	int32 *sound, ssize;
+	for (;;) {
+		// nobody is there to unpause a child
+		FCEUI_FrameAdvanceEnd();
+		FCEUI_SetEmulationPaused(0);
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+		// the branch stopped the script without returning
+		if (!luaRunning) {
+			fflush(stdout);
+			fflush(stderr);
+			_exit(1);
+		}
+	}
+}
+
+struct LuaForkBranch {
+	pid_t pid;
+	int fd;
+	int index;
+	std::string data;
+};
+
+// Turns what a child sent into the entry for its branch in the results table on top of the stack
+static void fork_result(lua_State *L, const LuaForkBranch &branch, int sends) {
+	const uint8 *p = (const uint8 *)branch.data.data();
+	uint32 size = 0;
+	if (branch.data.size() >= 4)
+		p = fork_get(p, &size, 4);
+
+	lua_newtable(L);
+	if (branch.data.size() < 4 || branch.data.size() - 4 != size) {
+		lua_pushstring(L, "the branch stopped the script or died before returning");
+		lua_setfield(L, -2, "error");
+	} else if (*p++ == 0) {
+		uint32 len;
+		p = fork_get(p, &len, 4);
+		lua_pushlstring(L, (const char *)p, len);
+		lua_setfield(L, -2, "error");
+	} else {
+		uint32 count;
+		p = fork_get(p, &count, 4);
+		for (uint32 i = 1; i <= count; i++) {
+			p = fork_unpack(L, p);
+			lua_rawseti(L, -2, i);
+		}
+		lua_pushinteger(L, count);
+		lua_setfield(L, -2, "n");
+
+		// where the branch ended up, as a lean savestate that savestate.load() continues from
+		if (sends & FORK_SENDSTATE) {
+			uint32 layout, rawsize;
+			int32 framecount;
+			p = fork_get(p, &layout, 4);
+			p = fork_get(p, &framecount, 4);
+			p = fork_get(p, &rawsize, 4);
+			LuaSaveState *ss = new(lua_newuserdata(L,sizeof(LuaSaveState))) LuaSaveState();
+			ss->lean = true;
+			ss->anonymous = true;
+			ss->raw.assign(p, p + rawsize);
+			if (sends & FORK_SENDSCREEN) {
+				ss->leanbackbuffer = true;
+				ss->backbuffer.assign(p + rawsize, p + rawsize + 256 * 256);
+			}
+			ss->rawlayout = layout;
+			ss->framecount = framecount;
+			ss->saved = true;
+			savestate_setmetatable(L);
+			lua_setfield(L, -2, "state");
+		}
+	}
+	lua_rawseti(L, -2, branch.index);
+}
+
+// table emu.fork(int n, function branch [, table options])
+//
+//  Runs branch(i) for i = 1..n, each in a forked copy of the emulator, at most
+//  options.jobs at a time (by default, one per processor). A branch plays like the
+//  script itself: it can set the joypads, call emu.frameadvance(), read memory and so
+//  on, and what it does is lost with its process. Returns a table with an entry per
+//  branch, holding what the branch returned (numbers, strings, booleans and tables of
+//  those) and its count in n. With options.state, the entry also has in state a lean
+//  savestate of where the branch ended up, so the script can carry on from the best
+//  branch with savestate.load(); options.screen returns that savestate with the
+//  branch's last frame in it as well, so loading it also shows that frame. A branch that failed has an error message in error instead. The
+//  emulator stands still until all the branches are done. Linux only.
+static int emu_fork(lua_State *L) {
+	int n = luaL_checkinteger(L, 1);
+	luaL_checktype(L, 2, LUA_TFUNCTION);
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN), sends = 0;
+	if (lua_istable(L, 3)) {
+		lua_getfield(L, 3, "jobs");
+		if (!lua_isnil(L, -1))
+			jobs = luaL_checkinteger(L, -1);
+		lua_getfield(L, 3, "state");
+		if (lua_toboolean(L, -1))
+			sends |= FORK_SENDSTATE;
+		lua_getfield(L, 3, "screen");
+		if (lua_toboolean(L, -1))
+			sends |= FORK_SENDSTATE | FORK_SENDSCREEN;
+		lua_pop(L, 3);
+	} else if (!lua_isnoneornil(L, 3))
+		return luaL_error(L, "emu.fork's options must be a table");
+	if (n < 0)
+		return luaL_error(L, "emu.fork needs a number of branches");
+	if (jobs < 1)
+		jobs = 1;
+
+	// the children carry on where the script stands, so they can only start from the main body
+	lua_getfield(L, LUA_REGISTRYINDEX, frameAdvanceThread);
+	bool mainthread = lua_tothread(L, -1) == L;
+	lua_pop(L, 1);
+	if (!mainthread || !frameBoundary)
+		return luaL_error(L, "can't call emu.fork() from here");
+	// every child would append to the same files
+	if (FCEUMOV_Mode(MOVIEMODE_RECORD) || FCEUI_WaveRecordRunning())
+		return luaL_error(L, "can't call emu.fork() while a movie or a wave file is being recorded");
+
+	lua_settop(L, 2);
+	// makes the function a child starts with, which calls branch(i)
+	luaL_loadstring(L, "local branch, i = ... return function() return branch(i) end");
+	lua_createtable(L, n, 0);
+
+	// whatever the parent has buffered would be written by the children as well
+	fflush(stdout);
+	fflush(stderr);
+
+	std::vector<LuaForkBranch> running;
+	std::vector<struct pollfd> fds;
+	int next = 1;
+	while (next <= n || !running.empty()) {
+		while (next <= n && (int)running.size() < jobs) {
+			LuaForkBranch branch;
+			branch.index = next++;
+
+			int pipefd[2];
+			if (pipe(pipefd) < 0) {
+				fork_result(L, branch, sends);
+				continue;
+			}
+
+			lua_pushvalue(L, 3);
+			lua_pushvalue(L, 2);
+			lua_pushinteger(L, branch.index);
+			lua_call(L, 2, 1);
+
+			branch.pid = fork();
+			if (branch.pid == 0) {
+				close(pipefd[0]);
+				for (size_t i = 0; i < running.size(); i++)
+					close(running[i].fd);
+				fork_runchild(L, pipefd[1], sends);
+			}
+			lua_pop(L, 1);
+			close(pipefd[1]);
+			if (branch.pid < 0) {
+				close(pipefd[0]);
+				fork_result(L, branch, sends);
+				continue;
+			}
+			branch.fd = pipefd[0];
+			running.push_back(branch);
+		}
+
+		fds.resize(running.size());
+		for (size_t i = 0; i < running.size(); i++) {
+			fds[i].fd = running[i].fd;
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+		}
+		if (poll(&fds[0], fds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		// walk backwards, so that finished branches can be taken out as we go
+		for (size_t i = running.size(); i-- > 0; ) {
+			if (!fds[i].revents)
+				continue;
+			char buf[65536];
+			ssize_t got = read(running[i].fd, buf, sizeof(buf));
+			if (got < 0 && errno == EINTR)
+				continue;
+			if (got > 0) {
+				running[i].data.append(buf, got);
+				continue;
+			}
+			close(running[i].fd);
+			while (waitpid(running[i].pid, NULL, 0) < 0 && errno == EINTR) {}
+			fork_result(L, running[i], sends);
+			running.erase(running.begin() + i);
+		}
+	}
+
+	// poll failing is not something to wait out
+	for (size_t i = 0; i < running.size(); i++) {
+		kill(running[i].pid, SIGKILL);
+		close(running[i].fd);
+		while (waitpid(running[i].pid, NULL, 0) < 0 && errno == EINTR) {}
+		running[i].data.clear();
+		fork_result(L, running[i], sends);
+	}
+
+	return 1;
+}
+#endif
 
 // int emu.framecount()
 //
@@ -2781,6 +3758,76 @@ int emu_emulating(lua_State *L) {
 	return 1;
 }
 
+// table emu.perf()
+//
+//   Returns the average per-frame milliseconds spent in each subsystem over the last second,
+//   with the worst frame of each in a "max" subtable and the average hook counts alongside.
+//   Returns nil if this build has no profiling timers.
+int emu_perf(lua_State *L) {
+	FCEU_PROFILE_STATS stats;
+	if (!FCEUI_GetProfileStats(&stats))
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+
+	lua_newtable(L);
+	lua_newtable(L);
+	for (int i = 0; i < PROFILE_STAGE_COUNT; i++)
+	{
+		lua_pushnumber(L, stats.max[i]);
+		lua_setfield(L, -2, FCEUI_ProfileStageName(i));
+	}
+	lua_pushnumber(L, stats.maxtotal);
+	lua_setfield(L, -2, "total");
+	lua_setfield(L, -2, "max");
+
+	for (int i = 0; i < PROFILE_STAGE_COUNT; i++)
+	{
+		lua_pushnumber(L, stats.avg[i]);
+		lua_setfield(L, -2, FCEUI_ProfileStageName(i));
+	}
+	lua_pushnumber(L, stats.avgtotal);
+	lua_setfield(L, -2, "total");
+	for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+	{
+		lua_pushnumber(L, stats.counts[i]);
+		lua_setfield(L, -2, FCEUI_ProfileCounterName(i));
+	}
+	lua_pushinteger(L, stats.frames);
+	lua_setfield(L, -2, "frames");
+	return 1;
+}
+
+// string emu.hashstate([string parts [, int bits]])
+//
+//   Returns a hash of the machine state as hex digits: 16 of them, or 32 when bits is 128.
+//   parts names what it covers, like "cpu,ram,oam"; the default is "all". Equal hashes
+//   mean equal state, in any build on any machine. Returns nil when no game is loaded.
+int emu_hashstate(lua_State *L) {
+	if (!GameInfo)
+	{
+		lua_pushnil(L);
+		return 1;
+	}
+	uint32 parts = FCEU_HASH_ALL;
+	if (!lua_isnoneornil(L, 1) && !FCEUI_HashParseParts(luaL_checkstring(L, 1), &parts))
+		luaL_error(L, "unknown part in \"%s\"; the parts are cpu, ram, wram, ppu, oam, apu, mapper, input and all", lua_tostring(L, 1));
+	int bits = luaL_optinteger(L, 2, 64);
+	if (bits != 64 && bits != 128)
+		luaL_error(L, "bits must be 64 or 128");
+
+	char hex[33];
+	uint64 high;
+	uint64 low = FCEUI_HashState(parts, &high);
+	if (bits == 128)
+		sprintf(hex, "%016llx%016llx", (unsigned long long)high, (unsigned long long)low);
+	else
+		sprintf(hex, "%016llx", (unsigned long long)low);
+	lua_pushstring(L, hex);
+	return 1;
+}
+
 // string movie.mode()
 //
 //   Returns "taseditor", "record", "playback", "finished" or nil
@@ -5367,6 +6414,10 @@ static const struct luaL_reg emulib [] = {
 	{"softreset", emu_softreset},
 	{"speedmode", emu_speedmode},
 	{"frameadvance", emu_frameadvance},
+	{"runplan", emu_runplan},
+#ifdef __linux
+	{"fork", emu_fork},
+#endif
 	{"paused", emu_paused},
 	{"pause", emu_pause},
 	{"unpause", emu_unpause},
@@ -5379,6 +6430,8 @@ static const struct luaL_reg emulib [] = {
 	{"lagged", emu_lagged},
 	{"setlagflag", emu_setlagflag},
 	{"emulating", emu_emulating},
+	{"perf", emu_perf},
+	{"hashstate", emu_hashstate},
 	{"registerbefore", emu_registerbefore},
 	{"registerafter", emu_registerafter},
 	{"registerexit", emu_registerexit},
@@ -5406,6 +6459,7 @@ static const struct luaL_reg memorylib [] = {
 
 	{"readbyte", memory_readbyte},
 	{"readbyterange", memory_readbyterange},
+	{"view", memory_view},
 	{"readbytesigned", memory_readbytesigned},	
 	{"readbyteunsigned", memory_readbyte},	// alternate naming scheme for unsigned
 	{"readword", memory_readword},
@@ -5460,6 +6514,7 @@ static const struct luaL_reg inputlib[] = {
 static const struct luaL_reg savestatelib[] = {
 	{"create", savestate_create},
 	{"object", savestate_object},
+	{"createlean", savestate_createlean},
 	{"save", savestate_save},
 	{"persist", savestate_persist},
 	{"load", savestate_load},
@@ -5609,17 +6664,33 @@ void FCEU_LuaFrameBoundary()
 	if (!L || !luaRunning)
 		return;
 
+	FCEU_PROFILE_STAGE(PROFILE_LUA);
+
 	// Our function needs calling
 	lua_settop(L,0);
 	lua_getfield(L, LUA_REGISTRYINDEX, frameAdvanceThread);
 	lua_State *thread = lua_tothread(L,1);
 
+	// An input plan plays out without the script; it is resumed with the result after the last frame
+	int nargs = 0;
+	if (luaPlan.frames) {
+		if (FCEU_LuaPlanStep(thread))
+			return;
+		nargs = 1;
+	}
+
 	// Lua calling C must know that we're busy inside a frame boundary
 	frameBoundary = TRUE;
 	frameAdvanceWaiting = FALSE;
 
 	numTries = 1000;
-	int result = lua_resume(thread, 0);
+	int result = lua_resume(thread, nargs);
+
+#ifdef __linux
+	// a forked branch is over, however it ended
+	if (forkChildFd >= 0 && result != LUA_YIELD)
+		fork_finish(thread, result);
+#endif
 
 	if (result == LUA_YIELD) {
 		// Okay, we're fine with that.
@@ -5964,6 +7035,8 @@ void FCEU_LuaGui(uint8 *XBuf)
 	if (!L/* || !luaRunning*/)
 		return;
 
+	FCEU_PROFILE_STAGE(PROFILE_LUA);
+
 	// First, check if we're being called by anybody
 	lua_getfield(L, LUA_REGISTRYINDEX, guiCallbackTable);
 
@@ -286,7 +286,8 @@ void MovieRecord::parse(MovieData* md, EMUFILE* is)
 }
 
 
-bool MovieRecord::parseBinary(MovieData* md, EMUFILE* is)
+template<typename STREAM>
+bool MovieRecord::parseBinary(MovieData* md, STREAM* is)
 {
 	commands = (uint8)is->fgetc();
 
@@ -309,7 +310,7 @@ bool MovieRecord::parseBinary(MovieData* md, EMUFILE* is)
 				zappers[port].y = (uint8)is->fgetc();
 				zappers[port].b = (uint8)is->fgetc();
 				zappers[port].bogo = (uint8)is->fgetc();
-				read64le(&zappers[port].zaphit,is);
+				is->read64le(&zappers[port].zaphit);
 			}
 		}
 	}
@@ -318,9 +319,10 @@ bool MovieRecord::parseBinary(MovieData* md, EMUFILE* is)
 }
 
 
-void MovieRecord::dumpBinary(MovieData* md, EMUFILE* os, int index)
+template<typename STREAM>
+void MovieRecord::dumpBinary(MovieData* md, STREAM* os, int index)
 {
-	write8le(commands,os);
+	os->write8le(commands);
 	if(md->fourscore)
 	{
 		for(int i=0;i<4;i++)
@@ -334,16 +336,21 @@ void MovieRecord::dumpBinary(MovieData* md, EMUFILE* os, int index)
 				os->fwrite(&joysticks[port],sizeof(joysticks[port]));
 			else if(md->ports[port] == SI_ZAPPER)
 			{
-				write8le(zappers[port].x,os);
-				write8le(zappers[port].y,os);
-				write8le(zappers[port].b,os);
-				write8le(zappers[port].bogo,os);
-				write64le(zappers[port].zaphit, os);
+				os->write8le(zappers[port].x);
+				os->write8le(zappers[port].y);
+				os->write8le(zappers[port].b);
+				os->write8le(zappers[port].bogo);
+				os->write64le(zappers[port].zaphit);
 			}
 		}
 	}
 }
 
+template bool MovieRecord::parseBinary<EMUFILE>(MovieData* md, EMUFILE* is);
+template bool MovieRecord::parseBinary<EMUFILE_MEMORY_SPAN>(MovieData* md, EMUFILE_MEMORY_SPAN* is);
+template void MovieRecord::dumpBinary<EMUFILE>(MovieData* md, EMUFILE* os, int index);
+template void MovieRecord::dumpBinary<EMUFILE_MEMORY_SPAN>(MovieData* md, EMUFILE_MEMORY_SPAN* os, int index);
+
 void MovieRecord::dump(MovieData* md, EMUFILE* os, int index)
 {
 	// dump the commands
@@ -495,8 +502,19 @@ int MovieData::dump(EMUFILE *os, bool binary)
 	{
 		//put one | to start the binary dump
 		os->fputc('|');
-		for(int i=0;i<(int)records.size();i++)
-			records[i].dumpBinary(this, os, i);
+		//savestates always dump into memory, so take the fast path there
+		EMUFILE_MEMORY* mem = dynamic_cast<EMUFILE_MEMORY*>(os);
+		if(mem)
+		{
+			EMUFILE_MEMORY_SPAN span(mem);
+			for(int i=0;i<(int)records.size();i++)
+				records[i].dumpBinary(this, &span, i);
+		}
+		else
+		{
+			for(int i=0;i<(int)records.size();i++)
+				records[i].dumpBinary(this, os, i);
+		}
 	} else
 	{
 		for(int i=0;i<(int)records.size();i++)
@@ -589,9 +607,17 @@ static void LoadFM2_binarychunk(MovieData& movieData, EMUFILE* fp, int size)
 		numRecords=movieData.loadFrameCount;
 
 	movieData.records.resize(numRecords);
-	for(int i=0;i<numRecords;i++)
+	EMUFILE_MEMORY* mem = dynamic_cast<EMUFILE_MEMORY*>(fp);
+	if(mem)
+	{
+		EMUFILE_MEMORY_SPAN span(mem);
+		for(int i=0;i<numRecords;i++)
+			movieData.records[i].parseBinary(&movieData,&span);
+	}
+	else
 	{
-		movieData.records[i].parseBinary(&movieData,fp);
+		for(int i=0;i<numRecords;i++)
+			movieData.records[i].parseBinary(&movieData,fp);
 	}
 }
 
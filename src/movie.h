@@ -150,9 +150,10 @@ public:
 	void clear();
 
 	void parse(MovieData* md, EMUFILE* is);
-	bool parseBinary(MovieData* md, EMUFILE* is);
 	void dump(MovieData* md, EMUFILE* os, int index);
-	void dumpBinary(MovieData* md, EMUFILE* os, int index);
+	//the binary forms take either an EMUFILE or an EMUFILE_MEMORY_SPAN
+	template<typename STREAM> bool parseBinary(MovieData* md, STREAM* is);
+	template<typename STREAM> void dumpBinary(MovieData* md, STREAM* os, int index);
 	void parseJoy(EMUFILE* is, uint8& joystate);
 	void dumpJoy(EMUFILE* os, uint8 joystate);
 
@@ -136,7 +136,7 @@ void NSFGI(GI h)
 	{
 	case GI_CLOSE:
 		if(NSFDATA) {free(NSFDATA);NSFDATA=0;}
-		if(ExWRAM) {free(ExWRAM);ExWRAM=0;}
+		if(ExWRAM) {FCEU_gfree(ExWRAM);ExWRAM=0;}
 		if(NSFHeader.SoundChip&1) {
 			//   NSFVRC6_Init();
 		} else if(NSFHeader.SoundChip&2) {
@@ -36,6 +36,7 @@
 #include "input.h"
 #include "driver.h"
 #include "debug.h"
+#include "profile.h"
 		 
 #include <cstring>
 #include <cstdio>
@@ -809,6 +810,7 @@ static DECLFW(B2003) {
 
 static DECLFW(B2004) {
 	PPUGenLatch = V;
+	StateHashDirty |= FCEU_HASH_OAM;
 	if (newppu) {
 		//the attribute upper bits are not connected
 		//so AND them out on write, since reading them
@@ -886,6 +888,7 @@ static DECLFW(B2006) {
 static DECLFW(B2007) {
 	uint32 tmp = RefreshAddr & 0x3FFF;
 
+	StateHashDirty |= FCEU_HASH_PPU;
 	if (newppu) {
 		PPUGenLatch = V;
 		RefreshAddr = ppur.get_2007access() & 0x3FFF;
@@ -1007,10 +1010,12 @@ static void CheckSpriteHit(int p) {
 //Needed for zapper emulation and *gasp* sprite emulation.
 static int spork = 0;
 
+//background shift registers, carried from one RefreshLine() call to the next
+static uint32 pshift[2];
+static uint32 atlatch;
+
 // lasttile is really "second to last tile."
 static void RefreshLine(int lastpixel) {
-	static uint32 pshift[2];
-	static uint32 atlatch;
 	uint32 smorkus = RefreshAddr;
 
 	#define RefreshAddr smorkus
@@ -1194,6 +1199,11 @@ static void RefreshLine(int lastpixel) {
 	firsttile = lasttile;
 }
 
+static INLINE void CallHBIRQHook(void) {
+	FCEU_PROFILE_COUNT(PROFILE_SCANLINEHOOK);
+	GameHBIRQHook();
+}
+
 static INLINE void Fixit2(void) {
 	if (ScreenON || SpriteON) {
 		uint32 rad = RefreshAddr;
@@ -1273,6 +1283,9 @@ static void DoLine(void) {
 	for (x = 63; x >= 0; x--)
 		*(uint32*)&dtarget[x << 2] = ((PPU[1]>>5)<<0)|((PPU[1]>>5)<<8)|((PPU[1]>>5)<<16)|((PPU[1]>>5)<<24);
 
+	if (scanline < 240)
+		FCEU_CheckDirtyLine(scanline);
+
 	sphitx = 0x100;
 
 	if (ScreenON || SpriteON)
@@ -1282,7 +1295,7 @@ static void DoLine(void) {
 		X6502_Run(6);
 		Fixit2();
 		X6502_Run(4);
-		GameHBIRQHook();
+		CallHBIRQHook();
 		X6502_Run(85 - 16 - 10);
 	} else {
 		X6502_Run(6);	// Tried 65, caused problems with Slalom(maybe others)
@@ -1291,7 +1304,7 @@ static void DoLine(void) {
 
 		// A semi-hack for Star Trek: 25th Anniversary
 		if (GameHBIRQHook && (ScreenON || SpriteON) && ((PPU[0] & 0x38) != 0x18))
-			GameHBIRQHook();
+			CallHBIRQHook();
 	}
 
 	DEBUG(FCEUD_UpdateNTView(scanline, 0));
@@ -1693,6 +1706,9 @@ void FCEUPPU_Power(void) {
 	memset(SPRAM, 0x00, 0x100);
 	FCEUPPU_Reset();
 
+	//otherwise the last game's tiles leak into the first rendered line
+	pshift[0] = pshift[1] = atlatch = 0;
+
 	for (x = 0x2000; x < 0x4000; x += 8) {
 		ARead[x] = A200x;
 		BWrite[x] = B2000;
@@ -1715,6 +1731,8 @@ void FCEUPPU_Power(void) {
 }
 
 int FCEUPPU_Loop(int skip) {
+	FCEU_PROFILE_STAGE(PROFILE_PPU);
+
 	if ((newppu) && (GameInfo->type != GIT_NSF)) {
 		int FCEUX_PPU_Loop(int skip);
 		return FCEUX_PPU_Loop(skip);
@@ -1723,6 +1741,7 @@ int FCEUPPU_Loop(int skip) {
 	//Needed for Knight Rider, possibly others.
 	if (ppudead) {
 		memset(XBuf, 0x80, 256 * 240);
+		FCEU_InvalidateImage();
 		X6502_Run(scanlines_per_frame * (256 + 85));
 		ppudead--;
 	} else {
@@ -1751,7 +1770,7 @@ int FCEUPPU_Loop(int skip) {
 
 			if (ScreenON || SpriteON) {
 				if (GameHBIRQHook && ((PPU[0] & 0x38) != 0x18))
-					GameHBIRQHook();
+					CallHBIRQHook();
 				if (PPU_hook)
 					for (x = 0; x < 42; x++) {
 						PPU_hook(0x2000); PPU_hook(0);
@@ -1786,7 +1805,7 @@ int FCEUPPU_Loop(int skip) {
 				X6502_Run(256);
 				for (scanline = 0; scanline < 240; scanline++) {
 					if (ScreenON || SpriteON)
-						GameHBIRQHook();
+						CallHBIRQHook();
 					if (scanline == y && SpriteON) PPU_status |= 0x40;
 					X6502_Run((scanline == 239) ? 85 : (256 + 85));
 				}
@@ -2190,6 +2209,9 @@ int FCEUX_PPU_Loop(int skip) {
 				}
 			}
 
+			if (sl != 0 && sl < 241)
+				FCEU_CheckDirtyLine(yp);
+
 			//look for sprites (was supposed to run concurrent with bg rendering)
 			oamcounts[scanslot] = 0;
 			oamcount = 0;
@@ -2308,7 +2330,7 @@ int FCEUX_PPU_Loop(int skip) {
 					//kirby requires deferring this til somewhere in sprite [2,5..
 					//if (PPUON && GameHBIRQHook) {
 					if (GameHBIRQHook) {
-						GameHBIRQHook();
+						CallHBIRQHook();
 					}
 				}
 
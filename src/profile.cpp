@@ -0,0 +1,250 @@
+/// \file
+/// \brief per-frame timing of the emulator's subsystems. the timers themselves are only compiled in with FCEU_PROFILE
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "types.h"
+#include "fceu.h"
+#include "driver.h"
+#include "drawing.h"
+#include "video.h"
+#include "profile.h"
+
+//frames kept for the rolling statistics
+#define PROFILE_WINDOW 60
+
+static const char* StageNames[PROFILE_STAGE_COUNT] = { "other", "cpu", "ppu", "apu", "filter", "lua", "blit" };
+static const char* CounterNames[PROFILE_COUNTER_COUNT] = { "cpuirqhooks", "scanlinehooks", "memhooks" };
+
+uint32 FCEU_ProfileCounts[PROFILE_COUNTER_COUNT];
+
+static int CurrentStage = PROFILE_OTHER;
+static uint64 LastTick;
+static uint64 StageTicks[PROFILE_STAGE_COUNT];
+
+struct PROFILE_FRAME
+{
+	uint64 ticks[PROFILE_STAGE_COUNT];
+	uint32 counts[PROFILE_COUNTER_COUNT];
+};
+static PROFILE_FRAME History[PROFILE_WINDOW];
+static int HistoryPos, HistoryCount;
+static uint32 FrameNumber;
+
+static FILE *CSV;
+static bool Show_Profile;
+
+uint64 FCEU_GetTicks()
+{
+#ifdef WIN32
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return t.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+double FCEU_TicksToMs(uint64 ticks)
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq;
+	if(!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	return (double)ticks * 1000.0 / (double)freq.QuadPart;
+#else
+	return (double)ticks / 1000000.0;
+#endif
+}
+
+int FCEU_ProfileEnter(int stage)
+{
+	uint64 now = FCEU_GetTicks();
+	StageTicks[CurrentStage] += now - LastTick;
+	LastTick = now;
+	int prev = CurrentStage;
+	CurrentStage = stage;
+	return prev;
+}
+
+void FCEU_ProfileLeave(int prev)
+{
+	uint64 now = FCEU_GetTicks();
+	StageTicks[CurrentStage] += now - LastTick;
+	LastTick = now;
+	CurrentStage = prev;
+}
+
+void FCEU_ProfileAdd(int stage, uint64 ticks)
+{
+	StageTicks[stage] += ticks;
+}
+
+void FCEU_ProfileFrame(void)
+{
+	uint64 now = FCEU_GetTicks();
+
+	//the very first boundary only starts the clock
+	if(LastTick)
+	{
+		StageTicks[CurrentStage] += now - LastTick;
+
+		PROFILE_FRAME &f = History[HistoryPos];
+		memcpy(f.ticks,StageTicks,sizeof(StageTicks));
+		memcpy(f.counts,FCEU_ProfileCounts,sizeof(FCEU_ProfileCounts));
+		HistoryPos = (HistoryPos + 1) % PROFILE_WINDOW;
+		if(HistoryCount < PROFILE_WINDOW)
+			HistoryCount++;
+
+		if(CSV)
+		{
+			uint64 total = 0;
+			fprintf(CSV,"%u",FrameNumber);
+			for(int i=0;i<PROFILE_STAGE_COUNT;i++)
+			{
+				fprintf(CSV,",%.3f",FCEU_TicksToMs(f.ticks[i]));
+				total += f.ticks[i];
+			}
+			fprintf(CSV,",%.3f",FCEU_TicksToMs(total));
+			for(int i=0;i<PROFILE_COUNTER_COUNT;i++)
+				fprintf(CSV,",%u",f.counts[i]);
+			fputc('\n',CSV);
+		}
+		FrameNumber++;
+	}
+
+	memset(StageTicks,0,sizeof(StageTicks));
+	memset(FCEU_ProfileCounts,0,sizeof(FCEU_ProfileCounts));
+	LastTick = now;
+}
+
+bool FCEUI_ProfileAvailable()
+{
+#ifdef FCEU_PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool FCEUI_GetProfileStats(FCEU_PROFILE_STATS *stats)
+{
+	memset(stats,0,sizeof(*stats));
+	if(!HistoryCount)
+		return false;
+
+	stats->frames = HistoryCount;
+	for(int n=0;n<HistoryCount;n++)
+	{
+		const PROFILE_FRAME &f = History[n];
+		double total = 0;
+		for(int i=0;i<PROFILE_STAGE_COUNT;i++)
+		{
+			double ms = FCEU_TicksToMs(f.ticks[i]);
+			stats->avg[i] += ms;
+			if(ms > stats->max[i])
+				stats->max[i] = ms;
+			total += ms;
+		}
+		stats->avgtotal += total;
+		if(total > stats->maxtotal)
+			stats->maxtotal = total;
+		for(int i=0;i<PROFILE_COUNTER_COUNT;i++)
+			stats->counts[i] += f.counts[i];
+	}
+
+	for(int i=0;i<PROFILE_STAGE_COUNT;i++)
+		stats->avg[i] /= HistoryCount;
+	stats->avgtotal /= HistoryCount;
+	for(int i=0;i<PROFILE_COUNTER_COUNT;i++)
+		stats->counts[i] /= HistoryCount;
+	return true;
+}
+
+const char* FCEUI_ProfileStageName(int stage)
+{
+	return (stage >= 0 && stage < PROFILE_STAGE_COUNT) ? StageNames[stage] : "";
+}
+
+const char* FCEUI_ProfileCounterName(int counter)
+{
+	return (counter >= 0 && counter < PROFILE_COUNTER_COUNT) ? CounterNames[counter] : "";
+}
+
+bool FCEUI_SetProfileCSV(const char *fname)
+{
+	if(CSV)
+	{
+		fclose(CSV);
+		CSV = NULL;
+	}
+	if(!fname || !*fname)
+		return true;
+
+	if(!FCEUI_ProfileAvailable())
+	{
+		FCEU_PrintError("This build has no profiling timers; rebuild with PROFILE=1 to write %s.",fname);
+		return false;
+	}
+
+	CSV = FCEUD_UTF8fopen(fname,"w");
+	if(!CSV)
+	{
+		FCEU_PrintError("Error opening profile log %s.",fname);
+		return false;
+	}
+
+	fprintf(CSV,"frame");
+	for(int i=0;i<PROFILE_STAGE_COUNT;i++)
+		fprintf(CSV,",%s_ms",StageNames[i]);
+	fprintf(CSV,",total_ms");
+	for(int i=0;i<PROFILE_COUNTER_COUNT;i++)
+		fprintf(CSV,",%s",CounterNames[i]);
+	fputc('\n',CSV);
+	FrameNumber = 0;
+	return true;
+}
+
+bool FCEUI_ShowProfile()
+{
+	return Show_Profile;
+}
+void FCEUI_SetShowProfile(bool show)
+{
+	Show_Profile = show;
+}
+void FCEUI_ToggleShowProfile()
+{
+	Show_Profile ^= 1;
+}
+
+void FCEU_DrawProfile(uint8 *XBuf)
+{
+	FCEU_PROFILE_STATS stats;
+	if(!Show_Profile || !FCEUI_GetProfileStats(&stats))
+		return;
+
+	//avg and max per stage, then the hook counts
+	char line[64];
+	int y = FSettings.FirstSLine + 4;
+	for(int i=0;i<PROFILE_STAGE_COUNT;i++)
+	{
+		sprintf(line,"%-6s %5.2f %5.2f",StageNames[i],stats.avg[i],stats.max[i]);
+		DrawTextTrans(XBuf + ClipSidesOffset + 2 + y*256, 256, (uint8*)line, 0xA0);
+		y += 9;
+	}
+	sprintf(line,"%-6s %5.2f %5.2f","total",stats.avgtotal,stats.maxtotal);
+	DrawTextTrans(XBuf + ClipSidesOffset + 2 + y*256, 256, (uint8*)line, 0xA0);
+	y += 9;
+	sprintf(line,"irq %d hb %d mem %d",(int)stats.counts[PROFILE_CPUIRQHOOK],(int)stats.counts[PROFILE_SCANLINEHOOK],(int)stats.counts[PROFILE_MEMHOOK]);
+	DrawTextTrans(XBuf + ClipSidesOffset + 2 + y*256, 256, (uint8*)line, 0xA0);
+}
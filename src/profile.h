@@ -0,0 +1,84 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "types.h"
+
+//the stages a frame's time is split into. time is exclusive: while the ppu runs the cpu, that time
+//goes to the cpu. PROFILE_OTHER collects everything outside a timed stage (driver input, throttling, etc.)
+enum EPROFILESTAGE
+{
+	PROFILE_OTHER,
+	PROFILE_CPU,
+	PROFILE_PPU,
+	PROFILE_APU,
+	PROFILE_FILTER,
+	PROFILE_LUA,
+	PROFILE_BLIT,	//timed on the display thread, while the emulation thread runs the others
+	PROFILE_STAGE_COUNT
+};
+
+//events counted per frame
+enum EPROFILECOUNTER
+{
+	PROFILE_CPUIRQHOOK,		//MapIRQHook calls
+	PROFILE_SCANLINEHOOK,	//GameHBIRQHook calls
+	PROFILE_MEMHOOK,		//lua memory hooks that fired
+	PROFILE_COUNTER_COUNT
+};
+
+//rolling statistics over the last few frames, times in milliseconds
+struct FCEU_PROFILE_STATS
+{
+	int frames;
+	double avg[PROFILE_STAGE_COUNT], max[PROFILE_STAGE_COUNT];
+	double avgtotal, maxtotal;
+	double counts[PROFILE_COUNTER_COUNT]; //average per frame
+};
+
+//a monotonic clock, always compiled in so other timing (run-ahead, etc.) can use it
+uint64 FCEU_GetTicks();
+double FCEU_TicksToMs(uint64 ticks);
+
+int FCEU_ProfileEnter(int stage);
+void FCEU_ProfileLeave(int prev);
+void FCEU_ProfileFrame(void);
+//adds time measured on another thread, such as the display's, to the frame being timed.
+//the stage state belongs to the emulation thread, so call it there
+void FCEU_ProfileAdd(int stage, uint64 ticks);
+extern uint32 FCEU_ProfileCounts[PROFILE_COUNTER_COUNT];
+
+#ifdef FCEU_PROFILE
+class FCEU_PROFILE_SCOPE
+{
+	int prev;
+public:
+	FCEU_PROFILE_SCOPE(int stage) : prev(FCEU_ProfileEnter(stage)) {}
+	~FCEU_PROFILE_SCOPE() { FCEU_ProfileLeave(prev); }
+};
+#define FCEU_PROFILE_STAGE(stage) FCEU_PROFILE_SCOPE _profile_scope(stage)
+#define FCEU_PROFILE_COUNT(counter) (FCEU_ProfileCounts[counter]++)
+#define FCEU_PROFILE_FRAME() FCEU_ProfileFrame()
+#define FCEU_PROFILE_ADD(stage,ticks) FCEU_ProfileAdd(stage,ticks)
+#else
+#define FCEU_PROFILE_STAGE(stage)
+#define FCEU_PROFILE_COUNT(counter)
+#define FCEU_PROFILE_FRAME()
+#define FCEU_PROFILE_ADD(stage,ticks)
+#endif
+
+//whether the timers were compiled in
+bool FCEUI_ProfileAvailable();
+//false until at least one frame has been timed
+bool FCEUI_GetProfileStats(FCEU_PROFILE_STATS *stats);
+const char* FCEUI_ProfileStageName(int stage);
+const char* FCEUI_ProfileCounterName(int counter);
+
+//writes one line per emulated frame to fname (which may be a fifo); NULL stops it
+bool FCEUI_SetProfileCSV(const char *fname);
+
+bool FCEUI_ShowProfile();
+void FCEUI_SetShowProfile(bool show);
+void FCEUI_ToggleShowProfile();
+void FCEU_DrawProfile(uint8 *XBuf);
+
+#endif
@@ -0,0 +1,380 @@
+/// \file
+/// \brief persistent index of a rom library, so loads can skip hashing and archive scans
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef WIN32
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#endif
+
+#include "types.h"
+#include "fceu.h"
+#include "file.h"
+#include "cart.h"
+#include "ines.h"
+#include "romindex.h"
+#include "emufile.h"
+#ifdef _SYSTEM_MINIZIP
+#include <minizip/unzip.h>
+#else
+#include "utils/unzip.h"
+#endif
+
+#define ROMINDEX_VERSION 2
+static const char ROMINDEX_MAGIC[8] = { 'F','C','E','U','X','I','D','X' };
+
+typedef std::map<std::string, ROMINDEX_ENTRY> TRomIndex;
+static TRomIndex RomIndex;
+
+static std::string AbsolutePath(const char *path)
+{
+#ifndef WIN32
+	char buf[PATH_MAX];
+	if(realpath(path,buf))
+		return buf;
+#endif
+	return path;
+}
+
+static bool StatFile(const std::string& path, uint64 *mtime, uint64 *size)
+{
+	struct stat st;
+	if(stat(path.c_str(),&st) == -1 || !S_ISREG(st.st_mode))
+		return false;
+	*mtime = (uint64)st.st_mtime;
+	*size = (uint64)st.st_size;
+	return true;
+}
+
+static void WriteString(EMUFILE *os, const std::string& str)
+{
+	os->write32le((u32)str.size());
+	os->fwrite(str.c_str(),str.size());
+}
+
+static bool ReadString(EMUFILE *is, std::string *str)
+{
+	u32 len;
+	if(!is->read32le(&len) || len > PATH_MAX * 2)
+		return false;
+	str->resize(len);
+	if(len && is->fread(&(*str)[0],len) != len)
+		return false;
+	return true;
+}
+
+static void WriteEntry(EMUFILE *os, const ROMINDEX_ENTRY& e)
+{
+	WriteString(os,e.path);
+	WriteString(os,e.member);
+	os->write64le(e.mtime);
+	os->write64le(e.size);
+	os->write32le(e.crc32);
+	os->fwrite(e.md5,16);
+	os->write32le((u32)e.mapper);
+	os->write8le(e.mirroring);
+	os->write8le(e.battery);
+	os->write8le(e.fixed);
+	os->write32le(e.prg_banks);
+	os->write32le(e.chr_banks);
+}
+
+static bool ReadEntry(EMUFILE *is, ROMINDEX_ENTRY *e)
+{
+	u32 mapper;
+	if(!ReadString(is,&e->path) || !ReadString(is,&e->member))
+		return false;
+	is->read64le(&e->mtime);
+	is->read64le(&e->size);
+	is->read32le(&e->crc32);
+	is->fread(e->md5,16);
+	is->read32le(&mapper);
+	e->mapper = (int32)mapper;
+	is->read8le(&e->mirroring);
+	is->read8le(&e->battery);
+	is->read8le(&e->fixed);
+	is->read32le(&e->prg_banks);
+	is->read32le(&e->chr_banks);
+	return !is->fail();
+}
+
+bool FCEUI_LoadRomIndex(const char *fname)
+{
+	RomIndex.clear();
+
+	EMUFILE_FILE is(fname,"rb");
+	if(is.fail())
+		return false;
+
+	char magic[8];
+	u32 version = 0, count = 0;
+	if(is.fread(magic,8) != 8 || memcmp(magic,ROMINDEX_MAGIC,8) || !is.read32le(&version) || version != ROMINDEX_VERSION || !is.read32le(&count))
+	{
+		FCEU_printf("Ignoring rom index %s: unrecognized format.\n",fname);
+		return false;
+	}
+
+	for(u32 i=0;i<count;i++)
+	{
+		ROMINDEX_ENTRY e;
+		if(!ReadEntry(&is,&e))
+		{
+			FCEU_printf("Ignoring rom index %s: file is truncated.\n",fname);
+			RomIndex.clear();
+			return false;
+		}
+		RomIndex[e.path] = e;
+	}
+
+	FCEU_printf("Loaded rom index %s (%d images).\n",fname,(int)RomIndex.size());
+	return true;
+}
+
+const ROMINDEX_ENTRY* FCEU_RomIndexFind(const char *path)
+{
+	if(RomIndex.empty())
+		return NULL;
+
+	//members picked out of an archive by the driver's archive browser arent indexed
+	std::string archive, file, fileToOpen;
+	FCEU_SplitArchiveFilename(path,archive,file,fileToOpen);
+	if(archive != "")
+		return NULL;
+
+	TRomIndex::const_iterator it = RomIndex.find(AbsolutePath(fileToOpen.c_str()));
+	if(it == RomIndex.end())
+		return NULL;
+
+	uint64 mtime, size;
+	if(!StatFile(it->first,&mtime,&size) || mtime != it->second.mtime || size != it->second.size)
+		return NULL;
+	return &it->second;
+}
+
+#ifndef WIN32
+
+static bool HasExtension(const std::string& name, const char *ext)
+{
+	size_t len = strlen(ext);
+	return name.size() >= len && !strcasecmp(name.c_str() + name.size() - len, ext);
+}
+
+//the same test TryUnzip uses to pick the member it loads
+static bool IsRomName(const std::string& name)
+{
+	return HasExtension(name,".nes") || HasExtension(name,".fds") || HasExtension(name,".nsf")
+		|| HasExtension(name,".unf") || HasExtension(name,".nez") || HasExtension(name,".unif");
+}
+
+static void CollectFiles(const std::string& dir, std::vector<std::string> *files)
+{
+	DIR *d = opendir(dir.c_str());
+	if(!d)
+		return;
+
+	struct dirent *de;
+	while((de = readdir(d)) != NULL)
+	{
+		if(de->d_name[0] == '.')
+			continue;
+
+		std::string path = dir + PSS + de->d_name;
+		struct stat st;
+		if(stat(path.c_str(),&st) == -1)
+			continue;
+		if(S_ISDIR(st.st_mode))
+			CollectFiles(path,files);
+		else if(S_ISREG(st.st_mode) && (HasExtension(path,".nes") || HasExtension(path,".zip") || HasExtension(path,".gz")))
+			files->push_back(path);
+	}
+	closedir(d);
+}
+
+static bool ReadZipImage(const std::string& path, std::string *member, std::vector<u8> *buf)
+{
+	unzFile tz = unzOpen(path.c_str());
+	if(!tz)
+		return false;
+
+	bool ok = false;
+	if(unzGoToFirstFile(tz) == UNZ_OK)
+	{
+		do {
+			char tempu[512];
+			unz_file_info ufo;
+			unzGetCurrentFileInfo(tz,&ufo,tempu,512,0,0,0,0);
+			tempu[511] = 0;
+			if(!IsRomName(tempu))
+				continue;
+
+			if(ufo.uncompressed_size && unzOpenCurrentFile(tz) == UNZ_OK)
+			{
+				buf->resize(ufo.uncompressed_size);
+				ok = unzReadCurrentFile(tz,&(*buf)[0],ufo.uncompressed_size) == (int)ufo.uncompressed_size;
+				unzCloseCurrentFile(tz);
+				*member = tempu;
+			}
+			break;
+		} while(unzGoToNextFile(tz) == UNZ_OK);
+	}
+	unzClose(tz);
+	return ok;
+}
+
+static bool ReadGzImage(const std::string& path, std::vector<u8> *buf)
+{
+	gzFile gz = gzopen(path.c_str(),"rb");
+	if(!gz)
+		return false;
+
+	u8 temp[65536];
+	int n;
+	while((n = gzread(gz,temp,sizeof(temp))) > 0)
+		buf->insert(buf->end(),temp,temp+n);
+	gzclose(gz);
+	return n == 0 && !buf->empty();
+}
+
+static bool ScanFile(const std::string& path, ROMINDEX_ENTRY *e)
+{
+	//the loader applies a matching .ips when it opens the file, so the image it sees wouldnt match the one hashed here
+	struct stat st;
+	if(stat((path + ".ips").c_str(),&st) == 0)
+		return false;
+
+	if(!StatFile(path,&e->mtime,&e->size) || !e->size)
+		return false;
+
+	std::vector<u8> buf;
+	if(HasExtension(path,".zip"))
+	{
+		if(!ReadZipImage(path,&e->member,&buf))
+			return false;
+	}
+	else if(HasExtension(path,".gz"))
+	{
+		if(!ReadGzImage(path,&buf))
+			return false;
+	}
+	else if(!EMUFILE::readAllBytes(&buf,path))
+		return false;
+
+	e->path = path;
+	return iNESProbe(&buf[0],(uint32)buf.size(),e);
+}
+
+struct ROMSCANJOB
+{
+	pthread_mutex_t lock;
+	const std::vector<std::string> *files;
+	size_t next;
+	std::vector<ROMINDEX_ENTRY> results;
+};
+
+static void* ScanThread(void *arg)
+{
+	ROMSCANJOB *job = (ROMSCANJOB*)arg;
+	for(;;)
+	{
+		pthread_mutex_lock(&job->lock);
+		size_t i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if(i >= job->files->size())
+			break;
+
+		ROMINDEX_ENTRY e;
+		if(!ScanFile((*job->files)[i],&e))
+			continue;
+
+		pthread_mutex_lock(&job->lock);
+		job->results.push_back(e);
+		pthread_mutex_unlock(&job->lock);
+	}
+	return 0;
+}
+
+static bool EntryPathLess(const ROMINDEX_ENTRY& a, const ROMINDEX_ENTRY& b)
+{
+	return a.path < b.path;
+}
+
+#endif
+
+int FCEUI_ScanRomLibrary(const char *dir, const char *fname, int threads)
+{
+#ifdef WIN32
+	FCEU_PrintError("Scanning a rom library is not supported on this platform.");
+	return -1;
+#else
+	std::vector<std::string> files;
+	CollectFiles(AbsolutePath(dir),&files);
+
+	if(threads <= 0)
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(threads <= 0)
+		threads = 1;
+
+	ROMSCANJOB job;
+	pthread_mutex_init(&job.lock,0);
+	job.files = &files;
+	job.next = 0;
+
+	std::vector<pthread_t> tids(threads);
+	int started = 0;
+	for(int i=0;i<threads;i++)
+		if(pthread_create(&tids[started],0,ScanThread,&job) == 0)
+			started++;
+	if(!started)
+		ScanThread(&job);
+	for(int i=0;i<started;i++)
+		pthread_join(tids[i],0);
+	pthread_mutex_destroy(&job.lock);
+
+	std::sort(job.results.begin(),job.results.end(),EntryPathLess);
+
+	//write next to the old index and swap it in, so a running instance never sees half an index
+	std::string tmpname = (std::string)fname + ".tmp";
+	{
+		EMUFILE_FILE os(tmpname,"wb");
+		if(os.fail())
+		{
+			FCEU_PrintError("Error creating rom index %s.",tmpname.c_str());
+			return -1;
+		}
+		os.fwrite(ROMINDEX_MAGIC,8);
+		os.write32le(ROMINDEX_VERSION);
+		os.write32le((u32)job.results.size());
+		for(size_t i=0;i<job.results.size();i++)
+			WriteEntry(&os,job.results[i]);
+		os.fflush();
+		if(os.fail())
+		{
+			FCEU_PrintError("Error writing rom index %s.",tmpname.c_str());
+			return -1;
+		}
+	}
+	if(rename(tmpname.c_str(),fname) != 0)
+	{
+		FCEU_PrintError("Error replacing rom index %s.",fname);
+		return -1;
+	}
+
+	RomIndex.clear();
+	for(size_t i=0;i<job.results.size();i++)
+		RomIndex[job.results[i].path] = job.results[i];
+
+	FCEU_printf("Indexed %d iNES images out of %d files on %d threads.\n",(int)job.results.size(),(int)files.size(),started ? started : 1);
+	return (int)job.results.size();
+#endif
+}
@@ -0,0 +1,42 @@
+#ifndef _ROMINDEX_H_
+#define _ROMINDEX_H_
+
+#include "types.h"
+
+#include <string>
+
+//one identified image in the rom library index.
+//images are keyed by the absolute path the loader would see (a .zip or .gz is keyed by the archive itself)
+//and are only trusted while the file on disk still has the recorded size and modification time
+struct ROMINDEX_ENTRY
+{
+	std::string path;
+
+	//the member picked out of a zip archive, "" for plain and gzipped files
+	std::string member;
+
+	uint64 mtime, size;
+
+	uint32 crc32;
+	uint8 md5[16];
+
+	//mapper, mirroring and battery after the header database corrections have been applied, and which
+	//of them the corrections changed, so loading an indexed image can skip the database
+	int32 mapper;
+	uint8 mirroring;
+	uint8 battery;
+	uint8 fixed;
+	uint32 prg_banks, chr_banks;
+};
+
+//loads an index written by FCEUI_ScanRomLibrary; a missing file just leaves the index empty
+bool FCEUI_LoadRomIndex(const char *fname);
+
+//walks dir (recursing into subdirectories), identifies every iNES image in it on <threads> worker threads
+//(0 picks one per core) and writes the index to fname. returns the number of images indexed, or -1 on failure
+int FCEUI_ScanRomLibrary(const char *dir, const char *fname, int threads);
+
+//returns the index entry for a file about to be loaded, or NULL if it isnt indexed or has changed since
+const ROMINDEX_ENTRY* FCEU_RomIndexFind(const char *path);
+
+#endif
@@ -0,0 +1,158 @@
+/// \file
+/// \brief run-ahead: after each frame, emulates a few more with the same input, shows the last of
+/// them and rolls back, so the picture answers the controller that many frames sooner
+
+#include <cstring>
+#include <vector>
+
+#include "types.h"
+#include "x6502.h"
+#include "fceu.h"
+#include "git.h"
+#include "cart.h"
+#include "cheat.h"
+#include "driver.h"
+#include "input.h"
+#include "ppu.h"
+#include "sound.h"
+#include "state.h"
+#include "video.h"
+#include "profile.h"
+#include "runahead.h"
+#include "trace.h"
+#include "snapshot.h"
+#ifdef _S9XLUA_H
+#include "fceulua.h"
+#endif
+
+//frames kept for the rolling statistics
+#define RUNAHEAD_WINDOW 60
+
+static const char* PhaseNames[RUNAHEAD_PHASE_COUNT] = { "save", "emulate", "load", "total" };
+
+static int RunAheadFrames;
+
+//the snapshot is taken every frame, so it lives in one buffer that is only reallocated when the
+//state layout changes (a new game)
+static std::vector<uint8> Snapshot;
+
+static uint64 History[RUNAHEAD_WINDOW][RUNAHEAD_PHASE_COUNT];
+static int HistoryPos, HistoryCount;
+
+void FCEUI_SetRunAhead(int frames)
+{
+	if(frames < 0) frames = 0;
+	if(frames > RUNAHEAD_MAX) frames = RUNAHEAD_MAX;
+	RunAheadFrames = frames;
+	HistoryPos = HistoryCount = 0;
+	if(!frames)
+		std::vector<uint8>().swap(Snapshot);
+}
+
+int FCEUI_GetRunAhead()
+{
+	return RunAheadFrames;
+}
+
+bool FCEUI_GetRunAheadStats(FCEU_RUNAHEAD_STATS *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->ahead = RunAheadFrames;
+	stats->statesize = Snapshot.size();
+	if(!HistoryCount)
+		return false;
+	stats->frames = HistoryCount;
+	for(int p = 0; p < RUNAHEAD_PHASE_COUNT; p++)
+	{
+		for(int i = 0; i < HistoryCount; i++)
+		{
+			double ms = FCEU_TicksToMs(History[i][p]);
+			stats->avg[p] += ms;
+			if(ms > stats->max[p])
+				stats->max[p] = ms;
+		}
+		stats->avg[p] /= HistoryCount;
+	}
+	return true;
+}
+
+const char* FCEUI_RunAheadPhaseName(int phase)
+{
+	return PhaseNames[phase];
+}
+
+bool FCEU_RunAheadBegin()
+{
+	if(!RunAheadFrames || !GameInfo || GameInfo->type == GIT_NSF)
+		return false;
+	//frame advance must show the frame it advanced to, and the avi must stay in step with the sound
+	if(EmulationPaused || FCEUI_AviIsRecording())
+		return false;
+	//the trace would record the hidden frames, and rolling back would take its clock back each frame
+	if(FCEUI_TraceActive())
+		return false;
+	//a burst would capture the frame ahead under the number of this one
+	if(FCEUI_BurstActive())
+		return false;
+#ifdef _S9XLUA_H
+	//scripts would see (and could change) frames that are thrown away
+	if(FCEU_LuaRunning())
+		return false;
+#endif
+	FCEU_HoldImage(true);
+	return true;
+}
+
+void FCEU_RunAheadEnd()
+{
+	uint64 t0 = FCEU_GetTicks();
+
+	uint32 size = FCEUSS_RawSize();
+	if(Snapshot.size() != size)
+		Snapshot.resize(size);
+	FCEUSS_SaveRaw(&Snapshot[0]);
+	char lag = lagFlag;
+	uint64 t1 = FCEU_GetTicks();
+
+	// the hidden frames are emulated in full. the old ppu's skip mode is a sprite 0 approximation
+	// that changes what the game does, and the picture is held back anyway, so skipping would save
+	// little and could make the frame that is shown wrong. the input stays what the real frame read.
+	FCEUSND_Suspend(1);
+	for(int i = 0; i < RunAheadFrames; i++)
+	{
+		if(geniestage != 1) FCEU_ApplyPeriodicCheats();
+		FCEUPPU_Loop(0);
+		timestampbase += timestamp;
+		timestamp = 0;
+	}
+	uint64 t2 = FCEU_GetTicks();
+
+	bool loaded = FCEUSS_LoadRaw(&Snapshot[0], size);
+	FCEUSND_Suspend(0);
+	if(loaded)
+		lagFlag = lag;
+	uint64 t3 = FCEU_GetTicks();
+
+	// XBuf still holds the last hidden frame
+	FCEU_HoldImage(false);
+	FCEU_PutImage();
+
+	// the state's layout changed during the hidden frames (a mapper moved its memory), so they
+	// can't be taken back. the game carries on from the last of them, and run-ahead goes off
+	// rather than keep rolling back over a layout that may change again
+	if(!loaded)
+	{
+		FCEU_PrintError("Run-ahead couldn't roll back the frames it ran ahead, so it has been turned off.");
+		FCEUI_SetRunAhead(0);
+		return;
+	}
+
+	uint64 *h = History[HistoryPos];
+	h[RUNAHEAD_SAVE] = t1 - t0;
+	h[RUNAHEAD_EMULATE] = t2 - t1;
+	h[RUNAHEAD_LOAD] = t3 - t2;
+	h[RUNAHEAD_TOTAL] = t3 - t0;
+	HistoryPos = (HistoryPos + 1) % RUNAHEAD_WINDOW;
+	if(HistoryCount < RUNAHEAD_WINDOW)
+		HistoryCount++;
+}
@@ -0,0 +1,41 @@
+#ifndef _RUNAHEAD_H_
+#define _RUNAHEAD_H_
+
+#include "types.h"
+
+//most frames that can be run ahead
+#define RUNAHEAD_MAX 8
+
+//where the time of a run-ahead frame goes
+enum ERUNAHEADPHASE
+{
+	RUNAHEAD_SAVE,		//snapshot after the real frame
+	RUNAHEAD_EMULATE,	//all the hidden frames together
+	RUNAHEAD_LOAD,		//rolling back to the snapshot
+	RUNAHEAD_TOTAL,
+	RUNAHEAD_PHASE_COUNT
+};
+
+//rolling statistics over the last few run-ahead frames, times in milliseconds
+struct FCEU_RUNAHEAD_STATS
+{
+	int frames;
+	int ahead;
+	uint32 statesize;
+	double avg[RUNAHEAD_PHASE_COUNT], max[RUNAHEAD_PHASE_COUNT];
+};
+
+//frames to run ahead, 0 (off) through RUNAHEAD_MAX. also starts the statistics over
+void FCEUI_SetRunAhead(int frames);
+int FCEUI_GetRunAhead();
+//false until a frame has been run ahead since the last FCEUI_SetRunAhead
+bool FCEUI_GetRunAheadStats(FCEU_RUNAHEAD_STATS *stats);
+const char* FCEUI_RunAheadPhaseName(int phase);
+
+//called by FCEUI_Emulate around the real frame. FCEU_RunAheadBegin decides whether this frame
+//runs ahead and, when it does, holds the picture back; FCEU_RunAheadEnd then runs the hidden
+//frames, rolls back and puts the picture of the last one up
+bool FCEU_RunAheadBegin();
+void FCEU_RunAheadEnd();
+
+#endif
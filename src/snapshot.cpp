@@ -0,0 +1,427 @@
+/// \file
+/// \brief screen snapshots: the emulation thread copies the picture with its emphasis and palette,
+/// and a pool of writer threads turns each copy into an 8 bit paletted png
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <vector>
+#include <zlib.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include "types.h"
+#include "snapshot.h"
+#include "fceu.h"
+#include "driver.h"
+#include "file.h"
+#include "movie.h"
+#include "palette.h"
+#include "video.h"
+#include "utils/crc32.h"
+
+//snapshots waiting for a writer; the emulation thread waits when this many are, about 8MB
+#define SNAP_QUEUE_MAX 64
+#define SNAP_THREADS_MAX 4
+
+uint64 FCEUD_GetTime(void);
+uint64 FCEUD_GetTimeFreq(void);
+
+struct SNAPJOB
+{
+	std::string fname;
+	int number;
+	int lines;
+	uint8 pixels[256*256], deemph[256*256];
+	uint8 palette[256*3];
+	uint8 deemphpalette[512*3];
+
+	//filled in by the writer
+	bool ok;
+	uint32 bytes;
+	double ms;
+};
+
+static std::deque<SNAPJOB*> pending, finished;
+static std::vector<SNAPJOB*> spare;
+static int writing; //jobs a writer has taken and not finished
+#ifndef WIN32
+static pthread_mutex_t lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake=PTHREAD_COND_INITIALIZER, done=PTHREAD_COND_INITIALIZER;
+static int threads;
+#endif
+
+//the burst being captured
+static bool burst;
+static FCEU_BURST_OPTIONS burstopts;
+static int burstbase; //the frame the every-nth count starts at
+static int burstlast; //the frame captured last, which a paused emulator shows again
+static int burstframes, burstfailed;
+static uint64 burstbytes;
+static double burstms;
+static uint64 burststart, burstshown;
+
+static double Milliseconds(uint64 from, uint64 to)
+{
+	return (double)(to-from)*1000.0/FCEUD_GetTimeFreq();
+}
+
+static bool WritePNGChunk(FILE *fp, uint32 size, const char *type, const uint8 *data, uint32 *bytes)
+{
+	uint8 tempo[4];
+	tempo[0]=size>>24;
+	tempo[1]=size>>16;
+	tempo[2]=size>>8;
+	tempo[3]=size;
+	if(fwrite(tempo,4,1,fp)!=1 || fwrite(type,4,1,fp)!=1)
+		return false;
+	if(size && fwrite(data,1,size,fp)!=size)
+		return false;
+
+	uint32 crc=CalcCRC32(0,(uint8 *)type,4);
+	if(size)
+		crc=CalcCRC32(crc,(uint8 *)data,size);
+	tempo[0]=crc>>24;
+	tempo[1]=crc>>16;
+	tempo[2]=crc>>8;
+	tempo[3]=crc;
+	if(fwrite(tempo,4,1,fp)!=1)
+		return false;
+	*bytes+=12+size;
+	return true;
+}
+
+static const uint8* ColorOf(const SNAPJOB *j, uint8 pixel, uint8 deemph)
+{
+	//the same lookup as ModernDeemphColorMap
+	if(deemph)
+		return j->deemphpalette+((pixel&0x3F)+deemph*64)*3;
+	return j->palette+pixel*3;
+}
+
+//a picture with more than 256 colours, which takes several emphasis changes in one frame, is
+//written as rgb instead
+static bool Encode(SNAPJOB *j)
+{
+	uint64 t0=FCEUD_GetTime();
+	int16 index[256*8];
+	memset(index,0xFF,sizeof(index));
+	uint8 plte[256*3];
+	int colors=0;
+	bool rgb=false;
+
+	int stride=256+1;
+	std::vector<uint8> rows(j->lines*stride);
+	for(int y=0;y<j->lines && !rgb;y++)
+	{
+		uint8 *row=&rows[y*stride];
+		const uint8 *p=j->pixels+y*256, *d=j->deemph+y*256;
+		*row++=0; //no filter
+		for(int x=0;x<256;x++)
+		{
+			int key=p[x]|((d[x]&7)<<8);
+			if(index[key]<0)
+			{
+				if(colors==256)
+				{
+					rgb=true;
+					break;
+				}
+				memcpy(plte+colors*3,ColorOf(j,p[x],d[x]&7),3);
+				index[key]=colors++;
+			}
+			row[x]=(uint8)index[key];
+		}
+	}
+	if(rgb)
+	{
+		stride=256*3+1;
+		rows.resize(j->lines*stride);
+		for(int y=0;y<j->lines;y++)
+		{
+			uint8 *row=&rows[y*stride];
+			const uint8 *p=j->pixels+y*256, *d=j->deemph+y*256;
+			*row++=0;
+			for(int x=0;x<256;x++,row+=3)
+				memcpy(row,ColorOf(j,p[x],d[x]&7),3);
+		}
+	}
+
+	uLongf compsize=compressBound(rows.size());
+	std::vector<uint8> comp(compsize);
+	j->bytes=0;
+	//a burst has to keep up with the game, and level 1 is about four times faster for half as much again
+	int level=j->number==SNAPSHOT_BURST ? Z_BEST_SPEED : Z_DEFAULT_COMPRESSION;
+	j->ok=compress2(&comp[0],&compsize,&rows[0],rows.size(),level)==Z_OK;
+
+	FILE *fp=j->ok ? FCEUD_UTF8fopen(j->fname.c_str(),"wb") : 0;
+	if(fp)
+	{
+		static const uint8 header[8]={137,80,78,71,13,10,26,10};
+		uint8 ihdr[13]={0,0,1,0, 0,0,0,(uint8)j->lines, 8,(uint8)(rgb ? 2 : 3),0,0,0};
+		j->ok=fwrite(header,8,1,fp)==1
+			&& WritePNGChunk(fp,13,"IHDR",ihdr,&j->bytes)
+			&& (rgb || WritePNGChunk(fp,colors*3,"PLTE",plte,&j->bytes))
+			&& WritePNGChunk(fp,compsize,"IDAT",&comp[0],&j->bytes)
+			&& WritePNGChunk(fp,0,"IEND",0,&j->bytes);
+		j->bytes+=8;
+		if(fclose(fp))
+			j->ok=false;
+	}
+	else
+		j->ok=false;
+	j->ms=Milliseconds(t0,FCEUD_GetTime());
+	return j->ok;
+}
+
+#ifndef WIN32
+static void* WriterThread(void*)
+{
+	pthread_mutex_lock(&lock);
+	for(;;)
+	{
+		while(pending.empty())
+			pthread_cond_wait(&wake,&lock);
+		SNAPJOB *j=pending.front();
+		pending.pop_front();
+		writing++;
+		pthread_mutex_unlock(&lock);
+		Encode(j);
+		pthread_mutex_lock(&lock);
+		writing--;
+		finished.push_back(j);
+		pthread_cond_broadcast(&done);
+	}
+	return 0;
+}
+
+//the writers start with the first snapshot and stay for the rest of the run, idle in between
+static void StartWriters()
+{
+	if(threads)
+		return;
+	long cpus=sysconf(_SC_NPROCESSORS_ONLN);
+	int want=cpus>2 ? (int)cpus-1 : 1;
+	if(want>SNAP_THREADS_MAX)
+		want=SNAP_THREADS_MAX;
+	for(int i=0;i<want;i++)
+	{
+		pthread_t tid;
+		if(pthread_create(&tid,0,WriterThread,0)==0)
+		{
+			pthread_detach(tid);
+			threads++;
+		}
+	}
+}
+#endif
+
+bool FCEU_SnapshotQueue(const char *fname, int number)
+{
+	if(!XBuf)
+		return false;
+
+	SNAPJOB *j;
+#ifndef WIN32
+	StartWriters();
+	pthread_mutex_lock(&lock);
+#endif
+	if(spare.empty())
+		j=new SNAPJOB;
+	else
+	{
+		j=spare.back();
+		spare.pop_back();
+	}
+#ifndef WIN32
+	pthread_mutex_unlock(&lock);
+#endif
+
+	j->fname=fname;
+	j->number=number;
+	j->lines=FSettings.LastSLine-FSettings.FirstSLine+1;
+	memcpy(j->pixels,XBuf+FSettings.FirstSLine*256,j->lines*256);
+	memcpy(j->deemph,XDBuf+FSettings.FirstSLine*256,j->lines*256);
+	for(int i=0;i<256;i++)
+		FCEUD_GetPalette(i,j->palette+i*3,j->palette+i*3+1,j->palette+i*3+2);
+	if(palo)
+	{
+		for(int i=0;i<512;i++)
+		{
+			j->deemphpalette[i*3]=palo[i].r;
+			j->deemphpalette[i*3+1]=palo[i].g;
+			j->deemphpalette[i*3+2]=palo[i].b;
+		}
+	}
+	else
+	{
+		for(int i=0;i<8;i++)
+			memcpy(j->deemphpalette+i*64*3,j->palette,64*3);
+	}
+
+#ifdef WIN32
+	Encode(j);
+	finished.push_back(j);
+#else
+	if(!threads)
+	{
+		Encode(j);
+		pthread_mutex_lock(&lock);
+		finished.push_back(j);
+		pthread_mutex_unlock(&lock);
+		return true;
+	}
+	pthread_mutex_lock(&lock);
+	//the writers are behind: wait for them rather than take more memory
+	while(pending.size()>=SNAP_QUEUE_MAX)
+		pthread_cond_wait(&done,&lock);
+	pending.push_back(j);
+	pthread_cond_signal(&wake);
+	pthread_mutex_unlock(&lock);
+#endif
+	return true;
+}
+
+void FCEU_SnapshotFlush()
+{
+#ifndef WIN32
+	pthread_mutex_lock(&lock);
+	while(!pending.empty() || writing)
+		pthread_cond_wait(&done,&lock);
+	pthread_mutex_unlock(&lock);
+#endif
+	FCEU_SnapshotPoll();
+}
+
+void FCEU_SnapshotPoll()
+{
+	std::deque<SNAPJOB*> jobs;
+#ifndef WIN32
+	pthread_mutex_lock(&lock);
+#endif
+	jobs.swap(finished);
+#ifndef WIN32
+	pthread_mutex_unlock(&lock);
+#endif
+	if(jobs.empty())
+		return;
+
+	for(size_t i=0;i<jobs.size();i++)
+	{
+		SNAPJOB *j=jobs[i];
+		if(j->number==SNAPSHOT_BURST)
+		{
+			if(j->ok)
+			{
+				burstbytes+=j->bytes;
+				burstms+=j->ms;
+			}
+			else
+				burstfailed++;
+		}
+		else if(!j->ok)
+			FCEU_DispMessage("Error saving screen snapshot.",0);
+		else if(j->number==SNAPSHOT_NAMED)
+			FCEU_DispMessage("Snapshot saved, %d KB in %.1f ms.",0,(int)((j->bytes+1023)>>10),j->ms);
+		else
+			FCEU_DispMessage("Screen snapshot %d saved, %d KB in %.1f ms.",0,j->number,(int)((j->bytes+1023)>>10),j->ms);
+	}
+
+#ifndef WIN32
+	pthread_mutex_lock(&lock);
+#endif
+	spare.insert(spare.end(),jobs.begin(),jobs.end());
+#ifndef WIN32
+	pthread_mutex_unlock(&lock);
+#endif
+}
+
+//the average time a writer took over each frame; several of them work at once
+static double BurstEncodeMs()
+{
+	int written=burstframes-burstfailed;
+	return written>0 ? burstms/written : 0;
+}
+
+void FCEUI_BurstStart(const FCEU_BURST_OPTIONS &options)
+{
+	FCEUI_BurstStop();
+	burstopts=options;
+	if(burstopts.every<1)
+		burstopts.every=1;
+	burstbase=burstopts.startframe>=0 ? burstopts.startframe : FCEUMOV_GetFrame();
+	burstlast=-1;
+	burstframes=burstfailed=0;
+	burstbytes=0;
+	burstms=0;
+	burststart=burstshown=FCEUD_GetTime();
+	burst=true;
+}
+
+void FCEUI_BurstStop()
+{
+	if(!burst)
+		return;
+	burst=false;
+	FCEU_SnapshotFlush();
+	double seconds=Milliseconds(burststart,FCEUD_GetTime())/1000.0;
+	double rate=seconds>0 ? burstframes/seconds : 0;
+	if(burstfailed)
+		FCEU_DispMessage("Burst: %d of %d frames could not be saved.",0,burstfailed,burstframes);
+	else
+		FCEU_DispMessage("Burst: %d frames, %.1f MB in %.1f s, %.0f frames/s.",0,
+			burstframes,burstbytes/1048576.0,seconds,rate);
+	FCEU_printf("Burst capture finished: %d frames, %d failed, %.1f MB in %.1f s, %.0f frames/s, %.1f ms to encode each.\n",
+		burstframes,burstfailed,burstbytes/1048576.0,seconds,rate,BurstEncodeMs());
+}
+
+bool FCEUI_BurstActive()
+{
+	return burst;
+}
+
+bool FCEU_BurstWants()
+{
+	if(!burst)
+		return false;
+	int frame=FCEUMOV_GetFrame();
+	if(frame<burstbase || (burstopts.stopframe>=0 && frame>burstopts.stopframe))
+		return false;
+	return (frame-burstbase)%burstopts.every==0;
+}
+
+void FCEU_BurstFrame()
+{
+	if(!burst)
+		return;
+	int frame=FCEUMOV_GetFrame();
+	if(burstopts.stopframe>=0 && frame>burstopts.stopframe)
+	{
+		FCEUI_BurstStop();
+		return;
+	}
+	if(frame==burstlast || !FCEU_BurstWants())
+		return;
+	burstlast=frame;
+	//the rate is over the frames captured, not the wait for startframe
+	if(!burstframes)
+		burststart=burstshown=FCEUD_GetTime();
+
+	if(!FCEU_SnapshotQueue(FCEU_MakeFName(FCEUMKF_BURST,frame,"png").c_str(),SNAPSHOT_BURST))
+		burstfailed++;
+	burstframes++;
+
+	//what it has done so far, once a second
+	uint64 now=FCEUD_GetTime();
+	if(Milliseconds(burstshown,now)>=1000)
+	{
+		double seconds=Milliseconds(burststart,now)/1000.0;
+		burstshown=now;
+		FCEU_DispMessage("Burst: %d frames, %.1f MB, %.0f frames/s, %.1f ms each.",0,
+			burstframes,burstbytes/1048576.0,burstframes/seconds,BurstEncodeMs());
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include "types.h"
+
+//which frames a burst captures. -1 leaves a bound out
+struct FCEU_BURST_OPTIONS
+{
+	int every;	//every this many frames...
+	int startframe;	//...from this one on...
+	int stopframe;	//...up to and including this one
+
+	FCEU_BURST_OPTIONS()
+		: every(1), startframe(-1), stopframe(-1)
+	{}
+};
+
+//what FCEU_SnapshotQueue says when the png is written, besides a snapshot number
+#define SNAPSHOT_BURST -1 //nothing, it counts towards the burst
+#define SNAPSHOT_NAMED -2 //that it was saved, without a number
+
+//queues the picture in XBuf, with its emphasis and the palette, to be written to fname as a png by
+//the writer threads
+bool FCEU_SnapshotQueue(const char *fname, int number);
+//waits until every queued snapshot is written
+void FCEU_SnapshotFlush();
+//called once a frame, to report the snapshots that were written since
+void FCEU_SnapshotPoll();
+
+//captures frames to numbered files in the snapshot directory as the game runs
+void FCEUI_BurstStart(const FCEU_BURST_OPTIONS &options);
+//waits for the last frames to be written and reports the burst
+void FCEUI_BurstStop();
+bool FCEUI_BurstActive();
+//whether the coming frame is to be captured, so it has to be drawn
+bool FCEU_BurstWants();
+//called with each finished picture, before anything is drawn over it
+void FCEU_BurstFrame();
+
+#endif
@@ -24,9 +24,11 @@
 #include "fceu.h"
 #include "sound.h"
 #include "filter.h"
+#include "stepsynth.h"
 #include "state.h"
 #include "wave.h"
 #include "debug.h"
+#include "profile.h"
 
 #include <cstdlib>
 #include <cstdio>
@@ -148,12 +150,6 @@ static uint32 ChannelBC[5];
 //savestate sync hack stuff
 int movieSyncHackOn=0,resetDMCacc=0,movieConvertOffset1,movieConvertOffset2;
 
-#ifdef WIN32
-extern volatile int datacount, undefinedcount;
-extern int debug_loggingCD;
-extern unsigned char *cdloggerdata;
-#endif
-
 static void LoadDMCPeriod(uint8 V)
 {
  if(PAL)
@@ -167,9 +163,7 @@ static void PrepDPCM()
  DMCAddress=0x4000+(DMCAddressLatch<<6);
  DMCSize=(DMCSizeLatch<<4)+1;
 
- #ifdef WIN32
- if(debug_loggingCD)LogDPCM(0x8000+DMCAddress, DMCSize);
- #endif
+ if(debug_loggingCD && cdloggerdata)LogDPCM(0x8000+DMCAddress, DMCSize);
 
 }
 
@@ -178,7 +172,7 @@ void LogDPCM(int romaddress, int dpcmsize){
 
 	if(i == -1)return;
 
-	for (int dpcmstart = i; dpcmstart < (i + dpcmsize); dpcmstart++) {
+	for (int dpcmstart = i; dpcmstart < (i + dpcmsize) && dpcmstart < (int)cdloggerdataSize; dpcmstart++) {
 		if(!(cdloggerdata[dpcmstart] & 0x40)) {
 			cdloggerdata[dpcmstart] |= 0x40;
 
@@ -1024,6 +1018,145 @@ static void RDoNoise(void)
  ChannelBC[3]=SOUNDTS;
 }
 
+/* Band-limited step synthesis (FSettings.stepsynth).  Rather than filling WaveHi a cpu cycle
+   at a time and running the FIR over all of it, the channels are clocked from one timer event
+   to the next and each change of the mixed output goes to stepsynth as a step.  All five Do*
+   pointers run this, since one call brings every channel up to SOUNDTS.  Expansion chips still
+   fill WaveHi, and FlushEmulateSound turns the changes in it into steps as well.
+*/
+static bool StepMode=false;
+static uint32 StepBC;
+static int32 StepOut, StepExpOut;
+
+//an idle timer, never reached within a frame
+#define STEP_IDLE 0x7FFFFFFF
+
+static INLINE int32 StepTriLevel(void)
+{
+ int32 tcout=(tristep&0xF);
+ if(!(tristep&0x10)) tcout^=0xF;
+ return (((tcout*3)<<16)/256*FSettings.TriangleVolume)>>16;
+}
+
+static void RDoSteps(void)
+{
+ int32 left=(int32)(SOUNDTS-StepBC);
+ uint32 t=StepBC;
+ int x;
+
+ if(left<=0)
+  return;
+
+ int32 sqamp[2],sqthresh[2],sqcf[2],sqrc[2],sqdc[2],sqout[2];
+ for(x=0;x<2;x++)
+ {
+  sqrc[x]=STEP_IDLE;
+  sqamp[x]=sqout[x]=0;
+  sqthresh[x]=sqcf[x]=0;
+  sqdc[x]=RectDutyCount[x];
+  if(curfreq[x]<8 || curfreq[x]>0x7ff) continue;
+  if(!CheckFreq(curfreq[x],PSG[(x<<2)|0x1])) continue;
+  if(!lengthcount[x]) continue;
+
+  //same volume as RDoSQ
+  int32 amp,ampx;
+  if(EnvUnits[x].Mode&0x1)
+   amp=EnvUnits[x].Speed;
+  else
+   amp=EnvUnits[x].decvolume;
+  ampx = x ? FSettings.Square2Volume : FSettings.Square1Volume;
+  if (ampx != 256) amp = (amp * ampx) / 256;
+
+  sqamp[x]=amp;
+  sqthresh[x]=RectDuties[(PSG[(x<<2)]&0xC0)>>6];
+  sqcf[x]=(curfreq[x]+1)*2;
+  sqrc[x]=wlcount[x]>0?wlcount[x]:1;
+  sqout[x]=sqdc[x]<sqthresh[x]?amp:0;
+ }
+
+ int32 trirc=STEP_IDLE;
+ int32 triout=StepTriLevel();
+ if(lengthcount[2] && TriCount)
+  trirc=wlcount[2]>0?wlcount[2]:1;
+
+ //the noise shift register runs even when the channel is silent
+ int32 noiseamp;
+ if(EnvUnits[2].Mode&0x1)
+  noiseamp=EnvUnits[2].Speed;
+ else
+  noiseamp=EnvUnits[2].decvolume;
+ if (FSettings.NoiseVolume != 256) noiseamp = (noiseamp * FSettings.NoiseVolume) / 256;
+ noiseamp<<=1;
+ if(!lengthcount[3])
+  noiseamp=0;
+ int32 noiserc=wlcount[3]>0?wlcount[3]:1;
+ int noisetap=(PSG[0xE]&0x80)?8:13;
+ const uint32 *noisefreq=PAL?NoiseFreqTablePAL:NoiseFreqTableNTSC;
+ int32 noiseout=((nreg>>0xe)&1)?0:noiseamp;
+
+ int32 pcmout=(((RawDALatch<<16)/256)*FSettings.PCMVolume)>>16;
+
+ for(;;)
+ {
+  int32 out=wlookup1[sqout[0]+sqout[1]]+wlookup2[triout+noiseout+pcmout];
+  if(out!=StepOut)
+  {
+   StepSynthAdd(t,out-StepOut);
+   StepOut=out;
+  }
+  if(!left)
+   break;
+
+  int32 n=left;
+  if(sqrc[0]<n) n=sqrc[0];
+  if(sqrc[1]<n) n=sqrc[1];
+  if(trirc<n) n=trirc;
+  if(noiserc<n) n=noiserc;
+  t+=n;
+  left-=n;
+
+  for(x=0;x<2;x++)
+  {
+   if(sqrc[x]==STEP_IDLE) continue;
+   sqrc[x]-=n;
+   if(!sqrc[x])
+   {
+    sqrc[x]=sqcf[x];
+    sqdc[x]=(sqdc[x]+1)&7;
+    sqout[x]=sqdc[x]<sqthresh[x]?sqamp[x]:0;
+   }
+  }
+  if(trirc!=STEP_IDLE)
+  {
+   trirc-=n;
+   if(!trirc)
+   {
+    trirc=(PSG[0xa]|((PSG[0xb]&7)<<8))+1;
+    tristep++;
+    triout=StepTriLevel();
+   }
+  }
+  noiserc-=n;
+  if(!noiserc)
+  {
+   noiserc=noisefreq[PSG[0xE]&0xF];
+   nreg=((nreg<<1)+(((nreg>>noisetap)&1)^((nreg>>14)&1)))&0x7fff;
+   noiseout=((nreg>>0xe)&1)?0:noiseamp;
+  }
+ }
+
+ for(x=0;x<2;x++)
+  if(sqrc[x]!=STEP_IDLE)
+  {
+   wlcount[x]=sqrc[x];
+   RectDutyCount[x]=sqdc[x];
+  }
+ if(trirc!=STEP_IDLE)
+  wlcount[2]=trirc;
+ wlcount[3]=noiserc;
+ StepBC=SOUNDTS;
+}
+
 DECLFW(Write_IRQFM)
 {
  V=(V&0xC0)>>6;
@@ -1047,9 +1180,36 @@ void SetNESSoundMap(void)
   SetReadHandler(0x4015,0x4015,StatusRead);
 }
 
+int SoundSuspended=0;
+static void (*SuspendedDo[5])(void);
+
+void FCEUSND_Suspend(int suspend)
+{
+  if(suspend==SoundSuspended) return;
+  SoundSuspended=suspend;
+  if(suspend)
+  {
+   SuspendedDo[0]=DoSQ1;
+   SuspendedDo[1]=DoSQ2;
+   SuspendedDo[2]=DoTriangle;
+   SuspendedDo[3]=DoNoise;
+   SuspendedDo[4]=DoPCM;
+   DoSQ1=DoSQ2=DoTriangle=DoNoise=DoPCM=Dummyfunc;
+  }
+  else
+  {
+   DoSQ1=SuspendedDo[0];
+   DoSQ2=SuspendedDo[1];
+   DoTriangle=SuspendedDo[2];
+   DoNoise=SuspendedDo[3];
+   DoPCM=SuspendedDo[4];
+  }
+}
+
 static int32 inbuf=0;
 int FlushEmulateSound(void)
 {
+  FCEU_PROFILE_STAGE(PROFILE_APU);
   int x;
   int32 end,left;
 
@@ -1068,7 +1228,32 @@ int FlushEmulateSound(void)
   DoNoise();
   DoPCM();
 
-  if(FSettings.soundq>=1)
+  if(StepMode)
+  {
+   if(GameExpSound.HiFill)
+   {
+    GameExpSound.HiFill();
+    for(x=0;x<timestamp;x++)
+    {
+     int32 b=WaveHi[x]&65535;
+     if(b!=StepExpOut)
+     {
+      StepSynthAdd(x,b-StepExpOut);
+      StepExpOut=b;
+     }
+    }
+    memset(WaveHi,0,timestamp*sizeof(int32));
+    if(GameExpSound.HiSync) GameExpSound.HiSync(0);
+   }
+   end=StepSynthEnd(timestamp,WaveFinal);
+   StepBC-=timestamp;
+   {
+    FCEU_PROFILE_STAGE(PROFILE_FILTER);
+    PostFilterSound(WaveFinal,end);
+   }
+   left=soundtsoffs;
+  }
+  else if(FSettings.soundq>=1)
   {
    int32 *tmpo=&WaveHi[soundtsoffs];
 
@@ -1080,7 +1265,10 @@ int FlushEmulateSound(void)
     *tmpo=(b&65535)+wlookup2[(b>>16)&255]+wlookup1[b>>24];
     tmpo++;
    }
-   end=NeoFilterSound(WaveHi,WaveFinal,SOUNDTS,&left);
+   {
+    FCEU_PROFILE_STAGE(PROFILE_FILTER);
+    end=NeoFilterSound(WaveHi,WaveFinal,SOUNDTS,&left);
+   }
 
    memmove(WaveHi,WaveHi+SOUNDTS-left,left*sizeof(uint32));
    memset(WaveHi+left,0,sizeof(WaveHi)-left*sizeof(uint32));
@@ -1095,7 +1283,10 @@ int FlushEmulateSound(void)
    if(GameExpSound.Fill)
     GameExpSound.Fill(end&0xF);
 
-   SexyFilter(Wave,WaveFinal,end>>4);
+   {
+    FCEU_PROFILE_STAGE(PROFILE_FILTER);
+    SexyFilter(Wave,WaveFinal,end>>4);
+   }
 
    //if(FSettings.lowpass)
    // SexyFilter2(WaveFinal,end>>4);
@@ -1218,12 +1409,21 @@ void FCEUSND_Power(void)
 
 	memset(Wave,0,sizeof(Wave));
         memset(WaveHi,0,sizeof(WaveHi));
+	memset(WaveFinal,0,sizeof(WaveFinal));
+	inbuf=0;
 	memset(&EnvUnits,0,sizeof(EnvUnits));
 
         for(x=0;x<5;x++)
          ChannelBC[x]=0;
         soundtsoffs=0;
         LoadDMCPeriod(DMCFormat&0xF);
+
+	//restart the resampler and filters too, or what the last game left in them leaks into this one
+	if(FSettings.SndRate)
+	 MakeFilters(FSettings.SndRate);
+	StepSynthClear();
+	StepBC=soundtsoffs;
+	StepOut=StepExpOut=0;
 }
 
 
@@ -1248,7 +1448,10 @@ void SetSoundVariables(void)
     wlookup2[x]=(double)16*16*16*4*163.67/((double)24329/(double)x+100);
     if(!FSettings.soundq) wlookup2[x]>>=4;
    }
-   if(FSettings.soundq>=1)
+   StepMode=FSettings.soundq>=1 && FSettings.stepsynth;
+   if(StepMode)
+    DoNoise=DoTriangle=DoPCM=DoSQ1=DoSQ2=RDoSteps;
+   else if(FSettings.soundq>=1)
    {
     DoNoise=RDoNoise;
     DoTriangle=RDoTriangle;
@@ -1268,11 +1471,26 @@ void SetSoundVariables(void)
   }
   else
   {
+   StepMode=false;
    DoNoise=DoTriangle=DoPCM=DoSQ1=DoSQ2=Dummyfunc;
    return;
   }
 
   MakeFilters(FSettings.SndRate);
+  if(StepMode)
+  {
+   //same level, frequency response, sample timing and samples per frame as the FIR, whose
+   //first sample is centered (taps+3)/2 cycles in and which holds back the last (taps+1)/2
+   //cycles of a frame
+   int32 taps,gain;
+   double cutoff;
+   uint32 ratio=(PAL?(int64)(PAL_CPU*65536):(int64)(NTSC_CPU*65536))/FSettings.SndRate;
+   NeoFilterResponse(&taps,&gain,&cutoff);
+   MakeStepKernel(ratio,gain,(taps+3)/2.0,(taps+1)/2.0,cutoff);
+   soundtsoffs=0;
+   StepBC=SOUNDTS;
+   StepOut=StepExpOut=0;
+  }
 
   if(GameExpSound.RChange)
    GameExpSound.RChange();
@@ -1303,6 +1521,12 @@ void FCEUI_SetSoundQuality(int quality)
 	SetSoundVariables();
 }
 
+void FCEUI_SetStepSynth(int enable)
+{
+	FSettings.stepsynth=enable;
+	SetSoundVariables();
+}
+
 void FCEUI_SetSoundVolume(uint32 volume)
 {
 	FSettings.SoundVolume=volume;
@@ -1378,6 +1602,7 @@ SFORMAT FCEUSND_STATEINFO[]={
  { &DMCShift, 1, "5SHF"},
 
  { &DMCHaveDMA, 1, "5HVDM"},
+ { &DMCDMABuf, 1, "5DMB"},
  { &DMCHaveSample, 1, "5HVSP"},
 
  { &DMCSizeLatch, 1, "5SZL"},
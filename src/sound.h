@@ -61,6 +61,16 @@ extern uint32 soundtsoffs;
 extern bool swapDuty;
 #define SOUNDTS (timestamp + soundtsoffs)
 
+/* Adds v to WaveHi over cpu cycles start to end-1.  The high quality
+   expansion sound renders whole runs of cycles between timer events with this
+   instead of stepping its timers a cycle at a time. */
+static INLINE void WaveHiRun(int32 start, int32 end, int32 v)
+{
+	int32 *p = WaveHi + start, *e = WaveHi + end;
+	while (p < e)
+		*p++ += v;
+}
+
 void SetNESSoundMap(void);
 void FrameSoundUpdate(void);
 
@@ -69,6 +79,14 @@ void FCEUSND_Reset(void);
 void FCEUSND_SaveState(void);
 void FCEUSND_LoadState(int version);
 
+/* Stops (1) and restarts (0) the sound renderers, for frames that are emulated
+   and then thrown away again.  The APU and expansion registers still update,
+   but nothing is mixed and the streaming counters stay where the last flush
+   left them, so FlushEmulateSound must not be called while suspended.
+   Expansion sound checks SoundSuspended before rendering on a write. */
+extern int SoundSuspended;
+void FCEUSND_Suspend(int suspend);
+
 void FCEU_SoundCPUHook(int);
 void Write_IRQFM (uint32 A, uint8 V); //mbg merge 7/17/06 brought over from latest mmbuild
 
@@ -27,12 +27,15 @@
 #include "sound.h"
 #include "utils/endian.h"
 #include "utils/memory.h"
+#include "utils/arena.h"
+#include "utils/hash.h"
 #include "utils/xstring.h"
 #include "file.h"
 #include "fds.h"
 #include "state.h"
 #include "movie.h"
 #include "ppu.h"
+#include "debug.h"
 #include "netplay.h"
 #include "video.h"
 #include "input.h"
@@ -56,6 +59,7 @@
 //#include <unistd.h> //mbg merge 7/17/06 removed
 
 #include <vector>
+#include <algorithm>
 #include <fstream>
 
 using namespace std;
@@ -90,6 +94,8 @@ std::vector<uint8> compressed_buf;
 #define SFMDATA_SIZE (64)
 static SFORMAT SFMDATA[SFMDATA_SIZE];
 static int SFEXINDEX;
+//set when SFMDATA changes, so the raw snapshot layout gets rebuilt
+static bool rawdirty=true;
 
 #define RLSB 		FCEUSTATE_RLSB	//0x80000000
 
@@ -126,7 +132,7 @@ SFORMAT SFCPUC[]={
 
 void foo(uint8* test) { (void)test; }
 
-static int SubWrite(EMUFILE* os, SFORMAT *sf)
+static int SubWrite(EMUFILE_MEMORY_SPAN* os, SFORMAT *sf)
 {
 	uint32 acc=0;
 
@@ -149,7 +155,7 @@ static int SubWrite(EMUFILE* os, SFORMAT *sf)
 		if(os)			//Are we writing or calculating the size of this block?
 		{
 			os->fwrite(sf->desc,4);
-			write32le(sf->s&(~FCEUSTATE_FLAGS),os);
+			os->write32le(sf->s&(~FCEUSTATE_FLAGS));
 
 #ifndef LSB_FIRST
 			if(sf->s&RLSB)
@@ -173,11 +179,11 @@ static int SubWrite(EMUFILE* os, SFORMAT *sf)
 	return(acc);
 }
 
-static int WriteStateChunk(EMUFILE* os, int type, SFORMAT *sf)
+static int WriteStateChunk(EMUFILE_MEMORY_SPAN* os, int type, SFORMAT *sf)
 {
 	os->fputc(type);
-	int bsize = SubWrite((EMUFILE*)0,sf);
-	write32le(bsize,os);
+	int bsize = SubWrite((EMUFILE_MEMORY_SPAN*)0,sf);
+	os->write32le(bsize);
 
 	if(!SubWrite(os,sf))
 	{
@@ -209,7 +215,7 @@ static SFORMAT *CheckS(SFORMAT *sf, uint32 tsize, char *desc)
 	return(0);
 }
 
-static bool ReadStateChunk(EMUFILE* is, SFORMAT *sf, int size)
+static bool ReadStateChunk(EMUFILE_MEMORY_SPAN* is, SFORMAT *sf, int size)
 {
 	SFORMAT *tmp;
 	int temp = is->ftell();
@@ -218,11 +224,9 @@ static bool ReadStateChunk(EMUFILE* is, SFORMAT *sf, int size)
 	{
 		uint32 tsize;
 		char toa[4];
-		if(is->fread(toa,4)<4)
+		if(is->fread(toa,4)<4 || !is->read32le(&tsize))
 			return false;
 
-		read32le(&tsize,is);
-
 		if((tmp=CheckS(sf,tsize,toa)))
 		{
 			if(tmp->s&FCEUSTATE_INDIRECT)
@@ -236,7 +240,7 @@ static bool ReadStateChunk(EMUFILE* is, SFORMAT *sf, int size)
 #endif
 		}
 		else
-			is->fseek(tsize,SEEK_CUR);
+			is->skip(tsize);
 	} // while(...)
 	return true;
 }
@@ -245,12 +249,13 @@ static int read_sfcpuc=0, read_snd=0;
 
 void FCEUD_BlitScreen(uint8 *XBuf); //mbg merge 7/17/06 YUCKY had to add
 void UpdateFCEUWindow(void);  //mbg merge 7/17/06 YUCKY had to add
-static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
+static bool ReadStateChunks(EMUFILE_MEMORY_SPAN* is, int32 totalsize)
 {
 	int t;
 	uint32 size;
 	bool ret=true;
 	bool warned=false;
+	StateHashDirty=~0U;
 
 	read_sfcpuc=0;
 	read_snd=0;
@@ -264,7 +269,7 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 	{
 		t=is->fgetc();
 		if(t==EOF) break;
-		if(!read32le(&size,is)) break;
+		if(!is->read32le(&size)) break;
 		totalsize -= size + 5;
 
 		switch(t)
@@ -274,7 +279,7 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 		case 31:if(!ReadStateChunk(is,FCEU_NEWPPU_STATEINFO,size)) ret=false;break;
 		case 4:if(!ReadStateChunk(is,FCEUCTRL_STATEINFO,size)) ret=false;break;
 		case 7:
-			if(!FCEUMOV_ReadState(is,size)) {
+			if(!FCEUMOV_ReadState(is->stream(),size)) {
 				//allow this to fail in old-format savestates.
 				if(!FCEU_state_loading_old_format)
 					ret=false;
@@ -299,7 +304,7 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 			}
 			else
 			{
-				is->fseek(size,SEEK_CUR);
+				is->skip(size);
 			}
 			break;
 		case 8:
@@ -308,6 +313,7 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 				extern uint8 *XBackBuf;
 				if(is->fread((char*)XBackBuf,size) != size)
 					ret = false;
+				FCEU_InvalidateImage();
 
 				//MBG TODO - can this be moved to a better place?
 				//does it even make sense, displaying XBuf when its XBackBuf we just loaded?
@@ -338,7 +344,7 @@ static bool ReadStateChunks(EMUFILE* is, int32 totalsize)
 				warned=true;
 			}
 			//if(fseek(st,size,SEEK_CUR)<0) goto endo;break;
-			is->fseek(size,SEEK_CUR);
+			is->skip(size);
 		}
 	}
 	//endo:
@@ -370,7 +376,8 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 	memory_savestate.set_len(0);	// this also seeks to the beginning
 	memory_savestate.unfail();
 
-	EMUFILE* os = &memory_savestate;
+	EMUFILE_MEMORY_SPAN span(&memory_savestate);
+	EMUFILE_MEMORY_SPAN* os = &span;
 
 	uint32 totalsize = 0;
 
@@ -390,12 +397,12 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 		//do not save the movie state if we are in Taseditor! That would be a huge waste of time and space!
 		if(!FCEUMOV_Mode(MOVIEMODE_TASEDITOR))
 		{
-			os->fseek(5,SEEK_CUR);
-			int size = FCEUMOV_WriteState(os);
-			os->fseek(-(size+5),SEEK_CUR);
+			os->skip(5);
+			int size = FCEUMOV_WriteState(&memory_savestate);
+			os->skip(-(size+5));
 			os->fputc(7);
-			write32le(size, os);
-			os->fseek(size,SEEK_CUR);
+			os->write32le(size);
+			os->skip(size);
 
 			totalsize += 5 + size;
 		}
@@ -405,7 +412,7 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel)
 		extern uint8 *XBackBuf;
 		uint32 size = 256 * 256 + 8;
 		os->fputc(8);
-		write32le(size, os);
+		os->write32le(size);
 		os->fwrite((char*)XBackBuf,size);
 		totalsize += 5 + size;
 	}
@@ -588,7 +595,17 @@ int FCEUSS_LoadFP_old(EMUFILE* is, ENUM_SSLOADPARAMS params)
 	//{
 	//	scan_chunks=1;
 	//}
-	x=ReadStateChunks(is,*(uint32*)(header+4));
+	//the chunk reader only works on memory, so pull the rest of the old state into memory_savestate
+	int remain = std::max(is->size() - is->ftell(), 0);
+	if ((int)(memory_savestate.get_vec())->size() < remain)
+		(memory_savestate.get_vec())->resize(remain);
+	memory_savestate.set_len(remain);
+	memory_savestate.unfail();
+	memory_savestate.fseek(0, SEEK_SET);
+	if(remain)
+		is->fread(memory_savestate.buf(), remain);
+	EMUFILE_MEMORY_SPAN span(&memory_savestate);
+	x=ReadStateChunks(&span,*(uint32*)(header+4));
 	//if(params == SSLOADPARAM_DUMMY)
 	//{
 	//	scan_chunks=0;
@@ -684,7 +701,8 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 
 	FCEUMOV_PreLoad();
 
-	bool x = (ReadStateChunks(&memory_savestate, totalsize) != 0);
+	EMUFILE_MEMORY_SPAN span(&memory_savestate);
+	bool x = (ReadStateChunks(&span, totalsize) != 0);
 
 	//mbg 5/24/08 - we don't support old states, so this shouldnt matter.
 	//if(read_sfcpuc && stateversion<9500)
@@ -855,6 +873,7 @@ void ResetExState(void (*PreSave)(void), void (*PostSave)(void))
 	SPreSave = PreSave;
 	SPostSave = PostSave;
 	SFEXINDEX=0;
+	rawdirty=true;
 }
 
 void AddExState(void *v, uint32 s, int type, char *desc)
@@ -904,6 +923,449 @@ void AddExState(void *v, uint32 s, int type, char *desc)
 		}
 	}
 	SFMDATA[SFEXINDEX].v=0;		// End marker.
+	rawdirty=true;
+}
+
+//the raw snapshot layout: every SFORMAT entry flattened to a pointer and a size, in chunk order,
+//except that the entries in the machine memory arena come first, merged into runs
+struct RAWRANGE
+{
+	void *v;
+	uint32 size;
+	bool indirect;
+};
+static std::vector<RAWRANGE> rawranges;
+static uint32 rawsize, rawlayout;
+
+//indirect entries that were resolved into an arena run, with what they pointed at then
+struct RAWREF
+{
+	void **ref;
+	void *v;
+};
+static std::vector<RAWREF> rawrefs;
+
+static bool RawRangeLess(const RAWRANGE &a, const RAWRANGE &b)
+{
+	return (uint8*)a.v<(uint8*)b.v;
+}
+
+static void AddRawRanges(SFORMAT *sf)
+{
+	for(;sf->v;sf++)
+	{
+		if(sf->s==~0)
+		{
+			AddRawRanges((SFORMAT *)sf->v);
+			continue;
+		}
+		RAWRANGE r;
+		r.v=sf->v;
+		r.size=sf->s&(~FCEUSTATE_FLAGS);
+		r.indirect=(sf->s&FCEUSTATE_INDIRECT)!=0;
+		if(!r.size)
+			continue;
+		rawranges.push_back(r);
+		rawsize+=r.size;
+	}
+}
+
+static void BuildRawRanges()
+{
+	rawranges.clear();
+	rawsize=0;
+	AddRawRanges(SFCPU);
+	AddRawRanges(SFCPUC);
+	AddRawRanges(FCEUPPU_STATEINFO);
+	AddRawRanges(FCEU_NEWPPU_STATEINFO);
+	AddRawRanges(FCEUCTRL_STATEINFO);
+	AddRawRanges(FCEUSND_STATEINFO);
+	AddRawRanges(SFMDATA);
+
+	//the game's memory is allocated in one place, so most of it sits back to back; each run of it
+	//is a single memcpy
+	std::vector<RAWRANGE> arena, rest;
+	rawrefs.clear();
+	for(size_t i=0;i<rawranges.size();i++)
+	{
+		RAWRANGE r=rawranges[i];
+		void *v=r.indirect ? *(void **)r.v : r.v;
+		if(!FCEU_ArenaContains(v))
+		{
+			rest.push_back(r);
+			continue;
+		}
+		if(r.indirect)
+		{
+			RAWREF ref={(void **)r.v,v};
+			rawrefs.push_back(ref);
+			r.v=v;
+			r.indirect=false;
+		}
+		arena.push_back(r);
+	}
+	std::sort(arena.begin(),arena.end(),RawRangeLess);
+
+	rawranges.clear();
+	for(size_t i=0;i<arena.size();i++)
+	{
+		uint8 *v=(uint8*)arena[i].v;
+		if(!rawranges.empty() && v<=(uint8*)rawranges.back().v+rawranges.back().size)
+		{
+			//touching or overlapping the run before it
+			RAWRANGE &last=rawranges.back();
+			uint32 size=(uint32)(v+arena[i].size-(uint8*)last.v);
+			if(size>last.size)
+				last.size=size;
+		}
+		else
+			rawranges.push_back(arena[i]);
+	}
+	rawranges.insert(rawranges.end(),rest.begin(),rest.end());
+
+	rawsize=0;
+	for(size_t i=0;i<rawranges.size();i++)
+		rawsize+=rawranges[i].size;
+	rawlayout++;
+	rawdirty=false;
+}
+
+//an indirect entry that now points somewhere else changes the layout like a new AddExState does
+static void CheckRawRefs()
+{
+	for(size_t i=0;i<rawrefs.size();i++)
+		if(*rawrefs[i].ref!=rawrefs[i].v)
+			rawdirty=true;
+}
+
+uint32 FCEUSS_RawSize()
+{
+	CheckRawRefs();
+	if(rawdirty)
+		BuildRawRanges();
+	return rawsize;
+}
+
+uint32 FCEUSS_RawLayout()
+{
+	CheckRawRefs();
+	if(rawdirty)
+		BuildRawRanges();
+	return rawlayout;
+}
+
+void FCEUSS_SaveRaw(uint8 *buf)
+{
+	CheckRawRefs();
+	if(rawdirty)
+		BuildRawRanges();
+
+	FCEUPPU_SaveState();
+	FCEUSND_SaveState();
+	if(SPreSave) SPreSave();
+	for(size_t i=0;i<rawranges.size();i++)
+	{
+		const RAWRANGE &r=rawranges[i];
+		memcpy(buf,r.indirect ? *(void **)r.v : r.v,r.size);
+		buf+=r.size;
+	}
+	if(SPostSave) SPostSave();
+}
+
+bool FCEUSS_LoadRaw(const uint8 *buf, uint32 size)
+{
+	CheckRawRefs();
+	if(rawdirty || size!=rawsize)
+		return false;
+
+	for(size_t i=0;i<rawranges.size();i++)
+	{
+		const RAWRANGE &r=rawranges[i];
+		memcpy(r.indirect ? *(void **)r.v : r.v,buf,r.size);
+		buf+=r.size;
+	}
+
+	if(GameStateRestore)
+		GameStateRestore(FCEU_VERSION_NUMERIC);
+	FCEUPPU_LoadState(FCEU_VERSION_NUMERIC);
+	FCEUSND_LoadState(FCEU_VERSION_NUMERIC);
+	extern int resetDMCacc;
+	resetDMCacc=0;
+	StateHashDirty=~0U;
+	return true;
+}
+
+//the tables of a raw snapshot, with the part of the state hash each one is in. the field hashes
+//and the state hashes both walk them through the same list of fields
+struct STATECHUNK
+{
+	const char *name;
+	SFORMAT *sf;
+	uint32 part;
+};
+static const STATECHUNK StateChunks[]={
+	{ "CPU", SFCPU, FCEU_HASH_CPU },
+	{ "CPUC", SFCPUC, FCEU_HASH_CPU },
+	{ "PPU", FCEUPPU_STATEINFO, FCEU_HASH_PPU },
+	{ "NPPU", FCEU_NEWPPU_STATEINFO, FCEU_HASH_PPU },
+	{ "CTRL", FCEUCTRL_STATEINFO, FCEU_HASH_INPUT },
+	{ "SND", FCEUSND_STATEINFO, FCEU_HASH_APU },
+	{ "MAP", SFMDATA, FCEU_HASH_MAPPER },
+};
+#define STATECHUNK_COUNT (sizeof(StateChunks)/sizeof(StateChunks[0]))
+
+//every field with the part it belongs to. the memory that is only written through handlers that
+//set StateHashDirty keeps its last hash until its part is dirty again; the rest is small, and is
+//hashed as it is each time
+struct HASHFIELD
+{
+	const char *chunk;
+	SFORMAT *sf;
+	uint32 part;
+	bool cached;
+	uint64 h[2];
+};
+
+uint32 StateHashDirty=~0U;
+static std::vector<HASHFIELD> hashfields;
+static uint32 hashlayout;
+static std::vector<uint8> hashbuf;
+static FILE *hashlog;
+static uint32 hashlogparts;
+static int hashlogframes;
+
+static const struct { const char *name; uint32 part; } HashPartNames[]={
+	{ "cpu", FCEU_HASH_CPU },
+	{ "ram", FCEU_HASH_RAM },
+	{ "wram", FCEU_HASH_WRAM },
+	{ "ppu", FCEU_HASH_PPU },
+	{ "oam", FCEU_HASH_OAM },
+	{ "apu", FCEU_HASH_APU },
+	{ "mapper", FCEU_HASH_MAPPER },
+	{ "input", FCEU_HASH_INPUT },
+	{ "all", FCEU_HASH_ALL },
+};
+#define HASHPART_COUNT (sizeof(HashPartNames)/sizeof(HashPartNames[0]))
+
+static void AddHashFields(const char *chunk, SFORMAT *sf, uint32 part)
+{
+	for(;sf->v;sf++)
+	{
+		if(sf->s==~0)
+		{
+			AddHashFields(chunk,(SFORMAT *)sf->v,part);
+			continue;
+		}
+		HASHFIELD f;
+		f.chunk=chunk;
+		f.sf=sf;
+		f.part=part;
+		f.cached=false;
+		if(sf->v==&RAM)
+		{
+			f.part=FCEU_HASH_RAM;
+			f.cached=true;
+		}
+		else if(sf->v==SPRAM)
+		{
+			f.part=FCEU_HASH_OAM;
+			f.cached=true;
+		}
+		else if(sf->v==NTARAM || sf->v==PALRAM)
+			f.cached=true;
+		else if(part==FCEU_HASH_MAPPER && sf->desc)
+		{
+			//the boards name their memory the same way
+			if(!strncmp(sf->desc,"WRAM",4))
+				f.part=FCEU_HASH_WRAM;
+			else if(!strncmp(sf->desc,"CHRR",4) || !strncmp(sf->desc,"EXNR",4))
+			{
+				f.part=FCEU_HASH_PPU;
+				f.cached=true;
+			}
+		}
+		hashfields.push_back(f);
+	}
+}
+
+//the list follows the raw layout, and a new one has no hashes cached yet
+static void CheckHashFields()
+{
+	uint32 layout=FCEUSS_RawLayout();
+	if(layout==hashlayout)
+		return;
+	hashfields.clear();
+	for(size_t i=0;i<STATECHUNK_COUNT;i++)
+		AddHashFields(StateChunks[i].name,StateChunks[i].sf,StateChunks[i].part);
+	hashlayout=layout;
+	StateHashDirty=~0U;
+}
+
+//appends the field little endian
+static void AppendField(SFORMAT *sf, std::vector<uint8> &buf)
+{
+	uint32 size=sf->s&(~FCEUSTATE_FLAGS);
+	uint8 *v=(sf->s&FCEUSTATE_INDIRECT) ? *(uint8 **)sf->v : (uint8 *)sf->v;
+	if(!v || !size)
+		return;
+	buf.insert(buf.end(),v,v+size);
+#ifndef LSB_FIRST
+	if(sf->s&RLSB)
+		FlipByteOrder(&buf[buf.size()-size],size);
+#endif
+}
+
+//the cached fields are all byte arrays, so they need no flipping
+static void HashField(SFORMAT *sf, uint64 *h)
+{
+	uint32 size=sf->s&(~FCEUSTATE_FLAGS);
+	uint8 *v=(sf->s&FCEUSTATE_INDIRECT) ? *(uint8 **)sf->v : (uint8 *)sf->v;
+	FCEU_Hash128(v,v ? size : 0,h);
+}
+
+void FCEUSS_GetFields(std::vector<FCEU_STATE_FIELD> *fields)
+{
+	CheckHashFields();
+	fields->clear();
+	for(size_t i=0;i<hashfields.size();i++)
+	{
+		const HASHFIELD &h=hashfields[i];
+		FCEU_STATE_FIELD f;
+		f.chunk=h.chunk;
+		strncpy(f.name,h.sf->desc,4);
+		f.name[4]=0;
+		f.size=h.sf->s&(~FCEUSTATE_FLAGS);
+		fields->push_back(f);
+	}
+}
+
+//the low half of a cached field's 128 bit hash is the FCEU_Hash64 of it, so the cached fields
+//only need hashing again when their part is dirty
+void FCEUSS_HashFields(std::vector<uint64> *hashes)
+{
+	CheckHashFields();
+	hashes->clear();
+	FCEUPPU_SaveState();
+	FCEUSND_SaveState();
+	if(SPreSave) SPreSave();
+	for(size_t i=0;i<hashfields.size();i++)
+	{
+		HASHFIELD &f=hashfields[i];
+		if(f.cached)
+		{
+			if(StateHashDirty&f.part)
+				HashField(f.sf,f.h);
+			hashes->push_back(f.h[0]);
+			continue;
+		}
+		hashbuf.clear();
+		AppendField(f.sf,hashbuf);
+		hashes->push_back(FCEU_Hash64(hashbuf.empty() ? 0 : &hashbuf[0],hashbuf.size()));
+	}
+	if(SPostSave) SPostSave();
+	StateHashDirty=0;
+}
+
+uint64 FCEUI_HashState(uint32 parts, uint64 *high)
+{
+	CheckHashFields();
+
+	FCEUPPU_SaveState();
+	FCEUSND_SaveState();
+	if(SPreSave) SPreSave();
+	//the uncached fields and the hashes of the cached ones, little endian, are hashed together
+	hashbuf.clear();
+	for(size_t i=0;i<hashfields.size();i++)
+	{
+		HASHFIELD &f=hashfields[i];
+		if(!(f.part&parts))
+			continue;
+		if(!f.cached)
+		{
+			AppendField(f.sf,hashbuf);
+			continue;
+		}
+		if(StateHashDirty&f.part)
+			HashField(f.sf,f.h);
+		for(int j=0;j<16;j++)
+			hashbuf.push_back((uint8)(f.h[j>>3]>>((j&7)*8)));
+	}
+	if(SPostSave) SPostSave();
+	StateHashDirty&=~parts;
+
+	uint64 h[2];
+	FCEU_Hash128(hashbuf.empty() ? 0 : &hashbuf[0],hashbuf.size(),h,parts);
+	if(high)
+		*high=h[1];
+	return h[0];
+}
+
+bool FCEUI_HashParseParts(const char *names, uint32 *parts)
+{
+	*parts=0;
+	std::string name;
+	for(const char *p=names;;p++)
+	{
+		if(*p && *p!=',' && *p!=' ' && *p!='+')
+		{
+			name+=(char)tolower(*p);
+			continue;
+		}
+		if(!name.empty())
+		{
+			size_t i;
+			for(i=0;i<HASHPART_COUNT;i++)
+				if(name==HashPartNames[i].name)
+					break;
+			if(i==HASHPART_COUNT)
+				return false;
+			*parts|=HashPartNames[i].part;
+			name.clear();
+		}
+		if(!*p)
+			break;
+	}
+	return *parts!=0;
+}
+
+bool FCEUI_HashLogStart(const char *fname, uint32 parts)
+{
+	FCEUI_HashLogStop();
+	hashlog=FCEUD_UTF8fopen(fname,"w");
+	if(!hashlog)
+	{
+		FCEU_PrintError("Couldn't open %s for the state hashes.",fname);
+		return false;
+	}
+	hashlogparts=parts;
+	hashlogframes=0;
+	fprintf(hashlog,"# FCEUX state hashes:");
+	for(size_t i=0;i<HASHPART_COUNT-1;i++)
+		if(parts&HashPartNames[i].part)
+			fprintf(hashlog," %s",HashPartNames[i].name);
+	fprintf(hashlog,"\n");
+	return true;
+}
+
+void FCEUI_HashLogStop()
+{
+	if(!hashlog)
+		return;
+	if(fclose(hashlog))
+		FCEU_PrintError("Couldn't write all the state hashes.");
+	else
+		FCEU_printf("State hash log finished, %d frames.\n",hashlogframes);
+	hashlog=0;
+}
+
+void FCEU_HashLogFrame()
+{
+	if(!hashlog)
+		return;
+	uint64 high;
+	uint64 low=FCEUI_HashState(hashlogparts,&high);
+	fprintf(hashlog,"%d %016llx%016llx\n",FCEUMOV_GetFrame(),(unsigned long long)high,(unsigned long long)low);
+	hashlogframes++;
 }
 
 void FCEUI_SelectStateNext(int n)
@@ -18,6 +18,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <vector>
+
 enum ENUM_SSLOADPARAMS
 {
 	SSLOADPARAM_NOBACKUP,
@@ -32,6 +34,59 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel);
 
 bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params);
 
+//raw snapshots: everything the savestate chunks cover, copied straight into a buffer the caller
+//owns, without chunk headers, compression, the back buffer or the movie. they cost a few memcpys,
+//but they only restore into the same loaded game, so they are not a savestate format.
+//FCEUSS_RawSize() is the buffer size; it changes when a game is loaded.
+uint32 FCEUSS_RawSize();
+void FCEUSS_SaveRaw(uint8 *buf);
+//fails when the layout changed since the snapshot was taken
+bool FCEUSS_LoadRaw(const uint8 *buf, uint32 size);
+//identifies the current layout; it changes whenever the layout is rebuilt, so a snapshot kept
+//across game loads can tell that it no longer fits, even when the size happens to match
+uint32 FCEUSS_RawLayout();
+
+//the savestate's fields one at a time, for comparing two machines field by field. chunk is the
+//table the field is in: CPU, CPUC, PPU, NPPU (the new ppu), CTRL, SND, or MAP for the board's own
+struct FCEU_STATE_FIELD
+{
+	const char *chunk;
+	char name[5];
+	uint32 size;
+};
+void FCEUSS_GetFields(std::vector<FCEU_STATE_FIELD> *fields);
+//an FCEU_Hash64 of each field as it is right now, in FCEUSS_GetFields order. multibyte values
+//are hashed little endian, so the hashes are the same on any machine. like FCEUI_HashState, it
+//keeps the hashes of RAM, OAM and the PPU's memory until they are written
+void FCEUSS_HashFields(std::vector<uint64> *hashes);
+
+//the parts of the machine a state hash can cover
+#define FCEU_HASH_CPU    0x01 //the registers and the cpu's timing
+#define FCEU_HASH_RAM    0x02
+#define FCEU_HASH_WRAM   0x04 //the board's work ram
+#define FCEU_HASH_PPU    0x08 //nametables, palette, chr ram and the ppu's registers
+#define FCEU_HASH_OAM    0x10
+#define FCEU_HASH_APU    0x20
+#define FCEU_HASH_MAPPER 0x40 //the rest of the board's state
+#define FCEU_HASH_INPUT  0x80
+#define FCEU_HASH_ALL    0xFF
+//a 128 bit hash of those parts as they are now: the low half is returned and the high half goes
+//to high when it is given. like the field hashes, it is the same on any machine and build that
+//saves the same state. RAM, OAM and the PPU's memory keep their hashes until they are written
+uint64 FCEUI_HashState(uint32 parts, uint64 *high=0);
+//parts from names like "cpu,ram,oam", or "all"; false on a name it does not know
+bool FCEUI_HashParseParts(const char *names, uint32 *parts);
+//writes the hash of those parts to fname after every frame, one line each, so two replays of a
+//movie can be compared with diff
+bool FCEUI_HashLogStart(const char *fname, uint32 parts);
+void FCEUI_HashLogStop();
+//called at the end of each frame
+void FCEU_HashLogFrame();
+
+//the parts written since they were last hashed, as FCEU_HASH_ bits. the cpu's and the ppu's
+//memory write handlers set theirs; whatever else changes memory behind them sets them all
+extern uint32 StateHashDirty;
+
 extern int CurrentState;
 void FCEUSS_CheckStates(void);
 
@@ -0,0 +1,164 @@
+/// \file
+/// \brief band-limited step synthesis for the high quality sound path
+
+#include <cmath>
+#include <cstring>
+
+#include "types.h"
+#include "stepsynth.h"
+
+#define STEP_PHASE_BITS 6
+#define STEP_PHASES (1<<STEP_PHASE_BITS)
+#define STEP_MAX_WIDTH 32
+#define STEP_BUFFER_SIZE 4096
+
+//kernel taps are 1.15 fixed point and every phase sums to exactly 1.0, so the running sum of
+//the buffer returns to the exact output level after each step
+#define STEP_UNIT_BITS 15
+
+static int32 kernel[STEP_PHASES][STEP_MAX_WIDTH];
+static int32 width;
+static int32 gain;
+
+//cpu cycles per output sample in 16.16, and its inverse scaled to 32.32 samples per 16.16 cycle.
+//samples are placed and counted in cycles exactly like NeoFilterSound does, so both engines
+//give the same number of samples in every frame.
+static uint32 ratio;
+static int64 inverse;
+
+//the cpu time buf[0] is centered on, 16.16 and counted from the start of the frame
+static int64 base;
+static int64 firstbase, lookahead;
+static int32 half;
+
+//differences of the output, summed up in StepSynthEnd. "used" is one past the last entry
+//any step has touched.
+static int32 buf[STEP_BUFFER_SIZE+STEP_MAX_WIDTH];
+static int32 used;
+static int64 level;
+
+static double BesselI0(double x)
+{
+	double sum=1,term=1;
+	for(int k=1;k<32;k++)
+	{
+		term*=(x/(2*k))*(x/(2*k));
+		sum+=term;
+	}
+	return sum;
+}
+
+//kaiser windowed sinc, t in output samples
+static double Impulse(double t, double half, double cutoff, double beta)
+{
+	double r=t/half;
+	if(r*r>=1)
+		return 0;
+	double x=2*cutoff*t;
+	double sinc=x==0?1:sin(M_PI*x)/(M_PI*x);
+	return sinc*BesselI0(beta*sqrt(1-r*r));
+}
+
+void MakeStepKernel(uint32 ratio_, int32 gain_, double first, double lookahead_, double cutoff)
+{
+	const double beta=4.0;
+
+	ratio=ratio_;
+	inverse=(int64)(((uint64)1<<48)/ratio);
+	gain=gain_;
+	firstbase=(int64)(first*65536);
+	lookahead=(int64)(lookahead_*65536);
+
+	//a step reaches back "half" samples before the one it is centered on, which has to fit in
+	//the lookahead. tap 0 only keeps the kernel's start aligned with the step's sample.
+	half=(int32)(lookahead/ratio);
+	if(half>(STEP_MAX_WIDTH-2)/2) half=(STEP_MAX_WIDTH-2)/2;
+	width=half*2+2;
+
+	//a step in phase p sits (p+0.5)/STEP_PHASES into its sample. tap i gets what the step
+	//response gains over output sample i, which puts the middle of the step "half" samples late.
+	const int sub=16;
+	for(int p=0;p<STEP_PHASES;p++)
+	{
+		double f=(p+0.5)/STEP_PHASES;
+		double taps[STEP_MAX_WIDTH],total=0;
+		for(int i=0;i<width;i++)
+		{
+			double a=i-1-f-half;
+			taps[i]=0;
+			for(int j=0;j<sub;j++)
+				taps[i]+=Impulse(a+(j+0.5)/sub,half,cutoff,beta);
+			total+=taps[i];
+		}
+
+		int32 sum=0,peak=0;
+		for(int i=0;i<width;i++)
+		{
+			kernel[p][i]=(int32)floor(taps[i]/total*(1<<STEP_UNIT_BITS)+0.5);
+			sum+=kernel[p][i];
+			if(kernel[p][i]>kernel[p][peak])
+				peak=i;
+		}
+		kernel[p][peak]+=(1<<STEP_UNIT_BITS)-sum;
+	}
+
+	StepSynthClear();
+}
+
+void StepSynthClear(void)
+{
+	memset(buf,0,sizeof(buf));
+	used=0;
+	base=firstbase;
+	level=0;
+}
+
+void StepSynthAdd(uint32 time, int32 delta)
+{
+	//steps from before the first sample all pile up at its start
+	int64 pos=(((((int64)time<<16)-base)*inverse)>>16)-((int64)half<<32);
+	if(pos<0)
+		pos=0;
+	int32 index=(int32)(pos>>32);
+	if(index>STEP_BUFFER_SIZE)
+		return;
+
+	const int32 *k=kernel[(pos>>(32-STEP_PHASE_BITS))&(STEP_PHASES-1)];
+	int32 *out=buf+index;
+	for(int32 i=0;i<width;i++)
+		out[i]+=k[i]*delta;
+	if(index+width>used)
+		used=index+width;
+}
+
+int32 StepSynthEnd(uint32 time, int32 *out)
+{
+	//the samples centered before time-lookahead are finished
+	int64 end=((int64)time<<16)-lookahead;
+	int32 count=0;
+	if(end>base)
+		count=(int32)((end-base+ratio-1)/ratio);
+	if(count>STEP_BUFFER_SIZE)
+		count=STEP_BUFFER_SIZE;
+	base+=(int64)count*ratio-((int64)time<<16);
+
+	for(int32 n=0;n<count;n++)
+	{
+		level+=buf[n];
+		out[n]=(int32)((level*gain)>>(STEP_UNIT_BITS+16));
+	}
+
+	//what is left belongs to steps past the end of the frame
+	if(used>count)
+	{
+		memmove(buf,buf+count,(used-count)*sizeof(int32));
+		memset(buf+used-count,0,count*sizeof(int32));
+		used-=count;
+	}
+	else
+	{
+		memset(buf,0,used*sizeof(int32));
+		used=0;
+	}
+	return count;
+}
@@ -0,0 +1,27 @@
+#ifndef _STEPSYNTH_H_
+#define _STEPSYNTH_H_
+
+#include "types.h"
+
+//band-limited step synthesis. the sound code reports every change of its output level as a
+//step at a cpu timestamp; each step is added to the output as a windowed-sinc step response,
+//so the result is already filtered and at the output rate.
+
+//builds the step kernels. ratio is cpu cycles per output sample in 16.16 fixed point, gain a
+//16.16 factor applied to the output and cutoff the lowpass frequency as a fraction of the output
+//rate. the first output sample is centered on cpu time "first", counted from the start of the
+//first frame after StepSynthClear. a frame ending at time t gives the samples centered before
+//t-lookahead; the kernel is as long as the lookahead allows.
+void MakeStepKernel(uint32 ratio, int32 gain, double first, double lookahead, double cutoff);
+
+//drops everything pending
+void StepSynthClear(void);
+
+//adds a step of delta at cpu time "time", counted from the start of the current frame
+void StepSynthAdd(uint32 time, int32 delta);
+
+//finishes the frame at cpu time "time", no steps before it may follow. writes the finished
+//samples to out and returns their count. the next frame's time 0 is "time".
+int32 StepSynthEnd(uint32 time, int32 *out);
+
+#endif
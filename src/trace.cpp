@@ -0,0 +1,417 @@
+/// \file
+/// \brief the instruction trace recorder: the cpu loop packs each instruction into a compact binary
+/// record, and full blocks of them go through a lock-free queue to a thread that compresses them to disk
+
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <zlib.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include "types.h"
+#include "trace.h"
+#include "x6502.h"
+#include "fceu.h"
+#include "ppu.h"
+#include "movie.h"
+#include "debug.h"
+#include "utils/endian.h"
+
+//no record is longer than this; a block is handed on before it could run out
+#define TRACE_RECORD_MAX 32
+//blocks between the cpu loop and the writer, 16MB of them
+#define TRACE_QUEUE_BLOCKS 64
+
+struct TRACEBLOCK
+{
+	uint32 used, count;
+	uint8 data[TRACE_BLOCK_SIZE];
+};
+
+static gzFile out;
+static FCEU_TRACE_OPTIONS opts;
+static bool armed, recording;
+static bool frameok; //startframe has been reached
+static bool failed;
+static uint64 total;
+
+//the block being filled, and what the next instruction is encoded against
+static TRACEBLOCK *cur;
+static bool needsync;
+static uint16 nextpc;
+static uint8 lastregs[5];
+static uint64 lastcycles;
+static int lastscanline;
+
+//streaming: the cpu loop fills queue[head%TRACE_QUEUE_BLOCKS] and the writer thread empties
+//queue[tail%TRACE_QUEUE_BLOCKS]. each side only moves its own index
+static TRACEBLOCK *queue[TRACE_QUEUE_BLOCKS];
+static volatile uint32 queuehead, queuetail;
+static bool threaded;
+#ifndef WIN32
+static volatile bool writerquit;
+static pthread_t writer;
+#endif
+
+//ring: the last blocks, oldest first, with the blocks dropped off the front kept for reuse
+static std::deque<TRACEBLOCK*> held;
+static std::vector<TRACEBLOCK*> spare;
+static uint64 heldcount;
+
+//a probe waiting for its instruction
+static void (*probe)();
+static uint32 probeleft;
+
+static void WriteBlock(TRACEBLOCK *b)
+{
+	uint8 header[8];
+	FCEU_en32lsb(header,b->used);
+	FCEU_en32lsb(header+4,b->count);
+	if(gzwrite(out,header,8)!=8 || gzwrite(out,b->data,b->used)!=(int)b->used)
+		failed=true;
+}
+
+#ifndef WIN32
+static void* WriterThread(void*)
+{
+	for(;;)
+	{
+		if(queuetail!=queuehead)
+		{
+			__sync_synchronize();
+			WriteBlock(queue[queuetail%TRACE_QUEUE_BLOCKS]);
+			__sync_synchronize();
+			queuetail++;
+		}
+		else if(writerquit)
+		{
+			//the last block is queued just before the quit, which can land after the check above
+			__sync_synchronize();
+			if(queuetail==queuehead)
+				break;
+		}
+		else
+			usleep(1000);
+	}
+	return 0;
+}
+#endif
+
+//hands the full block on and starts another
+static void NextBlock()
+{
+	if(opts.ring)
+	{
+		held.push_back(cur);
+		heldcount+=cur->count;
+		while(held.size()>1 && heldcount-held.front()->count>=opts.ring)
+		{
+			heldcount-=held.front()->count;
+			spare.push_back(held.front());
+			held.pop_front();
+		}
+		if(spare.empty())
+			cur=new TRACEBLOCK;
+		else
+		{
+			cur=spare.back();
+			spare.pop_back();
+		}
+	}
+	else if(!threaded)
+		WriteBlock(cur);
+#ifndef WIN32
+	else
+	{
+		__sync_synchronize();
+		queuehead++;
+		//the writer is behind: wait for it rather than lose instructions
+		while(queuehead-queuetail>=TRACE_QUEUE_BLOCKS)
+			usleep(200);
+		__sync_synchronize();
+		cur=queue[queuehead%TRACE_QUEUE_BLOCKS];
+	}
+#endif
+	cur->used=cur->count=0;
+	needsync=true;
+}
+
+static INLINE uint8* Put16(uint8 *p, uint32 v)
+{
+	p[0]=(uint8)v;
+	p[1]=(uint8)(v>>8);
+	return p+2;
+}
+
+static INLINE uint8* Put32(uint8 *p, uint32 v)
+{
+	FCEU_en32lsb(p,v);
+	return p+4;
+}
+
+static INLINE int Scanline()
+{
+	return newppu ? newppu_get_scanline() : scanline;
+}
+
+static void PutSync(uint64 cycles, int sl)
+{
+	uint8 *p=cur->data+cur->used;
+	*p++=TRACE_SYNC;
+	p=Put16(p,X.PC);
+	lastregs[0]=*p++=X.A;
+	lastregs[1]=*p++=X.X;
+	lastregs[2]=*p++=X.Y;
+	lastregs[3]=*p++=X.P;
+	lastregs[4]=*p++=X.S;
+	p=Put32(p,(uint32)cycles);
+	p=Put32(p,(uint32)(cycles>>32));
+	p=Put32(p,FCEUMOV_GetFrame());
+	p=Put16(p,sl);
+	cur->used=(uint32)(p-cur->data);
+	nextpc=X.PC;
+	lastcycles=cycles;
+	lastscanline=sl;
+	needsync=false;
+}
+
+static void Begin()
+{
+	recording=true;
+	needsync=true;
+}
+
+void FCEU_TraceInstruction(uint8 op)
+{
+	if(probe)
+	{
+		if(probeleft)
+			probeleft--;
+		else
+		{
+			void (*fn)()=probe;
+			probe=0;
+			fn();
+		}
+	}
+	if(!armed)
+		return;
+
+	if(!recording)
+	{
+		//a probe gets the cpu loop calling here before startframe is reached
+		if(!frameok || opts.startonbreak || X.PC!=opts.startpc)
+			return;
+		Begin();
+	}
+	else if(X.PC==opts.stoppc)
+	{
+		FCEUI_TraceStop();
+		return;
+	}
+
+	if(cur->used+TRACE_RECORD_MAX>TRACE_BLOCK_SIZE)
+		NextBlock();
+	uint64 cycles=timestampbase+timestamp;
+	int sl=Scanline();
+	//a state load or a reset can take the clock back, which a delta cannot say
+	if(needsync || cycles<lastcycles)
+		PutSync(cycles,sl);
+	uint8 *p=cur->data+cur->used;
+	if(sl!=lastscanline)
+	{
+		*p++=TRACE_SCANLINE;
+		p=Put16(p,sl);
+		lastscanline=sl;
+	}
+
+	int size=opsize[op];
+	if(!size)
+		size=1;
+	uint8 *tag=p++;
+	*tag=(uint8)size;
+	if(X.PC!=nextpc)
+	{
+		*tag|=TRACE_PC;
+		p=Put16(p,X.PC);
+	}
+	const uint8 regs[5]={X.A,X.X,X.Y,X.P,X.S};
+	for(int i=0;i<5;i++)
+	{
+		if(regs[i]!=lastregs[i])
+		{
+			*tag|=TRACE_A<<i;
+			*p++=lastregs[i]=regs[i];
+		}
+	}
+	*p++=op;
+	for(int i=1;i<size;i++)
+		*p++=GetMem((X.PC+i)&0xFFFF);
+	uint64 delta=cycles-lastcycles;
+	while(delta>=0x80)
+	{
+		*p++=(uint8)(delta|0x80);
+		delta>>=7;
+	}
+	*p++=(uint8)delta;
+
+	cur->used=(uint32)(p-cur->data);
+	cur->count++;
+	nextpc=(uint16)(X.PC+size);
+	lastcycles=cycles;
+	total++;
+}
+
+bool FCEU_TraceWanted()
+{
+	return probe || recording || (armed && frameok && opts.startpc>=0 && !opts.startonbreak);
+}
+
+void FCEU_TraceFrame()
+{
+	if(!armed)
+		return;
+	int frame=FCEUMOV_GetFrame();
+	if(!recording)
+	{
+		if(frame<opts.startframe || frameok)
+			return;
+		frameok=true;
+		if(opts.startpc<0 && !opts.startonbreak)
+			Begin();
+		return;
+	}
+	if(opts.stopframe>=0 && frame>=opts.stopframe)
+	{
+		FCEUI_TraceStop();
+		return;
+	}
+	if(cur->used+TRACE_RECORD_MAX>TRACE_BLOCK_SIZE)
+		NextBlock();
+	if(needsync)
+		return; //the sync record has the frame
+	uint8 *p=cur->data+cur->used;
+	*p++=TRACE_FRAME;
+	p=Put32(p,frame);
+	cur->used=(uint32)(p-cur->data);
+}
+
+void FCEU_TraceBreak()
+{
+	if(recording && opts.stoponbreak)
+		FCEUI_TraceStop();
+	else if(armed && !recording && opts.startonbreak)
+		Begin();
+}
+
+bool FCEUI_TraceActive()
+{
+	return armed;
+}
+
+void FCEUI_TraceProbe(uint32 instructions, void (*fn)())
+{
+	probe=fn;
+	probeleft=instructions;
+}
+
+bool FCEUI_TraceStart(const char *fname, const FCEU_TRACE_OPTIONS &options)
+{
+	FCEUI_TraceStop();
+
+	out=gzopen(fname,"wb1");
+	if(!out || gzwrite(out,TRACE_MAGIC,TRACE_MAGIC_SIZE)!=TRACE_MAGIC_SIZE)
+	{
+		if(out)
+			gzclose(out);
+		out=0;
+		FCEU_PrintError("Couldn't open %s for the trace.",fname);
+		return false;
+	}
+
+	opts=options;
+	failed=false;
+	total=0;
+	heldcount=0;
+	threaded=false;
+	if(opts.ring)
+		cur=new TRACEBLOCK;
+	else
+	{
+		for(int i=0;i<TRACE_QUEUE_BLOCKS;i++)
+			queue[i]=new TRACEBLOCK;
+		queuehead=queuetail=0;
+		cur=queue[0];
+#ifndef WIN32
+		writerquit=false;
+		threaded=pthread_create(&writer,0,WriterThread,0)==0;
+#endif
+	}
+	cur->used=cur->count=0;
+
+	armed=true;
+	recording=false;
+	frameok=opts.startframe<0 || FCEUMOV_GetFrame()>=opts.startframe;
+	if(frameok && opts.startpc<0 && !opts.startonbreak)
+		Begin();
+	return true;
+}
+
+void FCEUI_TraceStop()
+{
+	if(!armed)
+		return;
+	armed=recording=false;
+
+	if(opts.ring)
+	{
+		total=heldcount+cur->count;
+		held.push_back(cur);
+		for(size_t i=0;i<held.size();i++)
+		{
+			if(held[i]->used)
+				WriteBlock(held[i]);
+			delete held[i];
+		}
+		for(size_t i=0;i<spare.size();i++)
+			delete spare[i];
+		held.clear();
+		spare.clear();
+	}
+	else
+	{
+		if(!threaded && cur->used)
+			WriteBlock(cur);
+#ifndef WIN32
+		if(threaded)
+		{
+			if(cur->used)
+			{
+				__sync_synchronize();
+				queuehead++;
+			}
+			__sync_synchronize();
+			writerquit=true;
+			pthread_join(writer,0);
+		}
+#endif
+		for(int i=0;i<TRACE_QUEUE_BLOCKS;i++)
+		{
+			delete queue[i];
+			queue[i]=0;
+		}
+	}
+	cur=0;
+
+	if(gzclose(out)!=Z_OK)
+		failed=true;
+	out=0;
+	if(failed)
+		FCEU_PrintError("Couldn't write the whole trace.");
+	else
+		FCEU_printf("Trace finished, %llu instructions.\n",(unsigned long long)total);
+}
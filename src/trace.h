@@ -0,0 +1,64 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "types.h"
+
+//the instruction trace file: gzip compressed, TRACE_MAGIC and then blocks, each a uint32 byte count,
+//a uint32 instruction count and that many bytes of records. every block starts with a TRACE_SYNC,
+//so it can be decoded without the ones before it. numbers are little endian
+#define TRACE_MAGIC "FCEUTRC1"
+#define TRACE_MAGIC_SIZE 8
+#define TRACE_BLOCK_SIZE (256<<10)
+
+//each record starts with a tag byte. when its low two bits are 0 the record is a marker:
+#define TRACE_SYNC     0x00 //pc16 a x y p s cycles64 frame32 scanline16: everything the others leave out
+#define TRACE_SCANLINE 0x04 //scanline16
+#define TRACE_FRAME    0x08 //frame32
+//otherwise it is an instruction, and the low two bits are its length. it goes on with the pc16, when
+//the pc is not the one after the last instruction, and the registers that changed since then, each
+//only when its bit is set and in this order; then the instruction bytes and the cycles since the last
+//instruction as a varint (7 bits per byte, low first, the top bit set when more follow)
+#define TRACE_PC 0x04
+#define TRACE_A  0x08
+#define TRACE_X  0x10
+#define TRACE_Y  0x20
+#define TRACE_P  0x40
+#define TRACE_S  0x80
+
+//when the trace starts and stops. -1 leaves a condition out
+struct FCEU_TRACE_OPTIONS
+{
+	int startframe;	//start once this frame is reached...
+	int startpc;	//...and then at the first instruction here
+	int stopframe;
+	int stoppc;
+	bool startonbreak;	//start at a debugger breakpoint instead
+	bool stoponbreak;
+	uint32 ring;	//when not 0, keep only the last this many instructions in memory and write them out on stop
+
+	FCEU_TRACE_OPTIONS()
+		: startframe(-1), startpc(-1), stopframe(-1), stoppc(-1)
+		, startonbreak(false), stoponbreak(false), ring(0)
+	{}
+};
+
+//arms a trace into fname, replacing one already running. it records from the first instruction
+//unless the options say otherwise. streaming traces are compressed and written by a thread of their own
+bool FCEUI_TraceStart(const char *fname, const FCEU_TRACE_OPTIONS &options);
+//finishes the file. a trace that stops on its own does this itself
+void FCEUI_TraceStop();
+//armed or recording
+bool FCEUI_TraceActive();
+//calls probe once, after that many more instructions have run and before the next one does, to
+//look at the machine partway through a frame. it does not need a trace; NULL cancels it
+void FCEUI_TraceProbe(uint32 instructions, void (*probe)());
+
+//called by the cpu loop before each instruction, while FCEU_TraceWanted
+void FCEU_TraceInstruction(uint8 op);
+//whether the cpu loop has to call FCEU_TraceInstruction
+bool FCEU_TraceWanted();
+//called at the start of each frame, and when the debugger breaks
+void FCEU_TraceFrame();
+void FCEU_TraceBreak();
+
+#endif
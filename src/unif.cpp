@@ -85,7 +85,7 @@ static int FixRomSize(uint32 size, uint32 minimum) {
 static void FreeUNIF(void) {
 	int x;
 	if (UNIFchrrama) {
-		free(UNIFchrrama); UNIFchrrama = 0;
+		FCEU_gfree(UNIFchrrama); UNIFchrrama = 0;
 	}
 	if (boardname) {
 		free(boardname); boardname = 0;
@@ -529,7 +529,7 @@ static int InitializeBoard(void) {
 				else
 					CHRRAMSize = 8;
                 CHRRAMSize <<= 10;
-				if ((UNIFchrrama = (uint8*)FCEU_malloc(CHRRAMSize))) {
+				if ((UNIFchrrama = (uint8*)FCEU_gmalloc(CHRRAMSize))) {
 					SetupCartCHRMapping(0, UNIFchrrama, CHRRAMSize, 1);
 					AddExState(UNIFchrrama, CHRRAMSize, 0, "CHRR");
 				} else
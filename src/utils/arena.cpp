@@ -0,0 +1,98 @@
+/// \file
+/// \brief the machine memory arena: RAM, work RAM, CHR RAM, extra nametables and the mappers'
+/// buffers all come from FCEU_gmalloc, which carves them out of one reserved block. allocated one
+/// after the other as a game loads, they end up next to each other, and the raw snapshots copy
+/// them in a run or two instead of one memcpy each
+
+#include <string.h>
+#include <vector>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "arena.h"
+
+//every region starts on this boundary; allocations are sizes like 0x800 and 0x2000, so it leaves
+//no gaps between them
+#define ARENA_ALIGN 16
+
+//the regions in use, in address order
+struct ARENAREGION
+{
+	uint32 offset;
+	uint32 size;
+};
+
+static uint8 *base;
+static bool failed;
+static std::vector<ARENAREGION> regions;
+
+static bool Reserve()
+{
+	if(base || failed)
+		return base!=NULL;
+#ifdef WIN32
+	base=(uint8*)VirtualAlloc(NULL,FCEU_ARENA_SIZE,MEM_RESERVE|MEM_COMMIT,PAGE_READWRITE);
+#else
+	#ifndef MAP_ANONYMOUS
+	#define MAP_ANONYMOUS MAP_ANON
+	#endif
+	#ifndef MAP_NORESERVE
+	#define MAP_NORESERVE 0
+	#endif
+	void *p=mmap(NULL,FCEU_ARENA_SIZE,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE,-1,0);
+	base=p==MAP_FAILED ? NULL : (uint8*)p;
+#endif
+	failed=!base;
+	return base!=NULL;
+}
+
+void *FCEU_ArenaAlloc(uint32 size)
+{
+	if(!size || size>FCEU_ARENA_SIZE || !Reserve())
+		return NULL;
+	size=(size+ARENA_ALIGN-1)&~(ARENA_ALIGN-1);
+
+	//the first gap it fits in, so that a game loaded after another reuses the same places
+	uint32 at=0;
+	size_t i;
+	for(i=0;i<regions.size();i++)
+	{
+		if(regions[i].offset-at>=size)
+			break;
+		at=regions[i].offset+regions[i].size;
+	}
+	if(FCEU_ARENA_SIZE-at<size)
+		return NULL;
+
+	ARENAREGION r;
+	r.offset=at;
+	r.size=size;
+	regions.insert(regions.begin()+i,r);
+	memset(base+at,0,size);
+	return base+at;
+}
+
+bool FCEU_ArenaFree(void *ptr)
+{
+	if(!FCEU_ArenaContains(ptr))
+		return false;
+	uint32 offset=(uint32)((uint8*)ptr-base);
+	for(size_t i=0;i<regions.size();i++)
+	{
+		if(regions[i].offset==offset)
+		{
+			regions.erase(regions.begin()+i);
+			break;
+		}
+	}
+	return true;
+}
+
+bool FCEU_ArenaContains(const void *ptr)
+{
+	return base && (const uint8*)ptr>=base && (const uint8*)ptr<base+FCEU_ARENA_SIZE;
+}
@@ -0,0 +1,20 @@
+/// \file
+/// \brief the machine memory arena: one page-aligned block that the game's memory is carved out
+/// of, so that snapshots find it together
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include "../types.h"
+
+//address space the arena reserves. pages are only backed once they are used, and allocations
+//past it fall back to the heap
+#define FCEU_ARENA_SIZE (16 << 20)
+
+//size zeroed bytes from the arena, or NULL when it has no room left
+void *FCEU_ArenaAlloc(uint32 size);
+//false, doing nothing, when ptr did not come from the arena
+bool FCEU_ArenaFree(void *ptr);
+bool FCEU_ArenaContains(const void *ptr);
+
+#endif
@@ -0,0 +1,174 @@
+/// \file
+/// \brief fast 64 and 128 bit hashes for comparing machine state. the data is taken 64 bytes at a time
+/// into eight independent lanes, each adding a 32x32 bit product of the data and a key, which
+/// SSE2 does two lanes to a register
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hash.h"
+
+#define HASH_LANES 8
+#define HASH_STRIPE (HASH_LANES*8)
+//the lanes are scrambled after this many stripes, so long runs of data do not just add up
+#define HASH_SCRAMBLE 16
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+
+//the keys the data is mixed with, then the ones the lanes are scrambled with
+static const uint64 Keys[HASH_LANES*2] = {
+	0x8C9FF21EB4943E94ULL, 0x529BCFD80991254CULL, 0x12B8EB6D931B5E6EULL, 0xCEC50C5D0C1FCC21ULL,
+	0x31F5796E26EF1CA1ULL, 0x6FAD0E5AD91DFF82ULL, 0x061C22C6F5405433ULL, 0xACEBED3BE37886A1ULL,
+	0x0D81E8485A2713A6ULL, 0xA3E600F8F1FD238CULL, 0xEF1382C779E55F8EULL, 0xFE2C41FF60885D40ULL,
+	0x94CBB826DAC34BB2ULL, 0xB502428724A731F6ULL, 0xD0BEC29520B72715ULL, 0x81335F7CACFEBD80ULL,
+};
+
+#ifdef __SSE2__
+
+static void Stripes(uint64 *acc, const uint8 *p, size_t count)
+{
+	__m128i a[HASH_LANES/2];
+	for(int i=0;i<HASH_LANES/2;i++)
+		a[i]=_mm_loadu_si128((const __m128i*)acc+i);
+	for(size_t n=0;n<count;n++,p+=HASH_STRIPE)
+	{
+		for(int i=0;i<HASH_LANES/2;i++)
+		{
+			__m128i d=_mm_loadu_si128((const __m128i*)p+i);
+			__m128i k=_mm_xor_si128(d,_mm_loadu_si128((const __m128i*)Keys+i));
+			//the low half of each lane times its high half, and the data added to the other lane
+			__m128i product=_mm_mul_epu32(k,_mm_shuffle_epi32(k,_MM_SHUFFLE(0,3,0,1)));
+			__m128i swapped=_mm_shuffle_epi32(d,_MM_SHUFFLE(1,0,3,2));
+			a[i]=_mm_add_epi64(a[i],_mm_add_epi64(product,swapped));
+		}
+	}
+	for(int i=0;i<HASH_LANES/2;i++)
+		_mm_storeu_si128((__m128i*)acc+i,a[i]);
+}
+
+static void Scramble(uint64 *acc)
+{
+	const __m128i prime=_mm_set1_epi32(PRIME32_1);
+	for(int i=0;i<HASH_LANES/2;i++)
+	{
+		__m128i a=_mm_loadu_si128((const __m128i*)acc+i);
+		a=_mm_xor_si128(a,_mm_srli_epi64(a,47));
+		a=_mm_xor_si128(a,_mm_loadu_si128((const __m128i*)(Keys+HASH_LANES)+i));
+		//a 64 bit times 32 bit multiply, from two 32x32 bit ones
+		__m128i lo=_mm_mul_epu32(a,prime);
+		__m128i hi=_mm_mul_epu32(_mm_srli_epi64(a,32),prime);
+		_mm_storeu_si128((__m128i*)acc+i,_mm_add_epi64(lo,_mm_slli_epi64(hi,32)));
+	}
+}
+
+#else
+
+static INLINE uint64 Read64(const uint8 *p)
+{
+#ifdef LSB_FIRST
+	uint64 v;
+	memcpy(&v,p,8);
+	return v;
+#else
+	return (uint64)p[0]|((uint64)p[1]<<8)|((uint64)p[2]<<16)|((uint64)p[3]<<24)
+		|((uint64)p[4]<<32)|((uint64)p[5]<<40)|((uint64)p[6]<<48)|((uint64)p[7]<<56);
+#endif
+}
+
+static void Stripes(uint64 *acc, const uint8 *p, size_t count)
+{
+	for(size_t n=0;n<count;n++,p+=HASH_STRIPE)
+	{
+		for(int i=0;i<HASH_LANES;i++)
+		{
+			uint64 d=Read64(p+i*8);
+			uint64 k=d^Keys[i];
+			acc[i]+=(k&0xFFFFFFFF)*(k>>32);
+			acc[i^1]+=d;
+		}
+	}
+}
+
+static void Scramble(uint64 *acc)
+{
+	for(int i=0;i<HASH_LANES;i++)
+	{
+		uint64 a=acc[i];
+		a^=a>>47;
+		a^=Keys[HASH_LANES+i];
+		acc[i]=a*PRIME32_1;
+	}
+}
+
+#endif
+
+static INLINE uint64 Avalanche(uint64 h)
+{
+	h^=h>>33;
+	h*=PRIME64_2;
+	h^=h>>29;
+	h*=PRIME64_3;
+	h^=h>>32;
+	return h;
+}
+
+static void Accumulate(uint64 *acc, const void *data, size_t size, uint64 seed)
+{
+	const uint8 *p=(const uint8*)data;
+	for(int i=0;i<HASH_LANES;i++)
+		acc[i]=Keys[i]+seed;
+
+	size_t stripes=size/HASH_STRIPE;
+	while(stripes)
+	{
+		size_t n=stripes<HASH_SCRAMBLE ? stripes : HASH_SCRAMBLE;
+		Stripes(acc,p,n);
+		if(n==HASH_SCRAMBLE)
+			Scramble(acc);
+		p+=n*HASH_STRIPE;
+		stripes-=n;
+	}
+	//the rest, padded with zeros; the size goes into the result, so the padding does not collide
+	size_t rest=size%HASH_STRIPE;
+	if(rest)
+	{
+		uint8 last[HASH_STRIPE];
+		memset(last,0,sizeof(last));
+		memcpy(last,p,rest);
+		Stripes(acc,last,1);
+	}
+}
+
+uint64 FCEU_Hash64(const void *data, size_t size, uint64 seed)
+{
+	uint64 acc[HASH_LANES];
+	Accumulate(acc,data,size,seed);
+	uint64 h=seed^(size*PRIME64_1);
+	for(int i=0;i<HASH_LANES;i++)
+		h=(h^Avalanche(acc[i]))*PRIME64_1+PRIME64_4;
+	return Avalanche(h);
+}
+
+void FCEU_Hash128(const void *data, size_t size, uint64 out[2], uint64 seed)
+{
+	uint64 acc[HASH_LANES];
+	Accumulate(acc,data,size,seed);
+	uint64 lo=seed^(size*PRIME64_1);
+	uint64 hi=~seed^(size*PRIME64_2);
+	for(int i=0;i<HASH_LANES;i++)
+	{
+		uint64 a=Avalanche(acc[i]);
+		lo=(lo^a)*PRIME64_1+PRIME64_4;
+		//the other way round, so no lane lines up with the same step in both halves
+		hi=(hi^Avalanche(acc[HASH_LANES-1-i]^PRIME64_3))*PRIME64_2+PRIME64_1;
+	}
+	out[0]=Avalanche(lo);
+	out[1]=Avalanche(hi);
+}
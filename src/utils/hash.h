@@ -0,0 +1,16 @@
+/// \file
+/// \brief fast 64 and 128 bit hashes for comparing machine state between runs
+
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include "../types.h"
+
+//the SSE2 and the plain versions give the same hashes, on either byte order, so hashes from
+//different builds and machines can be compared
+uint64 FCEU_Hash64(const void *data, size_t size, uint64 seed=0);
+//the same lanes merged a second way for the high half; the low half is FCEU_Hash64's
+void FCEU_Hash128(const void *data, size_t size, uint64 out[2], uint64 seed=0);
+
+#endif
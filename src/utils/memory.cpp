@@ -27,12 +27,17 @@
 #include "../types.h"
 #include "../fceu.h"
 #include "memory.h"
+#include "arena.h"
 
-///allocates the specified number of bytes. exits process if this fails
+///allocates the specified number of bytes for the game's memory. exits process if this fails
 void *FCEU_gmalloc(uint32 size)
 {
 	
  void *ret;
+ //it goes in the arena, zeroed, while there is room
+ ret=FCEU_ArenaAlloc(size);
+ if(ret)
+  return ret;
  ret=malloc(size);
  if(!ret)  
  {
@@ -68,13 +73,14 @@ void *FCEU_malloc(uint32 size)
 ///frees memory allocated with FCEU_gmalloc
 void FCEU_gfree(void *ptr)
 {
- free(ptr);
+ if(!FCEU_ArenaFree(ptr))
+  free(ptr);
 }
 
 ///frees memory allocated with FCEU_malloc
 void FCEU_free(void *ptr)    // Might do something with this and FCEU_malloc later...
 {
- free(ptr);
+ FCEU_gfree(ptr);
 }
 
 void *FCEU_dmalloc(uint32 size)
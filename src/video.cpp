@@ -27,10 +27,12 @@
 #include "state.h"
 #include "movie.h"
 #include "palette.h"
+#include "snapshot.h"
 #include "nsf.h"
 #include "input.h"
 #include "vsuni.h"
 #include "drawing.h"
+#include "profile.h"
 #include "driver.h"
 #include "drivers/common/vidblit.h"
 #ifdef _S9XLUA_H
@@ -144,9 +146,19 @@ int FCEU_InitVirtualVideo(void)
 	return 1;
 }
 
+static bool HoldImage=false;
+
+void FCEU_HoldImage(bool hold)
+{
+	HoldImage=hold;
+}
+
 #ifdef FRAMESKIP
 void FCEU_PutImageDummy(void)
 {
+	FCEU_SnapshotPoll();
+	if(HoldImage)
+		return;
 	ShowFPS();
 	if(GameInfo->type!=GIT_NSF)
 	{
@@ -171,29 +183,96 @@ void FCEUI_SaveSnapshotAs(void)
 
 static void ReallySnap(void)
 {
-	int x=SaveSnapshot();
-	if(!x)
+	//the message comes when the writers are done with it
+	if(!SaveSnapshot())
 		FCEU_DispMessage("Error saving screen snapshot.",0);
-	else
-		FCEU_DispMessage("Screen snapshot %d saved.",0,x-1);
+}
+
+//lines of the picture that changed, one bit per line. the ppus compare each line they finish
+//with the back buffers, which hold the last picture without its overlays, so only those lines
+//need saving there. the overlays are found by comparing once more after they are drawn: a line
+//has to be redrawn when the ppu changed it, or it has an overlay now or had one last time.
+static uint32 RawDirty[FCEU_DIRTY_WORDS];
+static uint32 OverlayLines[FCEU_DIRTY_WORDS];
+//everything that changed since the driver last asked
+static uint32 ImageDirty[FCEU_DIRTY_WORDS];
+static bool ImageInvalid=true;
+
+void FCEU_CheckDirtyLine(int line)
+{
+	int ofs=line<<8;
+	if(memcmp(XBuf+ofs,XBackBuf+ofs,256) || memcmp(XDBuf+ofs,XDBackBuf+ofs,256))
+		RawDirty[line>>5]|=1u<<(line&31);
+}
+
+void FCEU_InvalidateImage()
+{
+	ImageInvalid=true;
+}
+
+void FCEUI_TakeDirtyLines(uint32 *lines)
+{
+	memcpy(lines,ImageDirty,sizeof(ImageDirty));
+	memset(ImageDirty,0,sizeof(ImageDirty));
+}
+
+static void SaveBackBuffer(void)
+{
+	if(ImageInvalid)
+	{
+		memcpy(XBackBuf, XBuf, 256*256);
+		memcpy(XDBackBuf, XDBuf, 256*256);
+		return;
+	}
+	for(int line=0;line<240;line++)
+	{
+		if(RawDirty[line>>5]&(1u<<(line&31)))
+		{
+			memcpy(XBackBuf+(line<<8), XBuf+(line<<8), 256);
+			memcpy(XDBackBuf+(line<<8), XDBuf+(line<<8), 256);
+		}
+	}
+}
+
+static void FinishImage(void)
+{
+	uint32 overlay[FCEU_DIRTY_WORDS]={0};
+	for(int line=0;line<240;line++)
+		if(memcmp(XBuf+(line<<8),XBackBuf+(line<<8),256))
+			overlay[line>>5]|=1u<<(line&31);
+
+	for(int i=0;i<FCEU_DIRTY_WORDS;i++)
+	{
+		ImageDirty[i]|=RawDirty[i]|overlay[i]|OverlayLines[i];
+		OverlayLines[i]=overlay[i];
+	}
+	//the nsf screen is drawn from scratch every time
+	if(ImageInvalid || GameInfo->type==GIT_NSF)
+		memset(ImageDirty,0xFF,sizeof(ImageDirty));
+	ImageInvalid=false;
+
+	//while paused the back buffer was left alone, so the lines still differ from it
+	if(!FCEUI_EmulationPaused())
+		memset(RawDirty,0,sizeof(RawDirty));
 }
 
 void FCEU_PutImage(void)
 {
+	FCEU_SnapshotPoll();
+	if(HoldImage)
+		return;
 	if(dosnapsave==2)	//Save screenshot as, currently only flagged & run by the Win32 build. //TODO SDL: implement this?
 	{
 		char nameo[512];
 		strcpy(nameo,FCEUI_GetSnapshotAsName().c_str());
-		if (nameo[0])
-		{
-			SaveSnapshot(nameo);
-			FCEU_DispMessage("Snapshot Saved.",0);
-		}
+		if (nameo[0] && !SaveSnapshot(nameo))
+			FCEU_DispMessage("Error saving screen snapshot.",0);
 		dosnapsave=0;
 	}
 	if(GameInfo->type==GIT_NSF)
 	{
 		DrawNSF(XBuf);
+		FCEU_BurstFrame();
 
 #ifdef _S9XLUA_H
 		FCEU_LuaGui(XBuf);
@@ -210,7 +289,8 @@ void FCEU_PutImage(void)
 	{
 		//Save backbuffer before overlay stuff is written.
 		if(!FCEUI_EmulationPaused())
-			memcpy(XBackBuf, XBuf, 256*256);
+			SaveBackBuffer();
+		FCEU_BurstFrame();
 
 		//Some messages need to be displayed before the avi is dumped
 		DrawMessage(true);
@@ -238,6 +318,7 @@ void FCEU_PutImage(void)
 		FCEU_DrawNTSCControlBars(XBuf);
 		FCEU_DrawRecordingStatus(XBuf);
 		ShowFPS();
+		FCEU_DrawProfile(XBuf);
 	}
 
 	if(FCEUD_ShouldDrawInputAids())
@@ -436,6 +517,7 @@ void FCEU_PutImage(void)
 		}
 	} else DrawMessage(false);
 
+	FinishImage();
 }
 void snapAVI()
 {
@@ -501,40 +583,6 @@ void FCEU_ResetMessages()
 }
 
 
-static int WritePNGChunk(FILE *fp, uint32 size, char *type, uint8 *data)
-{
-	uint32 crc;
-
-	uint8 tempo[4];
-
-	tempo[0]=size>>24;
-	tempo[1]=size>>16;
-	tempo[2]=size>>8;
-	tempo[3]=size;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	if(fwrite(type,4,1,fp)!=1)
-		return 0;
-
-	if(size)
-		if(fwrite(data,1,size,fp)!=size)
-			return 0;
-
-	crc=CalcCRC32(0,(uint8 *)type,4);
-	if(size)
-		crc=CalcCRC32(crc,data,size);
-
-	tempo[0]=crc>>24;
-	tempo[1]=crc>>16;
-	tempo[2]=crc>>8;
-	tempo[3]=crc;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	return 1;
-}
-
 uint32 GetScreenPixel(int x, int y, bool usebackup) {
 
 	uint8 r,g,b;
@@ -563,196 +611,29 @@ int GetScreenPixelPalette(int x, int y, bool usebackup) {
 
 }
 
+//the png is written by the snapshot writers; the number is the one in the file name, plus one
 int SaveSnapshot(void)
 {
-	int totallines=FSettings.LastSLine-FSettings.FirstSLine+1;
-	int x,u,y;
-	FILE *pp=NULL;
-	uint8 *compmem=NULL;
-	uLongf compmemsize=(totallines*263+12)*3;
-
-	if(!(compmem=(uint8 *)FCEU_malloc(compmemsize)))
-		return 0;
-
+	FILE *pp;
+	unsigned int u;
 	for (u = lastu; u < 99999; ++u)
 	{
 		pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"rb");
 		if(pp==NULL) break;
 		fclose(pp);
 	}
-	lastu = u;
 
-	if(!(pp=FCEUD_UTF8fopen(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),"wb")))
-	{
-		free(compmem);
+	if(!FCEU_SnapshotQueue(FCEU_MakeFName(FCEUMKF_SNAP,u,"png").c_str(),u))
 		return 0;
-	}
-
-	{
-		static const uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
-	}
-
-	{
-		uint8 chunko[13];
-
-		chunko[0]=chunko[1]=chunko[3]=0;
-		chunko[2]=0x1;			// Width of 256
-
-		chunko[4]=chunko[5]=chunko[6]=0;
-		chunko[7]=totallines;			// Height
-
-		chunko[8]=8;				// 8 bits per sample(24 bits per pixel)
-		chunko[9]=2;				// Color type; RGB triplet
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
-
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
-	}
-
-	{
-		uint8 *tmp=XBuf+FSettings.FirstSLine*256;
-		uint8 *dest,*mal,*mork;
-
-		int bufsize = (256*3+1)*totallines;
-		if(!(mal=mork=dest=(uint8 *)FCEU_dmalloc(bufsize)))
-			goto PNGerr;
-		//   mork=dest=XBuf;
-
-		for(y=0;y<totallines;y++)
-		{
-			*dest=0;			// No filter.
-			dest++;
-			for(x=256;x;x--)
-			{
-				u32 color = ModernDeemphColorMap(tmp);
-				*dest++=(color>>0x10)&0xFF;
-				*dest++=(color>>0x08)&0xFF;
-				*dest++=(color>>0x00)&0xFF;
-				tmp++;
-			}
-		}
-
-		if(compress(compmem,&compmemsize,mork,bufsize)!=Z_OK)
-		{
-			if(mal) free(mal);
-			goto PNGerr;
-		}
-		if(mal) free(mal);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
-	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
-
-	free(compmem);
-	fclose(pp);
-
+	//the file is not there yet for the next snapshot to find
+	lastu = u+1;
 	return u+1;
-
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
 }
 
 //overloaded SaveSnapshot for "Savesnapshot As" function
 int SaveSnapshot(char fileName[512])
 {
-	int totallines=FSettings.LastSLine-FSettings.FirstSLine+1;
-	int x,y;
-	FILE *pp=NULL;
-	uint8 *compmem=NULL;
-	uLongf compmemsize=totallines*263+12;
-
-	if(!(compmem=(uint8 *)FCEU_malloc(compmemsize)))
-		return 0;
-
-	if(!(pp=FCEUD_UTF8fopen(fileName,"wb")))
-	{
-		free(compmem);
-		return 0;
-	}
-
-	{
-		static uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
-	}
-
-	{
-		uint8 chunko[13];
-
-		chunko[0]=chunko[1]=chunko[3]=0;
-		chunko[2]=0x1;			// Width of 256
-
-		chunko[4]=chunko[5]=chunko[6]=0;
-		chunko[7]=totallines;			// Height
-
-		chunko[8]=8;				// bit depth
-		chunko[9]=3;				// Color type; indexed 8-bit
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
-
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
-	}
-
-	{
-		uint8 pdata[256*3];
-		for(x=0;x<256;x++)
-			FCEUD_GetPalette(x,pdata+x*3,pdata+x*3+1,pdata+x*3+2);
-		if(!WritePNGChunk(pp,256*3,"PLTE",pdata))
-			goto PNGerr;
-	}
-
-	{
-		uint8 *tmp=XBuf+FSettings.FirstSLine*256;
-		uint8 *dest,*mal,*mork;
-
-		if(!(mal=mork=dest=(uint8 *)FCEU_dmalloc((totallines<<8)+totallines)))
-			goto PNGerr;
-		//   mork=dest=XBuf;
-
-		for(y=0;y<totallines;y++)
-		{
-			*dest=0;			// No filter.
-			dest++;
-			for(x=256;x;x--,tmp++,dest++)
-				*dest=*tmp;
-		}
-
-		if(compress(compmem,&compmemsize,mork,(totallines<<8)+totallines)!=Z_OK)
-		{
-			if(mal) free(mal);
-			goto PNGerr;
-		}
-		if(mal) free(mal);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
-	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
-
-	free(compmem);
-	fclose(pp);
-
-	return 0;
-
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
+	return FCEU_SnapshotQueue(fileName,SNAPSHOT_NAMED) ? 1 : 0;
 }
 // called when another ROM is opened
 void ResetScreenshotsCounter()
@@ -12,6 +12,11 @@ extern uint8 *XBackBuf;
 extern uint8 *XDBuf;
 extern uint8 *XDBackBuf;
 extern int ClipSidesOffset;
+
+//called by the ppus for each line of XBuf and XDBuf they finish
+void FCEU_CheckDirtyLine(int line);
+//for whatever replaces the picture or the back buffer wholesale: the next picture is all redrawn
+void FCEU_InvalidateImage();
 extern struct GUIMESSAGE
 {
 	//countdown for gui messages
@@ -78,6 +78,10 @@ int FCEUI_EndWaveRecord()
  return 1;
 }
 
+bool FCEUI_WaveRecordRunning(void)
+{
+ return soundlog != 0;
+}
 
 bool FCEUI_BeginWaveRecord(const char *fn)
 {
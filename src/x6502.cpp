@@ -22,7 +22,11 @@
 #include "x6502.h"
 #include "fceu.h"
 #include "debug.h"
+#include "cart.h"
+#include "profile.h"
 #include "sound.h"
+#include "trace.h"
+#include "state.h"
 #ifdef _S9XLUA_H
 #include "fceulua.h"
 #endif
@@ -30,6 +34,7 @@
 #include "x6502abbrev.h"
 
 #include <cstring>
+#include <cstddef>
 X6502 X;
 uint32 timestamp;
 void (*MapIRQHook)(int a);
@@ -48,15 +53,79 @@ static INLINE uint8 RdMem(unsigned int A)
  return(_DB=ARead[A](A));
 }
 
+//the optional work in the cpu loop. X6502_Run is compiled once for each combination, so the
+//variants without a feature do not even test for it
+#define CPU_HOOKS    1 //lua write and exec hooks
+#define CPU_DEBUGGER 2 //breakpoints and tracing, through DebugCycle
+#define CPU_CDL      4 //the code/data logger
+#define CPU_TRACE    8 //the instruction trace recorder
+
 //normal memory write
+template<int F>
 static INLINE void WrMem(unsigned int A, uint8 V)
 {
 	BWrite[A](A,V);
 	#ifdef _S9XLUA_H
-	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
+	if(F & CPU_HOOKS)
+		CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
 	#endif
 }
 
+//code/data logging, done by the cpu loop itself as it fetches instructions and reads the data
+//they work on. the bits are the .cdl format's
+static int cdlindirect; //the last instruction was an indirect jmp
+static uint8 cdlmemop;  //the current instruction reads through a pointer
+
+//where A is in the prg rom, or -1
+static INLINE ptrdiff_t CDLAddress(unsigned int A)
+{
+ ptrdiff_t j=&Page[A>>11][A]-PRGptr[0];
+ return (j>=0 && j<(ptrdiff_t)cdloggerdataSize) ? j : -1;
+}
+
+static INLINE void LogCDCode(uint8 op)
+{
+ ptrdiff_t j=CDLAddress(_PC);
+ if(j!=-1)
+ {
+  for(int i=0;i<opsize[op] && j+i<(ptrdiff_t)cdloggerdataSize;i++)
+  {
+   uint8 &b=cdloggerdata[j+i];
+   if(b & 1)
+    continue;
+   if(!(b & 2))
+    undefinedcount--;
+   b|=1 | (((_PC+i)>>11)&0x0c) | (((_PC&0x8000)>>8)^0x80) | (cdlindirect ? 0x10 : 0);
+   codecount++;
+  }
+ }
+ cdlindirect=op==0x6C;
+ cdlmemop=(optype[op]==1 || optype[op]==4) ? 0x20 : 0;
+}
+
+static INLINE void LogCDRead(unsigned int A)
+{
+ ptrdiff_t j=CDLAddress(A);
+ if(j==-1)
+  return;
+ uint8 &b=cdloggerdata[j];
+ if(b & 2)
+  return;
+ if(!(b & 1))
+  undefinedcount--;
+ b|=2 | ((A>>11)&0x0c) | cdlmemop;
+ datacount++;
+}
+
+//a read of the data an instruction works on, as opposed to an opcode, operand or dummy read
+template<int F>
+static INLINE uint8 RdData(unsigned int A)
+{
+ if(F & CPU_CDL)
+  LogCDRead(A);
+ return RdMem(A);
+}
+
 static INLINE uint8 RdRAM(unsigned int A)
 {
   //bbit edited: this was changed so cheat substituion would work
@@ -64,11 +133,14 @@ static INLINE uint8 RdRAM(unsigned int A)
   // return(_DB=RAM[A]);
 }
 
+template<int F>
 static INLINE void WrRAM(unsigned int A, uint8 V)
 {
 	RAM[A]=V;
+	StateHashDirty|=FCEU_HASH_RAM;
 	#ifdef _S9XLUA_H
-	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
+	if(F & CPU_HOOKS)
+		CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
 	#endif
 }
 
@@ -90,7 +162,7 @@ void X6502_DMW(uint32 A, uint8 V)
 #define PUSH(V) \
 {       \
  uint8 VTMP=V;  \
- WrRAM(0x100+_S,VTMP);  \
+ WrRAM<F>(0x100+_S,VTMP);  \
  _S--;  \
 }
 
@@ -303,35 +375,35 @@ static uint8 ZNTable[256];
 */
 
 #define RMW_A(op) {uint8 x=_A; op; _A=x; break; } /* Meh... */
-#define RMW_AB(op) {unsigned int A; uint8 x; GetAB(A); x=RdMem(A); WrMem(A,x); op; WrMem(A,x); break; }
-#define RMW_ABI(reg,op) {unsigned int A; uint8 x; GetABIWR(A,reg); x=RdMem(A); WrMem(A,x); op; WrMem(A,x); break; }
+#define RMW_AB(op) {unsigned int A; uint8 x; GetAB(A); x=RdData<F>(A); WrMem<F>(A,x); op; WrMem<F>(A,x); break; }
+#define RMW_ABI(reg,op) {unsigned int A; uint8 x; GetABIWR(A,reg); x=RdData<F>(A); WrMem<F>(A,x); op; WrMem<F>(A,x); break; }
 #define RMW_ABX(op)  RMW_ABI(_X,op)
 #define RMW_ABY(op)  RMW_ABI(_Y,op)
-#define RMW_IX(op)  {unsigned int A; uint8 x; GetIX(A); x=RdMem(A); WrMem(A,x); op; WrMem(A,x); break; }
-#define RMW_IY(op)  {unsigned int A; uint8 x; GetIYWR(A); x=RdMem(A); WrMem(A,x); op; WrMem(A,x); break; }
-#define RMW_ZP(op)  {uint8 A; uint8 x; GetZP(A); x=RdRAM(A); op; WrRAM(A,x); break; }
-#define RMW_ZPX(op) {uint8 A; uint8 x; GetZPI(A,_X); x=RdRAM(A); op; WrRAM(A,x); break;}
+#define RMW_IX(op)  {unsigned int A; uint8 x; GetIX(A); x=RdData<F>(A); WrMem<F>(A,x); op; WrMem<F>(A,x); break; }
+#define RMW_IY(op)  {unsigned int A; uint8 x; GetIYWR(A); x=RdData<F>(A); WrMem<F>(A,x); op; WrMem<F>(A,x); break; }
+#define RMW_ZP(op)  {uint8 A; uint8 x; GetZP(A); x=RdRAM(A); op; WrRAM<F>(A,x); break; }
+#define RMW_ZPX(op) {uint8 A; uint8 x; GetZPI(A,_X); x=RdRAM(A); op; WrRAM<F>(A,x); break;}
 
 #define LD_IM(op)  {uint8 x; x=RdMem(_PC); _PC++; op; break;}
 #define LD_ZP(op)  {uint8 A; uint8 x; GetZP(A); x=RdRAM(A); op; break;}
 #define LD_ZPX(op)  {uint8 A; uint8 x; GetZPI(A,_X); x=RdRAM(A); op; break;}
 #define LD_ZPY(op)  {uint8 A; uint8 x; GetZPI(A,_Y); x=RdRAM(A); op; break;}
-#define LD_AB(op)  {unsigned int A; uint8 x; GetAB(A); x=RdMem(A); op; break; }
-#define LD_ABI(reg,op)  {unsigned int A; uint8 x; GetABIRD(A,reg); x=RdMem(A); op; break;}
+#define LD_AB(op)  {unsigned int A; uint8 x; GetAB(A); x=RdData<F>(A); op; break; }
+#define LD_ABI(reg,op)  {unsigned int A; uint8 x; GetABIRD(A,reg); x=RdData<F>(A); op; break;}
 #define LD_ABX(op)  LD_ABI(_X,op)
 #define LD_ABY(op)  LD_ABI(_Y,op)
-#define LD_IX(op)  {unsigned int A; uint8 x; GetIX(A); x=RdMem(A); op; break;}
-#define LD_IY(op)  {unsigned int A; uint8 x; GetIYRD(A); x=RdMem(A); op; break;}
-
-#define ST_ZP(r)  {uint8 A; GetZP(A); WrRAM(A,r); break;}
-#define ST_ZPX(r)  {uint8 A; GetZPI(A,_X); WrRAM(A,r); break;}
-#define ST_ZPY(r)  {uint8 A; GetZPI(A,_Y); WrRAM(A,r); break;}
-#define ST_AB(r)  {unsigned int A; GetAB(A); WrMem(A,r); break;}
-#define ST_ABI(reg,r)  {unsigned int A; GetABIWR(A,reg); WrMem(A,r); break; }
+#define LD_IX(op)  {unsigned int A; uint8 x; GetIX(A); x=RdData<F>(A); op; break;}
+#define LD_IY(op)  {unsigned int A; uint8 x; GetIYRD(A); x=RdData<F>(A); op; break;}
+
+#define ST_ZP(r)  {uint8 A; GetZP(A); WrRAM<F>(A,r); break;}
+#define ST_ZPX(r)  {uint8 A; GetZPI(A,_X); WrRAM<F>(A,r); break;}
+#define ST_ZPY(r)  {uint8 A; GetZPI(A,_Y); WrRAM<F>(A,r); break;}
+#define ST_AB(r)  {unsigned int A; GetAB(A); WrMem<F>(A,r); break;}
+#define ST_ABI(reg,r)  {unsigned int A; GetABIWR(A,reg); WrMem<F>(A,r); break; }
 #define ST_ABX(r)  ST_ABI(_X,r)
 #define ST_ABY(r)  ST_ABI(_Y,r)
-#define ST_IX(r)  {unsigned int A; GetIX(A); WrMem(A,r); break; }
-#define ST_IY(r)  {unsigned int A; GetIYWR(A); WrMem(A,r); break; }
+#define ST_IX(r)  {unsigned int A; GetIX(A); WrMem<F>(A,r); break; }
+#define ST_IY(r)  {unsigned int A; GetIYWR(A); WrMem<F>(A,r); break; }
 
 static uint8 CycTable[256] =
 {
@@ -412,15 +484,34 @@ void X6502_Power(void)
  X6502_Reset();
 }
 
-void X6502_Run(int32 cycles)
+//the optional work that is needed right now
+static int CPUFeatures()
 {
-  if(PAL)
-   cycles*=15;    // 15*4=60
-  else
-   cycles*=16;    // 16*4=64
+ int f=0;
+ #ifdef _S9XLUA_H
+ if(FCEU_LuaMemHooksActive())
+  f|=CPU_HOOKS;
+ #endif
+ #ifdef FCEUDEF_DEBUGGER
+ if(DebuggerActive())
+  f|=CPU_DEBUGGER;
+ #endif
+ if(debug_loggingCD && cdloggerdata)
+  f|=CPU_CDL;
+ if(FCEU_TraceWanted())
+  f|=CPU_TRACE;
+ return f;
+}
+
+//runs until the cycles are used up, or until the features change under a variant whose lua hooks,
+//debugger or trace could have changed them
+template<int F>
+static void RunCPU()
+{
+  //the plain variants count instructions here and add them up on the way out, since nothing
+  //reads the counters in the meantime
+  uint32 instructions=0;
 
-  _count+=cycles;
-extern int test; test++;
   while(_count>0)
   {
    int32 temp;
@@ -430,7 +521,7 @@ extern int test; test++;
    {
     if(_IRQlow&FCEU_IQRESET)
     {
-	 DEBUG( if(debug_loggingCD) LogCDVectors(0xFFFC); )
+	 if(F & CPU_CDL) LogCDVectors(0xFFFC);
      _PC=RdMem(0xFFFC);
      _PC|=RdMem(0xFFFD)<<8;
      _jammed=0;
@@ -451,7 +542,7 @@ extern int test; test++;
       PUSH(_PC);
       PUSH((_P&~B_FLAG)|(U_FLAG));
       _P|=I_FLAG;
-	  DEBUG( if(debug_loggingCD) LogCDVectors(0xFFFA) );
+	  if(F & CPU_CDL) LogCDVectors(0xFFFA);
       _PC=RdMem(0xFFFA);
       _PC|=RdMem(0xFFFB)<<8;
       _IRQlow&=~FCEU_IQNMI;
@@ -466,7 +557,7 @@ extern int test; test++;
       PUSH(_PC);
       PUSH((_P&~B_FLAG)|(U_FLAG));
       _P|=I_FLAG;
-	  DEBUG( if(debug_loggingCD) LogCDVectors(0xFFFE) );
+	  if(F & CPU_CDL) LogCDVectors(0xFFFE);
       _PC=RdMem(0xFFFE);
       _PC|=RdMem(0xFFFF)<<8;
      }
@@ -475,35 +566,90 @@ extern int test; test++;
     if(_count<=0)
     {
      _PI=_P;
-     return;
+     break;
      } //Should increase accuracy without a
               //major speed hit.
    }
 
 	//will probably cause a major speed decrease on low-end systems
-   DEBUG( DebugCycle() );
+   DEBUG( if(F & CPU_DEBUGGER) DebugCycle() );
 
-   IncrementInstructionsCounters();
+   if(F & (CPU_HOOKS|CPU_DEBUGGER))
+    IncrementInstructionsCounters();
+   else
+    instructions++;
 
    _PI=_P;
    b1=RdMem(_PC);
+   if(F & CPU_CDL)
+    LogCDCode(b1);
+   if(F & CPU_TRACE)
+    FCEU_TraceInstruction(b1);
 
    ADDCYC(CycTable[b1]);
 
    temp=_tcount;
    _tcount=0;
-   if(MapIRQHook) MapIRQHook(temp);
+   if(MapIRQHook)
+   {
+    FCEU_PROFILE_COUNT(PROFILE_CPUIRQHOOK);
+    MapIRQHook(temp);
+   }
    
    if (scanline < normalscanlines || scanline == totalscanlines)
     FCEU_SoundCPUHook(temp);
    #ifdef _S9XLUA_H
-   CallRegisteredLuaMemHook(_PC, 1, 0, LUAMEMHOOK_EXEC);
+   if(F & CPU_HOOKS)
+    CallRegisteredLuaMemHook(_PC, 1, 0, LUAMEMHOOK_EXEC);
    #endif
    _PC++;
    switch(b1)
    {
     #include "ops.inc"
    }
+
+   if((F & (CPU_HOOKS|CPU_DEBUGGER|CPU_TRACE)) && CPUFeatures()!=F)
+    break;
+  }
+
+  total_instructions+=instructions;
+  delta_instructions+=instructions;
+}
+
+void X6502_Run(int32 cycles)
+{
+  FCEU_PROFILE_STAGE(PROFILE_CPU);
+
+  if(PAL)
+   cycles*=15;    // 15*4=60
+  else
+   cycles*=16;    // 16*4=64
+
+  _count+=cycles;
+extern int test; test++;
+  while(_count>0)
+  {
+   switch(CPUFeatures())
+   {
+    case 0: RunCPU<0>(); break;
+    case CPU_HOOKS: RunCPU<CPU_HOOKS>(); break;
+    case CPU_CDL: RunCPU<CPU_CDL>(); break;
+    case CPU_CDL|CPU_HOOKS: RunCPU<CPU_CDL|CPU_HOOKS>(); break;
+    case CPU_TRACE: RunCPU<CPU_TRACE>(); break;
+    case CPU_TRACE|CPU_HOOKS: RunCPU<CPU_TRACE|CPU_HOOKS>(); break;
+    case CPU_TRACE|CPU_CDL: RunCPU<CPU_TRACE|CPU_CDL>(); break;
+    case CPU_TRACE|CPU_CDL|CPU_HOOKS: RunCPU<CPU_TRACE|CPU_CDL|CPU_HOOKS>(); break;
+    #ifdef FCEUDEF_DEBUGGER
+    case CPU_DEBUGGER: RunCPU<CPU_DEBUGGER>(); break;
+    case CPU_DEBUGGER|CPU_HOOKS: RunCPU<CPU_DEBUGGER|CPU_HOOKS>(); break;
+    case CPU_CDL|CPU_DEBUGGER: RunCPU<CPU_CDL|CPU_DEBUGGER>(); break;
+    case CPU_CDL|CPU_DEBUGGER|CPU_HOOKS: RunCPU<CPU_CDL|CPU_DEBUGGER|CPU_HOOKS>(); break;
+    case CPU_TRACE|CPU_DEBUGGER: RunCPU<CPU_TRACE|CPU_DEBUGGER>(); break;
+    case CPU_TRACE|CPU_DEBUGGER|CPU_HOOKS: RunCPU<CPU_TRACE|CPU_DEBUGGER|CPU_HOOKS>(); break;
+    case CPU_TRACE|CPU_CDL|CPU_DEBUGGER: RunCPU<CPU_TRACE|CPU_CDL|CPU_DEBUGGER>(); break;
+    case CPU_TRACE|CPU_CDL|CPU_DEBUGGER|CPU_HOOKS: RunCPU<CPU_TRACE|CPU_CDL|CPU_DEBUGGER|CPU_HOOKS>(); break;
+    #endif
+   }
   }
 }
 